@@ -16,17 +16,237 @@
 #include "dng_area_task.h"
 
 #include "dng_abort_sniffer.h"
+#include "dng_exceptions.h"
 #include "dng_flags.h"
+#include "dng_memory.h"
+#include "dng_mutex.h"
 #include "dng_sdk_limits.h"
 #include "dng_tile_iterator.h"
 #include "dng_utils.h"
 
+#include <algorithm>
+
+#if qDNGThreadSafe && qLinux
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+#endif
+
 #if qImagecore
 extern bool gPrintTimings;
 #endif
 
 /*****************************************************************************/
 
+#if qDNGThreadSafe
+
+/*****************************************************************************/
+
+// Tile-level scheduling between area tasks of different priorities.  The
+// priority of a task is that of the sniffer it is performed with, and a task
+// without a sniffer runs at the maximum priority.  Before each tile, a
+// thread waits while a task of a higher priority is running, so a background
+// task yields its threads to a foreground one at the next tile boundary.
+// The longer a thread waits, the higher its priority counts for, so that
+// lower priority tasks always make progress.
+
+class dng_area_task_scheduler
+	{
+	
+	private:
+	
+		enum
+			{
+			
+			// A waiting thread gains one priority level this often.
+			
+			kAgingMilliseconds = 250
+			
+			};
+	
+		dng_mutex fMutex;
+		
+		dng_condition fCondition;
+		
+		uint32 fActive [dng_priority_count];
+		
+	public:
+	
+		dng_area_task_scheduler ()
+		
+			:	fMutex     ("dng_area_task_scheduler")
+			,	fCondition ()
+			
+			{
+			
+			for (uint32 level = 0; level < dng_priority_count; level++)
+				{
+				fActive [level] = 0;
+				}
+			
+			}
+			
+		void Enter (dng_priority priority)
+			{
+			
+			dng_lock_mutex lock (&fMutex);
+			
+			fActive [priority]++;
+			
+			}
+			
+		void Leave (dng_priority priority)
+			{
+			
+			dng_lock_mutex lock (&fMutex);
+			
+			fActive [priority]--;
+			
+			fCondition.Broadcast ();
+			
+			}
+			
+		void WaitTurn (dng_priority priority)
+			{
+			
+			if (priority >= dng_priority_maximum)
+				{
+				return;
+				}
+				
+			dng_lock_mutex lock (&fMutex);
+			
+			real64 start = -1.0;
+			
+			while (true)
+				{
+				
+				uint32 level = priority;
+				
+				real64 timeout = -1.0;
+				
+				if (start >= 0.0)
+					{
+					
+					real64 aging = kAgingMilliseconds * 0.001;
+					
+					real64 waited = TickTimeInSeconds () - start;
+					
+					uint32 steps = (uint32) (waited / aging);
+					
+					level = Min_uint32 (level + steps, dng_priority_maximum);
+					
+					timeout = (steps + 1) * aging - waited;
+					
+					}
+					
+				if (level >= MaxActive ())
+					{
+					return;
+					}
+					
+				if (start < 0.0)
+					{
+					start = TickTimeInSeconds ();
+					continue;
+					}
+					
+				fCondition.Wait (fMutex, timeout);
+				
+				}
+			
+			}
+			
+	private:
+	
+		dng_priority MaxActive () const
+			{
+			
+			// Assumes mutex is locked.
+			
+			for (uint32 level = dng_priority_maximum;
+				 level > dng_priority_minimum;
+				 level--)
+				{
+				
+				if (fActive [level])
+					{
+					return (dng_priority) level;
+					}
+					
+				}
+				
+			return dng_priority_minimum;
+			
+			}
+			
+		// Hidden copy constructor and assignment operator.
+
+		dng_area_task_scheduler (const dng_area_task_scheduler &);
+
+		dng_area_task_scheduler & operator= (const dng_area_task_scheduler &);
+		
+	};
+
+/*****************************************************************************/
+
+static dng_area_task_scheduler gAreaTaskScheduler;
+
+/*****************************************************************************/
+
+// Marks a task as running at a priority for the life of the object.
+
+class dng_area_task_schedule
+	{
+	
+	private:
+	
+		dng_priority fPriority;
+		
+	public:
+	
+		dng_area_task_schedule (dng_priority priority)
+		
+			:	fPriority (priority)
+			
+			{
+			
+			gAreaTaskScheduler.Enter (fPriority);
+			
+			}
+			
+		~dng_area_task_schedule ()
+			{
+			
+			gAreaTaskScheduler.Leave (fPriority);
+			
+			}
+			
+	private:
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_area_task_schedule (const dng_area_task_schedule &);
+
+		dng_area_task_schedule & operator= (const dng_area_task_schedule &);
+		
+	};
+
+/*****************************************************************************/
+
+static dng_priority TaskPriority (dng_abort_sniffer *sniffer)
+	{
+	
+	return sniffer ? sniffer->Priority () : dng_priority_maximum;
+	
+	}
+
+/*****************************************************************************/
+
+#endif	// qDNGThreadSafe
+
+/*****************************************************************************/
+
 dng_area_task::dng_area_task ()
 
 	:	fMaxThreads   (kMaxMPThreads)
@@ -188,6 +408,12 @@ void dng_area_task::ProcessOnThread (uint32 threadIndex,
 									 dng_abort_sniffer *sniffer)
 	{
 	
+	#if qDNGThreadSafe
+	
+	dng_priority priority = TaskPriority (sniffer);
+	
+	#endif
+	
 	dng_rect repeatingTile1 = RepeatingTile1 ();
 	dng_rect repeatingTile2 = RepeatingTile2 ();
 	dng_rect repeatingTile3 = RepeatingTile3 ();
@@ -235,6 +461,12 @@ void dng_area_task::ProcessOnThread (uint32 threadIndex,
 				while (iter4.GetOneTile (tile4))
 					{
 					
+					#if qDNGThreadSafe
+					
+					gAreaTaskScheduler.WaitTurn (priority);
+					
+					#endif
+					
 					dng_abort_sniffer::SniffForAbort (sniffer);
 					
 					Process (threadIndex, tile4, sniffer);
@@ -259,6 +491,12 @@ void dng_area_task::Perform (dng_area_task &task,
 	
 	dng_point tileSize (task.FindTileSize (area));
 		
+	#if qDNGThreadSafe
+	
+	dng_area_task_schedule schedule (TaskPriority (sniffer));
+	
+	#endif
+		
 	task.Start (1, tileSize, allocator, sniffer);
 	
 	task.ProcessOnThread (0, area, tileSize, sniffer);
@@ -268,3 +506,957 @@ void dng_area_task::Perform (dng_area_task &task,
 	}
 
 /*****************************************************************************/
+
+#if qDNGThreadSafe
+
+/*****************************************************************************/
+
+// Shared state for the threads of dng_area_task::PerformThreads.  The tile
+// list is split into bands of consecutive entries.  Each thread takes tiles
+// from the front of its own band, and once that is empty, steals from the
+// back of the band with the most tiles remaining.
+
+class dng_area_task_queue
+	{
+	
+	private:
+	
+		dng_area_task &fTask;
+		
+		const dng_std_vector<dng_rect> &fTiles;
+		
+		dng_priority fPriority;
+		
+		dng_mutex fMutex;
+		
+		uint32 fBands;
+		
+		uint32 fBandNext [kMaxMPThreads];
+		uint32 fBandEnd  [kMaxMPThreads];
+		
+		dng_error_code fError;
+		
+	public:
+	
+		dng_area_task_queue (dng_area_task &task,
+							 const dng_std_vector<dng_rect> &tiles,
+							 const dng_std_vector<uint32> &bandStart,
+							 dng_priority priority)
+		
+			:	fTask     (task)
+			,	fTiles    (tiles)
+			,	fPriority (priority)
+			,	fMutex    ("dng_area_task_queue")
+			,	fBands    ((uint32) bandStart.size ())
+			,	fError    (dng_error_none)
+			
+			{
+			
+			for (uint32 band = 0; band < fBands; band++)
+				{
+				
+				fBandNext [band] = bandStart [band];
+				
+				fBandEnd [band] = (band + 1 < fBands) ? bandStart [band + 1]
+													  : (uint32) tiles.size ();
+				
+				}
+			
+			}
+			
+		dng_error_code Error () const
+			{
+			return fError;
+			}
+			
+		void Run (uint32 threadIndex,
+				  dng_abort_sniffer *sniffer)
+			{
+			
+			uint32 ownBand = threadIndex % fBands;
+			
+			while (true)
+				{
+				
+				uint32 tileIndex;
+				
+				gAreaTaskScheduler.WaitTurn (fPriority);
+				
+					{
+					
+					dng_lock_mutex lock (&fMutex);
+					
+					if (fError != dng_error_none)
+						{
+						return;
+						}
+						
+					if (fBandNext [ownBand] < fBandEnd [ownBand])
+						{
+						
+						tileIndex = fBandNext [ownBand]++;
+						
+						}
+						
+					else
+						{
+						
+						uint32 victim = 0;
+						uint32 most   = 0;
+						
+						for (uint32 band = 0; band < fBands; band++)
+							{
+							
+							uint32 left = fBandEnd [band] - fBandNext [band];
+							
+							if (left > most)
+								{
+								victim = band;
+								most   = left;
+								}
+							
+							}
+							
+						if (most == 0)
+							{
+							return;
+							}
+							
+						tileIndex = --fBandEnd [victim];
+						
+						}
+					
+					}
+					
+				dng_error_code error = dng_error_none;
+					
+				try
+					{
+					
+					dng_abort_sniffer::SniffForAbort (sniffer);
+					
+					fTask.Process (threadIndex, fTiles [tileIndex], sniffer);
+					
+					}
+					
+				catch (const dng_exception &except)
+					{
+					
+					error = except.ErrorCode ();
+					
+					}
+					
+				catch (...)
+					{
+					
+					error = dng_error_unknown;
+					
+					}
+					
+				if (error != dng_error_none)
+					{
+					
+					dng_lock_mutex lock (&fMutex);
+					
+					if (fError == dng_error_none)
+						{
+						fError = error;
+						}
+						
+					return;
+					
+					}
+				
+				}
+				
+			}
+			
+	private:
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_area_task_queue (const dng_area_task_queue &);
+
+		dng_area_task_queue & operator= (const dng_area_task_queue &);
+		
+	};
+
+/*****************************************************************************/
+
+struct dng_area_task_thread_info
+	{
+	
+	dng_area_task_queue *fQueue;
+	
+	uint32 fThreadIndex;
+	
+	dng_abort_sniffer *fSniffer;
+	
+	// Bind the thread to fCPU, or let it run on any CPU if fCPU is -1.
+	
+	bool fBind;
+	
+	int32 fCPU;
+	
+	};
+
+/*****************************************************************************/
+
+// CPU affinity for the threads of dng_area_task::PerformThreads.  Only
+// implemented on Linux; elsewhere threads are left where the OS puts them.
+
+#if qLinux
+
+/*****************************************************************************/
+
+// Hands out disjoint sets of the CPUs the process may run on.  The CPUs are
+// listed one from each NUMA node in turn, so a reservation of several CPUs
+// is spread over the nodes.
+
+class dng_cpu_registry
+	{
+	
+	private:
+	
+		dng_mutex fMutex;
+		
+		bool fInitialized;
+		
+		cpu_set_t fProcessCPUs;
+		
+		dng_std_vector<int32> fOrder;
+		
+		dng_std_vector<bool> fReserved;
+		
+	public:
+	
+		dng_cpu_registry ()
+		
+			:	fMutex       ("dng_cpu_registry")
+			,	fInitialized (false)
+			,	fOrder       ()
+			,	fReserved    ()
+			
+			{
+			
+			CPU_ZERO (&fProcessCPUs);
+			
+			}
+			
+		uint32 Reserve (uint32 count,
+						int32 *cpus)
+			{
+			
+			dng_lock_mutex lock (&fMutex);
+			
+			Initialize ();
+			
+			uint32 reserved = 0;
+			
+			for (uint32 index = 0;
+				 index < (uint32) fOrder.size () && reserved < count;
+				 index++)
+				{
+				
+				if (!fReserved [index])
+					{
+					
+					fReserved [index] = true;
+					
+					cpus [reserved++] = fOrder [index];
+					
+					}
+				
+				}
+				
+			return reserved;
+			
+			}
+			
+		void Release (uint32 count,
+					  const int32 *cpus)
+			{
+			
+			dng_lock_mutex lock (&fMutex);
+			
+			for (uint32 index = 0; index < (uint32) fOrder.size (); index++)
+				{
+				
+				for (uint32 cpu = 0; cpu < count; cpu++)
+					{
+					
+					if (fOrder [index] == cpus [cpu])
+						{
+						fReserved [index] = false;
+						}
+					
+					}
+				
+				}
+			
+			}
+			
+		// Let the calling thread run on any CPU of the process, rather than
+		// only on those of the thread that created it.
+			
+		void Unbind ()
+			{
+			
+			cpu_set_t set;
+			
+				{
+				
+				dng_lock_mutex lock (&fMutex);
+				
+				Initialize ();
+				
+				set = fProcessCPUs;
+				
+				}
+				
+			if (CPU_COUNT (&set))
+				{
+				sched_setaffinity (0, sizeof (set), &set);
+				}
+			
+			}
+			
+		static bool Bind (int32 cpu)
+			{
+			
+			if (cpu < 0)
+				{
+				return false;
+				}
+				
+			cpu_set_t set;
+			
+			CPU_ZERO (&set);
+			
+			CPU_SET (cpu, &set);
+			
+			return sched_setaffinity (0, sizeof (set), &set) == 0;
+			
+			}
+			
+	private:
+	
+		// Called with fMutex held.  The process CPUs are those of the first
+		// thread to ask, which no reservation has bound yet.
+	
+		void Initialize ()
+			{
+			
+			if (fInitialized)
+				{
+				return;
+				}
+				
+			fInitialized = true;
+			
+			if (sched_getaffinity (0, sizeof (fProcessCPUs), &fProcessCPUs) != 0)
+				{
+				CPU_ZERO (&fProcessCPUs);
+				return;
+				}
+				
+			// Find the node of each CPU.  CPUs of no known node, including
+			// all of them without NUMA support, count as node 0.
+				
+			dng_std_vector<int32> node (CPU_SETSIZE, 0);
+			
+			int32 nodes = 1;
+			
+			if (DIR *dir = opendir ("/sys/devices/system/node"))
+				{
+				
+				while (struct dirent *entry = readdir (dir))
+					{
+					
+					unsigned nodeIndex;
+					
+					if (sscanf (entry->d_name, "node%u", &nodeIndex) != 1 ||
+						nodeIndex >= CPU_SETSIZE)
+						{
+						continue;
+						}
+						
+					char path [128];
+					
+					snprintf (path,
+							  sizeof (path),
+							  "/sys/devices/system/node/node%u/cpulist",
+							  nodeIndex);
+							  
+					FILE *file = fopen (path, "r");
+					
+					if (!file)
+						{
+						continue;
+						}
+						
+					// The list looks like "0-7,16-23".
+						
+					unsigned first;
+					unsigned last;
+					
+					while (fscanf (file, "%u", &first) == 1)
+						{
+						
+						last = first;
+						
+						int c = fgetc (file);
+						
+						if (c == '-')
+							{
+							
+							if (fscanf (file, "%u", &last) != 1)
+								{
+								break;
+								}
+								
+							c = fgetc (file);
+							
+							}
+							
+						for (unsigned cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+							{
+							node [cpu] = (int32) nodeIndex;
+							}
+							
+						nodes = Max_int32 (nodes, (int32) nodeIndex + 1);
+							
+						if (c != ',')
+							{
+							break;
+							}
+						
+						}
+						
+					fclose (file);
+					
+					}
+					
+				closedir (dir);
+				
+				}
+				
+			// List the CPUs of the process taking one from each node in turn.
+			
+			dng_std_vector<int32> next (nodes, 0);
+			
+			while (true)
+				{
+				
+				bool found = false;
+				
+				for (int32 nodeIndex = 0; nodeIndex < nodes; nodeIndex++)
+					{
+					
+					int32 &cpu = next [nodeIndex];
+					
+					while (cpu < CPU_SETSIZE && !(CPU_ISSET (cpu, &fProcessCPUs) &&
+												  node [cpu] == nodeIndex))
+						{
+						cpu++;
+						}
+						
+					if (cpu < CPU_SETSIZE)
+						{
+						
+						fOrder.push_back (cpu++);
+						
+						found = true;
+						
+						}
+					
+					}
+					
+				if (!found)
+					{
+					break;
+					}
+				
+				}
+				
+			fReserved.assign (fOrder.size (), false);
+			
+			}
+			
+	private:
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_cpu_registry (const dng_cpu_registry &);
+
+		dng_cpu_registry & operator= (const dng_cpu_registry &);
+		
+	};
+
+/*****************************************************************************/
+
+static dng_cpu_registry gCPURegistry;
+
+/*****************************************************************************/
+
+// Binds the calling thread to a CPU, and gives it its original affinity back
+// when destroyed.
+
+class dng_area_task_binding
+	{
+	
+	private:
+	
+		cpu_set_t fSaved;
+		
+		bool fBound;
+		
+	public:
+	
+		explicit dng_area_task_binding (int32 cpu)
+		
+			:	fBound (false)
+			
+			{
+			
+			CPU_ZERO (&fSaved);
+			
+			if (cpu >= 0 &&
+				sched_getaffinity (0, sizeof (fSaved), &fSaved) == 0)
+				{
+				fBound = dng_cpu_registry::Bind (cpu);
+				}
+			
+			}
+			
+		~dng_area_task_binding ()
+			{
+			
+			if (fBound)
+				{
+				sched_setaffinity (0, sizeof (fSaved), &fSaved);
+				}
+			
+			}
+			
+	private:
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_area_task_binding (const dng_area_task_binding &);
+
+		dng_area_task_binding & operator= (const dng_area_task_binding &);
+		
+	};
+
+/*****************************************************************************/
+
+#endif	// qLinux
+
+/*****************************************************************************/
+
+static void * dng_area_task_thread (void *arg)
+	{
+	
+	dng_area_task_thread_info *info = (dng_area_task_thread_info *) arg;
+	
+	#if qLinux
+	
+	if (info->fBind && !dng_cpu_registry::Bind (info->fCPU))
+		{
+		gCPURegistry.Unbind ();
+		}
+	
+	#endif
+	
+	info->fQueue->Run (info->fThreadIndex,
+					   info->fSniffer);
+	
+	return NULL;
+	
+	}
+
+/*****************************************************************************/
+
+// Sort key used to reorder the tile list of dng_area_task::PerformThreads.
+
+struct dng_area_task_tile_key
+	{
+	
+	uint64 fKey;
+	
+	uint32 fIndex;
+	
+	bool operator< (const dng_area_task_tile_key &other) const
+		{
+		return fKey < other.fKey;
+		}
+	
+	};
+
+/*****************************************************************************/
+
+static void SortTiles (dng_std_vector<dng_rect> &tiles,
+					   dng_std_vector<dng_area_task_tile_key> &keys)
+	{
+	
+	std::stable_sort (keys.begin (), keys.end ());
+	
+	dng_std_vector<dng_rect> sorted;
+	
+	sorted.reserve (tiles.size ());
+	
+	for (uint32 index = 0; index < (uint32) keys.size (); index++)
+		{
+		sorted.push_back (tiles [keys [index].fIndex]);
+		}
+		
+	tiles.swap (sorted);
+	
+	}
+
+/*****************************************************************************/
+
+#endif	// qDNGThreadSafe
+
+/*****************************************************************************/
+
+dng_cpu_reservation::dng_cpu_reservation (uint32 count)
+
+	:	fCount (0)
+	
+	{
+	
+	#if qDNGThreadSafe && qLinux
+	
+	fCount = gCPURegistry.Reserve (Min_uint32 (count, kMaxMPThreads), fCPU);
+	
+	#else
+	
+	(void) count;
+	
+	#endif
+	
+	}
+
+/*****************************************************************************/
+
+dng_cpu_reservation::~dng_cpu_reservation ()
+	{
+	
+	#if qDNGThreadSafe && qLinux
+	
+	gCPURegistry.Release (fCount, fCPU);
+	
+	#endif
+	
+	}
+
+/*****************************************************************************/
+
+void dng_area_task::PerformThreads (dng_area_task &task,
+									const dng_rect &area,
+									uint32 threadCount,
+									dng_memory_allocator *allocator,
+									dng_abort_sniffer *sniffer,
+									const dng_cpu_reservation *cpus)
+	{
+	
+	#if qDNGThreadSafe
+	
+	dng_point tileSize (task.FindTileSize (area));
+	
+	// Break the area into tiles, in the same order ProcessOnThread would
+	// visit them.
+	
+	dng_std_vector<dng_rect> tiles;
+	
+	dng_rect repeatingTile1 = task.RepeatingTile1 ();
+	dng_rect repeatingTile2 = task.RepeatingTile2 ();
+	dng_rect repeatingTile3 = task.RepeatingTile3 ();
+	
+	if (repeatingTile1.IsEmpty ())
+		{
+		repeatingTile1 = area;
+		}
+	
+	if (repeatingTile2.IsEmpty ())
+		{
+		repeatingTile2 = area;
+		}
+	
+	if (repeatingTile3.IsEmpty ())
+		{
+		repeatingTile3 = area;
+		}
+		
+	dng_rect tile1;
+	
+	dng_tile_iterator iter1 (repeatingTile3, area);
+	
+	while (iter1.GetOneTile (tile1))
+		{
+		
+		dng_rect tile2;
+		
+		dng_tile_iterator iter2 (repeatingTile2, tile1);
+		
+		while (iter2.GetOneTile (tile2))
+			{
+			
+			dng_rect tile3;
+			
+			dng_tile_iterator iter3 (repeatingTile1, tile2);
+			
+			while (iter3.GetOneTile (tile3))
+				{
+				
+				dng_rect tile4;
+				
+				dng_tile_iterator iter4 (tileSize, tile3);
+				
+				while (iter4.GetOneTile (tile4))
+					{
+					
+					tiles.push_back (tile4);
+					
+					}
+					
+				}
+				
+			}
+		
+		}
+		
+	// Don't use more threads than the task allows, or than there are
+	// tiles or minimum task areas to go around.
+	
+	uint64 minArea = Max_uint32 (task.MinTaskArea (), 1);
+	
+	uint64 areaThreads = ((uint64) area.W () * (uint64) area.H () + minArea - 1) / minArea;
+	
+	threadCount = Min_uint32 (threadCount, task.MaxThreads ());
+	threadCount = Min_uint32 (threadCount, kMaxMPThreads);
+	threadCount = Min_uint32 (threadCount, (uint32) tiles.size ());
+	
+	if (areaThreads < threadCount)
+		{
+		threadCount = (uint32) areaThreads;
+		}
+	
+	// Arrange the tiles in the order the task asks for.  Bound threads keep
+	// to their own rows, which are the rows whose pages they first touched
+	// in dng_host::Make_dng_image.
+	
+	bool bound = cpus && cpus->Count () && threadCount > 1;
+	
+	dng_std_vector<uint32> bandStart (1, 0);
+	
+	dng_tile_order order = task.TileOrder ();
+	
+	if (order == kTileOrder_Raster && bound)
+		{
+		order = kTileOrder_Rows;
+		}
+	
+	if ((order == kTileOrder_Bands || order == kTileOrder_Rows) && threadCount > 1)
+		{
+		
+		// Assign each tile to the band holding its left edge, or its top
+		// edge for row bands.  The stable sort keeps raster order within
+		// each band, so a thread walks through its band one tile row at a
+		// time.
+		
+		dng_std_vector<dng_area_task_tile_key> keys (tiles.size ());
+		
+		for (uint32 index = 0; index < (uint32) tiles.size (); index++)
+			{
+			
+			if (order == kTileOrder_Rows)
+				{
+				
+				uint64 offset = (uint64) (tiles [index].t - area.t);
+				
+				keys [index].fKey = (offset * threadCount) / area.H ();
+				
+				}
+				
+			else
+				{
+				
+				uint64 offset = (uint64) (tiles [index].l - area.l);
+				
+				keys [index].fKey = (offset * threadCount) / area.W ();
+				
+				}
+			
+			keys [index].fIndex = index;
+			
+			}
+			
+		SortTiles (tiles, keys);
+		
+		bandStart.clear ();
+		
+		for (uint32 index = 0; index < (uint32) keys.size (); index++)
+			{
+			
+			if (index == 0 || keys [index].fKey != keys [index - 1].fKey)
+				{
+				bandStart.push_back (index);
+				}
+			
+			}
+			
+		// If there are fewer tile columns, or rows, than threads, split the
+		// largest bands until every thread has a band of its own.
+		
+		while ((uint32) bandStart.size () < threadCount)
+			{
+			
+			uint32 tallest = 0;
+			uint32 most    = 0;
+			
+			for (uint32 band = 0; band < (uint32) bandStart.size (); band++)
+				{
+				
+				uint32 end = (band + 1 < (uint32) bandStart.size ()) ? bandStart [band + 1]
+																	 : (uint32) tiles.size ();
+				
+				if (end - bandStart [band] > most)
+					{
+					tallest = band;
+					most    = end - bandStart [band];
+					}
+				
+				}
+				
+			if (most < 2)
+				{
+				break;
+				}
+				
+			bandStart.insert (bandStart.begin () + tallest + 1,
+							  bandStart [tallest] + most / 2);
+			
+			}
+		
+		}
+		
+	else if (order == kTileOrder_Morton)
+		{
+		
+		// Interleave the bits of the tile grid coordinates.
+		
+		dng_std_vector<dng_area_task_tile_key> keys (tiles.size ());
+		
+		for (uint32 index = 0; index < (uint32) tiles.size (); index++)
+			{
+			
+			uint32 row = (uint32) (tiles [index].t - area.t) / (uint32) tileSize.v;
+			uint32 col = (uint32) (tiles [index].l - area.l) / (uint32) tileSize.h;
+			
+			uint64 key = 0;
+			
+			for (uint32 bit = 0; bit < 32; bit++)
+				{
+				
+				key |= (uint64) ((col >> bit) & 1) << (2 * bit);
+				key |= (uint64) ((row >> bit) & 1) << (2 * bit + 1);
+				
+				}
+				
+			keys [index].fKey   = key;
+			keys [index].fIndex = index;
+			
+			}
+			
+		SortTiles (tiles, keys);
+		
+		}
+	
+	if (threadCount > 1)
+		{
+		
+		dng_priority priority = TaskPriority (sniffer);
+		
+		dng_area_task_schedule schedule (priority);
+		
+		task.Start (threadCount, tileSize, allocator, sniffer);
+		
+		dng_area_task_queue queue (task, tiles, bandStart, priority);
+		
+		dng_abort_sniffer *threadSniffer = (sniffer && sniffer->ThreadSafe ())
+										 ? sniffer
+										 : NULL;
+		
+		dng_area_task_thread_info info [kMaxMPThreads];
+		
+		pthread_t thread [kMaxMPThreads];
+		
+		bool started [kMaxMPThreads];
+		
+		#if !qLinux
+		
+		bound = false;
+		
+		#endif
+		
+		for (uint32 threadIndex = 1; threadIndex < threadCount; threadIndex++)
+			{
+			
+			info [threadIndex].fQueue       = &queue;
+			info [threadIndex].fThreadIndex = threadIndex;
+			info [threadIndex].fSniffer     = threadSniffer;
+			info [threadIndex].fBind        = bound;
+			info [threadIndex].fCPU         = bound ? cpus->CPUForThread (threadIndex)
+													: -1;
+			
+			started [threadIndex] = pthread_create (&thread [threadIndex],
+													NULL,
+													dng_area_task_thread,
+													&info [threadIndex]) == 0;
+			
+			}
+			
+		#if qLinux
+		
+		dng_area_task_binding binding (bound ? cpus->CPUForThread (0) : -1);
+			
+		#endif
+		
+		queue.Run (0, sniffer);
+		
+		for (uint32 threadIndex = 1; threadIndex < threadCount; threadIndex++)
+			{
+			
+			if (started [threadIndex])
+				{
+				pthread_join (thread [threadIndex], NULL);
+				}
+			
+			}
+			
+		if (queue.Error () != dng_error_none)
+			{
+			Throw_dng_error (queue.Error ());
+			}
+			
+		task.Finish (threadCount);
+		
+		return;
+		
+		}
+	
+	#else
+	
+	(void) threadCount;
+	(void) cpus;
+	
+	#endif
+	
+	Perform (task, area, allocator, sniffer);
+	
+	}
+
+/*****************************************************************************/
@@ -24,10 +24,93 @@
 
 #include "dng_classes.h"
 #include "dng_point.h"
+#include "dng_sdk_limits.h"
 #include "dng_types.h"
 
 /*****************************************************************************/
 
+/// \brief Orders in which PerformThreads hands out tiles to its threads.
+
+enum dng_tile_order
+	{
+	
+	/// Tiles are handed out in raster order to whichever thread is free.
+	
+	kTileOrder_Raster = 0,
+	
+	/// Tile columns are split into one contiguous vertical band per thread.
+	/// Each thread walks down its own band, so consecutive tiles on a thread
+	/// share the source rows in their overlap. Idle threads steal from the
+	/// bottom of the band with the most work left.
+	
+	kTileOrder_Bands,
+	
+	/// Tile rows are split into one contiguous horizontal band per thread,
+	/// which is also a contiguous range of pages.  Idle threads steal from
+	/// the bottom of the band with the most work left.  PerformThreads uses
+	/// this in place of kTileOrder_Raster when its threads are bound to CPUs.
+	
+	kTileOrder_Rows,
+	
+	/// Tiles are handed out in Morton (Z-curve) order, so tiles processed
+	/// close together in time are also close together in the image.
+	
+	kTileOrder_Morton
+	
+	};
+
+/*****************************************************************************/
+
+/// \brief CPUs reserved for the threads of PerformThreads, disjoint from those
+/// of every other reservation alive in the process.  The CPUs are taken from
+/// the NUMA nodes in turn, so the threads of a reservation are spread over
+/// the nodes.  Only implemented on Linux in thread safe builds; elsewhere
+/// nothing is reserved.
+
+class dng_cpu_reservation
+	{
+	
+	private:
+	
+		uint32 fCount;
+		
+		int32 fCPU [kMaxMPThreads];
+		
+	public:
+	
+		/// Reserve up to count CPUs.  Fewer, or none, are reserved once the
+		/// other reservations hold the rest.
+	
+		explicit dng_cpu_reservation (uint32 count);
+		
+		~dng_cpu_reservation ();
+		
+		/// Number of CPUs reserved.
+		
+		uint32 Count () const
+			{
+			return fCount;
+			}
+			
+		/// CPU for thread threadIndex, or -1 if the thread is not bound.
+			
+		int32 CPUForThread (uint32 threadIndex) const
+			{
+			return threadIndex < fCount ? fCPU [threadIndex] : -1;
+			}
+			
+	private:
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_cpu_reservation (const dng_cpu_reservation &);
+
+		dng_cpu_reservation & operator= (const dng_cpu_reservation &);
+		
+	};
+
+/*****************************************************************************/
+
 /// \brief Abstract class for rectangular processing operations with support for partitioning across multiple processing resources and observing memory constraints.
 
 class dng_area_task
@@ -122,6 +205,27 @@ class dng_area_task
 		
 		virtual dng_rect RepeatingTile3 () const;
 
+		/// Hint for whether adjacent tiles of this task read overlapping source
+		/// areas, so processing them on the same thread one after the other
+		/// lets the second reuse source data still in cache. Default is false.
+
+		virtual bool ReusesSourceOverlap () const
+			{
+			return false;
+			}
+
+		/// Order in which PerformThreads hands out tiles. The default uses
+		/// kTileOrder_Bands for tasks that report ReusesSourceOverlap, and
+		/// kTileOrder_Raster otherwise. Results must not depend on the order.
+		///
+		/// \retval One of the dng_tile_order values.
+
+		virtual dng_tile_order TileOrder () const
+			{
+			return ReusesSourceOverlap () ? kTileOrder_Bands
+										  : kTileOrder_Raster;
+			}
+
 		/// Task startup method called before any processing is done on partitions.
 		/// The Start method is called before any processing is done and can be overridden to allocate temporary buffers, etc.
 		///
@@ -183,12 +287,40 @@ class dng_area_task
 		/// \param area The area on which mage processing should be performed.
 		/// \param allocator dng_memory_allocator to use for allocating temporary buffers, etc.
 		/// \param sniffer dng_abort_sniffer to use to check for user cancellation and progress updates.
+		/// Its priority is the priority of the task; see PerformThreads.
 
 		static void Perform (dng_area_task &task,
 				  			 const dng_rect &area,
 				  			 dng_memory_allocator *allocator,
 				  			 dng_abort_sniffer *sniffer);
 
+		/// Resource partitioner that splits the area into tiles and processes
+		/// them on up to threadCount threads, with each thread taking the next
+		/// unprocessed tile, in the task's TileOrder, until none remain.  The calling thread is used as
+		/// thread 0.  Falls back to Perform if only one thread is useful or if
+		/// the SDK is not built thread safe.
+		/// \param task The task to perform.
+		/// \param area The area on which image processing should be performed.
+		/// \param threadCount Maximum number of threads to use.
+		/// \param allocator dng_memory_allocator to use for allocating temporary buffers, etc.
+		/// \param sniffer dng_abort_sniffer to use to check for user cancellation and progress updates.
+		/// Only passed to the other threads if it is thread safe.  Its
+		/// priority, or dng_priority_maximum if NULL, is the priority of the
+		/// task.  Before each tile, a thread waits while a task of higher
+		/// priority is running, for at most a quarter second per level of
+		/// difference, so background tasks yield to interactive ones at tile
+		/// boundaries without being starved.
+		/// \param cpus If not NULL, thread N is bound to the Nth reserved CPU,
+		/// so that the same band of an area always runs on the same CPU, and
+		/// threads beyond the reservation may run on any CPU of the process.
+
+		static void PerformThreads (dng_area_task &task,
+									const dng_rect &area,
+									uint32 threadCount,
+									dng_memory_allocator *allocator,
+									dng_abort_sniffer *sniffer,
+									const dng_cpu_reservation *cpus = NULL);
+
 	};
 
 /*****************************************************************************/
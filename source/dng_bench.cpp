@@ -0,0 +1,1144 @@
+/*****************************************************************************/
+// Copyright 2006-2012 Adobe Systems Incorporated
+// All Rights Reserved.
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this file in
+// accordance with the terms of the Adobe license agreement accompanying it.
+/*****************************************************************************/
+
+// Pipeline benchmark.
+//
+// Runs the dng_validate pipeline (parse, stage 1 read, digest validation,
+// stage 2 and 3, render and rotate, resample, DNG and TIFF encode) over a
+// set of files at one or more thread counts, and writes per-stage wall time,
+// CPU time, allocation and peak memory figures as JSON.  Output files are
+// encoded to memory, so the figures do not include disk writes.
+
+/*****************************************************************************/
+
+#include "dng_color_space.h"
+#include "dng_exceptions.h"
+#include "dng_file_stream.h"
+#include "dng_globals.h"
+#include "dng_host.h"
+#include "dng_image_writer.h"
+#include "dng_info.h"
+#include "dng_memory.h"
+#include "dng_memory_stream.h"
+#include "dng_mutex.h"
+#include "dng_negative.h"
+#include "dng_render.h"
+#include "dng_resample.h"
+#include "dng_sdk_limits.h"
+#include "dng_string.h"
+#include "dng_string_list.h"
+#include "dng_tag_values.h"
+#include "dng_utils.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#if !qWinOS
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+/*****************************************************************************/
+
+#if qDNGValidateTarget
+
+/*****************************************************************************/
+
+#define kDNGBenchVersion "1.0"
+
+/*****************************************************************************/
+
+// Pipeline stages, in the order they run.
+
+enum
+	{
+	kBenchStage_Parse = 0,
+	kBenchStage_ReadStage1,
+	kBenchStage_ValidateDigest,
+	kBenchStage_BuildStage2,
+	kBenchStage_BuildStage3,
+	kBenchStage_Render,
+	kBenchStage_Resample,
+	kBenchStage_WriteDNG,
+	kBenchStage_WriteTIFF,
+	kBenchStage_Count
+	};
+
+static const char * const kBenchStageNames [kBenchStage_Count] =
+	{
+	"parse",
+	"read_stage1",
+	"validate_digest",
+	"build_stage2",
+	"build_stage3",
+	"render",
+	"resample",
+	"write_dng",
+	"write_tiff"
+	};
+
+/*****************************************************************************/
+
+// Allocator that counts the bytes allocated through it, and tracks the
+// peak of the bytes live at once since the last call to ResetPeak.
+
+class dng_bench_allocator: public dng_memory_allocator
+	{
+
+	private:
+
+		dng_mutex fMutex;
+
+		uint64 fAllocatedBytes;
+		uint64 fAllocatedCount;
+
+		uint64 fLiveBytes;
+		uint64 fPeakBytes;
+
+	public:
+
+		dng_bench_allocator ()
+
+			:	fMutex ("dng_bench_allocator")
+
+			,	fAllocatedBytes (0)
+			,	fAllocatedCount (0)
+			,	fLiveBytes      (0)
+			,	fPeakBytes      (0)
+
+			{
+
+			}
+
+		virtual dng_memory_block * Allocate (uint32 size);
+
+		virtual dng_memory_block * Allocate64 (uint64 size);
+
+		void Release (uint64 size)
+			{
+
+			dng_lock_mutex lock (&fMutex);
+
+			fLiveBytes -= size;
+
+			}
+
+		void ResetPeak ()
+			{
+
+			dng_lock_mutex lock (&fMutex);
+
+			fPeakBytes = fLiveBytes;
+
+			}
+
+		uint64 AllocatedBytes ()
+			{
+			dng_lock_mutex lock (&fMutex);
+			return fAllocatedBytes;
+			}
+
+		uint64 AllocatedCount ()
+			{
+			dng_lock_mutex lock (&fMutex);
+			return fAllocatedCount;
+			}
+
+		uint64 PeakBytes ()
+			{
+			dng_lock_mutex lock (&fMutex);
+			return fPeakBytes;
+			}
+
+	};
+
+/*****************************************************************************/
+
+// Block returned by dng_bench_allocator, wrapping a block from the default
+// allocator.
+
+class dng_bench_block: public dng_memory_block
+	{
+
+	private:
+
+		dng_bench_allocator &fAllocator;
+
+		AutoPtr<dng_memory_block> fBlock;
+
+	public:
+
+		dng_bench_block (dng_bench_allocator &allocator,
+						 uint64 size)
+
+			:	dng_memory_block (size)
+
+			,	fAllocator (allocator)
+			,	fBlock     (gDefaultDNGMemoryAllocator.Allocate64 (size))
+
+			{
+
+			SetBuffer (fBlock->Buffer ());
+
+			}
+
+		virtual ~dng_bench_block ()
+			{
+
+			fAllocator.Release (LogicalSize64 ());
+
+			}
+
+	private:
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_bench_block (const dng_bench_block &block);
+
+		dng_bench_block & operator= (const dng_bench_block &block);
+
+	};
+
+/*****************************************************************************/
+
+dng_memory_block * dng_bench_allocator::Allocate (uint32 size)
+	{
+
+	return Allocate64 (size);
+
+	}
+
+/*****************************************************************************/
+
+dng_memory_block * dng_bench_allocator::Allocate64 (uint64 size)
+	{
+
+	dng_memory_block *block = new dng_bench_block (*this, size);
+
+	if (!block)
+		{
+		ThrowMemoryFull ();
+		}
+
+	dng_lock_mutex lock (&fMutex);
+
+	fAllocatedBytes += size;
+	fAllocatedCount += 1;
+
+	fLiveBytes += size;
+
+	fPeakBytes = Max_uint64 (fPeakBytes, fLiveBytes);
+
+	return block;
+
+	}
+
+/*****************************************************************************/
+
+// Process CPU time (all threads) in seconds.
+
+static real64 BenchCPUTime ()
+	{
+
+	#if !qWinOS
+
+	struct rusage usage;
+
+	if (getrusage (RUSAGE_SELF, &usage) == 0)
+		{
+
+		return (real64) usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1.0E-6 +
+			   (real64) usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1.0E-6;
+
+		}
+
+	#endif
+
+	return 0.0;
+
+	}
+
+/*****************************************************************************/
+
+// Process peak resident set size in kilobytes.  This never goes down, so
+// it only shows which stage first reached a new high.
+
+static uint64 BenchMaxRSS ()
+	{
+
+	#if !qWinOS
+
+	struct rusage usage;
+
+	if (getrusage (RUSAGE_SELF, &usage) == 0)
+		{
+
+		#if qMacOS
+		return (uint64) usage.ru_maxrss >> 10;
+		#else
+		return (uint64) usage.ru_maxrss;
+		#endif
+
+		}
+
+	#endif
+
+	return 0;
+
+	}
+
+/*****************************************************************************/
+
+// Figures for one stage of one run.
+
+struct dng_bench_stage
+	{
+
+	real64 fWall;
+	real64 fCPU;
+
+	uint64 fAllocatedBytes;
+	uint64 fAllocatedCount;
+
+	uint64 fPeakBytes;
+
+	uint64 fMaxRSS;
+
+	dng_bench_stage ()
+
+		:	fWall           (0.0)
+		,	fCPU            (0.0)
+		,	fAllocatedBytes (0)
+		,	fAllocatedCount (0)
+		,	fPeakBytes      (0)
+		,	fMaxRSS         (0)
+
+		{
+
+		}
+
+	};
+
+/*****************************************************************************/
+
+// Measures the stages of one run of the pipeline.
+
+class dng_bench_run
+	{
+
+	private:
+
+		dng_bench_allocator &fAllocator;
+
+		dng_bench_stage fStage [kBenchStage_Count];
+
+		uint32 fCurrent;
+
+		real64 fStartWall;
+		real64 fStartCPU;
+
+		uint64 fStartBytes;
+		uint64 fStartCount;
+
+	public:
+
+		explicit dng_bench_run (dng_bench_allocator &allocator)
+
+			:	fAllocator  (allocator)
+			,	fCurrent    (kBenchStage_Count)
+			,	fStartWall  (0.0)
+			,	fStartCPU   (0.0)
+			,	fStartBytes (0)
+			,	fStartCount (0)
+
+			{
+
+			}
+
+		void Begin (uint32 stage)
+			{
+
+			fCurrent = stage;
+
+			fAllocator.ResetPeak ();
+
+			fStartBytes = fAllocator.AllocatedBytes ();
+			fStartCount = fAllocator.AllocatedCount ();
+
+			fStartCPU = BenchCPUTime ();
+
+			fStartWall = TickTimeInSeconds ();
+
+			}
+
+		void End ()
+			{
+
+			real64 wall = TickTimeInSeconds ();
+
+			dng_bench_stage &stage = fStage [fCurrent];
+
+			stage.fWall = wall - fStartWall;
+
+			stage.fCPU = BenchCPUTime () - fStartCPU;
+
+			stage.fAllocatedBytes = fAllocator.AllocatedBytes () - fStartBytes;
+			stage.fAllocatedCount = fAllocator.AllocatedCount () - fStartCount;
+
+			stage.fPeakBytes = fAllocator.PeakBytes ();
+
+			stage.fMaxRSS = BenchMaxRSS ();
+
+			fCurrent = kBenchStage_Count;
+
+			}
+
+		const dng_bench_stage & Stage (uint32 stage) const
+			{
+			return fStage [stage];
+			}
+
+	};
+
+/*****************************************************************************/
+
+// Options shared by all runs.
+
+struct dng_bench_options
+	{
+
+	uint32 fIterations;
+
+	uint32 fRenderSize;
+
+	uint32 fResampleSize;
+
+	std::vector<uint32> fThreadCounts;
+
+	dng_bench_options ()
+
+		:	fIterations   (3)
+		,	fRenderSize   (0)
+		,	fResampleSize (1024)
+		,	fThreadCounts ()
+
+		{
+
+		}
+
+	};
+
+/*****************************************************************************/
+
+// Runs the pipeline once on one file.
+
+static void dng_bench_pipeline (const char *filename,
+								const dng_bench_options &options,
+								uint32 threadCount,
+								dng_bench_allocator &allocator,
+								dng_bench_run &run,
+								real64 &megapixels)
+	{
+
+	dng_file_stream stream (filename);
+
+	dng_host host (&allocator);
+
+	host.SetThreadCount (threadCount);
+
+	host.SetSaveDNGVersion (dngVersion_SaveDefault);
+
+	host.SetSaveLinearDNG (false);
+
+	host.SetKeepOriginalFile (false);
+
+	AutoPtr<dng_negative> negative;
+
+	dng_info info;
+
+	run.Begin (kBenchStage_Parse);
+
+	info.Parse (host, stream);
+
+	info.PostParse (host);
+
+	if (!info.IsValidDNG ())
+		{
+		ThrowBadFormat ();
+		}
+
+	negative.Reset (host.Make_dng_negative ());
+
+	negative->Parse (host, stream, info);
+
+	negative->PostParse (host, stream, info);
+
+	run.End ();
+
+	run.Begin (kBenchStage_ReadStage1);
+
+	negative->ReadStage1Image (host, stream, info);
+
+	if (info.fMaskIndex != -1)
+		{
+		negative->ReadTransparencyMask (host, stream, info);
+		}
+
+	run.End ();
+
+	megapixels = (real64) negative->Stage1Image ()->Bounds ().W () *
+				 (real64) negative->Stage1Image ()->Bounds ().H () * 1.0E-6;
+
+	run.Begin (kBenchStage_ValidateDigest);
+
+	negative->ValidateRawImageDigest (host);
+
+	run.End ();
+
+	run.Begin (kBenchStage_BuildStage2);
+
+	negative->SynchronizeMetadata ();
+
+	negative->BuildStage2Image (host);
+
+	run.End ();
+
+	run.Begin (kBenchStage_BuildStage3);
+
+	negative->BuildStage3Image (host);
+
+	run.End ();
+
+	AutoPtr<dng_image> finalImage;
+
+	const dng_color_space &finalSpace = negative->IsMonochrome () ? dng_space_GrayGamma22::Get ()
+																  : dng_space_sRGB       ::Get ();
+
+	run.Begin (kBenchStage_Render);
+
+		{
+
+		dng_render render (host, *negative);
+
+		render.SetFinalSpace (finalSpace);
+
+		render.SetFinalPixelType (ttByte);
+
+		render.SetMaximumSize (options.fRenderSize);
+
+		finalImage.Reset (render.Render ());
+
+		finalImage->MaterializeRotate (negative->Orientation ());
+
+		}
+
+	run.End ();
+
+	run.Begin (kBenchStage_Resample);
+
+		{
+
+		const dng_image &srcImage = *negative->Stage3Image ();
+
+		dng_rect srcBounds = srcImage.Bounds ();
+
+		real64 scale = Min_real64 (1.0, options.fResampleSize /
+										(real64) Max_int32 (srcBounds.W (),
+															srcBounds.H ()));
+
+		dng_rect dstBounds (Max_int32 (1, Round_int32 (srcBounds.H () * scale)),
+							Max_int32 (1, Round_int32 (srcBounds.W () * scale)));
+
+		AutoPtr<dng_image> dstImage (host.Make_dng_image (dstBounds,
+														  srcImage.Planes (),
+														  srcImage.PixelType ()));
+
+		ResampleImage (host,
+					   srcImage,
+					   *dstImage.Get (),
+					   srcBounds,
+					   dstBounds,
+					   dng_resample_bicubic::Get ());
+
+		}
+
+	run.End ();
+
+	run.Begin (kBenchStage_WriteDNG);
+
+		{
+
+		dng_memory_stream dngStream (allocator);
+
+		dng_image_writer writer;
+
+		writer.WriteDNG (host,
+						 dngStream,
+						 *negative.Get ());
+
+		}
+
+	run.End ();
+
+	run.Begin (kBenchStage_WriteTIFF);
+
+		{
+
+		dng_memory_stream tiffStream (allocator);
+
+		dng_image_writer writer;
+
+		writer.WriteTIFF (host,
+						  tiffStream,
+						  *finalImage.Get (),
+						  finalImage->Planes () >= 3 ? piRGB
+													 : piBlackIsZero,
+						  ccUncompressed,
+						  negative.Get (),
+						  &finalSpace);
+
+		}
+
+	run.End ();
+
+	}
+
+/*****************************************************************************/
+
+// Writes a string as a JSON string literal.
+
+static void PutBenchString (FILE *output,
+							const char *s)
+	{
+
+	fputc ('"', output);
+
+	for (; *s; s++)
+		{
+
+		uint8 c = (uint8) *s;
+
+		if (c == '"' || c == '\\')
+			{
+			fprintf (output, "\\%c", c);
+			}
+
+		else if (c < 0x20)
+			{
+			fprintf (output, "\\u%04x", (unsigned) c);
+			}
+
+		else
+			{
+			fputc (c, output);
+			}
+
+		}
+
+	fputc ('"', output);
+
+	}
+
+/*****************************************************************************/
+
+static real64 BenchMedian (std::vector<real64> values)
+	{
+
+	std::sort (values.begin (), values.end ());
+
+	uint32 count = (uint32) values.size ();
+
+	if (count == 0)
+		{
+		return 0.0;
+		}
+
+	if (count & 1)
+		{
+		return values [count >> 1];
+		}
+
+	return 0.5 * (values [(count >> 1) - 1] + values [count >> 1]);
+
+	}
+
+/*****************************************************************************/
+
+// Benchmarks one file at each thread count, and writes its JSON object.
+// Wall and CPU times are the median over the iterations; the memory figures
+// come from the first iteration, since they do not depend on timing.
+
+static bool dng_bench_file (const char *filename,
+							const dng_bench_options &options,
+							FILE *output,
+							bool first)
+	{
+
+	fprintf (stderr, "Benchmarking \"%s\"...\n", filename);
+
+	fprintf (output, "%s\n    {\n      \"file\": ", first ? "" : ",");
+
+	PutBenchString (output, filename);
+
+	dng_error_code error = dng_error_none;
+
+	real64 megapixels = 0.0;
+
+	bool firstRun = true;
+
+	for (uint32 countIndex = 0; countIndex < (uint32) options.fThreadCounts.size (); countIndex++)
+		{
+
+		uint32 threadCount = options.fThreadCounts [countIndex];
+
+		std::vector<dng_bench_run> runs;
+
+		try
+			{
+
+			for (uint32 iteration = 0; iteration < options.fIterations; iteration++)
+				{
+
+				dng_bench_allocator allocator;
+
+				dng_bench_run run (allocator);
+
+				dng_bench_pipeline (filename,
+									options,
+									threadCount,
+									allocator,
+									run,
+									megapixels);
+
+				runs.push_back (run);
+
+				}
+
+			}
+
+		catch (const dng_exception &except)
+			{
+
+			error = except.ErrorCode ();
+
+			break;
+
+			}
+
+		catch (...)
+			{
+
+			error = dng_error_unknown;
+
+			break;
+
+			}
+
+		if (firstRun)
+			{
+
+			fprintf (output,
+					 ",\n      \"megapixels\": %.3f,\n      \"runs\": [",
+					 megapixels);
+
+			}
+
+		fprintf (output,
+				 "%s\n        {\n          \"threads\": %u,\n          \"stages\": {",
+				 firstRun ? "" : ",",
+				 (unsigned) threadCount);
+
+		firstRun = false;
+
+		real64 totalWall = 0.0;
+		real64 totalCPU  = 0.0;
+
+		for (uint32 stageIndex = 0; stageIndex < kBenchStage_Count; stageIndex++)
+			{
+
+			std::vector<real64> wall;
+			std::vector<real64> cpu;
+
+			for (uint32 j = 0; j < (uint32) runs.size (); j++)
+				{
+
+				wall.push_back (runs [j].Stage (stageIndex).fWall);
+				cpu .push_back (runs [j].Stage (stageIndex).fCPU );
+
+				}
+
+			const dng_bench_stage &stage = runs [0].Stage (stageIndex);
+
+			real64 wallMedian = BenchMedian (wall);
+			real64 cpuMedian  = BenchMedian (cpu);
+
+			totalWall += wallMedian;
+			totalCPU  += cpuMedian;
+
+			fprintf (output,
+					 "%s\n            \"%s\": { \"wall_ms\": %.3f, \"wall_min_ms\": %.3f, "
+					 "\"cpu_ms\": %.3f, \"alloc_bytes\": %llu, \"alloc_count\": %llu, "
+					 "\"peak_bytes\": %llu, \"max_rss_kb\": %llu }",
+					 stageIndex ? "," : "",
+					 kBenchStageNames [stageIndex],
+					 wallMedian * 1000.0,
+					 *std::min_element (wall.begin (), wall.end ()) * 1000.0,
+					 cpuMedian * 1000.0,
+					 (unsigned long long) stage.fAllocatedBytes,
+					 (unsigned long long) stage.fAllocatedCount,
+					 (unsigned long long) stage.fPeakBytes,
+					 (unsigned long long) stage.fMaxRSS);
+
+			}
+
+		fprintf (output,
+				 "\n          },\n"
+				 "          \"total_wall_ms\": %.3f,\n"
+				 "          \"total_cpu_ms\": %.3f,\n"
+				 "          \"megapixels_per_second\": %.3f\n"
+				 "        }",
+				 totalWall * 1000.0,
+				 totalCPU  * 1000.0,
+				 totalWall > 0.0 ? megapixels / totalWall : 0.0);
+
+		}
+
+	if (!firstRun)
+		{
+		fprintf (output, "\n      ]");
+		}
+
+	if (error != dng_error_none)
+		{
+
+		fprintf (stderr, "*** Error %d in \"%s\"\n", (int) error, filename);
+
+		fprintf (output, ",\n      \"error\": %d", (int) error);
+
+		}
+
+	fprintf (output, "\n    }");
+
+	return error == dng_error_none;
+
+	}
+
+/*****************************************************************************/
+
+// Adds a file, or the DNG files in a directory in name order.
+
+static void AddBenchFiles (const char *path,
+						   dng_string_list &files)
+	{
+
+	dng_string name;
+
+	name.Set (path);
+
+	#if !qWinOS
+
+	DIR *dir = opendir (path);
+
+	if (dir)
+		{
+
+		uint32 first = files.Count ();
+
+		while (struct dirent *entry = readdir (dir))
+			{
+
+			dng_string entryName;
+
+			entryName.Set (entry->d_name);
+
+			if (!entryName.EndsWith (".dng"))
+				{
+				continue;
+				}
+
+			dng_string fullName (name);
+
+			if (!fullName.EndsWith ("/"))
+				{
+				fullName.Append ("/");
+				}
+
+			fullName.Append (entryName.Get ());
+
+			uint32 index = first;
+
+			while (index < files.Count () &&
+				   strcmp (files [index].Get (), fullName.Get ()) < 0)
+				{
+				index++;
+				}
+
+			files.Insert (index, fullName);
+
+			}
+
+		closedir (dir);
+
+		return;
+
+		}
+
+	#endif
+
+	files.Append (name);
+
+	}
+
+/*****************************************************************************/
+
+static bool ParseBenchThreads (const char *list,
+							   std::vector<uint32> &counts)
+	{
+
+	counts.clear ();
+
+	std::vector<char> s (list, list + strlen (list) + 1);
+
+	for (char *token = strtok (&s [0], ",");
+		 token;
+		 token = strtok (NULL, ","))
+		{
+
+		int32 count = atoi (token);
+
+		if (count < 1 || count > (int32) kMaxMPThreads)
+			{
+			return false;
+			}
+
+		counts.push_back ((uint32) count);
+
+		}
+
+	return !counts.empty ();
+
+	}
+
+/*****************************************************************************/
+
+int main (int argc, char *argv [])
+	{
+
+	try
+		{
+
+		if (argc == 1)
+			{
+
+			fprintf (stderr,
+					 "\n"
+					 "dng_bench, version " kDNGBenchVersion "\n"
+					 "\n"
+					 "Usage:  %s [options] file_or_dir1 file_or_dir2 ...\n"
+					 "\n"
+					 "Valid options:\n"
+					 "-threads <list>  Thread counts to run, e.g. 1,2,4 (default 1 and\n"
+					 "                 the number of processors, up to %u)\n"
+					 "-iterations <num> Runs per file and thread count (default 3)\n"
+					 "-size <num>      Maximum size of the rendered image (default full)\n"
+					 "-resample <num>  Maximum size of the resampled stage 3 image\n"
+					 "                 (default 1024)\n"
+					 "-o <file>        Write the JSON report to <file> (default stdout)\n"
+					 "\n",
+					 argv [0],
+					 (unsigned) kMaxMPThreads);
+
+			return 1;
+
+			}
+
+		dng_bench_options options;
+
+		const char *outputName = NULL;
+
+		int index;
+
+		for (index = 1; index < argc && argv [index] [0] == '-'; index++)
+			{
+
+			dng_string option;
+
+			option.Set (&argv [index] [1]);
+
+			if (index + 1 >= argc)
+				{
+				fprintf (stderr, "*** Missing value after \"-%s\"\n", option.Get ());
+				return 1;
+				}
+
+			const char *value = argv [++index];
+
+			if (option.Matches ("threads", true))
+				{
+
+				if (!ParseBenchThreads (value, options.fThreadCounts))
+					{
+					fprintf (stderr, "*** Invalid thread counts \"%s\"\n", value);
+					return 1;
+					}
+
+				}
+
+			else if (option.Matches ("iterations", true))
+				{
+
+				options.fIterations = (uint32) atoi (value);
+
+				if (!options.fIterations)
+					{
+					fprintf (stderr, "*** Invalid number after -iterations\n");
+					return 1;
+					}
+
+				}
+
+			else if (option.Matches ("size", true))
+				{
+				options.fRenderSize = (uint32) atoi (value);
+				}
+
+			else if (option.Matches ("resample", true))
+				{
+
+				options.fResampleSize = (uint32) atoi (value);
+
+				if (!options.fResampleSize)
+					{
+					fprintf (stderr, "*** Invalid number after -resample\n");
+					return 1;
+					}
+
+				}
+
+			else if (option.Matches ("o", true))
+				{
+				outputName = value;
+				}
+
+			else
+				{
+				fprintf (stderr, "*** Unknown option \"-%s\"\n", option.Get ());
+				return 1;
+				}
+
+			}
+
+		if (options.fThreadCounts.empty ())
+			{
+
+			options.fThreadCounts.push_back (1);
+
+			#if qDNGThreadSafe && !qWinOS
+
+			long processors = sysconf (_SC_NPROCESSORS_ONLN);
+
+			if (processors > 1)
+				{
+				options.fThreadCounts.push_back (Min_uint32 ((uint32) processors,
+															 kMaxMPThreads));
+				}
+
+			#endif
+
+			}
+
+		dng_string_list files;
+
+		for (; index < argc; index++)
+			{
+			AddBenchFiles (argv [index], files);
+			}
+
+		if (files.Count () == 0)
+			{
+			fprintf (stderr, "*** No files to benchmark\n");
+			return 1;
+			}
+
+		FILE *output = stdout;
+
+		if (outputName)
+			{
+
+			output = fopen (outputName, "w");
+
+			if (!output)
+				{
+				fprintf (stderr, "*** Unable to open \"%s\"\n", outputName);
+				return 1;
+				}
+
+			}
+
+		// The per-stage figures replace the timer printouts.
+
+		gDNGShowTimers = false;
+
+		fprintf (output,
+				 "{\n"
+				 "  \"version\": \"" kDNGBenchVersion "\",\n"
+				 "  \"iterations\": %u,\n"
+				 "  \"render_size\": %u,\n"
+				 "  \"resample_size\": %u,\n"
+				 "  \"files\": [",
+				 (unsigned) options.fIterations,
+				 (unsigned) options.fRenderSize,
+				 (unsigned) options.fResampleSize);
+
+		uint32 failed = 0;
+
+		for (uint32 fileIndex = 0; fileIndex < files.Count (); fileIndex++)
+			{
+
+			if (!dng_bench_file (files [fileIndex].Get (),
+								 options,
+								 output,
+								 fileIndex == 0))
+				{
+				failed++;
+				}
+
+			}
+
+		fprintf (output, "\n  ]\n}\n");
+
+		if (output != stdout)
+			{
+			fclose (output);
+			}
+
+		return failed ? 1 : 0;
+
+		}
+
+	catch (...)
+		{
+
+		}
+
+	fprintf (stderr, "*** Exception thrown in main routine\n");
+
+	return 1;
+
+	}
+
+/*****************************************************************************/
+
+#endif
+
+/*****************************************************************************/
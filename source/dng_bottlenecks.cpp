@@ -55,6 +55,9 @@ dng_suite gDNGSuite =
 	RefBaselineRGBtoRGB,
 	RefBaseline1DTable,
 	RefBaselineRGBTone,
+	RefBaselineRGBTone16,
+	RefBaselineRGBtoGray16_8,
+	RefBaselineRGBtoRGB16_8,
 	RefResampleDown16,
 	RefResampleDown32,
 	RefResampleAcross16,
@@ -66,7 +69,9 @@ dng_suite gDNGSuite =
 	RefVignetteMask16,
 	RefVignette16,
 	RefVignette32,
-	RefMapArea16
+	RefMapArea16,
+	RefScaleRow16,
+	RefDeltaRow16
 	};
 
 /*****************************************************************************/
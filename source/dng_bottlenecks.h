@@ -430,6 +430,44 @@ typedef void (BaselineRGBToneProc)
 
 /*****************************************************************************/
 
+// Fixed-point versions of the final rendering steps, used for 8-bit output.
+// Pixel values are 16-bit with 65535 meaning 1.0, tone tables have 65536
+// entries, and matrix coefficients are scaled by 1 << kBaselineMatrix16Shift.
+
+const int32 kBaselineMatrix16Shift = 12;
+
+typedef void (BaselineRGBTone16Proc)
+			 (const uint16 *sPtrR,
+			  const uint16 *sPtrG,
+			  const uint16 *sPtrB,
+			  uint16 *dPtrR,
+			  uint16 *dPtrG,
+			  uint16 *dPtrB,
+			  uint32 count,
+			  const uint16 *table);
+
+typedef void (BaselineRGBtoGray16_8Proc)
+			 (const uint16 *sPtrR,
+			  const uint16 *sPtrG,
+			  const uint16 *sPtrB,
+			  uint8 *dPtrG,
+			  uint32 count,
+			  const int32 *matrix,
+			  const uint8 *encodeTable);
+
+typedef void (BaselineRGBtoRGB16_8Proc)
+			 (const uint16 *sPtrR,
+			  const uint16 *sPtrG,
+			  const uint16 *sPtrB,
+			  uint8 *dPtrR,
+			  uint8 *dPtrG,
+			  uint8 *dPtrB,
+			  uint32 count,
+			  const int32 *matrix,
+			  const uint8 *encodeTable);
+
+/*****************************************************************************/
+
 typedef void (ResampleDown16Proc)
 			 (const uint16 *sPtr,
 			  uint16 *dPtr,
@@ -566,6 +604,27 @@ typedef void (MapArea16Proc)
 
 /*****************************************************************************/
 
+// Stage 1 opcode kernels for 16-bit data.  Each pixel is converted to 0.0 to
+// 1.0, processed and converted back with the same real32 arithmetic as the
+// ttFloat opcode paths and CopyArea16_R32/CopyAreaR32_16, so the results
+// match those paths exactly without the intermediate buffers.
+
+typedef void (ScaleRow16Proc)
+			 (uint16 *dPtr,
+			  const real32 *scale,
+			  uint32 count,
+			  int32 dStep,
+			  int32 scaleStep);
+
+typedef void (DeltaRow16Proc)
+			 (uint16 *dPtr,
+			  const real32 *delta,
+			  uint32 count,
+			  int32 dStep,
+			  int32 deltaStep);
+
+/*****************************************************************************/
+
 struct dng_suite	
 	{
 	ZeroBytesProc			*ZeroBytes;
@@ -602,6 +661,9 @@ struct dng_suite
 	BaselineRGBtoRGBProc	*BaselineRGBtoRGB;
 	Baseline1DTableProc		*Baseline1DTable;
 	BaselineRGBToneProc		*BaselineRGBTone;
+	BaselineRGBTone16Proc	*BaselineRGBTone16;
+	BaselineRGBtoGray16_8Proc *BaselineRGBtoGray16_8;
+	BaselineRGBtoRGB16_8Proc *BaselineRGBtoRGB16_8;
 	ResampleDown16Proc		*ResampleDown16;
 	ResampleDown32Proc		*ResampleDown32;
 	ResampleAcross16Proc	*ResampleAcross16;
@@ -614,6 +676,8 @@ struct dng_suite
 	Vignette16Proc			*Vignette16;
 	Vignette32Proc			*Vignette32;
 	MapArea16Proc			*MapArea16;
+	ScaleRow16Proc			*ScaleRow16;
+	DeltaRow16Proc			*DeltaRow16;
 	};
 
 /*****************************************************************************/
@@ -1436,6 +1500,71 @@ inline void DoBaselineRGBTone (const real32 *sPtrR,
 
 /*****************************************************************************/
 
+inline void DoBaselineRGBTone16 (const uint16 *sPtrR,
+								 const uint16 *sPtrG,
+								 const uint16 *sPtrB,
+								 uint16 *dPtrR,
+								 uint16 *dPtrG,
+								 uint16 *dPtrB,
+								 uint32 count,
+								 const uint16 *table)
+	{
+	
+	(gDNGSuite.BaselineRGBTone16) (sPtrR,
+								   sPtrG,
+								   sPtrB,
+								   dPtrR,
+								   dPtrG,
+								   dPtrB,
+								   count,
+								   table);
+	
+	}
+
+inline void DoBaselineRGBtoGray16_8 (const uint16 *sPtrR,
+									 const uint16 *sPtrG,
+									 const uint16 *sPtrB,
+									 uint8 *dPtrG,
+									 uint32 count,
+									 const int32 *matrix,
+									 const uint8 *encodeTable)
+	{
+	
+	(gDNGSuite.BaselineRGBtoGray16_8) (sPtrR,
+									   sPtrG,
+									   sPtrB,
+									   dPtrG,
+									   count,
+									   matrix,
+									   encodeTable);
+	
+	}
+
+inline void DoBaselineRGBtoRGB16_8 (const uint16 *sPtrR,
+									const uint16 *sPtrG,
+									const uint16 *sPtrB,
+									uint8 *dPtrR,
+									uint8 *dPtrG,
+									uint8 *dPtrB,
+									uint32 count,
+									const int32 *matrix,
+									const uint8 *encodeTable)
+	{
+	
+	(gDNGSuite.BaselineRGBtoRGB16_8) (sPtrR,
+									  sPtrG,
+									  sPtrB,
+									  dPtrR,
+									  dPtrG,
+									  dPtrB,
+									  count,
+									  matrix,
+									  encodeTable);
+	
+	}
+
+/*****************************************************************************/
+
 inline void DoResampleDown16 (const uint16 *sPtr,
 							  uint16 *dPtr,
 							  uint32 sCount,
@@ -1710,6 +1839,40 @@ inline void DoMapArea16 (uint16 *dPtr,
 
 /*****************************************************************************/
 
+inline void DoScaleRow16 (uint16 *dPtr,
+						  const real32 *scale,
+						  uint32 count,
+						  int32 dStep,
+						  int32 scaleStep)
+	{
+	
+	(gDNGSuite.ScaleRow16) (dPtr,
+							scale,
+							count,
+							dStep,
+							scaleStep);
+
+	}
+
+/*****************************************************************************/
+
+inline void DoDeltaRow16 (uint16 *dPtr,
+						  const real32 *delta,
+						  uint32 count,
+						  int32 dStep,
+						  int32 deltaStep)
+	{
+	
+	(gDNGSuite.DeltaRow16) (dPtr,
+							delta,
+							count,
+							dStep,
+							deltaStep);
+
+	}
+
+/*****************************************************************************/
+
 #endif
 	
 /*****************************************************************************/
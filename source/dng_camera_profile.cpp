@@ -20,6 +20,8 @@
 #include "dng_exceptions.h"
 #include "dng_image_writer.h"
 #include "dng_info.h"
+#include "dng_memory.h"
+#include "dng_mutex.h"
 #include "dng_parse_utils.h"
 #include "dng_safe_arithmetic.h"
 #include "dng_tag_codes.h"
@@ -555,6 +557,41 @@ void dng_camera_profile::CalculateFingerprint () const
 
 /******************************************************************************/
 
+dng_fingerprint dng_camera_profile::HueSatMapFingerprint () const
+	{
+	
+	dng_md5_printer_stream printer;
+
+	printer.SetLittleEndian ();
+	
+	FingerprintHueSatMap (printer, fHueSatDeltas1);
+	FingerprintHueSatMap (printer, fHueSatDeltas2);
+
+	printer.Put_uint32 (fHueSatMapEncoding);
+	
+	return printer.Result ();
+	
+	}
+
+/******************************************************************************/
+
+dng_fingerprint dng_camera_profile::LookTableFingerprint () const
+	{
+	
+	dng_md5_printer_stream printer;
+
+	printer.SetLittleEndian ();
+	
+	FingerprintHueSatMap (printer, fLookTable);
+
+	printer.Put_uint32 (fLookTableEncoding);
+	
+	return printer.Result ();
+	
+	}
+
+/******************************************************************************/
+
 bool dng_camera_profile::ValidForwardMatrix (const dng_matrix &m)
 	{
 	
@@ -1148,6 +1185,298 @@ void dng_camera_profile::SetFourColorBayer ()
 
 /*****************************************************************************/
 
+// Process-wide store of the hue/sat and look tables of camera profiles, keyed
+// by profile fingerprint.  Profiles with the same data, such as those parsed
+// from many files from the same camera model, point their tables at the copy
+// held here, so the table data is only held once.  The interpolated tables
+// returned by HueSatMapForWhite for these profiles are cached here as well.
+
+class dng_camera_profile_registry
+	{
+	
+	private:
+	
+		enum
+			{
+			
+			// Interpolated tables cached per entry.
+			
+			kWhiteCacheSize = 4
+			
+			};
+	
+		struct entry
+			{
+			
+			dng_fingerprint fFingerprint;
+			
+			dng_hue_sat_map fHueSatDeltas1;
+			dng_hue_sat_map fHueSatDeltas2;
+			
+			dng_hue_sat_map fLookTable;
+			
+			uint32 fWhiteCount;
+			uint32 fWhiteNext;
+			
+			real64 fWhiteWeight [kWhiteCacheSize];
+			
+			dng_hue_sat_map fWhiteMap [kWhiteCacheSize];
+			
+			entry ()
+				:	fWhiteCount (0)
+				,	fWhiteNext  (0)
+				{
+				}
+			
+			};
+	
+		// Taken before the mutexes of the table blocks, so it must come
+		// first in the lock order.
+		
+		dng_mutex fMutex;
+		
+		dng_std_vector<entry *> fEntries;
+		
+	public:
+	
+		dng_camera_profile_registry ()
+		
+			:	fMutex   ("dng_camera_profile_registry",
+						  dng_mutex::kDNGMutexLevelLeaf - 1)
+			,	fEntries ()
+			
+			{
+			
+			}
+			
+		~dng_camera_profile_registry ()
+			{
+			
+			for (uint32 index = 0; index < (uint32) fEntries.size (); index++)
+				{
+				delete fEntries [index];
+				}
+			
+			}
+			
+		void Share (const dng_fingerprint &fingerprint,
+					dng_hue_sat_map &hueSatDeltas1,
+					dng_hue_sat_map &hueSatDeltas2,
+					dng_hue_sat_map &lookTable)
+			{
+			
+			dng_lock_mutex lock (&fMutex);
+			
+			Purge ();
+			
+			for (uint32 index = 0; index < (uint32) fEntries.size (); index++)
+				{
+				
+				entry &e = *fEntries [index];
+				
+				if (e.fFingerprint == fingerprint)
+					{
+					
+					// The fingerprint does not cover every table in every
+					// case, so only share tables that are really equal.
+					
+					if (e.fHueSatDeltas1 == hueSatDeltas1 &&
+						e.fHueSatDeltas2 == hueSatDeltas2 &&
+						e.fLookTable     == lookTable)
+						{
+						
+						hueSatDeltas1 = e.fHueSatDeltas1;
+						hueSatDeltas2 = e.fHueSatDeltas2;
+						
+						lookTable = e.fLookTable;
+						
+						}
+						
+					return;
+					
+					}
+				
+				}
+				
+			AutoPtr<entry> e (new entry);
+			
+			e->fFingerprint = fingerprint;
+			
+			e->fHueSatDeltas1 = hueSatDeltas1;
+			e->fHueSatDeltas2 = hueSatDeltas2;
+			
+			e->fLookTable = lookTable;
+			
+			fEntries.push_back (e.Get ());
+			
+			e.Release ();
+			
+			}
+			
+		dng_hue_sat_map * FindForWhite (const dng_hue_sat_map &hueSatDeltas1,
+										const dng_hue_sat_map &hueSatDeltas2,
+										real64 weight1)
+			{
+			
+			dng_lock_mutex lock (&fMutex);
+			
+			entry *e = Find (hueSatDeltas1, hueSatDeltas2);
+			
+			if (e)
+				{
+				
+				for (uint32 index = 0; index < e->fWhiteCount; index++)
+					{
+					
+					if (e->fWhiteWeight [index] == weight1)
+						{
+						return new dng_hue_sat_map (e->fWhiteMap [index]);
+						}
+					
+					}
+				
+				}
+				
+			return NULL;
+			
+			}
+			
+		void AddForWhite (const dng_hue_sat_map &hueSatDeltas1,
+						  const dng_hue_sat_map &hueSatDeltas2,
+						  real64 weight1,
+						  const dng_hue_sat_map &map)
+			{
+			
+			dng_lock_mutex lock (&fMutex);
+			
+			entry *e = Find (hueSatDeltas1, hueSatDeltas2);
+			
+			if (e)
+				{
+				
+				e->fWhiteWeight [e->fWhiteNext] = weight1;
+				
+				e->fWhiteMap [e->fWhiteNext] = map;
+				
+				e->fWhiteNext = (e->fWhiteNext + 1) % kWhiteCacheSize;
+				
+				e->fWhiteCount = Min_uint32 (e->fWhiteCount + 1, kWhiteCacheSize);
+				
+				}
+			
+			}
+			
+		void Purge ()
+			{
+			
+			// Assumes mutex is locked.
+			
+			uint32 kept = 0;
+			
+			for (uint32 index = 0; index < (uint32) fEntries.size (); index++)
+				{
+				
+				entry *e = fEntries [index];
+				
+				if (e->fHueSatDeltas1.IsShared () ||
+					e->fHueSatDeltas2.IsShared () ||
+					e->fLookTable    .IsShared ())
+					{
+					fEntries [kept++] = e;
+					}
+					
+				else
+					{
+					delete e;
+					}
+				
+				}
+				
+			fEntries.resize (kept);
+			
+			}
+			
+		dng_mutex & Mutex ()
+			{
+			return fMutex;
+			}
+			
+	private:
+	
+		entry * Find (const dng_hue_sat_map &hueSatDeltas1,
+					  const dng_hue_sat_map &hueSatDeltas2)
+			{
+			
+			// Assumes mutex is locked.  Matches on the table data itself,
+			// so a profile whose tables have since been changed is not
+			// found.
+			
+			for (uint32 index = 0; index < (uint32) fEntries.size (); index++)
+				{
+				
+				entry *e = fEntries [index];
+				
+				if (e->fHueSatDeltas1.GetConstDeltas () == hueSatDeltas1.GetConstDeltas () &&
+					e->fHueSatDeltas2.GetConstDeltas () == hueSatDeltas2.GetConstDeltas ())
+					{
+					return e;
+					}
+				
+				}
+				
+			return NULL;
+			
+			}
+			
+		// Hidden copy constructor and assignment operator.
+
+		dng_camera_profile_registry (const dng_camera_profile_registry &);
+
+		dng_camera_profile_registry & operator= (const dng_camera_profile_registry &);
+		
+	};
+
+/*****************************************************************************/
+
+static dng_camera_profile_registry gCameraProfileRegistry;
+
+/*****************************************************************************/
+
+void dng_camera_profile::ShareTables ()
+	{
+	
+	if (fWasStubbed)
+		{
+		return;
+		}
+		
+	if (!fHueSatDeltas1.IsValid () &&
+		!fHueSatDeltas2.IsValid () &&
+		!fLookTable    .IsValid ())
+		{
+		return;
+		}
+		
+	gCameraProfileRegistry.Share (Fingerprint (),
+								  fHueSatDeltas1,
+								  fHueSatDeltas2,
+								  fLookTable);
+	
+	}
+
+/*****************************************************************************/
+
+void dng_camera_profile::PurgeSharedTables ()
+	{
+	
+	dng_lock_mutex lock (&gCameraProfileRegistry.Mutex ());
+	
+	gCameraProfileRegistry.Purge ();
+	
+	}
+
+/*****************************************************************************/
+
 dng_hue_sat_map * dng_camera_profile::HueSatMapForWhite (const dng_xy_coord &white) const
 	{
 	
@@ -1217,11 +1546,29 @@ dng_hue_sat_map * dng_camera_profile::HueSatMapForWhite (const dng_xy_coord &whi
 			g = 1.0 - g;
 			}
 		
+		// Use the cached interpolation if the tables are shared.
+		
+		dng_hue_sat_map *cached = gCameraProfileRegistry.FindForWhite (fHueSatDeltas1,
+																	   fHueSatDeltas2,
+																	   g);
+																	   
+		if (cached)
+			{
+			return cached;
+			}
+		
 		// Do the interpolation.
 		
-		return dng_hue_sat_map::Interpolate (HueSatDeltas1 (),
-											 HueSatDeltas2 (),
-											 g);
+		AutoPtr<dng_hue_sat_map> result (dng_hue_sat_map::Interpolate (HueSatDeltas1 (),
+																	   HueSatDeltas2 (),
+																	   g));
+																	   
+		gCameraProfileRegistry.AddForWhite (fHueSatDeltas1,
+											fHueSatDeltas2,
+											g,
+											*result);
+											
+		return result.Release ();
 		
 		}
 		
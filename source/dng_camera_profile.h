@@ -509,6 +509,16 @@ class dng_camera_profile
 
 			}
 
+		/// Fingerprint of the hue/sat deltas (both tables and their
+		/// encoding) only, ignoring the rest of the profile.
+
+		dng_fingerprint HueSatMapFingerprint () const;
+
+		/// Fingerprint of the look table and its encoding only, ignoring
+		/// the rest of the profile.
+
+		dng_fingerprint LookTableFingerprint () const;
+
 		/// Getter for camera profile id.
 		/// \retval ID of profile.
 
@@ -820,10 +830,25 @@ class dng_camera_profile
 		virtual void SetFourColorBayer ();
 		
 		/// Find the hue/sat table to use for a given white point, if any.
-		/// The calling routine owns the resulting table.
+		/// The calling routine owns the resulting table.  For a profile
+		/// whose tables are shared (see ShareTables) the last few
+		/// interpolated tables are cached and shared as well.
 		
 		dng_hue_sat_map * HueSatMapForWhite (const dng_xy_coord &white) const;
 		
+		/// Share the hue/sat and look tables of this profile with all other
+		/// profiles in the process with the same fingerprint and table data,
+		/// so only one copy of the tables is held.  Changing a table
+		/// afterwards only changes this profile.  Called by
+		/// dng_negative::AddProfile.
+
+		void ShareTables ();
+
+		/// Free the shared tables which are no longer used by any profile.
+		/// This is also done on each call to ShareTables.
+
+		static void PurgeSharedTables ();
+
 		/// Stub out the profile (free memory used by large tables).
 		
 		void Stub ();
@@ -0,0 +1,173 @@
+/*****************************************************************************/
+// Copyright 2006-2012 Adobe Systems Incorporated
+// All Rights Reserved.
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this file in
+// accordance with the terms of the Adobe license agreement accompanying it.
+/*****************************************************************************/
+
+#include "dng_chunked_stream.h"
+
+#include "dng_bottlenecks.h"
+#include "dng_exceptions.h"
+#include "dng_safe_arithmetic.h"
+#include "dng_utils.h"
+
+#include <algorithm>
+
+/*****************************************************************************/
+
+dng_chunked_stream::dng_chunked_stream (uint32 segmentCount,
+										const void * const *segmentData,
+										const uint64 *segmentLength,
+										dng_abort_sniffer *sniffer,
+										uint64 offsetInOriginalFile)
+
+	:	dng_stream (sniffer,
+					kDefaultBufferSize,
+					offsetInOriginalFile)
+
+	,	fSegmentCount     (0)
+	,	fSegmentData      (segmentCount, sizeof (const uint8 *))
+	,	fSegmentStartData (SafeUint32Add (segmentCount, 1), sizeof (uint64))
+
+	{
+
+	const uint8 **data = (const uint8 **) fSegmentData.Buffer ();
+
+	uint64 *start = fSegmentStartData.Buffer_uint64 ();
+
+	uint64 offset = 0;
+
+	for (uint32 index = 0; index < segmentCount; index++)
+		{
+
+		if (segmentLength [index] == 0)
+			{
+			continue;
+			}
+
+		if (segmentData [index] == NULL ||
+			offset + segmentLength [index] < offset)
+			{
+			ThrowProgramError ("Bad segment in dng_chunked_stream");
+			}
+
+		data  [fSegmentCount] = (const uint8 *) segmentData [index];
+		start [fSegmentCount] = offset;
+
+		fSegmentCount++;
+
+		offset += segmentLength [index];
+
+		}
+
+	start [fSegmentCount] = offset;
+
+	}
+
+/*****************************************************************************/
+
+dng_chunked_stream::~dng_chunked_stream ()
+	{
+
+	}
+
+/*****************************************************************************/
+
+uint32 dng_chunked_stream::FindSegment (uint64 offset) const
+	{
+
+	const uint64 *start = fSegmentStartData.Buffer_uint64 ();
+
+	// Last segment starting at or before offset.
+
+	return (uint32) (std::upper_bound (start,
+									   start + fSegmentCount,
+									   offset) - start) - 1;
+
+	}
+
+/*****************************************************************************/
+
+const void * dng_chunked_stream::DirectData (uint64 offset,
+											 uint32 count)
+	{
+
+	const uint64 *start = fSegmentStartData.Buffer_uint64 ();
+
+	if (offset >= start [fSegmentCount])
+		{
+		return NULL;
+		}
+
+	uint32 segment = FindSegment (offset);
+
+	if (offset + count > start [segment + 1])
+		{
+		return NULL;
+		}
+
+	const uint8 * const *data = (const uint8 * const *) fSegmentData.Buffer ();
+
+	return data [segment] + (offset - start [segment]);
+
+	}
+
+/*****************************************************************************/
+
+uint64 dng_chunked_stream::DoGetLength ()
+	{
+
+	return fSegmentStartData.Buffer_uint64 () [fSegmentCount];
+
+	}
+
+/*****************************************************************************/
+
+void dng_chunked_stream::DoRead (void *data,
+								 uint32 count,
+								 uint64 offset)
+	{
+
+	const uint64 *start = fSegmentStartData.Buffer_uint64 ();
+
+	if (offset + count > start [fSegmentCount])
+		{
+		ThrowEndOfFile ();
+		}
+
+	if (count == 0)
+		{
+		return;
+		}
+
+	const uint8 * const *segmentData = (const uint8 * const *) fSegmentData.Buffer ();
+
+	uint8 *dPtr = (uint8 *) data;
+
+	uint32 segment = FindSegment (offset);
+
+	while (count)
+		{
+
+		uint64 segmentOffset = offset - start [segment];
+
+		uint32 block = (uint32) Min_uint64 (count,
+											start [segment + 1] - offset);
+
+		DoCopyBytes (segmentData [segment] + segmentOffset,
+					 dPtr,
+					 block);
+
+		dPtr   += block;
+		offset += block;
+		count  -= block;
+
+		segment++;
+
+		}
+
+	}
+
+/*****************************************************************************/
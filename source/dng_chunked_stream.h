@@ -0,0 +1,97 @@
+/*****************************************************************************/
+// Copyright 2006-2012 Adobe Systems Incorporated
+// All Rights Reserved.
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this file in
+// accordance with the terms of the Adobe license agreement accompanying it.
+/*****************************************************************************/
+
+/** \file
+ * Stream abstraction for reading from a list of caller-owned memory segments.
+ */
+
+/*****************************************************************************/
+
+#ifndef __dng_chunked_stream__
+#define __dng_chunked_stream__
+
+/*****************************************************************************/
+
+#include "dng_stream.h"
+
+/*****************************************************************************/
+
+/// \brief A read-only dng_stream over a list of memory segments owned by the
+/// caller.
+///
+/// The segments are read in order as one stream, which may be longer than
+/// 4 GB.  The data is not copied, so the segments must stay valid for the
+/// life of the stream.  Reads that fall within one segment are available
+/// without copying through DirectData.
+
+class dng_chunked_stream: public dng_stream
+	{
+
+	private:
+
+		uint32 fSegmentCount;
+
+		// Pointer to the data of each segment.
+
+		dng_memory_data fSegmentData;
+
+		// Stream offset of the start of each segment, plus one extra entry
+		// for the end of the stream.
+
+		dng_memory_data fSegmentStartData;
+
+	public:
+
+		/// Construct a stream over a list of segments.
+		/// \param segmentCount Number of segments.
+		/// \param segmentData Pointer to the data of each segment.
+		/// \param segmentLength Length in bytes of each segment.  Empty
+		/// segments are skipped.
+		/// \param sniffer If non-NULL used to check for user cancellation.
+		/// \param offsetInOriginalFile If data came from a file originally,
+		/// offset can be saved here for later use.
+
+		dng_chunked_stream (uint32 segmentCount,
+							const void * const *segmentData,
+							const uint64 *segmentLength,
+							dng_abort_sniffer *sniffer = NULL,
+							uint64 offsetInOriginalFile = kDNGStreamInvalidOffset);
+
+		virtual ~dng_chunked_stream ();
+
+		virtual const void * DirectData (uint64 offset,
+										 uint32 count);
+
+	protected:
+
+		virtual uint64 DoGetLength ();
+
+		virtual void DoRead (void *data,
+							 uint32 count,
+							 uint64 offset);
+
+	private:
+
+		// Index of the segment holding the byte at offset, which must be
+		// less than the stream length.
+
+		uint32 FindSegment (uint64 offset) const;
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_chunked_stream (const dng_chunked_stream &stream);
+
+		dng_chunked_stream & operator= (const dng_chunked_stream &stream);
+
+	};
+
+/*****************************************************************************/
+
+#endif
+
+/*****************************************************************************/
@@ -30,8 +30,10 @@ class dng_basic_tag_set;
 class dng_camera_profile;
 class dng_camera_profile_id;
 class dng_camera_profile_info;
+class dng_chunked_stream;
 class dng_color_space;
 class dng_color_spec;
+class dng_cpu_reservation;
 class dng_date_time;
 class dng_date_time_info;
 class dng_exif;
@@ -43,10 +45,14 @@ class dng_image;
 class dng_image_preview;
 class dng_image_writer;
 class dng_info;
+class dng_inplace_opcode;
 class dng_iptc;
 class dng_jpeg_image;
 class dng_jpeg_preview;
+class dng_job;
+class dng_job_queue;
 class dng_linearization_info;
+class dng_linearized_image;
 class dng_matrix;
 class dng_matrix_3by3;
 class dng_matrix_4by3;
@@ -64,6 +70,8 @@ class dng_opcode;
 class dng_opcode_list;
 class dng_orientation;
 class dng_negative;
+class dng_parse_index;
+class dng_parse_index_stream;
 class dng_pixel_buffer;
 class dng_point;
 class dng_point_real64;
@@ -15,6 +15,7 @@
 
 #include "dng_gain_map.h"
 
+#include "dng_bottlenecks.h"
 #include "dng_exceptions.h"
 #include "dng_globals.h"
 #include "dng_host.h"
@@ -567,13 +568,56 @@ void dng_opcode_GainMap::ProcessArea (dng_negative & /* negative */,
 			for (int32 row = overlap.t; row < overlap.b; row += fAreaSpec.RowPitch ())
 				{
 				
-				real32 *dPtr = buffer.DirtyPixel_real32 (row, overlap.l, plane);
-				
 				dng_gain_map_interpolator interp (*fGainMap,
 												  imageBounds,
 												  row,
 												  overlap.l,
 												  mapPlane);
+												  
+				// 16-bit data is scaled by the gains for a band of pixels
+				// at a time.
+				
+				if (buffer.fPixelType == ttShort)
+					{
+					
+					const uint32 kBandSize = 256;
+					
+					real32 gain [kBandSize];
+					
+					uint16 *sPtr = buffer.DirtyPixel_uint16 (row, overlap.l, plane);
+					
+					uint32 count = (cols + colPitch - 1) / colPitch;
+					
+					for (uint32 first = 0; first < count; first += kBandSize)
+						{
+						
+						uint32 band = Min_uint32 (count - first, kBandSize);
+						
+						for (uint32 k = 0; k < band; k++)
+							{
+							
+							gain [k] = interp.Interpolate ();
+							
+							for (uint32 j = 0; j < colPitch; j++)
+								{
+								interp.Increment ();
+								}
+							
+							}
+							
+						DoScaleRow16 (sPtr + first * colPitch,
+									  gain,
+									  band,
+									  colPitch,
+									  1);
+						
+						}
+					
+					continue;
+					
+					}
+				
+				real32 *dPtr = buffer.DirtyPixel_real32 (row, overlap.l, plane);
 										   
 				for (uint32 col = 0; col < cols; col += colPitch)
 					{
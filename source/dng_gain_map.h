@@ -179,11 +179,12 @@ class dng_opcode_GainMap: public dng_inplace_opcode
 
 		virtual void PutData (dng_stream &stream) const;
 		
-		/// The pixel data type of this opcode.
+		/// The pixel data type of this opcode.  16-bit data is processed in
+		/// place by DoScaleRow16.
 
-		virtual uint32 BufferPixelType (uint32 /* imagePixelType */)
+		virtual uint32 BufferPixelType (uint32 imagePixelType)
 			{
-			return ttFloat;
+			return imagePixelType == ttShort ? ttShort : ttFloat;
 			}
 	
 		/// The adjusted bounds (processing area) of this opcode. It is limited to
@@ -17,18 +17,24 @@
 
 #include "dng_abort_sniffer.h"
 #include "dng_area_task.h"
+#include "dng_auto_ptr.h"
 #include "dng_bad_pixels.h"
 #include "dng_exceptions.h"
 #include "dng_exif.h"
 #include "dng_gain_map.h"
 #include "dng_ifd.h"
+#include "dng_job_queue.h"
 #include "dng_lens_correction.h"
 #include "dng_memory.h"
 #include "dng_misc_opcodes.h"
 #include "dng_negative.h"
+#include "dng_pixel_buffer.h"
 #include "dng_resample.h"
+#include "dng_sdk_limits.h"
 #include "dng_shared.h"
 #include "dng_simple_image.h"
+#include "dng_tag_types.h"
+#include "dng_utils.h"
 
 #if qDNGUseXMP
 #include "dng_xmp.h"
@@ -52,6 +58,16 @@ dng_host::dng_host (dng_memory_allocator *allocator,
 	,	fSaveDNGVersion		(dngVersion_None)
 	,	fSaveLinearDNG		(false)
 	,	fKeepOriginalFile	(false)
+	,	fThreadCount		(1)
+	,	fThreadAffinity		(false)
+	,	fThreadCPUsMutex	("dng_host::fThreadCPUsMutex")
+	,	fThreadCPUs			()
+	,	fBandPipeline		(false)
+	,	fSelectLosslessPredictor (false)
+	,	fReadGapThreshold (4096)
+	,	fJobThreadCount	(4)
+	,	fJobQueueMutex	("dng_host::fJobQueueMutex")
+	,	fJobQueue		()
 	
 	{
 	
@@ -96,6 +112,15 @@ dng_memory_block * dng_host::Allocate (uint32 logicalSize)
 		
 /*****************************************************************************/
 
+dng_memory_block * dng_host::Allocate64 (uint64 logicalSize)
+	{
+	
+	return Allocator ().Allocate64 (logicalSize);
+		
+	}
+		
+/*****************************************************************************/
+
 void dng_host::SniffForAbort ()
 	{
 	
@@ -105,6 +130,25 @@ void dng_host::SniffForAbort ()
 		
 /*****************************************************************************/
 
+void dng_host::SetThreadCount (uint32 count)
+	{
+	
+	#if qDNGThreadSafe
+	
+	fThreadCount = Pin_uint32 (1, count, kMaxMPThreads);
+	
+	#else
+	
+	(void) count;
+	
+	fThreadCount = 1;
+	
+	#endif
+	
+	}
+	
+/*****************************************************************************/
+
 void dng_host::ValidateSizes ()
 	{
 	
@@ -235,6 +279,36 @@ void dng_host::PerformAreaTask (dng_area_task &task,
 								const dng_rect &area)
 	{
 	
+	if (fThreadCount > 1)
+		{
+		
+		const dng_cpu_reservation *cpus = NULL;
+		
+		if (fThreadAffinity)
+			{
+			
+			dng_lock_mutex lock (&fThreadCPUsMutex);
+			
+			if (!fThreadCPUs.Get ())
+				{
+				fThreadCPUs.Reset (new dng_cpu_reservation (fThreadCount));
+				}
+				
+			cpus = fThreadCPUs.Get ();
+			
+			}
+		
+		dng_area_task::PerformThreads (task,
+									   area,
+									   fThreadCount,
+									   &Allocator (),
+									   Sniffer (),
+									   cpus);
+									   
+		return;
+		
+		}
+	
 	dng_area_task::Perform (task,
 							area,
 							&Allocator (),
@@ -247,7 +321,142 @@ void dng_host::PerformAreaTask (dng_area_task &task,
 uint32 dng_host::PerformAreaTaskThreads ()
 	{
 	
-	return 1;
+	return fThreadCount;
+	
+	}
+
+/*****************************************************************************/
+
+dng_job_queue & dng_host::JobQueue ()
+	{
+	
+	dng_lock_mutex lock (&fJobQueueMutex);
+	
+	if (!fJobQueue.Get ())
+		{
+		
+		fJobQueue.Reset (new dng_job_queue (Allocator (),
+											fJobThreadCount));
+		
+		}
+		
+	return *fJobQueue.Get ();
+	
+	}
+
+/*****************************************************************************/
+
+void dng_host::SubmitJob (dng_job &job)
+	{
+	
+	JobQueue ().Submit (job);
+	
+	}
+
+/*****************************************************************************/
+
+uint32 dng_host::MinimumTileCount ()
+	{
+	
+	// Files are often decoded on other machines, so do not assume the
+	// reader has as few threads as we do.
+	
+	const uint32 kReaderThreads = 4;
+	
+	return 2 * Max_uint32 (PerformAreaTaskThreads (), kReaderThreads);
+	
+	}
+
+/*****************************************************************************/
+
+static uint32 LeastCommonMultiple (uint32 a, uint32 b)
+	{
+	
+	uint32 x = a;
+	uint32 y = b;
+	
+	while (y)
+		{
+		
+		uint32 t = x % y;
+		
+		x = y;
+		y = t;
+		
+		}
+		
+	return x ? (a / x) * b : 1;
+	
+	}
+
+/*****************************************************************************/
+
+void dng_host::FindTileSize (dng_ifd &ifd,
+							 uint32 bytesPerTile,
+							 uint32 cellH,
+							 uint32 cellV)
+	{
+	
+	// Below this size, per-tile overhead (offsets, codec headers, predictor
+	// restarts and task dispatch) outweighs the extra parallelism.
+	
+	const uint32 kMinTileBytes = 32 * 1024;
+	
+	// Images with more than this many times MinimumTileCount tiles get
+	// larger tiles, up to kMaxTileGrowth times the budget.
+	
+	const uint32 kExcessTileFactor = 16;
+	const uint32 kMaxTileGrowth    = 4;
+	
+	// TIFF requires tile sizes to be multiples of 16.
+	
+	uint32 minCellH = LeastCommonMultiple (16, ifd.fSubTileBlockCols);
+	uint32 minCellV = LeastCommonMultiple (16, ifd.fSubTileBlockRows);
+	
+	cellH = LeastCommonMultiple (Max_uint32 (cellH, 1), minCellH);
+	cellV = LeastCommonMultiple (Max_uint32 (cellV, 1), minCellV);
+	
+	real64 imageBytes = (real64) ifd.fImageWidth  *
+						(real64) ifd.fImageLength *
+						(real64) ifd.fSamplesPerPixel *
+						(real64) ((ifd.fBitsPerSample [0] + 7) >> 3);
+	
+	real64 minTiles = (real64) Max_uint32 (MinimumTileCount (), 1);
+	
+	real64 budget = (real64) bytesPerTile;
+	
+	if (imageBytes > budget * minTiles * kExcessTileFactor)
+		{
+		
+		budget = Min_real64 (budget * kMaxTileGrowth,
+							 imageBytes / (minTiles * kExcessTileFactor));
+		
+		}
+		
+	else if (imageBytes < budget * minTiles)
+		{
+		
+		budget = Max_real64 (Min_real64 (budget, kMinTileBytes),
+							 imageBytes / minTiles);
+		
+		}
+	
+	ifd.FindTileSize (Round_uint32 (budget),
+					  cellH,
+					  cellV);
+					  
+	// Cell alignment only matters between tiles, so a single column or row
+	// of tiles need not be padded beyond the TIFF minimum.
+	
+	if (ifd.TilesAcross () == 1)
+		{
+		ifd.fTileWidth = ((ifd.fImageWidth + minCellH - 1) / minCellH) * minCellH;
+		}
+		
+	if (ifd.TilesDown () == 1)
+		{
+		ifd.fTileLength = ((ifd.fImageLength + minCellV - 1) / minCellV) * minCellV;
+		}
 	
 	}
 
@@ -338,15 +547,59 @@ dng_negative * dng_host::Make_dng_negative ()
 
 /*****************************************************************************/
 
+// Zeroes a new dng_simple_image on the PerformAreaTask threads, so that each
+// band of rows of the image is first touched by the thread that will process
+// it.  Tiles a few rows high keep the band edges close to those of the tasks
+// that use the image.
+
+class dng_first_touch_task: public dng_area_task
+	{
+	
+	private:
+	
+		dng_pixel_buffer fBuffer;
+		
+	public:
+	
+		dng_first_touch_task (dng_simple_image &image)
+		
+			:	fBuffer ()
+			
+			{
+			
+			image.GetPixelBuffer (fBuffer);
+			
+			fMaxTileSize = dng_point (16, image.Bounds ().W ());
+			
+			}
+			
+		virtual dng_tile_order TileOrder () const
+			{
+			return kTileOrder_Rows;
+			}
+			
+		virtual void Process (uint32 /* threadIndex */,
+							  const dng_rect &tile,
+							  dng_abort_sniffer * /* sniffer */)
+			{
+			
+			fBuffer.SetZero (tile, 0, fBuffer.fPlanes);
+			
+			}
+			
+	};
+
+/*****************************************************************************/
+
 dng_image * dng_host::Make_dng_image (const dng_rect &bounds,
 									  uint32 planes,
 									  uint32 pixelType)
 	{
 	
-	dng_image *result = new dng_simple_image (bounds,
-											  planes,
-											  pixelType,
-											  Allocator ());
+	dng_simple_image *result = new dng_simple_image (bounds,
+													 planes,
+													 pixelType,
+													 Allocator ());
 	
 	if (!result)
 		{
@@ -354,6 +607,25 @@ dng_image * dng_host::Make_dng_image (const dng_rect &bounds,
 		ThrowMemoryFull ();
 
 		}
+		
+	// Smaller images do not span enough pages to be worth spreading out.
+		
+	const uint64 kMinFirstTouchBytes = 4 * 1024 * 1024;
+		
+	if (fThreadAffinity && fThreadCount > 1 &&
+		(uint64) bounds.W () * (uint64) bounds.H () *
+		(uint64) planes * (uint64) TagTypeSize (pixelType) >= kMinFirstTouchBytes)
+		{
+		
+		AutoPtr<dng_image> image (result);
+		
+		dng_first_touch_task task (*result);
+		
+		PerformAreaTask (task, bounds);
+		
+		image.Release ();
+		
+		}
 	
 	return result;
 	
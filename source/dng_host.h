@@ -26,6 +26,7 @@
 #include "dng_auto_ptr.h"
 #include "dng_classes.h"
 #include "dng_errors.h"
+#include "dng_mutex.h"
 #include "dng_types.h"
 
 /*****************************************************************************/
@@ -104,6 +105,45 @@ class dng_host
 		// Keep the original raw file data block?
 		
 		bool fKeepOriginalFile;
+		
+		// Number of threads PerformAreaTask may use.
+		
+		uint32 fThreadCount;
+		
+		// Bind PerformAreaTask threads to CPUs?
+		
+		bool fThreadAffinity;
+		
+		// CPUs the PerformAreaTask threads are bound to, reserved on first
+		// use under fThreadCPUsMutex.
+		
+		dng_mutex fThreadCPUsMutex;
+		
+		AutoPtr<dng_cpu_reservation> fThreadCPUs;
+		
+		// Build stage 3 one tile at a time through linearization,
+		// interpolation and opcode list 3?
+		
+		bool fBandPipeline;
+		
+		// Choose the lossless JPEG predictor for each tile?
+		
+		bool fSelectLosslessPredictor;
+		
+		// Largest gap, in bytes, between tiles that are read together.
+		
+		uint32 fReadGapThreshold;
+		
+		// Worker threads for the job queue.
+		
+		uint32 fJobThreadCount;
+		
+		// Queue for asynchronous jobs, created on first use under
+		// fJobQueueMutex, since jobs may be submitted from any thread.
+		
+		dng_mutex fJobQueueMutex;
+		
+		AutoPtr<dng_job_queue> fJobQueue;
 	
 	public:
 	
@@ -136,6 +176,13 @@ class dng_host
 
 		virtual dng_memory_block * Allocate (uint32 logicalSize);
 		
+		/// Allocate a new dng_memory_block, which may be larger than 4 GB,
+		/// using the host's memory allocator.
+		/// \param logicalSize Number of usable bytes returned dng_memory_block
+		/// must contain.
+
+		virtual dng_memory_block * Allocate64 (uint64 logicalSize);
+		
 		/// Setter for host's abort sniffer.
 		
 		void SetSniffer (dng_abort_sniffer *sniffer)
@@ -270,6 +317,70 @@ class dng_host
 			return fCropFactor;
 			}
 			
+		/// Setter for the number of threads used by PerformAreaTask.
+		/// \param count Number of threads.  Values less than one, or greater
+		/// than one if the SDK is not thread safe, are treated as one.
+		
+		void SetThreadCount (uint32 count);
+		
+		/// Getter for the number of threads used by PerformAreaTask.
+		
+		uint32 ThreadCount () const
+			{
+			return fThreadCount;
+			}
+			
+		/// Setter for binding PerformAreaTask threads to CPUs.  When set, and
+		/// ThreadCount is more than one, the host reserves ThreadCount CPUs on
+		/// first use, spread over the NUMA nodes and disjoint from those of
+		/// other hosts, and binds thread N of every task to the Nth of them.
+		/// Tasks that would hand out tiles in raster order give each thread
+		/// its own band of rows instead, and Make_dng_image zeroes large
+		/// images by the same row bands, so each band's pages are first
+		/// touched on the node whose CPU processes it.  Only has an effect on
+		/// Linux.  Call before the first PerformAreaTask.
+		/// \param affinity True to bind threads to CPUs.
+		
+		void SetThreadAffinity (bool affinity)
+			{
+			fThreadAffinity = affinity;
+			}
+			
+		/// Getter for binding PerformAreaTask threads to CPUs.
+		
+		bool ThreadAffinity () const
+			{
+			return fThreadAffinity;
+			}
+			
+		/// Setter for flag determining whether the stage 3 image is built by a
+		/// band pipeline.  Each PerformAreaTask tile of stage 3 is then
+		/// interpolated and run through the in-place opcodes of opcode list 3
+		/// while it is still in cache, and the stage 2 data it needs is
+		/// linearized and run through the in-place opcodes of opcode list 2
+		/// as it is read where possible, rather than each step making its own
+		/// pass over a full size image.  Opcode lists holding opcodes that
+		/// read neighboring pixels, such as warps or bad pixel fixes, are
+		/// still applied to the full image with ApplyOpcodeList, as is opcode
+		/// list 2 for multi-plane stage 2 images.  A stage 2 image that is
+		/// linearized as it is read does not include opcode list 2.  Gain
+		/// maps are interpolated from the left edge of each tile, so their
+		/// results can differ in the lowest bit.  Defaults to false.
+		/// \param bands If true, build stage 3 with the band pipeline.
+		
+		void SetBandPipeline (bool bands)
+			{
+			fBandPipeline = bands;
+			}
+			
+		/// Getter for flag determining whether the stage 3 image is built by a
+		/// band pipeline.
+		
+		bool BandPipeline () const
+			{
+			return fBandPipeline;
+			}
+			
 		/// Makes sures minimum, preferred, and maximum sizes are reasonable.
 			
 		void ValidateSizes ();
@@ -312,6 +423,44 @@ class dng_host
 			{
 			return fKeepOriginalFile;
 			}
+			
+		/// Setter for flag determining whether the lossless JPEG encoder picks
+		/// the predictor for each tile from a subsample of its data, rather
+		/// than always predicting from the left neighbor.  Gives smaller files
+		/// for smooth or high bit depth data, at some cost in encode time.
+		/// \param select If true, choose the predictor for each tile.
+
+		void SetSelectLosslessPredictor (bool select)
+			{
+			fSelectLosslessPredictor = select;
+			}
+
+		/// Getter for flag determining whether to choose the lossless JPEG
+		/// predictor for each tile.
+
+		bool SelectLosslessPredictor () const
+			{
+			return fSelectLosslessPredictor;
+			}
+
+		/// Setter for the largest gap, in bytes, between the data of two tiles
+		/// that dng_read_image still fetches with a single read.  The gap bytes
+		/// are read and discarded, which is cheaper than another round trip
+		/// on high latency storage.  Defaults to 4 KB.
+		/// \param gap Gap threshold in bytes.  Zero only merges tiles that are
+		/// exactly adjacent.
+
+		void SetReadGapThreshold (uint32 gap)
+			{
+			fReadGapThreshold = gap;
+			}
+
+		/// Getter for the read gap threshold.
+
+		uint32 ReadGapThreshold () const
+			{
+			return fReadGapThreshold;
+			}
 
 		/// Determine if an error is the result of a temporary, but planned-for
 		/// occurence such as user cancellation or memory exhaustion. This method is
@@ -324,9 +473,10 @@ class dng_host
 		virtual bool IsTransientError (dng_error_code code);
 
 		/// General top-level botttleneck for image processing tasks.
-		/// Default implementation calls dng_area_task::PerformAreaTask method on 
-		/// task. Can be overridden in derived classes to support multiprocessing, 
-		/// for example.
+		/// Default implementation calls dng_area_task::Perform method on task,
+		/// or dng_area_task::PerformThreads if ThreadCount is more than one.
+		/// Can be overridden in derived classes to support other forms of
+		/// multiprocessing, for example.
 		/// \param task Image processing task to perform on area.
 		/// \param area Rectangle over which to perform image processing task.
 
@@ -334,9 +484,63 @@ class dng_host
 									  const dng_rect &area);
 									  
 		/// How many multiprocessing threads does PerformAreaTask use?
-		/// Default implementation always returns 1 since it is single threaded.
+		/// Default implementation returns ThreadCount.
 		
 		virtual uint32 PerformAreaTaskThreads ();
+		
+		/// Setter for the number of jobs the job queue runs at once.  Only
+		/// has an effect before the queue is first used.  Defaults to four.
+		/// \param count Number of worker threads.
+		
+		void SetJobThreadCount (uint32 count)
+			{
+			fJobThreadCount = count;
+			}
+			
+		/// Getter for the number of jobs the job queue runs at once.
+		
+		uint32 JobThreadCount () const
+			{
+			return fJobThreadCount;
+			}
+			
+		/// The queue for asynchronous jobs (open, decode, render, encode),
+		/// created on first use with JobThreadCount worker threads, and shared
+		/// by everything submitting jobs through this host.  Each job runs
+		/// with a host of its own.  Destroying this host waits for the
+		/// submitted jobs to finish.
+		
+		dng_job_queue & JobQueue ();
+		
+		/// Queue a job on JobQueue.  Returns at once; the job reports its
+		/// result through dng_job::Done, dng_job::IsDone or dng_job::Wait.
+		/// \param job Job to run, which must stay valid until it is done.
+		
+		void SubmitJob (dng_job &job);
+
+		/// Minimum number of tiles FindTileSize aims for, so that the image
+		/// can be encoded, and later decoded, in parallel.  Default
+		/// implementation returns twice the larger of PerformAreaTaskThreads
+		/// and a typical reader's thread count of four.
+		
+		virtual uint32 MinimumTileCount ();
+		
+		/// Choose the tile layout of an image about to be written.  Default
+		/// implementation starts from a per-tile byte budget, shrinks it so
+		/// there are at least MinimumTileCount tiles (but no tile is below
+		/// 32 KB), and grows it up to four times for images that would
+		/// otherwise get many more tiles than that.
+		/// \param ifd IFD to update, with image size, samples per pixel, bits
+		/// per sample and any sub-tile block size already set.
+		/// \param bytesPerTile Default uncompressed size of each tile.
+		/// \param cellH Tile widths are a multiple of this, e.g. the CFA
+		/// pattern width.
+		/// \param cellV Tile lengths are a multiple of this.
+		
+		virtual void FindTileSize (dng_ifd &ifd,
+								   uint32 bytesPerTile,
+								   uint32 cellH = 16,
+								   uint32 cellV = 16);
 
 		/// Factory method for dng_exif class. Can be used to customize allocation or 
 		/// to ensure a derived class is used instead of dng_exif.
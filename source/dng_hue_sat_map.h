@@ -156,6 +156,13 @@ class dng_hue_sat_map
 			{
 			fDeltas.EnsureWriteable ();
 			}
+
+		/// Is the table data shared with another hue sat map?
+
+		bool IsShared () const
+			{
+			return fDeltas.IsShared ();
+			}
 		
 		/// Set a specific table entry, specified by table indices.
 
@@ -4250,11 +4250,14 @@ void dng_ifd::ReadImage (dng_host &host,
 						 dng_stream &stream,
 						 dng_image &image,
 						 dng_jpeg_image *jpegImage,
-						 dng_fingerprint *jpegDigest) const
+						 dng_fingerprint *jpegDigest,
+						 uint32 jpegScale) const
 	{
 	
 	dng_read_image reader;
 	
+	reader.SetJPEGScale (jpegScale);
+	
 	reader.Read (host,
 				 *this,
 				 stream,
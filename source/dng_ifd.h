@@ -285,11 +285,16 @@ class dng_ifd
 		
 		virtual bool CanRead () const;
 		
+		/// Reads the image data of this IFD.  A jpegScale other than 1 decodes
+		/// baseline JPEG data at 1/jpegScale of its size, see
+		/// dng_read_image::SetJPEGScale.
+
 		virtual void ReadImage (dng_host &host,
 								dng_stream &stream,
 								dng_image &image,
 								dng_jpeg_image *jpegImage = NULL,
-								dng_fingerprint *jpegDigest = NULL) const;
+								dng_fingerprint *jpegDigest = NULL,
+								uint32 jpegScale = 1) const;
 			
 	protected:
 							   
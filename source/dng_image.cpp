@@ -748,6 +748,15 @@ void dng_image::Rotate (const dng_orientation &orientation)
 		
 /*****************************************************************************/
 
+void dng_image::MaterializeRotate (const dng_orientation &orientation)
+	{
+	
+	Rotate (orientation);
+	
+	}
+		
+/*****************************************************************************/
+
 void dng_image::CopyArea (const dng_image &src,
 						  const dng_rect &area,
 						  uint32 srcPlane,
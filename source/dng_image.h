@@ -275,6 +275,14 @@ class dng_image
 
 		virtual void Rotate (const dng_orientation &orientation);
 		
+		/// Rotate image to reflect given orientation change, and lay out the
+		/// pixel data in the rotated order.  Use instead of Rotate when the
+		/// result will be read many times, since a lazily rotated image may
+		/// be walked down its columns.  Default implementation calls Rotate.
+		/// \param orientation Directive to rotate image in a certain way.
+
+		virtual void MaterializeRotate (const dng_orientation &orientation);
+		
 		/// Copy image data from an area of one image to same area of another.
 		/// \param src Image to copy from.
 		/// \param area Rectangle of images to copy.
@@ -2678,6 +2678,15 @@ dng_image_writer::~dng_image_writer ()
 						    
 /*****************************************************************************/
 
+void dng_image_writer::AdjustRawTileLayout (dng_host & /* host */,
+											const dng_negative & /* negative */,
+											dng_ifd & /* ifd */)
+	{
+	
+	}
+
+/*****************************************************************************/
+
 uint32 dng_image_writer::CompressedBufferSize (const dng_ifd &ifd,
 											   uint32 uncompressedSize)
 	{
@@ -3882,7 +3891,8 @@ void dng_image_writer::WriteData (dng_host &host,
 								ifd.fBitsPerSample [0],
 								temp.fRowStep,
 								temp.fColStep,
-								stream);
+								stream,
+								host.SelectLosslessPredictor ());
 										
 			break;
 			
@@ -6134,17 +6144,35 @@ void dng_image_writer::WriteDNG (dng_host &host,
 		
 		}
 	
-	else if (info.fCompression == ccJPEG)
+	else if (info.fCompression == ccJPEG ||
+			 info.fCompression == ccDeflate)
 		{
 		
-		info.FindTileSize (128 * 1024);
+		// Keep tiles aligned to whole CFA patterns.
 		
-		}
+		uint32 cellH = 16;
+		uint32 cellV = 16;
 		
-	else if (info.fCompression == ccDeflate)
-		{
+		if (mosaicInfo.IsColorFilterArray ())
+			{
+			
+			while (cellH % mosaicInfo.fCFAPatternSize.h)
+				{
+				cellH += 16;
+				}
+				
+			while (cellV % mosaicInfo.fCFAPatternSize.v)
+				{
+				cellV += 16;
+				}
+			
+			}
 		
-		info.FindTileSize (512 * 1024);
+		host.FindTileSize (info,
+						   info.fCompression == ccJPEG ? 128 * 1024
+													   : 512 * 1024,
+						   cellH,
+						   cellV);
 		
 		}
 		
@@ -6164,6 +6192,13 @@ void dng_image_writer::WriteDNG (dng_host &host,
 		
 		}
 		
+	if (!rawJPEGImage)
+		{
+		
+		AdjustRawTileLayout (host, negative, info);
+		
+		}
+		
 	#ifdef qTestRowInterleave
 	
 	info.fRowInterleaveFactor = qTestRowInterleave;
@@ -6683,7 +6718,7 @@ void dng_image_writer::WriteDNG (dng_host &host,
 				
 		if (maskInfo->fCompression == ccDeflate)
 			{
-			maskInfo->FindTileSize (512 * 1024);
+			host.FindTileSize (*maskInfo, 512 * 1024);
 			}
 		else
 			{
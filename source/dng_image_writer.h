@@ -1203,6 +1203,18 @@ class dng_image_writer
 		
 	protected:
 	
+		/// Hook to change the tile layout of the main raw image, called after
+		/// the default tile size (or single strip) has been chosen.  Not called
+		/// when saving existing lossy JPEG data, which has a fixed layout.
+		/// Default implementation does nothing.
+		/// \param host Host interface.
+		/// \param negative The negative being written.
+		/// \param ifd The raw image IFD, with compression and predictor set.
+		
+		virtual void AdjustRawTileLayout (dng_host &host,
+										  const dng_negative &negative,
+										  dng_ifd &ifd);
+	
 		virtual uint32 CompressedBufferSize (const dng_ifd &ifd,
 											 uint32 uncompressedSize);
 											 
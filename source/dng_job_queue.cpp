@@ -0,0 +1,557 @@
+/*****************************************************************************/
+// Copyright 2006-2012 Adobe Systems Incorporated
+// All Rights Reserved.
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this file in
+// accordance with the terms of the Adobe license agreement accompanying it.
+/*****************************************************************************/
+
+#include "dng_job_queue.h"
+
+#include "dng_color_space.h"
+#include "dng_exceptions.h"
+#include "dng_host.h"
+#include "dng_image.h"
+#include "dng_image_writer.h"
+#include "dng_info.h"
+#include "dng_negative.h"
+#include "dng_render.h"
+#include "dng_utils.h"
+
+/*****************************************************************************/
+
+dng_job_sniffer::dng_job_sniffer ()
+
+	:	fCanceled (false)
+
+	{
+
+	}
+
+/*****************************************************************************/
+
+void dng_job_sniffer::Sniff ()
+	{
+
+	if (fCanceled)
+		{
+		ThrowUserCanceled ();
+		}
+
+	}
+
+/*****************************************************************************/
+
+dng_job::dng_job ()
+
+	:	fSniffer   ()
+	,	fQueue     (NULL)
+	,	fNext      (NULL)
+	,	fState     (kPending)
+	,	fErrorCode (dng_error_none)
+	,	fDone      (false)
+
+	{
+
+	}
+
+/*****************************************************************************/
+
+dng_job::~dng_job ()
+	{
+
+	}
+
+/*****************************************************************************/
+
+void dng_job::Cancel ()
+	{
+
+	fSniffer.Cancel ();
+
+	}
+
+/*****************************************************************************/
+
+bool dng_job::IsDone () const
+	{
+
+	#if qDNGThreadSafe
+
+	if (fQueue)
+		{
+
+		dng_lock_mutex lock (&fQueue->fMutex);
+
+		return fDone;
+
+		}
+
+	#endif
+
+	return fDone;
+
+	}
+
+/*****************************************************************************/
+
+void dng_job::Wait ()
+	{
+
+	if (!fQueue)
+		{
+		return;
+		}
+
+	#if qDNGThreadSafe
+
+	dng_lock_mutex lock (&fQueue->fMutex);
+
+	while (!fDone)
+		{
+		fQueue->fDoneCondition.Wait (fQueue->fMutex);
+		}
+
+	#endif
+
+	}
+
+/*****************************************************************************/
+
+dng_host * dng_job::MakeHost (dng_memory_allocator &allocator,
+							  dng_abort_sniffer *sniffer)
+	{
+
+	return new dng_host (&allocator, sniffer);
+
+	}
+
+/*****************************************************************************/
+
+void dng_job::Done ()
+	{
+
+	}
+
+/*****************************************************************************/
+
+dng_job_queue::dng_job_queue (dng_memory_allocator &allocator,
+							  uint32 threadCount)
+
+	:	fAllocator   (allocator)
+	,	fThreadCount (Pin_uint32 (1, threadCount, kMaxMPThreads))
+	,	fFirstJob    (NULL)
+	,	fLastJob     (NULL)
+	,	fStopping    (false)
+
+	#if qDNGThreadSafe
+
+	,	fMutex          ("dng_job_queue")
+	,	fJobCondition   ()
+	,	fDoneCondition  ()
+	,	fThreadsStarted (0)
+
+	#endif
+
+	{
+
+	#if qDNGThreadSafe
+
+	while (fThreadsStarted < fThreadCount)
+		{
+
+		if (pthread_create (&fThread [fThreadsStarted],
+							NULL,
+							ThreadProc,
+							this) != 0)
+			{
+			break;
+			}
+
+		fThreadsStarted++;
+
+		}
+
+	// Jobs run on the submitting thread if no worker could be started.
+
+	fThreadCount = Max_uint32 (fThreadsStarted, 1);
+
+	#endif
+
+	}
+
+/*****************************************************************************/
+
+dng_job_queue::~dng_job_queue ()
+	{
+
+	#if qDNGThreadSafe
+
+		{
+
+		dng_lock_mutex lock (&fMutex);
+
+		fStopping = true;
+
+		fJobCondition.Broadcast ();
+
+		}
+
+	for (uint32 index = 0; index < fThreadsStarted; index++)
+		{
+		pthread_join (fThread [index], NULL);
+		}
+
+	#endif
+
+	}
+
+/*****************************************************************************/
+
+void dng_job_queue::Submit (dng_job &job)
+	{
+
+	job.fQueue     = this;
+	job.fNext      = NULL;
+	job.fState     = dng_job::kPending;
+	job.fErrorCode = dng_error_none;
+	job.fDone      = false;
+
+	#if qDNGThreadSafe
+
+	if (fThreadsStarted)
+		{
+
+		dng_lock_mutex lock (&fMutex);
+
+		if (fLastJob)
+			{
+			fLastJob->fNext = &job;
+			}
+		else
+			{
+			fFirstJob = &job;
+			}
+
+		fLastJob = &job;
+
+		fJobCondition.Signal ();
+
+		return;
+
+		}
+
+	#endif
+
+	RunJob (job);
+
+	}
+
+/*****************************************************************************/
+
+#if qDNGThreadSafe
+
+/*****************************************************************************/
+
+void * dng_job_queue::ThreadProc (void *arg)
+	{
+
+	((dng_job_queue *) arg)->Work ();
+
+	return NULL;
+
+	}
+
+/*****************************************************************************/
+
+void dng_job_queue::Work ()
+	{
+
+	while (true)
+		{
+
+		dng_job *job;
+
+			{
+
+			dng_lock_mutex lock (&fMutex);
+
+			while (!fFirstJob && !fStopping)
+				{
+				fJobCondition.Wait (fMutex);
+				}
+
+			// Pending jobs are finished before the threads stop.
+
+			if (!fFirstJob)
+				{
+				return;
+				}
+
+			// Take the first of the jobs with the highest priority.
+
+			dng_job *prev = NULL;
+
+			job = fFirstJob;
+
+			for (dng_job *scan = fFirstJob; scan->fNext; scan = scan->fNext)
+				{
+
+				if (scan->fNext->Priority () > job->Priority ())
+					{
+					prev = scan;
+					job  = scan->fNext;
+					}
+
+				}
+
+			if (prev)
+				{
+				prev->fNext = job->fNext;
+				}
+			else
+				{
+				fFirstJob = job->fNext;
+				}
+
+			if (fLastJob == job)
+				{
+				fLastJob = prev;
+				}
+
+			}
+
+		RunJob (*job);
+
+		}
+
+	}
+
+/*****************************************************************************/
+
+#endif
+
+/*****************************************************************************/
+
+void dng_job_queue::RunJob (dng_job &job)
+	{
+
+	if (job.fSniffer.Canceled ())
+		{
+
+		job.fErrorCode = dng_error_user_canceled;
+
+		}
+
+	else
+		{
+
+		job.fState = dng_job::kRunning;
+
+		try
+			{
+
+			AutoPtr<dng_host> host (job.MakeHost (fAllocator,
+												  &job.fSniffer));
+
+			job.Run (*host);
+
+			}
+
+		catch (const dng_exception &except)
+			{
+
+			job.fErrorCode = except.ErrorCode ();
+
+			}
+
+		catch (...)
+			{
+
+			job.fErrorCode = dng_error_unknown;
+
+			}
+
+		}
+
+	if (job.fErrorCode == dng_error_none)
+		{
+		job.fState = dng_job::kSucceeded;
+		}
+
+	else if (job.fErrorCode == dng_error_user_canceled)
+		{
+		job.fState = dng_job::kCanceled;
+		}
+
+	else
+		{
+		job.fState = dng_job::kFailed;
+		}
+
+	// The callback must not stop the worker thread.
+
+	try
+		{
+
+		job.Done ();
+
+		}
+
+	catch (...)
+		{
+
+		}
+
+	// The job may be deleted by its owner as soon as it is marked done.
+
+	#if qDNGThreadSafe
+
+	dng_lock_mutex lock (&fMutex);
+
+	job.fDone = true;
+
+	fDoneCondition.Broadcast ();
+
+	#else
+
+	job.fDone = true;
+
+	#endif
+
+	}
+
+/*****************************************************************************/
+
+dng_open_job::dng_open_job (dng_stream &stream,
+							bool decode)
+
+	:	fStream   (stream)
+	,	fDecode   (decode)
+	,	fNegative ()
+
+	{
+
+	}
+
+/*****************************************************************************/
+
+dng_open_job::~dng_open_job ()
+	{
+
+	}
+
+/*****************************************************************************/
+
+void dng_open_job::Run (dng_host &host)
+	{
+
+	dng_info info;
+
+	info.Parse (host, fStream);
+
+	info.PostParse (host);
+
+	if (!info.IsValidDNG ())
+		{
+		ThrowBadFormat ();
+		}
+
+	AutoPtr<dng_negative> negative (host.Make_dng_negative ());
+
+	negative->Parse (host, fStream, info);
+
+	negative->PostParse (host, fStream, info);
+
+	if (fDecode)
+		{
+
+		negative->ReadStage1Image (host, fStream, info);
+
+		if (info.fMaskIndex != -1)
+			{
+			negative->ReadTransparencyMask (host, fStream, info);
+			}
+
+		negative->ValidateRawImageDigest (host);
+
+		negative->SynchronizeMetadata ();
+
+		negative->BuildStage2Image (host);
+
+		negative->BuildStage3Image (host);
+
+		}
+
+	fNegative.Reset (negative.Release ());
+
+	}
+
+/*****************************************************************************/
+
+dng_render_job::dng_render_job (const dng_negative &negative,
+								uint32 maximumSize,
+								const dng_color_space *finalSpace,
+								uint32 finalPixelType)
+
+	:	fNegative       (negative)
+	,	fMaximumSize    (maximumSize)
+	,	fFinalSpace     (finalSpace)
+	,	fFinalPixelType (finalPixelType)
+	,	fImage          ()
+
+	{
+
+	}
+
+/*****************************************************************************/
+
+dng_render_job::~dng_render_job ()
+	{
+
+	}
+
+/*****************************************************************************/
+
+void dng_render_job::Run (dng_host &host)
+	{
+
+	dng_render render (host, fNegative);
+
+	if (fFinalSpace)
+		{
+		render.SetFinalSpace (*fFinalSpace);
+		}
+
+	render.SetFinalPixelType (fFinalPixelType);
+
+	render.SetMaximumSize (fMaximumSize);
+
+	fImage.Reset (render.Render ());
+
+	}
+
+/*****************************************************************************/
+
+dng_encode_job::dng_encode_job (dng_negative &negative,
+								dng_stream &stream)
+
+	:	fNegative (negative)
+	,	fStream   (stream)
+
+	{
+
+	}
+
+/*****************************************************************************/
+
+void dng_encode_job::Run (dng_host &host)
+	{
+
+	dng_image_writer writer;
+
+	writer.WriteDNG (host, fStream, fNegative);
+
+	}
+
+/*****************************************************************************/
@@ -0,0 +1,420 @@
+/*****************************************************************************/
+// Copyright 2006-2012 Adobe Systems Incorporated
+// All Rights Reserved.
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this file in
+// accordance with the terms of the Adobe license agreement accompanying it.
+/*****************************************************************************/
+
+/** \file
+ * Asynchronous jobs (open, decode, render, encode) run on a shared pool of
+ * worker threads.
+ */
+
+/*****************************************************************************/
+
+#ifndef __dng_job_queue__
+#define __dng_job_queue__
+
+/*****************************************************************************/
+
+#include "dng_abort_sniffer.h"
+#include "dng_auto_ptr.h"
+#include "dng_classes.h"
+#include "dng_errors.h"
+#include "dng_flags.h"
+#include "dng_mutex.h"
+#include "dng_sdk_limits.h"
+#include "dng_tag_types.h"
+#include "dng_types.h"
+
+/*****************************************************************************/
+
+/// \brief Abort sniffer used by a dng_job, which signals cancellation once
+/// dng_job::Cancel has been called.
+
+class dng_job_sniffer: public dng_abort_sniffer
+	{
+
+	private:
+
+		volatile bool fCanceled;
+
+	public:
+
+		dng_job_sniffer ();
+
+		void Cancel ()
+			{
+			fCanceled = true;
+			}
+
+		bool Canceled () const
+			{
+			return fCanceled;
+			}
+
+		virtual bool ThreadSafe () const
+			{
+			return true;
+			}
+
+	protected:
+
+		virtual void Sniff ();
+
+	};
+
+/*****************************************************************************/
+
+/// \brief A unit of work submitted to a dng_job_queue.
+///
+/// Derived classes implement Run, and may override Done to be called back on
+/// the worker thread when the job finishes.  The caller owns the job and must
+/// keep it alive until IsDone returns true, for example by calling Wait.
+
+class dng_job
+	{
+
+	friend class dng_job_queue;
+
+	public:
+
+		/// Job states.
+
+		enum
+			{
+			kPending,
+			kRunning,
+			kSucceeded,
+			kFailed,
+			kCanceled
+			};
+
+	private:
+
+		dng_job_sniffer fSniffer;
+
+		dng_job_queue *fQueue;
+
+		dng_job *fNext;
+
+		volatile uint32 fState;
+
+		dng_error_code fErrorCode;
+
+		// Guarded by the queue's mutex.
+
+		bool fDone;
+
+	public:
+
+		dng_job ();
+
+		virtual ~dng_job ();
+
+		/// Request cancellation.  A pending job is not run; a running job
+		/// stops at its next abort check.  Either way it finishes in the
+		/// kCanceled state.  May be called from any thread.
+
+		void Cancel ();
+
+		/// Set the priority of the job.  Pending jobs of a higher priority
+		/// are started first, and the area tasks of a running job take tiles
+		/// ahead of those of lower priority jobs.  The default is
+		/// dng_priority_maximum.  Call before Submit.
+
+		void SetPriority (dng_priority priority)
+			{
+			fSniffer.SetPriority (priority);
+			}
+
+		/// Priority of the job.
+
+		dng_priority Priority () const
+			{
+			return fSniffer.Priority ();
+			}
+
+		/// Current state.
+
+		uint32 State () const
+			{
+			return fState;
+			}
+
+		/// Error code of a failed job, dng_error_user_canceled for a canceled
+		/// job, and dng_error_none otherwise.
+
+		dng_error_code ErrorCode () const
+			{
+			return fErrorCode;
+			}
+
+		/// True once the job has finished and Done has returned.  The job is
+		/// not touched by the queue after this.
+
+		bool IsDone () const;
+
+		/// Block until the job is done.  Not for use from an event loop
+		/// thread, which should poll IsDone or use Done instead.
+
+		void Wait ();
+
+	protected:
+
+		/// Make the host the job runs with.  The default is a plain dng_host,
+		/// which runs its area tasks on the worker thread only.
+		/// \param allocator The queue's allocator.
+		/// \param sniffer The job's abort sniffer.
+
+		virtual dng_host * MakeHost (dng_memory_allocator &allocator,
+									 dng_abort_sniffer *sniffer);
+
+		/// Do the work of the job.  Exceptions are caught and recorded as
+		/// the job's error code.
+
+		virtual void Run (dng_host &host) = 0;
+
+		/// Called on the worker thread after the job has finished, with
+		/// State and ErrorCode already set.  Default does nothing.
+
+		virtual void Done ();
+
+	private:
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_job (const dng_job &job);
+
+		dng_job & operator= (const dng_job &job);
+
+	};
+
+/*****************************************************************************/
+
+/// \brief A pool of worker threads running dng_job objects in priority order,
+/// and in the order they are submitted within a priority, at most ThreadCount
+/// at a time.
+///
+/// Submit never blocks on the work itself, so it may be called from an event
+/// loop.  Jobs that read data should be given streams whose data is already
+/// in memory, such as a dng_chunked_stream over the received chunks, so that
+/// the workers never wait on the network.
+
+class dng_job_queue
+	{
+
+	friend class dng_job;
+
+	private:
+
+		dng_memory_allocator &fAllocator;
+
+		uint32 fThreadCount;
+
+		dng_job *fFirstJob;
+		dng_job *fLastJob;
+
+		bool fStopping;
+
+		#if qDNGThreadSafe
+
+		dng_mutex fMutex;
+
+		// Signaled when a job is added or the queue is stopping.
+
+		dng_condition fJobCondition;
+
+		// Broadcast when a job is done.
+
+		dng_condition fDoneCondition;
+
+		pthread_t fThread [kMaxMPThreads];
+
+		uint32 fThreadsStarted;
+
+		#endif
+
+	public:
+
+		/// Start the worker threads.
+		/// \param allocator Allocator used by the jobs' hosts.
+		/// \param threadCount Maximum number of jobs run at once.
+
+		dng_job_queue (dng_memory_allocator &allocator,
+					   uint32 threadCount);
+
+		/// Waits for all submitted jobs, then stops the worker threads.
+
+		~dng_job_queue ();
+
+		/// Maximum number of jobs run at once.
+
+		uint32 ThreadCount () const
+			{
+			return fThreadCount;
+			}
+
+		/// Queue a job.  Without thread support the job is run at once on
+		/// the calling thread.
+
+		void Submit (dng_job &job);
+
+	private:
+
+		#if qDNGThreadSafe
+
+		static void * ThreadProc (void *arg);
+
+		void Work ();
+
+		#endif
+
+		void RunJob (dng_job &job);
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_job_queue (const dng_job_queue &queue);
+
+		dng_job_queue & operator= (const dng_job_queue &queue);
+
+	};
+
+/*****************************************************************************/
+
+/// \brief Job that parses a DNG file into a negative and, optionally, decodes
+/// it through stage 3.
+
+class dng_open_job: public dng_job
+	{
+
+	private:
+
+		dng_stream &fStream;
+
+		bool fDecode;
+
+		AutoPtr<dng_negative> fNegative;
+
+	public:
+
+		/// \param stream Stream holding the file.  Must stay valid until the
+		/// job is done.
+		/// \param decode If true, also read the raw image, validate its
+		/// digest, and build the stage 2 and stage 3 images.
+
+		dng_open_job (dng_stream &stream,
+					  bool decode = true);
+
+		virtual ~dng_open_job ();
+
+		/// The negative, once the job has succeeded.
+
+		dng_negative * Negative ()
+			{
+			return fNegative.Get ();
+			}
+
+		/// Take ownership of the negative.
+
+		dng_negative * ReleaseNegative ()
+			{
+			return fNegative.Release ();
+			}
+
+	protected:
+
+		virtual void Run (dng_host &host);
+
+	};
+
+/*****************************************************************************/
+
+/// \brief Job that renders a decoded negative to a final image.
+
+class dng_render_job: public dng_job
+	{
+
+	private:
+
+		const dng_negative &fNegative;
+
+		uint32 fMaximumSize;
+
+		const dng_color_space *fFinalSpace;
+
+		uint32 fFinalPixelType;
+
+		AutoPtr<dng_image> fImage;
+
+	public:
+
+		/// \param negative Negative with a stage 3 image.  Must stay valid
+		/// until the job is done.
+		/// \param maximumSize Maximum size of the longer side of the result,
+		/// or zero for full size.
+		/// \param finalSpace Output color space, or NULL for sRGB.
+		/// \param finalPixelType ttByte, ttShort or ttFloat.
+
+		dng_render_job (const dng_negative &negative,
+						uint32 maximumSize = 0,
+						const dng_color_space *finalSpace = NULL,
+						uint32 finalPixelType = ttByte);
+
+		virtual ~dng_render_job ();
+
+		/// The rendered image, once the job has succeeded.
+
+		dng_image * Image ()
+			{
+			return fImage.Get ();
+			}
+
+		/// Take ownership of the rendered image.
+
+		dng_image * ReleaseImage ()
+			{
+			return fImage.Release ();
+			}
+
+	protected:
+
+		virtual void Run (dng_host &host);
+
+	};
+
+/*****************************************************************************/
+
+/// \brief Job that encodes a negative as a DNG file.
+
+class dng_encode_job: public dng_job
+	{
+
+	private:
+
+		dng_negative &fNegative;
+
+		dng_stream &fStream;
+
+	public:
+
+		/// \param negative Negative to write.  Must stay valid until the job
+		/// is done.
+		/// \param stream Stream to write to.  Must stay valid until the job
+		/// is done.
+
+		dng_encode_job (dng_negative &negative,
+						dng_stream &stream);
+
+	protected:
+
+		virtual void Run (dng_host &host);
+
+	};
+
+/*****************************************************************************/
+
+#endif
+
+/*****************************************************************************/
@@ -192,7 +192,7 @@ void dng_jpeg_image::Encode (dng_host &host,
 	
 	ifd.fCompression = ccLossyJPEG;
 	
-	ifd.FindTileSize (512 * 512 * ifd.fSamplesPerPixel);
+	host.FindTileSize (ifd, 512 * 512 * ifd.fSamplesPerPixel);
 	
 	fTileSize.h = ifd.fTileWidth;
 	fTileSize.v = ifd.fTileLength;
@@ -983,6 +983,11 @@ class dng_filter_warp: public dng_filter_task
 
 		virtual void Initialize (dng_host &host);
 
+		virtual bool ReusesSourceOverlap () const
+			{
+			return true;
+			}
+
 		virtual dng_rect SrcArea (const dng_rect &dstArea);
 
 		virtual dng_point SrcTileSize (const dng_point &dstTileSize);
@@ -35,7 +35,6 @@ class dng_linearize_plane
 	private:
 	
 		const dng_image & fSrcImage;
-		      dng_image & fDstImage;
 		      
 		uint32 fPlane;
 	
@@ -64,12 +63,30 @@ class dng_linearize_plane
 		dng_linearize_plane (dng_host &host,
 							 dng_linearization_info &info,
 							 const dng_image &srcImage,
-							 dng_image &dstImage,
+							 uint32 dstPixelType,
 							 uint32 plane);
 							 
 		~dng_linearize_plane ();
 		
-		void Process (const dng_rect &tile);
+		void Process (const dng_rect &tile,
+					  dng_pixel_buffer &dstBuffer) const;
+					  
+	private:
+	
+		enum
+			{
+			
+			// Columns of black pattern expanded at a time by ProcessRow.
+			
+			kRowChunk = 256
+			
+			};
+	
+		void ProcessRow (const void *sPtr,
+						 void *dPtr,
+						 uint32 count,
+						 uint32 dstRow,
+						 uint32 dstCol) const;
 								  
 	};
 
@@ -78,15 +95,14 @@ class dng_linearize_plane
 dng_linearize_plane::dng_linearize_plane (dng_host &host,
 										  dng_linearization_info &info,
 										  const dng_image &srcImage,
-										  dng_image &dstImage,
+										  uint32 dstPixelType,
 										  uint32 plane)
 							 
 	:	fSrcImage (srcImage)
-	,	fDstImage (dstImage)
 	,	fPlane (plane)
 	,	fActiveArea (info.fActiveArea)
 	,	fSrcPixelType (srcImage.PixelType ())
-	,	fDstPixelType (dstImage.PixelType ())
+	,	fDstPixelType (dstPixelType)
 	,	fReal32 (false)
 	,	fScale (0.0f)
 	,	fScale_buffer ()
@@ -448,7 +464,8 @@ dng_linearize_plane::~dng_linearize_plane ()
 							 
 /*****************************************************************************/
 
-void dng_linearize_plane::Process (const dng_rect &srcTile)
+void dng_linearize_plane::Process (const dng_rect &srcTile,
+									dng_pixel_buffer &dstBuffer) const
 	{
 
 	// Process tile.
@@ -456,7 +473,6 @@ void dng_linearize_plane::Process (const dng_rect &srcTile)
 	dng_rect dstTile = srcTile - fActiveArea.TL ();
 		
 	dng_const_tile_buffer srcBuffer (fSrcImage, srcTile);
-	dng_dirty_tile_buffer dstBuffer (fDstImage, dstTile);
 	
 	int32 sStep = srcBuffer.fColStep;
 	int32 dStep = dstBuffer.fColStep;
@@ -480,6 +496,17 @@ void dng_linearize_plane::Process (const dng_rect &srcTile)
 										   dstCol,
 										   fPlane);
 										   
+		// Contiguous rows use the unit step kernels.
+		
+		if (sStep == 1 && dStep == 1)
+			{
+			
+			ProcessRow (sPtr, dPtr, count, dstRow, dstCol);
+			
+			continue;
+			
+			}
+										   
 		// Floating point source case.
 		
 		if (fSrcPixelType == ttFloat)
@@ -952,6 +979,361 @@ void dng_linearize_plane::Process (const dng_rect &srcTile)
 	
 /*****************************************************************************/
 
+// Same results as the strided loops in Process, with the repeating black
+// pattern of each chunk of the row expanded into a buffer first, so that the
+// inner loops have no per-pixel branches and can be vectorized.  The floating
+// point cases subtract the row black and the pattern black in the same order
+// as Process.
+
+void dng_linearize_plane::ProcessRow (const void *sPtr,
+									  void *dPtr,
+									  uint32 count,
+									  uint32 dstRow,
+									  uint32 dstCol) const
+	{
+	
+	// Simple LUT case.
+	
+	if (fSrcPixelType != ttFloat &&
+		fSrcPixelType != ttLong  &&
+		fBlack_1D_rows == 0 &&
+		fBlack_2D_rows == 0)
+		{
+		
+		if (fDstPixelType == ttShort)
+			{
+			
+			const uint16 *lut = fScale_buffer->Buffer_uint16 ();
+			
+			uint16 *dstPtr = (uint16 *) dPtr;
+			
+			if (fSrcPixelType == ttByte)
+				{
+				
+				const uint8 *srcPtr = (const uint8 *) sPtr;
+				
+				for (uint32 j = 0; j < count; j++)
+					{
+					dstPtr [j] = lut [srcPtr [j]];
+					}
+					
+				}
+				
+			else
+				{
+				
+				const uint16 *srcPtr = (const uint16 *) sPtr;
+				
+				for (uint32 j = 0; j < count; j++)
+					{
+					dstPtr [j] = lut [srcPtr [j]];
+					}
+					
+				}
+			
+			}
+			
+		else
+			{
+			
+			const real32 *lut = fScale_buffer->Buffer_real32 ();
+			
+			real32 *dstPtr = (real32 *) dPtr;
+			
+			if (fSrcPixelType == ttByte)
+				{
+				
+				const uint8 *srcPtr = (const uint8 *) sPtr;
+				
+				for (uint32 j = 0; j < count; j++)
+					{
+					dstPtr [j] = lut [srcPtr [j]];
+					}
+					
+				}
+				
+			else
+				{
+				
+				const uint16 *srcPtr = (const uint16 *) sPtr;
+				
+				for (uint32 j = 0; j < count; j++)
+					{
+					dstPtr [j] = lut [srcPtr [j]];
+					}
+					
+				}
+			
+			}
+			
+		return;
+		
+		}
+		
+	// Floating point source, scale only case.
+	
+	if (fSrcPixelType == ttFloat &&
+		fBlack_1D_rows == 0 &&
+		fBlack_2D_cols == 0)
+		{
+		
+		real32 scale = fScale;
+		
+		const real32 *srcPtr = (const real32 *) sPtr;
+		
+		real32 *dstPtr = (real32 *) dPtr;
+		
+		for (uint32 j = 0; j < count; j++)
+			{
+			dstPtr [j] = srcPtr [j] * scale;
+			}
+			
+		return;
+		
+		}
+		
+	// Find the black pattern for this row.
+	
+	uint32 b1_index = fBlack_1D_rows ? dstRow % fBlack_1D_rows : 0;
+	
+	uint32 b2_count = fBlack_2D_cols;
+	uint32 b2_phase = 0;
+	
+	uint32 b2_offset = 0;
+	
+	if (b2_count)
+		{
+		
+		b2_offset = b2_count * (dstRow % fBlack_2D_rows);
+				 
+		b2_phase = dstCol % b2_count;
+		
+		}
+		
+	// Integer math case.
+	
+	if (fSrcPixelType != ttFloat && !fReal32)
+		{
+		
+		const int32 *lut = fScale_buffer->Buffer_int32 ();
+		
+		int32 b1 = fBlack_1D_rows ? fBlack_1D_buffer->Buffer_int32 () [b1_index] : 0;
+		
+		b1 -= 128;		// Rounding for 8 bit shift
+		
+		const int32 *b2 = b2_count ? fBlack_2D_buffer->Buffer_int32 () + b2_offset
+								   : NULL;
+		
+		uint16 *dstPtr = (uint16 *) dPtr;
+		
+		int32 black [kRowChunk];
+		
+		for (uint32 done = 0; done < count; done += kRowChunk)
+			{
+			
+			uint32 n = Min_uint32 (count - done, kRowChunk);
+			
+			for (uint32 j = 0; j < n; j++)
+				{
+				
+				if (b2_count)
+					{
+					
+					black [j] = b1 + b2 [b2_phase];
+					
+					if (++b2_phase == b2_count)
+						{
+						b2_phase = 0;
+						}
+						
+					}
+					
+				else
+					{
+					black [j] = b1;
+					}
+					
+				}
+				
+			if (fSrcPixelType == ttByte)
+				{
+				
+				const uint8 *srcPtr = (const uint8 *) sPtr + done;
+				
+				for (uint32 j = 0; j < n; j++)
+					{
+					
+					int32 x = (lut [srcPtr [j]] - black [j]) >> 8;
+					
+					dstPtr [done + j] = (uint16) Pin_int32 (0, x, 0x0FFFF);
+					
+					}
+					
+				}
+				
+			else
+				{
+				
+				const uint16 *srcPtr = (const uint16 *) sPtr + done;
+				
+				for (uint32 j = 0; j < n; j++)
+					{
+					
+					int32 x = (lut [srcPtr [j]] - black [j]) >> 8;
+					
+					dstPtr [done + j] = (uint16) Pin_int32 (0, x, 0x0FFFF);
+					
+					}
+					
+				}
+			
+			}
+			
+		return;
+		
+		}
+		
+	// Floating point math cases.
+	
+	real32 b1 = fBlack_1D_rows ? fBlack_1D_buffer->Buffer_real32 () [b1_index] : 0.0f;
+	
+	const real32 *b2 = b2_count ? fBlack_2D_buffer->Buffer_real32 () + b2_offset
+							    : NULL;
+	
+	real32 scale = fScale;
+	
+	real32 dstScale = (real32) 0x0FFFF;
+	
+	// Subtracting zero leaves every value unchanged, so the case without a
+	// black pattern uses a buffer of zeros.
+	
+	real32 black [kRowChunk];
+	
+	if (!b2_count)
+		{
+		
+		for (uint32 j = 0; j < kRowChunk; j++)
+			{
+			black [j] = 0.0f;
+			}
+			
+		}
+	
+	for (uint32 done = 0; done < count; done += kRowChunk)
+		{
+		
+		uint32 n = Min_uint32 (count - done, kRowChunk);
+		
+		if (b2_count)
+			{
+			
+			for (uint32 j = 0; j < n; j++)
+				{
+				
+				black [j] = b2 [b2_phase];
+				
+				if (++b2_phase == b2_count)
+					{
+					b2_phase = 0;
+					}
+					
+				}
+				
+			}
+			
+		// Floating point source, not pinned.
+		
+		if (fSrcPixelType == ttFloat)
+			{
+			
+			const real32 *srcPtr = (const real32 *) sPtr + done;
+			
+			real32 *dstPtr = (real32 *) dPtr + done;
+			
+			for (uint32 j = 0; j < n; j++)
+				{
+				dstPtr [j] = (srcPtr [j] * scale - b1) - black [j];
+				}
+				
+			}
+			
+		// Case 1: uint8/uint16 -> real32
+			
+		else if (fSrcPixelType != ttLong)
+			{
+			
+			const real32 *lut = fScale_buffer->Buffer_real32 ();
+			
+			real32 *dstPtr = (real32 *) dPtr + done;
+			
+			if (fSrcPixelType == ttByte)
+				{
+				
+				const uint8 *srcPtr = (const uint8 *) sPtr + done;
+				
+				for (uint32 j = 0; j < n; j++)
+					{
+					dstPtr [j] = Pin_real32 (0.0f, (lut [srcPtr [j]] - b1) - black [j], 1.0f);
+					}
+					
+				}
+				
+			else
+				{
+				
+				const uint16 *srcPtr = (const uint16 *) sPtr + done;
+				
+				for (uint32 j = 0; j < n; j++)
+					{
+					dstPtr [j] = Pin_real32 (0.0f, (lut [srcPtr [j]] - b1) - black [j], 1.0f);
+					}
+					
+				}
+				
+			}
+			
+		// Case 2: uint32 -> real32
+		
+		else if (fDstPixelType == ttFloat)
+			{
+			
+			const uint32 *srcPtr = (const uint32 *) sPtr + done;
+			
+			real32 *dstPtr = (real32 *) dPtr + done;
+			
+			for (uint32 j = 0; j < n; j++)
+				{
+				dstPtr [j] = Pin_real32 (0.0f, (((real32) srcPtr [j]) * scale - b1) - black [j], 1.0f);
+				}
+				
+			}
+			
+		// Case 3: uint32 -> uint16
+		
+		else
+			{
+			
+			const uint32 *srcPtr = (const uint32 *) sPtr + done;
+			
+			uint16 *dstPtr = (uint16 *) dPtr + done;
+			
+			for (uint32 j = 0; j < n; j++)
+				{
+				
+				real32 x = Pin_real32 (0.0f, (((real32) srcPtr [j]) * scale - b1) - black [j], 1.0f);
+				
+				dstPtr [j] = (uint16) (x * dstScale + 0.5f);
+				
+				}
+				
+			}
+			
+		}
+	
+	}
+	
+/*****************************************************************************/
+
 class dng_linearize_image: public dng_area_task
 	{
 	
@@ -1004,7 +1386,7 @@ dng_linearize_image::dng_linearize_image (dng_host &host,
 		fPlaneTask [plane].Reset (new dng_linearize_plane (host,
 														   info,
 														   srcImage,
-														   dstImage,
+														   dstImage.PixelType (),
 														   plane));
 														   
 		}
@@ -1047,12 +1429,15 @@ void dng_linearize_image::Process (uint32 /* threadIndex */,
 							  	   dng_abort_sniffer * /* sniffer */)
 	{
 
+	dng_dirty_tile_buffer dstBuffer (fDstImage,
+									 srcTile - fActiveArea.TL ());
+
 	// Process each plane.
 	
 	for (uint32 plane = 0; plane < fSrcImage.Planes (); plane++)
 		{
 		
-		fPlaneTask [plane]->Process (srcTile);
+		fPlaneTask [plane]->Process (srcTile, dstBuffer);
 														   
 		}
 		
@@ -1060,6 +1445,190 @@ void dng_linearize_image::Process (uint32 /* threadIndex */,
 	
 /*****************************************************************************/
 
+class dng_get_image_task: public dng_area_task
+	{
+	
+	private:
+	
+		const dng_image & fSrcImage;
+		      dng_image & fDstImage;
+		
+	public:
+	
+		dng_get_image_task (const dng_image &srcImage,
+							dng_image &dstImage);
+			
+		virtual dng_rect RepeatingTile1 () const;
+			
+		virtual dng_rect RepeatingTile2 () const;
+			
+		virtual void Process (uint32 threadIndex,
+							  const dng_rect &tile,
+							  dng_abort_sniffer *sniffer);
+		
+	};
+	
+/*****************************************************************************/
+
+dng_get_image_task::dng_get_image_task (const dng_image &srcImage,
+										dng_image &dstImage)
+
+	:	fSrcImage (srcImage)
+	,	fDstImage (dstImage)
+	
+	{
+	
+	fMaxTileSize = dng_point (1024, 1024);
+	
+	}
+							 
+/*****************************************************************************/
+
+dng_rect dng_get_image_task::RepeatingTile1 () const
+	{
+	
+	return fSrcImage.RepeatingTile ();
+	
+	}
+							 
+/*****************************************************************************/
+
+dng_rect dng_get_image_task::RepeatingTile2 () const
+	{
+	
+	return fDstImage.RepeatingTile ();
+	
+	}
+							 
+/*****************************************************************************/
+
+void dng_get_image_task::Process (uint32 /* threadIndex */,
+								  const dng_rect &tile,
+								  dng_abort_sniffer * /* sniffer */)
+	{
+	
+	dng_dirty_tile_buffer dstBuffer (fDstImage, tile);
+	
+	fSrcImage.Get (dstBuffer);
+	
+	}
+	
+/*****************************************************************************/
+
+dng_linearized_image::dng_linearized_image (dng_host &host,
+											dng_linearization_info &info,
+											AutoPtr<dng_image> &srcImage,
+											const dng_rect &bounds,
+											uint32 pixelType)
+
+	:	dng_image (bounds,
+				   srcImage->Planes (),
+				   pixelType)
+				   
+	,	fAllocator  (host.Allocator ())
+	,	fSrcImage   (srcImage.Release ())
+	,	fActiveArea (info.fActiveArea)
+	
+	{
+	
+	for (uint32 plane = 0; plane < Planes (); plane++)
+		{
+		
+		fPlaneTask [plane].Reset (new dng_linearize_plane (host,
+														   info,
+														   *fSrcImage,
+														   pixelType,
+														   plane));
+														   
+		}
+		
+	}
+
+/*****************************************************************************/
+
+dng_linearized_image::~dng_linearized_image ()
+	{
+	
+	}
+
+/*****************************************************************************/
+
+dng_rect dng_linearized_image::RepeatingTile () const
+	{
+	
+	return fSrcImage->RepeatingTile () - fActiveArea.TL ();
+	
+	}
+
+/*****************************************************************************/
+
+void dng_linearized_image::Linearize (dng_host &host,
+									  dng_image &dstImage) const
+	{
+	
+	dng_get_image_task task (*this, dstImage);
+	
+	host.PerformAreaTask (task, Bounds ());
+	
+	}
+
+/*****************************************************************************/
+
+void dng_linearized_image::DoGet (dng_pixel_buffer &buffer) const
+	{
+	
+	// Linearize into a buffer of our own pixel type, then convert.
+	
+	if (buffer.fPixelType != PixelType ())
+		{
+		
+		uint32 bufferSize = ComputeBufferSize (PixelType (),
+											   buffer.fArea.Size (),
+											   buffer.fPlanes,
+											   padNone);
+		
+		AutoPtr<dng_memory_block> block (fAllocator.Allocate (bufferSize));
+		
+		dng_pixel_buffer temp (buffer.fArea,
+							   buffer.fPlane,
+							   buffer.fPlanes,
+							   PixelType (),
+							   pcInterleaved,
+							   block->Buffer ());
+		
+		DoGet (temp);
+		
+		buffer.CopyArea (temp,
+						 buffer.fArea,
+						 buffer.fPlane,
+						 buffer.fPlanes);
+		
+		return;
+		
+		}
+		
+	dng_rect srcTile = buffer.fArea + fActiveArea.TL ();
+	
+	for (uint32 plane = buffer.fPlane; plane < buffer.fPlane + buffer.fPlanes; plane++)
+		{
+		
+		fPlaneTask [plane]->Process (srcTile, buffer);
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+void dng_linearized_image::DoPut (const dng_pixel_buffer & /* buffer */)
+	{
+	
+	ThrowProgramError ("dng_linearized_image is read-only");
+	
+	}
+	
+/*****************************************************************************/
+
 dng_linearization_info::dng_linearization_info ()
 
 	:	fActiveArea ()
@@ -1301,7 +1870,7 @@ void dng_linearization_info::PostParse (dng_host & /* host */,
 	if (fActiveArea.IsEmpty ())
 		{
 		
-		fActiveArea = negative.Stage1Image ()->Bounds ();
+		fActiveArea = negative.FullStageBounds (1);
 		
 		}
 	
@@ -1429,7 +1998,7 @@ void dng_linearization_info::Linearize (dng_host &host,
 								   dstImage);
 								   
 	host.PerformAreaTask (processor,
-						  fActiveArea);
+						  fActiveArea & srcImage.Bounds ());
 						
 	}
 				
@@ -24,6 +24,7 @@
 
 #include "dng_auto_ptr.h"
 #include "dng_classes.h"
+#include "dng_image.h"
 #include "dng_memory.h"
 #include "dng_rational.h"
 #include "dng_rect.h"
@@ -159,6 +160,72 @@ class dng_linearization_info
 	
 /*****************************************************************************/
 
+class dng_linearize_plane;
+
+/*****************************************************************************/
+
+/// \brief A stage 2 image that linearizes its stage 1 image as it is read.
+///
+/// Used in place of a full size stage 2 image that is only read once, by
+/// a downscaling interpolation, so each tile is linearized and binned in one
+/// pass.  The image is read-only.
+
+class dng_linearized_image: public dng_image
+	{
+	
+	private:
+	
+		dng_memory_allocator &fAllocator;
+	
+		AutoPtr<dng_image> fSrcImage;
+		
+		dng_rect fActiveArea;
+		
+		AutoPtr<dng_linearize_plane> fPlaneTask [kMaxColorPlanes];
+		
+	public:
+	
+		/// \param host Host used for the linearization tables.
+		/// \param info Linearization info, which is not needed after this
+		/// returns.
+		/// \param srcImage Stage 1 image, which this image takes ownership of.
+		/// \param bounds Bounds of the stage 2 image.
+		/// \param pixelType Pixel type of the stage 2 image, ttShort or ttFloat.
+	
+		dng_linearized_image (dng_host &host,
+							  dng_linearization_info &info,
+							  AutoPtr<dng_image> &srcImage,
+							  const dng_rect &bounds,
+							  uint32 pixelType);
+							  
+		virtual ~dng_linearized_image ();
+		
+		virtual dng_rect RepeatingTile () const;
+		
+		/// Linearize the whole image into dstImage, which has the same bounds,
+		/// planes and pixel type.
+		
+		void Linearize (dng_host &host,
+						dng_image &dstImage) const;
+		
+	protected:
+	
+		virtual void DoGet (dng_pixel_buffer &buffer) const;
+		
+		virtual void DoPut (const dng_pixel_buffer &buffer);
+		
+	private:
+	
+		// Hidden copy constructor and assignment operator.
+	
+		dng_linearized_image (const dng_linearized_image &image);
+		
+		dng_linearized_image & operator= (const dng_linearized_image &image);
+		
+	};
+
+/*****************************************************************************/
+
 #endif
 	
 /*****************************************************************************/
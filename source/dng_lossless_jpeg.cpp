@@ -53,6 +53,9 @@
 #include "dng_memory.h"
 #include "dng_stream.h"
 #include "dng_tag_codes.h"
+#include "dng_utils.h"
+
+#include <math.h>
 
 /*****************************************************************************/
 
@@ -2618,6 +2621,12 @@ class dng_lossless_encoder
 		int32 fSrcColStep;
 	
 		dng_stream &fStream;
+		
+		bool fSelectPredictor;
+		
+		// Predictor selection value (PSV) written to the scan header.
+		
+		uint32 fPredictor;
 	
 		HuffmanTable huffTable [4];
 		
@@ -2641,12 +2650,17 @@ class dng_lossless_encoder
 					 	      uint32 srcBitDepth,
 					 	      int32 srcRowStep,
 					 	      int32 srcColStep,
-					 	      dng_stream &stream);
+					 	      dng_stream &stream,
+					 	      bool selectPredictor = false);
 		
 		void Encode ();
 		
 	private:
 	
+		int32 Predict (const uint16 *sPtr) const;
+		
+		uint32 SelectPredictor ();
+	
 		void EmitByte (uint8 value);
 	
 		void EmitBits (int code, int size);
@@ -2692,7 +2706,8 @@ dng_lossless_encoder::dng_lossless_encoder (const uint16 *srcData,
 											uint32 srcBitDepth,
 											int32 srcRowStep,
 											int32 srcColStep,
-											dng_stream &stream)
+											dng_stream &stream,
+											bool selectPredictor)
 								    
 	:	fSrcData     (srcData    )
 	,	fSrcRows     (srcRows    )
@@ -2703,6 +2718,9 @@ dng_lossless_encoder::dng_lossless_encoder (const uint16 *srcData,
 	,	fSrcColStep  (srcColStep )
 	,	fStream      (stream     )
 	
+	,	fSelectPredictor (selectPredictor)
+	,	fPredictor       (1)
+	
 	,	huffPutBuffer (0)
 	,	huffPutBits   (0)
 	
@@ -2944,6 +2962,154 @@ inline void dng_lossless_encoder::EncodeOneDiff (int diff, HuffmanTable *dctbl)
 
 /*****************************************************************************/
 
+// Predicts the sample at sPtr, which is not in the first row or column,
+// the same way as dng_lossless_decoder::QuickPredict.
+
+inline int32 dng_lossless_encoder::Predict (const uint16 *sPtr) const
+	{
+	
+	int32 diag  = sPtr [-fSrcRowStep - fSrcColStep];
+	int32 upper = sPtr [-fSrcRowStep              ];
+	int32 left  = sPtr [              -fSrcColStep];
+	
+	switch (fPredictor)
+		{
+		
+		case 1:
+			return left;
+
+		case 2:
+			return upper;
+
+		case 3:
+			return diag;
+
+		case 4:
+			return left + upper - diag;
+
+		case 5:
+			return left + ((upper - diag) >> 1);
+
+		case 6:
+			return upper + ((left - diag) >> 1);
+
+		default:
+			return (left + upper) >> 1;
+
+		}
+		
+	}
+
+/*****************************************************************************/
+
+// Estimates the coded size of a subsample of the image for each predictor,
+// using the difference categories (Huffman code) plus their extra bits, and
+// returns the best.  Predictor 1 is kept unless another saves at least 1%,
+// since the decoder has a faster path for it.
+
+uint32 dng_lossless_encoder::SelectPredictor ()
+	{
+	
+	const uint32 kPredictors  = 7;
+	const uint32 kSampleRows  = 16;
+	const uint32 kSampleCols  = 256;
+	
+	if (fSrcRows < 2 || fSrcCols < 2)
+		{
+		return 1;
+		}
+		
+	uint32 rowStep = Max_uint32 (1, (fSrcRows - 1) / kSampleRows);
+	uint32 colStep = Max_uint32 (1, (fSrcCols - 1) / kSampleCols);
+	
+	uint32 counts [kPredictors] [4] [17];
+	
+	memset (counts, 0, sizeof (counts));
+	
+	for (uint32 row = 1; row < fSrcRows; row += rowStep)
+		{
+		
+		const uint16 *rowPtr = fSrcData + row * fSrcRowStep;
+		
+		for (uint32 col = 1; col < fSrcCols; col += colStep)
+			{
+			
+			const uint16 *sPtr = rowPtr + col * fSrcColStep;
+			
+			for (uint32 channel = 0; channel < fSrcChannels; channel++)
+				{
+				
+				for (uint32 index = 0; index < kPredictors; index++)
+					{
+					
+					fPredictor = index + 1;
+					
+					int16 diff = (int16) (sPtr [channel] - Predict (sPtr + channel));
+					
+					CountOneDiff (diff, counts [index] [channel]);
+					
+					}
+				
+				}
+			
+			}
+		
+		}
+		
+	real64 bestBits = 0.0;
+	real64 baseBits = 0.0;
+	
+	uint32 best = 1;
+		
+	for (uint32 index = 0; index < kPredictors; index++)
+		{
+		
+		real64 bits = 0.0;
+		
+		for (uint32 channel = 0; channel < fSrcChannels; channel++)
+			{
+			
+			real64 total = 0.0;
+			
+			for (uint32 nbits = 0; nbits <= 16; nbits++)
+				{
+				total += counts [index] [channel] [nbits];
+				}
+			
+			for (uint32 nbits = 0; nbits <= 16; nbits++)
+				{
+				
+				real64 count = counts [index] [channel] [nbits];
+				
+				if (count > 0.0)
+					{
+					bits += count * (nbits + log (total / count) / log (2.0));
+					}
+				
+				}
+			
+			}
+			
+		if (index == 0)
+			{
+			baseBits = bits;
+			bestBits = bits;
+			}
+			
+		else if (bits < bestBits && bits < baseBits * 0.99)
+			{
+			bestBits = bits;
+			best     = index + 1;
+			}
+		
+		}
+		
+	return best;
+	
+	}
+
+/*****************************************************************************/
+
 /*
  *--------------------------------------------------------------
  *
@@ -2973,6 +3139,43 @@ void dng_lossless_encoder::FreqCountSet ()
     	
 		const uint16 *sPtr = fSrcData + row * fSrcRowStep;
 		
+		// Rows after the first using a predictor other than the left
+		// neighbor.  The first column is predicted from the row above.
+		
+		if (row > 0 && fPredictor != 1)
+			{
+			
+    		const uint16 *uPtr = sPtr - fSrcRowStep;
+			
+    		for (uint32 channel = 0; channel < fSrcChannels; channel++)
+    			{
+    			
+    			int16 diff = (int16) (sPtr [channel] - uPtr [channel]);
+    			
+    			CountOneDiff (diff, freqCount [channel]);
+    			
+    			}
+			
+	    	for (uint32 col = 1; col < fSrcCols; col++)
+	    		{
+	    		
+	    		sPtr += fSrcColStep;
+	    			
+	    		for (uint32 channel = 0; channel < fSrcChannels; channel++)
+	    			{
+	    			
+	    			int16 diff = (int16) (sPtr [channel] - Predict (sPtr + channel));
+	    			
+	    			CountOneDiff (diff, freqCount [channel]);
+	    			
+	    			}
+	    			
+	    		}
+	    		
+	    	continue;
+			
+			}
+		
 		// Initialize predictors for this row.
 		
 		int32 predictor [4];
@@ -3079,6 +3282,43 @@ void dng_lossless_encoder::HuffEncode ()
     	
 		const uint16 *sPtr = fSrcData + row * fSrcRowStep;
 		
+		// Rows after the first using a predictor other than the left
+		// neighbor.  The first column is predicted from the row above.
+		
+		if (row > 0 && fPredictor != 1)
+			{
+			
+    		const uint16 *uPtr = sPtr - fSrcRowStep;
+			
+    		for (uint32 channel = 0; channel < fSrcChannels; channel++)
+    			{
+    			
+    			int16 diff = (int16) (sPtr [channel] - uPtr [channel]);
+    			
+    			EncodeOneDiff (diff, &huffTable [channel]);
+    			
+    			}
+			
+	    	for (uint32 col = 1; col < fSrcCols; col++)
+	    		{
+	    		
+	    		sPtr += fSrcColStep;
+	    			
+	    		for (uint32 channel = 0; channel < fSrcChannels; channel++)
+	    			{
+	    			
+	    			int16 diff = (int16) (sPtr [channel] - Predict (sPtr + channel));
+	    			
+	    			EncodeOneDiff (diff, &huffTable [channel]);
+	    			
+	    			}
+	    			
+	    		}
+	    		
+	    	continue;
+			
+			}
+		
 		// Initialize predictors for this row.
 		
 		int32 predictor [4];
@@ -3630,7 +3870,7 @@ void dng_lossless_encoder::EmitSos ()
 		
     	}
 
-    EmitByte (1);		// PSV - hardcoded - tknoll
+    EmitByte ((uint8) fPredictor);		// PSV
     EmitByte (0);	    // Spectral selection end  - Se
     EmitByte (0);  		// The point transform parameter 
     
@@ -3728,6 +3968,10 @@ void dng_lossless_encoder::Encode ()
 	{
 	
 	DNG_ASSERT (fSrcChannels <= 4, "Too many components in scan");
+	
+	// Choose the predictor, if requested.
+	
+	fPredictor = fSelectPredictor ? SelectPredictor () : 1;
     
 	// Count the times each difference category occurs. 
 	// Construct the optimal Huffman table.
@@ -3759,7 +4003,8 @@ void EncodeLosslessJPEG (const uint16 *srcData,
 						 uint32 srcBitDepth,
 						 int32 srcRowStep,
 						 int32 srcColStep,
-						 dng_stream &stream)
+						 dng_stream &stream,
+						 bool selectPredictor)
 	{
 	
 	dng_lossless_encoder encoder (srcData,
@@ -3769,7 +4014,8 @@ void EncodeLosslessJPEG (const uint16 *srcData,
 							      srcBitDepth,
 							      srcRowStep,
 							      srcColStep,
-							      stream);
+							      stream,
+							      selectPredictor);
 
 	encoder.Encode ();
 	
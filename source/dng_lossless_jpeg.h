@@ -60,7 +60,8 @@ void EncodeLosslessJPEG (const uint16 *srcData,
 						 uint32 srcBitDepth,
 						 int32 srcRowStep,
 						 int32 srcColStep,
-						 dng_stream &stream);
+						 dng_stream &stream,
+						 bool selectPredictor = false);
 						 
 /*****************************************************************************/
 
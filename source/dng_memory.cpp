@@ -18,6 +18,7 @@
 #include "dng_bottlenecks.h"
 #include "dng_exceptions.h"
 #include "dng_safe_arithmetic.h"
+#include "dng_utils.h"
 
 /*****************************************************************************/
 
@@ -126,11 +127,30 @@ void dng_memory_data::Clear ()
 dng_memory_block * dng_memory_block::Clone (dng_memory_allocator &allocator) const
 	{
 	
-	uint32 size = LogicalSize ();
+	uint64 size = LogicalSize64 ();
 	
-	dng_memory_block * result = allocator.Allocate (size);
+	dng_memory_block * result = size <= 0xFFFFFFFF
+							  ? allocator.Allocate ((uint32) size)
+							  : allocator.Allocate64 (size);
 	
-	DoCopyBytes (Buffer (), result->Buffer (), size);
+	// Copy in pieces, since DoCopyBytes takes a uint32 count.
+	
+	const uint8 *sPtr = Buffer_uint8 ();
+		  uint8 *dPtr = result->Buffer_uint8 ();
+	
+	while (size)
+		{
+		
+		uint32 count = (uint32) Min_uint64 (size, 0x80000000);
+		
+		DoCopyBytes (sPtr, dPtr, count);
+		
+		sPtr += count;
+		dPtr += count;
+		
+		size -= count;
+		
+		}
 		
 	return result;
 	
@@ -147,7 +167,7 @@ class dng_malloc_block : public dng_memory_block
 	
 	public:
 	
-		dng_malloc_block (uint32 logicalSize);
+		dng_malloc_block (uint64 logicalSize);
 		
 		virtual ~dng_malloc_block ();
 		
@@ -163,17 +183,30 @@ class dng_malloc_block : public dng_memory_block
 	
 /*****************************************************************************/
 
-dng_malloc_block::dng_malloc_block (uint32 logicalSize)
+dng_malloc_block::dng_malloc_block (uint64 logicalSize)
 
 	:	dng_memory_block (logicalSize)
 	
 	,	fMalloc (NULL)
 	
 	{
+	
+	// Blocks over 4 GB may not fit in a size_t on 32-bit platforms.
+	
+	const uint64 physicalSize64 = PhysicalSize ();
+	
+	const size_t physicalSize = (size_t) physicalSize64;
+	
+	if ((uint64) physicalSize != physicalSize64)
+		{
+		
+		ThrowMemoryFull ();
+		
+		}
 
 #if (qLinux && !defined(__ANDROID_API__)) || (defined(__ANDROID_API__) && __ANDROID_API__ >= 17)
 
-	int err = ::posix_memalign( (void **) &fMalloc, 16, (size_t) PhysicalSize() );
+	int err = ::posix_memalign( (void **) &fMalloc, 16, physicalSize );
 
 	if (err)
 		{
@@ -184,7 +217,7 @@ dng_malloc_block::dng_malloc_block (uint32 logicalSize)
 
 #else
 
-	fMalloc = (char*)malloc (PhysicalSize ());
+	fMalloc = (char*)malloc (physicalSize);
 	
 	if (!fMalloc)
 		{
@@ -233,6 +266,31 @@ dng_memory_block * dng_memory_allocator::Allocate (uint32 size)
 
 /*****************************************************************************/
 
+dng_memory_block * dng_memory_allocator::Allocate64 (uint64 size)
+	{
+	
+	if (size <= 0xFFFFFFFF)
+		{
+		
+		return Allocate ((uint32) size);
+		
+		}
+	
+	dng_memory_block *result = new dng_malloc_block (size);
+	
+	if (!result)
+		{
+		
+		ThrowMemoryFull ();
+		
+		}
+	
+	return result;
+	
+	}
+
+/*****************************************************************************/
+
 dng_memory_allocator gDefaultDNGMemoryAllocator;
 
 /*****************************************************************************/
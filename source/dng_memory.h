@@ -288,19 +288,19 @@ class dng_memory_block
 	
 	private:
 	
-		uint32 fLogicalSize;
+		uint64 fLogicalSize;
 		
 		char *fBuffer;
 		
 	protected:
 	
-		dng_memory_block (uint32 logicalSize)
+		dng_memory_block (uint64 logicalSize)
 			:	fLogicalSize (logicalSize)
 			,	fBuffer (NULL)
 			{
 			}
 		
-		uint32 PhysicalSize ()
+		uint64 PhysicalSize ()
 			{
 			
 			// This size is padded for TWO reasons!  The first is allow alignment
@@ -321,8 +321,8 @@ class dng_memory_block
 			//  Linux is 8 byte, but it's using mem_align.  
 			// We should fix the SIMD routines and revisit removing this padding - Alec.
 			
-			uint32 result;
-			if (!SafeUint32Add(fLogicalSize, 64u, &result))
+			uint64 result;
+			if (!SafeUint64Add(fLogicalSize, 64u, &result))
 				{
 				ThrowMemoryFull("Arithmetic overflow in PhysicalSize()");
 				}
@@ -346,9 +346,28 @@ class dng_memory_block
 	
 		/// Getter for available size, in bytes, of memory block.
 		/// \retval size in bytes of available memory in memory block.
+		/// \exception dng_exception with fErrorCode equal to dng_error_memory
+		/// if the block is larger than 4 GB, which only blocks from
+		/// dng_memory_allocator::Allocate64 can be.
 
 		uint32 LogicalSize () const
 			{
+			
+			if (fLogicalSize > 0xFFFFFFFF)
+				{
+				ThrowMemoryFull ("Memory block too large for LogicalSize()");
+				}
+				
+			return (uint32) fLogicalSize;
+			
+			}
+
+		/// Getter for available size, in bytes, of memory block, which may be
+		/// larger than 4 GB.
+		/// \retval size in bytes of available memory in memory block.
+
+		uint64 LogicalSize64 () const
+			{
 			return fLogicalSize;
 			}
 
@@ -525,6 +544,15 @@ class dng_memory_allocator
 		/// \exception dng_exception with fErrorCode equal to dng_error_memory.
 
 		virtual dng_memory_block * Allocate (uint32 size);
+		
+		/// Allocate a dng_memory block that may be larger than 4 GB, such as
+		/// the buffer of a whole image.  The default calls Allocate for sizes
+		/// that fit in a uint32, and otherwise uses malloc.
+		/// \param size Number of bytes in memory block.
+		/// \retval A dng_memory_block with at least size bytes of valid storage.
+		/// \exception dng_exception with fErrorCode equal to dng_error_memory.
+
+		virtual dng_memory_block * Allocate64 (uint64 size);
 	
 	};
 
@@ -20,6 +20,7 @@
 #include "dng_globals.h"
 #include "dng_host.h"
 #include "dng_image.h"
+#include "dng_pixel_buffer.h"
 #include "dng_rect.h"
 #include "dng_safe_arithmetic.h"
 #include "dng_stream.h"
@@ -242,6 +243,20 @@ dng_rect dng_area_spec::Overlap (const dng_rect &tile) const
 
 /*****************************************************************************/
 
+bool dng_area_spec::Covers (const dng_rect &imageBounds) const
+	{
+	
+	if (fRowPitch != 1 || fColPitch != 1)
+		{
+		return false;
+		}
+		
+	return fArea.IsEmpty () || (fArea & imageBounds) == imageBounds;
+	
+	}
+
+/*****************************************************************************/
+
 dng_opcode_MapTable::dng_opcode_MapTable (dng_host &host,
 										  const dng_area_spec &areaSpec,
 										  const uint16 *table,
@@ -393,6 +408,15 @@ dng_rect dng_opcode_MapTable::ModifiedBounds (const dng_rect &imageBounds)
 	return fAreaSpec.Overlap (imageBounds);
 	
 	}
+
+/*****************************************************************************/
+
+bool dng_opcode_MapTable::IsScaleInvariant (const dng_rect &imageBounds) const
+	{
+	
+	return fAreaSpec.Covers (imageBounds);
+	
+	}
 	
 /*****************************************************************************/
 
@@ -441,6 +465,7 @@ dng_opcode_MapPolynomial::dng_opcode_MapPolynomial (const dng_area_spec &areaSpe
 												  
 	,	fAreaSpec (areaSpec)
 	,	fDegree   (degree)
+	,	fTable16  ()
 	
 	{
 	
@@ -478,6 +503,7 @@ dng_opcode_MapPolynomial::dng_opcode_MapPolynomial (dng_stream &stream)
 	
 	,	fAreaSpec ()
 	,	fDegree   (0)
+	,	fTable16  ()
 	
 	{
 	
@@ -599,6 +625,40 @@ uint32 dng_opcode_MapPolynomial::BufferPixelType (uint32 imagePixelType)
 		factor32 *= scale32;
 		
 		}
+		
+	// On 16-bit data, map every value through the same conversions and
+	// real32 arithmetic as the ttFloat path, so the table gives the same
+	// results without converting each tile.
+		
+	if (imagePixelType == ttShort)
+		{
+		
+		fTable16.Allocate (0x10000, sizeof (uint16));
+		
+		dng_memory_data values (0x10000, sizeof (real32));
+		
+		uint16 *table = fTable16.Buffer_uint16 ();
+		
+		for (uint32 index = 0; index < 0x10000; index++)
+			{
+			table [index] = (uint16) index;
+			}
+			
+		dng_rect area (1, 0x10000);
+		
+		dng_pixel_buffer buffer16 (area, 0, 1, ttShort, pcInterleaved, table);
+		
+		dng_pixel_buffer buffer32 (area, 0, 1, ttFloat, pcInterleaved, values.Buffer ());
+		
+		buffer32.CopyArea (buffer16, area, 0, 1);
+		
+		MapRow32 (values.Buffer_real32 (), 0x10000, 1);
+		
+		buffer16.CopyArea (buffer32, area, 0, 1);
+		
+		return ttShort;
+		
+		}
 
 	return ttFloat;
 	
@@ -612,6 +672,15 @@ dng_rect dng_opcode_MapPolynomial::ModifiedBounds (const dng_rect &imageBounds)
 	return fAreaSpec.Overlap (imageBounds);
 	
 	}
+
+/*****************************************************************************/
+
+bool dng_opcode_MapPolynomial::IsScaleInvariant (const dng_rect &imageBounds) const
+	{
+	
+	return fAreaSpec.Covers (imageBounds);
+	
+	}
 								  
 /*****************************************************************************/
 
@@ -637,188 +706,217 @@ void dng_opcode_MapPolynomial::ProcessArea (dng_negative & /* negative */,
 			 plane++)
 			{
 			
+			// 16-bit data uses the table built by BufferPixelType.
+			
+			if (buffer.fPixelType == ttShort)
+				{
+				
+				DoMapArea16 (buffer.DirtyPixel_uint16 (overlap.t, overlap.l, plane),
+							 1,
+							 (overlap.H () + fAreaSpec.RowPitch () - 1) / fAreaSpec.RowPitch (),
+							 (cols + colPitch - 1) / colPitch,
+							 0,
+							 fAreaSpec.RowPitch () * buffer.RowStep (),
+							 colPitch,
+							 fTable16.Buffer_uint16 ());
+				
+				continue;
+				
+				}
+			
 			for (int32 row = overlap.t; row < overlap.b; row += fAreaSpec.RowPitch ())
 				{
 				
-				real32 *dPtr = buffer.DirtyPixel_real32 (row, overlap.l, plane);
+				MapRow32 (buffer.DirtyPixel_real32 (row, overlap.l, plane),
+						  cols,
+						  colPitch);
 				
-				switch (fDegree)
-					{
-					
-					case 0:
-						{
-						
-						real32 y = Pin_real32 (0.0f,
-											   fCoefficient32 [0],
-											   1.0f);
-						
-						for (uint32 col = 0; col < cols; col += colPitch)
-							{
-							
-							dPtr [col] = y;
-							
-							}
-							
-						break;
-					
-						}
+				}
+			
+			}
+		
+		}
+	
+	}
 
-					case 1:
-						{
-						
-						real32 c0 = fCoefficient32 [0];
-						real32 c1 = fCoefficient32 [1];
-						
-						if (c0 == 0.0f)
-							{
-							
-							if (c1 > 0.0f)
-								{
-						
-								for (uint32 col = 0; col < cols; col += colPitch)
-									{
-									
-									real32 x = dPtr [col];
-									
-									real32 y = c1 * x;
-											   
-									dPtr [col] = Min_real32 (y, 1.0f);
-									
-									}
-								
-								}
-								
-							else
-								{
-						
-								for (uint32 col = 0; col < cols; col += colPitch)
-									{
-									
-									dPtr [col] = 0.0f;
-									
-									}
-								
-								}
-							
-							}
-							
-						else
-							{
-						
-							for (uint32 col = 0; col < cols; col += colPitch)
-								{
-								
-								real32 x = dPtr [col];
-								
-								real32 y = c0 +
-										   c1 * x;
-										   
-								dPtr [col] = Pin_real32 (0.0f, y, 1.0f);
-								
-								}
-								
-							}
-							
-						break;
-					
-						}
-					
-					case 2:
-						{
-						
-						for (uint32 col = 0; col < cols; col += colPitch)
-							{
-							
-							real32 x = dPtr [col];
-							
-							real32 y =  fCoefficient32 [0] + x *
-									   (fCoefficient32 [1] + x *
-									   (fCoefficient32 [2]));
-									   
-							dPtr [col] = Pin_real32 (0.0f, y, 1.0f);
-							
-							}
-							
-						break;
-					
-						}
-					
-					case 3:
-						{
-						
-						for (uint32 col = 0; col < cols; col += colPitch)
-							{
-							
-							real32 x = dPtr [col];
-							
-							real32 y =  fCoefficient32 [0] + x *
-									   (fCoefficient32 [1] + x *
-									   (fCoefficient32 [2] + x *
-									   (fCoefficient32 [3])));
-									   
-							dPtr [col] = Pin_real32 (0.0f, y, 1.0f);
-							
-							}
-							
-						break;
-					
-						}
-					
-					case 4:
+/*****************************************************************************/
+
+void dng_opcode_MapPolynomial::MapRow32 (real32 *dPtr,
+										 uint32 cols,
+										 uint32 colPitch) const
+	{
+	
+	switch (fDegree)
+		{
+	
+		case 0:
+			{
+	
+			real32 y = Pin_real32 (0.0f,
+								   fCoefficient32 [0],
+								   1.0f);
+	
+			for (uint32 col = 0; col < cols; col += colPitch)
+				{
+	
+				dPtr [col] = y;
+	
+				}
+	
+			break;
+	
+			}
+	
+		case 1:
+			{
+	
+			real32 c0 = fCoefficient32 [0];
+			real32 c1 = fCoefficient32 [1];
+	
+			if (c0 == 0.0f)
+				{
+	
+				if (c1 > 0.0f)
+					{
+	
+					for (uint32 col = 0; col < cols; col += colPitch)
 						{
-						
-						for (uint32 col = 0; col < cols; col += colPitch)
-							{
-							
-							real32 x = dPtr [col];
-							
-							real32 y =  fCoefficient32 [0] + x *
-									   (fCoefficient32 [1] + x *
-									   (fCoefficient32 [2] + x *
-									   (fCoefficient32 [3] + x *
-									   (fCoefficient32 [4]))));
-									   
-							dPtr [col] = Pin_real32 (0.0f, y, 1.0f);
-							
-							}
-							
-						break;
-					
+	
+						real32 x = dPtr [col];
+	
+						real32 y = c1 * x;
+	
+						dPtr [col] = Min_real32 (y, 1.0f);
+	
 						}
-																						
-					default:
+	
+					}
+	
+				else
+					{
+	
+					for (uint32 col = 0; col < cols; col += colPitch)
 						{
-						
-						for (uint32 col = 0; col < cols; col += colPitch)
-							{
-							
-							real32 x = dPtr [col];
-							
-							real32 y = fCoefficient32 [0];
-							
-							real32 xx = x;
-							
-							for (uint32 j = 1; j <= fDegree; j++)
-								{
-								
-								y += fCoefficient32 [j] * xx;
-								
-								xx *= x;
-								
-								}
-																   
-							dPtr [col] = Pin_real32 (0.0f, y, 1.0f);
-							
-							}
-							
+	
+						dPtr [col] = 0.0f;
+	
 						}
-											
+	
 					}
-				
+	
 				}
-			
+	
+			else
+				{
+	
+				for (uint32 col = 0; col < cols; col += colPitch)
+					{
+	
+					real32 x = dPtr [col];
+	
+					real32 y = c0 +
+							   c1 * x;
+	
+					dPtr [col] = Pin_real32 (0.0f, y, 1.0f);
+	
+					}
+	
+				}
+	
+			break;
+	
 			}
-		
+	
+		case 2:
+			{
+	
+			for (uint32 col = 0; col < cols; col += colPitch)
+				{
+	
+				real32 x = dPtr [col];
+	
+				real32 y =  fCoefficient32 [0] + x *
+						   (fCoefficient32 [1] + x *
+						   (fCoefficient32 [2]));
+	
+				dPtr [col] = Pin_real32 (0.0f, y, 1.0f);
+	
+				}
+	
+			break;
+	
+			}
+	
+		case 3:
+			{
+	
+			for (uint32 col = 0; col < cols; col += colPitch)
+				{
+	
+				real32 x = dPtr [col];
+	
+				real32 y =  fCoefficient32 [0] + x *
+						   (fCoefficient32 [1] + x *
+						   (fCoefficient32 [2] + x *
+						   (fCoefficient32 [3])));
+	
+				dPtr [col] = Pin_real32 (0.0f, y, 1.0f);
+	
+				}
+	
+			break;
+	
+			}
+	
+		case 4:
+			{
+	
+			for (uint32 col = 0; col < cols; col += colPitch)
+				{
+	
+				real32 x = dPtr [col];
+	
+				real32 y =  fCoefficient32 [0] + x *
+						   (fCoefficient32 [1] + x *
+						   (fCoefficient32 [2] + x *
+						   (fCoefficient32 [3] + x *
+						   (fCoefficient32 [4]))));
+	
+				dPtr [col] = Pin_real32 (0.0f, y, 1.0f);
+	
+				}
+	
+			break;
+	
+			}
+	
+		default:
+			{
+	
+			for (uint32 col = 0; col < cols; col += colPitch)
+				{
+	
+				real32 x = dPtr [col];
+	
+				real32 y = fCoefficient32 [0];
+	
+				real32 xx = x;
+	
+				for (uint32 j = 1; j <= fDegree; j++)
+					{
+	
+					y += fCoefficient32 [j] * xx;
+	
+					xx *= x;
+	
+					}
+	
+				dPtr [col] = Pin_real32 (0.0f, y, 1.0f);
+	
+				}
+	
+			}
+	
 		}
 	
 	}
@@ -961,8 +1059,10 @@ uint32 dng_opcode_DeltaPerRow::BufferPixelType (uint32 imagePixelType)
 		}
 		
 	fScale = (real32) (1.0 / scale32);
+	
+	// 16-bit data is processed in place by DoDeltaRow16.
 		
-	return ttFloat;
+	return imagePixelType == ttShort ? ttShort : ttFloat;
 	
 	}
 
@@ -1008,6 +1108,19 @@ void dng_opcode_DeltaPerRow::ProcessArea (dng_negative & /* negative */,
 				
 				real32 rowDelta = *(table++) * fScale;
 				
+				if (buffer.fPixelType == ttShort)
+					{
+					
+					DoDeltaRow16 (buffer.DirtyPixel_uint16 (row, overlap.l, plane),
+								  &rowDelta,
+								  (cols + colPitch - 1) / colPitch,
+								  colPitch,
+								  0);
+					
+					continue;
+					
+					}
+				
 				real32 *dPtr = buffer.DirtyPixel_real32 (row, overlap.l, plane);
 				
 				for (uint32 col = 0; col < cols; col += colPitch)
@@ -1167,8 +1280,10 @@ uint32 dng_opcode_DeltaPerColumn::BufferPixelType (uint32 imagePixelType)
 		}
 		
 	fScale = (real32) (1.0 / scale32);
+	
+	// 16-bit data is processed in place by DoDeltaRow16.
 		
-	return ttFloat;
+	return imagePixelType == ttShort ? ttShort : ttFloat;
 	
 	}
 
@@ -1210,6 +1325,49 @@ void dng_opcode_DeltaPerColumn::ProcessArea (dng_negative & /* negative */,
 								  ((overlap.l - fAreaSpec.Area ().l) /
 								   fAreaSpec.ColPitch ());
 			
+			// 16-bit data is processed row by row, for a band of columns
+			// at a time.
+			
+			if (buffer.fPixelType == ttShort)
+				{
+				
+				const uint32 kBandSize = 256;
+				
+				real32 colDelta [kBandSize];
+				
+				uint32 colPitch = fAreaSpec.ColPitch ();
+				
+				uint32 count = (overlap.W () + colPitch - 1) / colPitch;
+				
+				for (uint32 first = 0; first < count; first += kBandSize)
+					{
+					
+					uint32 band = Min_uint32 (count - first, kBandSize);
+					
+					for (uint32 j = 0; j < band; j++)
+						{
+						colDelta [j] = table [first + j] * fScale;
+						}
+					
+					uint16 *dPtr = buffer.DirtyPixel_uint16 (overlap.t,
+															 overlap.l + first * colPitch,
+															 plane);
+					
+					for (uint32 row = 0; row < rows; row++)
+						{
+						
+						DoDeltaRow16 (dPtr, colDelta, band, colPitch, 1);
+						
+						dPtr += rowStep;
+						
+						}
+					
+					}
+				
+				continue;
+				
+				}
+			
 			for (int32 col = overlap.l; col < overlap.r; col += fAreaSpec.ColPitch ())
 				{
 				
@@ -1345,10 +1503,12 @@ void dng_opcode_ScalePerRow::PutData (dng_stream &stream) const
 
 /*****************************************************************************/
 
-uint32 dng_opcode_ScalePerRow::BufferPixelType (uint32 /* imagePixelType */)
+uint32 dng_opcode_ScalePerRow::BufferPixelType (uint32 imagePixelType)
 	{
+	
+	// 16-bit data is processed in place by DoScaleRow16.
 			
-	return ttFloat;
+	return imagePixelType == ttShort ? ttShort : ttFloat;
 	
 	}
 
@@ -1394,6 +1554,19 @@ void dng_opcode_ScalePerRow::ProcessArea (dng_negative & /* negative */,
 				
 				real32 rowScale = *(table++);
 				
+				if (buffer.fPixelType == ttShort)
+					{
+					
+					DoScaleRow16 (buffer.DirtyPixel_uint16 (row, overlap.l, plane),
+								  &rowScale,
+								  (cols + colPitch - 1) / colPitch,
+								  colPitch,
+								  0);
+					
+					continue;
+					
+					}
+				
 				real32 *dPtr = buffer.DirtyPixel_real32 (row, overlap.l, plane);
 				
 				for (uint32 col = 0; col < cols; col += colPitch)
@@ -1522,10 +1695,12 @@ void dng_opcode_ScalePerColumn::PutData (dng_stream &stream) const
 
 /*****************************************************************************/
 
-uint32 dng_opcode_ScalePerColumn::BufferPixelType (uint32 /* imagePixelType */)
+uint32 dng_opcode_ScalePerColumn::BufferPixelType (uint32 imagePixelType)
 	{
 	
-	return ttFloat;
+	// 16-bit data is processed in place by DoScaleRow16.
+	
+	return imagePixelType == ttShort ? ttShort : ttFloat;
 	
 	}
 
@@ -1567,6 +1742,30 @@ void dng_opcode_ScalePerColumn::ProcessArea (dng_negative & /* negative */,
 								  ((overlap.l - fAreaSpec.Area ().l) /
 								   fAreaSpec.ColPitch ());
 			
+			// 16-bit data is processed row by row.
+			
+			if (buffer.fPixelType == ttShort)
+				{
+				
+				uint32 colPitch = fAreaSpec.ColPitch ();
+				
+				uint32 count = (overlap.W () + colPitch - 1) / colPitch;
+				
+				uint16 *dPtr = buffer.DirtyPixel_uint16 (overlap.t, overlap.l, plane);
+				
+				for (uint32 row = 0; row < rows; row++)
+					{
+					
+					DoScaleRow16 (dPtr, table, count, colPitch, 1);
+					
+					dPtr += rowStep;
+					
+					}
+				
+				continue;
+				
+				}
+			
 			for (int32 col = overlap.l; col < overlap.r; col += fAreaSpec.ColPitch ())
 				{
 				
@@ -22,6 +22,7 @@
 
 /*****************************************************************************/
 
+#include "dng_memory.h"
 #include "dng_opcodes.h"
 
 /*****************************************************************************/
@@ -144,6 +145,11 @@ class dng_area_spec
 		/// area and the specified tile.
 		
 		dng_rect Overlap (const dng_rect &tile) const;
+		
+		/// Does this area include every pixel (row and column) of an image
+		/// with the specified bounds?
+		
+		bool Covers (const dng_rect &imageBounds) const;
 
 	};
 
@@ -181,6 +187,8 @@ class dng_opcode_MapTable: public dng_inplace_opcode
 		virtual uint32 BufferPixelType (uint32 imagePixelType);
 			
 		virtual dng_rect ModifiedBounds (const dng_rect &imageBounds);
+		
+		virtual bool IsScaleInvariant (const dng_rect &imageBounds) const;
 	
 		virtual void ProcessArea (dng_negative &negative,
 								  uint32 threadIndex,
@@ -219,6 +227,10 @@ class dng_opcode_MapPolynomial: public dng_inplace_opcode
 		
 		real32 fCoefficient32 [kMaxDegree + 1];
 		
+		// Table of the function for 16-bit data.
+		
+		dng_memory_data fTable16;
+		
 	public:
 	
 		/// Create a MapPolynomial opcode with the specified area, polynomial
@@ -241,6 +253,8 @@ class dng_opcode_MapPolynomial: public dng_inplace_opcode
 		virtual uint32 BufferPixelType (uint32 imagePixelType);
 			
 		virtual dng_rect ModifiedBounds (const dng_rect &imageBounds);
+		
+		virtual bool IsScaleInvariant (const dng_rect &imageBounds) const;
 	
 		virtual void ProcessArea (dng_negative &negative,
 								  uint32 threadIndex,
@@ -248,6 +262,15 @@ class dng_opcode_MapPolynomial: public dng_inplace_opcode
 								  const dng_rect &dstArea,
 								  const dng_rect &imageBounds);
 								  
+	private:
+	
+		// Apply the function to every colPitch-th value of a row of cols
+		// real32 values.
+	
+		void MapRow32 (real32 *dPtr,
+					   uint32 cols,
+					   uint32 colPitch) const;
+								  
 	};
 
 /*****************************************************************************/
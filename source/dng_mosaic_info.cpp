@@ -24,13 +24,18 @@
 #include "dng_ifd.h"
 #include "dng_image.h"
 #include "dng_info.h"
+#include "dng_memory.h"
 #include "dng_negative.h"
+#include "dng_opcode_list.h"
+#include "dng_opcodes.h"
 #include "dng_pixel_buffer.h"
 #include "dng_tag_types.h"
 #include "dng_tag_values.h"
 #include "dng_tile_iterator.h"
 #include "dng_utils.h"
 
+#include <vector>
+
 /*****************************************************************************/
 
 // A interpolation kernel for a single pixel of a single plane.
@@ -1115,6 +1120,23 @@ class dng_fast_interpolator: public dng_filter_task
 		
 		uint32 fFilterColor [kMaxCFAPattern] [kMaxCFAPattern];
 		
+		// For a 2x2 pattern and even cell sizes, every cell holds the same
+		// number of samples of each color, so the averages can use a fixed
+		// count per plane.
+		
+		bool fEvenCells;
+		
+		uint32 fCount [kMaxColorPlanes];
+		
+		// Exact division by fCount for 16-bit sums: (x * fMultiplier) >>
+		// fShift equals x / fCount for all x below 2^31.
+		
+		uint64 fMultiplier [kMaxColorPlanes];
+		
+		uint32 fShift [kMaxColorPlanes];
+		
+		real32 fScale [kMaxColorPlanes];
+		
 	public:
 	
 		dng_fast_interpolator (const dng_mosaic_info &info,
@@ -1129,6 +1151,29 @@ class dng_fast_interpolator: public dng_filter_task
 								  dng_pixel_buffer &srcBuffer,
 								  dng_pixel_buffer &dstBuffer);
 		
+	private:
+	
+		enum
+			{
+			
+			// Widest source area handled by the even cell kernels.
+			
+			kMaxEvenCellCols = 512
+			
+			};
+	
+		void ProcessEvenCells16 (dng_pixel_buffer &srcBuffer,
+								 dng_pixel_buffer &dstBuffer);
+		
+		void ProcessEvenCells32 (dng_pixel_buffer &srcBuffer,
+								 dng_pixel_buffer &dstBuffer);
+		
+		void ProcessArea16 (dng_pixel_buffer &srcBuffer,
+							dng_pixel_buffer &dstBuffer);
+		
+		void ProcessArea32 (dng_pixel_buffer &srcBuffer,
+							dng_pixel_buffer &dstBuffer);
+		
 	};
 
 /*****************************************************************************/
@@ -1144,14 +1189,18 @@ dng_fast_interpolator::dng_fast_interpolator (const dng_mosaic_info &info,
 	
 	,	fInfo       (info     )
 	,	fDownScale  (downScale)
+	,	fEvenCells  (false    )
 	
 	{
 	
 	fSrcPlane  = srcPlane;
 	fSrcPlanes = 1;
 	
-	fSrcPixelType = ttShort;
-	fDstPixelType = ttShort;
+	// Floating point images are averaged as floating point, so HDR data is
+	// not clipped to 16 bits.
+	
+	fSrcPixelType = srcImage.PixelType () == ttFloat ? ttFloat : ttShort;
+	fDstPixelType = fSrcPixelType;
 	
 	fSrcRepeat = fInfo.fCFAPatternSize;
 	
@@ -1194,6 +1243,58 @@ dng_fast_interpolator::dng_fast_interpolator (const dng_mosaic_info &info,
 			}
 				
 		}
+		
+	// Find the counts for even cells.
+	
+	if (fInfo.fCFAPatternSize == dng_point (2, 2) &&
+		fDownScale.v >= 2 && (fDownScale.v & 1) == 0 &&
+		fDownScale.h >= 2 && (fDownScale.h & 1) == 0 &&
+		fDownScale.h <= kMaxEvenCellCols / 2 &&
+		fDownScale.v * fDownScale.h <= 4096)
+		{
+		
+		uint32 samples = (fDownScale.v >> 1) * (fDownScale.h >> 1);
+		
+		for (uint32 plane = 0; plane < fInfo.fColorPlanes; plane++)
+			{
+			fCount [plane] = 0;
+			}
+			
+		for (uint32 r = 0; r < 2; r++)
+			for (uint32 c = 0; c < 2; c++)
+				{
+				fCount [fFilterColor [r] [c]] += samples;
+				}
+				
+		fEvenCells = true;
+			
+		for (uint32 plane = 0; plane < fInfo.fColorPlanes; plane++)
+			{
+			
+			uint32 count = fCount [plane];
+			
+			if (count == 0)
+				{
+				fEvenCells = false;
+				break;
+				}
+				
+			uint32 bits = 0;
+			
+			while ((1u << bits) < count)
+				{
+				bits++;
+				}
+				
+			fShift [plane] = 31 + bits;
+			
+			fMultiplier [plane] = (((uint64) 1 << fShift [plane]) + count - 1) / count;
+			
+			fScale [plane] = 1.0f / (real32) count;
+			
+			}
+		
+		}
 
 	}
 
@@ -1216,6 +1317,269 @@ void dng_fast_interpolator::ProcessArea (uint32 /* threadIndex */,
 								      	 dng_pixel_buffer &dstBuffer)
 	{
 	
+	bool evenCells = fEvenCells &&
+					 srcBuffer.fArea.W () <= kMaxEvenCellCols;
+	
+	if (fSrcPixelType == ttFloat)
+		{
+		
+		if (evenCells)
+			{
+			ProcessEvenCells32 (srcBuffer, dstBuffer);
+			}
+		else
+			{
+			ProcessArea32 (srcBuffer, dstBuffer);
+			}
+			
+		}
+		
+	else
+		{
+		
+		if (evenCells)
+			{
+			ProcessEvenCells16 (srcBuffer, dstBuffer);
+			}
+		else
+			{
+			ProcessArea16 (srcBuffer, dstBuffer);
+			}
+			
+		}
+	
+	}
+	
+/*****************************************************************************/
+
+// Each cell starts on the first row and column of the pattern.  For each row
+// of cells, the even and odd rows are summed down each column, then the
+// column sums are summed across each cell by pattern column.
+
+void dng_fast_interpolator::ProcessEvenCells16 (dng_pixel_buffer &srcBuffer,
+												dng_pixel_buffer &dstBuffer)
+	{
+	
+	dng_rect srcArea = srcBuffer.fArea;
+	dng_rect dstArea = dstBuffer.fArea;
+	
+	uint32 cols = srcArea.W ();
+	
+	uint32 cellRows = fDownScale.v;
+	uint32 cellCols = fDownScale.h;
+	
+	uint32 planes = fInfo.fColorPlanes;
+	
+	int32 srcRowStep = srcBuffer.fRowStep;
+	
+	int32 dstPlaneStep = dstBuffer.fPlaneStep;
+	
+	uint32 sum0 [kMaxEvenCellCols];
+	uint32 sum1 [kMaxEvenCellCols];
+	
+	uint32 total [kMaxColorPlanes];
+	
+	int32 srcRow = srcArea.t;
+	
+	for (int32 dstRow = dstArea.t; dstRow < dstArea.b; dstRow++)
+		{
+		
+		const uint16 *sPtr = srcBuffer.ConstPixel_uint16 (srcRow,
+														  srcArea.l,
+														  fSrcPlane);
+																  
+		uint16 *dPtr = dstBuffer.DirtyPixel_uint16 (dstRow,
+													dstArea.l,
+													0);
+					   						 
+		for (uint32 col = 0; col < cols; col++)
+			{
+			sum0 [col] = 0;
+			sum1 [col] = 0;
+			}
+			
+		for (uint32 cellRow = 0; cellRow < cellRows; cellRow += 2)
+			{
+			
+			const uint16 *sPtr0 = sPtr;
+			const uint16 *sPtr1 = sPtr + srcRowStep;
+			
+			for (uint32 col = 0; col < cols; col++)
+				{
+				sum0 [col] += (uint32) sPtr0 [col];
+				sum1 [col] += (uint32) sPtr1 [col];
+				}
+				
+			sPtr += 2 * srcRowStep;
+			
+			}
+			
+		const uint32 *cPtr0 = sum0;
+		const uint32 *cPtr1 = sum1;
+		
+		for (int32 dstCol = dstArea.l; dstCol < dstArea.r; dstCol++)
+			{
+			
+			uint32 s00 = 0;
+			uint32 s01 = 0;
+			uint32 s10 = 0;
+			uint32 s11 = 0;
+			
+			for (uint32 cellCol = 0; cellCol < cellCols; cellCol += 2)
+				{
+				s00 += cPtr0 [cellCol    ];
+				s01 += cPtr0 [cellCol + 1];
+				s10 += cPtr1 [cellCol    ];
+				s11 += cPtr1 [cellCol + 1];
+				}
+				
+			for (uint32 plane = 0; plane < planes; plane++)
+				{
+				total [plane] = 0;
+				}
+				
+			total [fFilterColor [0] [0]] += s00;
+			total [fFilterColor [0] [1]] += s01;
+			total [fFilterColor [1] [0]] += s10;
+			total [fFilterColor [1] [1]] += s11;
+			
+			for (uint32 plane = 0; plane < planes; plane++)
+				{
+				
+				uint64 t = total [plane] + (fCount [plane] >> 1);
+				
+				dPtr [plane * dstPlaneStep] = (uint16) ((t * fMultiplier [plane]) >> fShift [plane]);
+				
+				}
+				
+			cPtr0 += cellCols;
+			cPtr1 += cellCols;
+			
+			dPtr ++;
+			
+			}
+			
+		srcRow += cellRows;
+		
+		}
+	
+	}
+	
+/*****************************************************************************/
+
+void dng_fast_interpolator::ProcessEvenCells32 (dng_pixel_buffer &srcBuffer,
+												dng_pixel_buffer &dstBuffer)
+	{
+	
+	dng_rect srcArea = srcBuffer.fArea;
+	dng_rect dstArea = dstBuffer.fArea;
+	
+	uint32 cols = srcArea.W ();
+	
+	uint32 cellRows = fDownScale.v;
+	uint32 cellCols = fDownScale.h;
+	
+	uint32 planes = fInfo.fColorPlanes;
+	
+	int32 srcRowStep = srcBuffer.fRowStep;
+	
+	int32 dstPlaneStep = dstBuffer.fPlaneStep;
+	
+	real32 sum0 [kMaxEvenCellCols];
+	real32 sum1 [kMaxEvenCellCols];
+	
+	real32 total [kMaxColorPlanes];
+	
+	int32 srcRow = srcArea.t;
+	
+	for (int32 dstRow = dstArea.t; dstRow < dstArea.b; dstRow++)
+		{
+		
+		const real32 *sPtr = srcBuffer.ConstPixel_real32 (srcRow,
+														  srcArea.l,
+														  fSrcPlane);
+																  
+		real32 *dPtr = dstBuffer.DirtyPixel_real32 (dstRow,
+													dstArea.l,
+													0);
+					   						 
+		for (uint32 col = 0; col < cols; col++)
+			{
+			sum0 [col] = 0.0f;
+			sum1 [col] = 0.0f;
+			}
+			
+		for (uint32 cellRow = 0; cellRow < cellRows; cellRow += 2)
+			{
+			
+			const real32 *sPtr0 = sPtr;
+			const real32 *sPtr1 = sPtr + srcRowStep;
+			
+			for (uint32 col = 0; col < cols; col++)
+				{
+				sum0 [col] += sPtr0 [col];
+				sum1 [col] += sPtr1 [col];
+				}
+				
+			sPtr += 2 * srcRowStep;
+			
+			}
+			
+		const real32 *cPtr0 = sum0;
+		const real32 *cPtr1 = sum1;
+		
+		for (int32 dstCol = dstArea.l; dstCol < dstArea.r; dstCol++)
+			{
+			
+			real32 s00 = 0.0f;
+			real32 s01 = 0.0f;
+			real32 s10 = 0.0f;
+			real32 s11 = 0.0f;
+			
+			for (uint32 cellCol = 0; cellCol < cellCols; cellCol += 2)
+				{
+				s00 += cPtr0 [cellCol    ];
+				s01 += cPtr0 [cellCol + 1];
+				s10 += cPtr1 [cellCol    ];
+				s11 += cPtr1 [cellCol + 1];
+				}
+				
+			for (uint32 plane = 0; plane < planes; plane++)
+				{
+				total [plane] = 0.0f;
+				}
+				
+			total [fFilterColor [0] [0]] += s00;
+			total [fFilterColor [0] [1]] += s01;
+			total [fFilterColor [1] [0]] += s10;
+			total [fFilterColor [1] [1]] += s11;
+			
+			for (uint32 plane = 0; plane < planes; plane++)
+				{
+				
+				dPtr [plane * dstPlaneStep] = total [plane] * fScale [plane];
+				
+				}
+				
+			cPtr0 += cellCols;
+			cPtr1 += cellCols;
+			
+			dPtr ++;
+			
+			}
+			
+		srcRow += cellRows;
+		
+		}
+	
+	}
+	
+/*****************************************************************************/
+
+void dng_fast_interpolator::ProcessArea16 (dng_pixel_buffer &srcBuffer,
+										   dng_pixel_buffer &dstBuffer)
+	{
+	
 	dng_rect srcArea = srcBuffer.fArea;
 	dng_rect dstArea = dstBuffer.fArea;
 					  
@@ -1329,37 +1693,772 @@ void dng_fast_interpolator::ProcessArea (uint32 /* threadIndex */,
 	
 /*****************************************************************************/
 
-dng_mosaic_info::dng_mosaic_info ()
-
-	:	fCFAPatternSize  ()
-	,	fColorPlanes     (0)
-	,	fCFALayout		 (1)
-	,	fBayerGreenSplit (0)
-	,	fSrcSize		 ()
-	,	fCroppedSize     ()
-	,	fAspectRatio     (1.0)
-	
-	{
-	
-	}
-
-/*****************************************************************************/
-
-dng_mosaic_info::~dng_mosaic_info ()
+void dng_fast_interpolator::ProcessArea32 (dng_pixel_buffer &srcBuffer,
+										   dng_pixel_buffer &dstBuffer)
 	{
 	
-	}
-		
-/*****************************************************************************/
-
-void dng_mosaic_info::Parse (dng_host & /* host */,
-							 dng_stream & /* stream */,
-							 dng_info &info)
-	{
+	dng_rect srcArea = srcBuffer.fArea;
+	dng_rect dstArea = dstBuffer.fArea;
+					  
+	// Downsample buffer.
 	
-	// Find main image IFD.
+	int32 srcRow = srcArea.t;
 	
-	dng_ifd &rawIFD = *info.fIFD [info.fMainIndex].Get ();
+	uint32 srcRowPhase1 = 0;
+	uint32 srcRowPhase2 = 0;
+	
+	uint32 patRows = fInfo.fCFAPatternSize.v;
+	uint32 patCols = fInfo.fCFAPatternSize.h;
+	
+	uint32 cellRows = fDownScale.v;
+	uint32 cellCols = fDownScale.h;
+	
+	uint32 plane;
+	uint32 planes = fInfo.fColorPlanes;
+	
+	int32 dstPlaneStep = dstBuffer.fPlaneStep;
+	
+	real32 total [kMaxColorPlanes];
+	uint32 count [kMaxColorPlanes];
+	
+	for (plane = 0; plane < planes; plane++)
+		{
+		total [plane] = 0.0f;
+		count [plane] = 0;
+		}
+			
+	for (int32 dstRow = dstArea.t; dstRow < dstArea.b; dstRow++)
+		{
+		
+		const real32 *sPtr = srcBuffer.ConstPixel_real32 (srcRow,
+														  srcArea.l,
+														  fSrcPlane);
+																  
+		real32 *dPtr = dstBuffer.DirtyPixel_real32 (dstRow,
+													dstArea.l,
+													0);
+					   						 
+		uint32 srcColPhase1 = 0;
+		uint32 srcColPhase2 = 0;
+		
+		for (int32 dstCol = dstArea.l; dstCol < dstArea.r; dstCol++)
+			{
+			
+			const real32 *ssPtr = sPtr;
+			
+			srcRowPhase2 = srcRowPhase1;
+			
+			for (uint32 cellRow = 0; cellRow < cellRows; cellRow++)
+				{
+				
+				const uint32 *filterRow = fFilterColor [srcRowPhase2];
+			
+				if (++srcRowPhase2 == patRows)
+					{
+					srcRowPhase2 = 0;
+					}
+					
+				srcColPhase2 = srcColPhase1;
+				
+				for (uint32 cellCol = 0; cellCol < cellCols; cellCol++)
+					{
+				
+					uint32 color = filterRow [srcColPhase2];
+					
+					if (++srcColPhase2 == patCols)
+						{
+						srcColPhase2 = 0;
+						}
+					
+					total [color] += ssPtr [cellCol];
+					count [color] ++;
+					
+					}
+					
+				ssPtr += srcBuffer.fRowStep;
+				
+				}
+				
+			for (plane = 0; plane < planes; plane++)
+				{
+				
+				dPtr [plane * dstPlaneStep] = count [plane] ? total [plane] / (real32) count [plane]
+															: 0.0f;
+				
+				total [plane] = 0.0f;
+				count [plane] = 0;
+				
+				}
+				
+			srcColPhase1 = srcColPhase2;
+				
+			sPtr += cellCols;
+				
+			dPtr ++;
+
+			}
+			
+		srcRowPhase1 = srcRowPhase2;
+			
+		srcRow += cellRows;
+		
+		}
+				   
+	}
+	
+/*****************************************************************************/
+
+// The in-place opcodes of one opcode list as applied to each tile by
+// dng_mosaic_band_task, with the area and buffer pixel type of each.
+
+class dng_band_opcodes
+	{
+	
+	public:
+	
+		// Bounds of the whole stage image, as seen by the opcodes.
+	
+		dng_rect fImageBounds;
+		
+		dng_std_vector<dng_inplace_opcode *> fOpcodes;
+		
+		dng_std_vector<dng_rect> fBounds;
+		
+		dng_std_vector<uint32> fPixelType;
+		
+		// Per-thread buffers for opcodes that need another pixel type.
+		
+		AutoPtr<dng_memory_block> fBuffer [kMaxMPThreads];
+		
+	public:
+	
+		dng_band_opcodes ()
+		
+			:	fImageBounds ()
+			,	fOpcodes     ()
+			,	fBounds      ()
+			,	fPixelType   ()
+			
+			{
+			}
+			
+		void Add (dng_inplace_opcode &opcode,
+				  const dng_image &image)
+			{
+			
+			dng_rect bounds = opcode.ModifiedBounds (image.Bounds ());
+			
+			if (bounds.NotEmpty ())
+				{
+				
+				fOpcodes.push_back (&opcode);
+				
+				fBounds.push_back (bounds);
+				
+				fPixelType.push_back (opcode.BufferPixelType (image.PixelType ()));
+				
+				}
+			
+			}
+			
+		void Prepare (dng_negative &negative,
+					  uint32 threadCount,
+					  const dng_point &tileSize,
+					  uint32 planes,
+					  uint32 pixelType,
+					  dng_memory_allocator &allocator);
+					  
+		void Process (dng_negative &negative,
+					  uint32 threadIndex,
+					  dng_pixel_buffer &buffer,
+					  const dng_rect &area);
+		
+	private:
+	
+		// Hidden copy constructor and assignment operator.
+	
+		dng_band_opcodes (const dng_band_opcodes &opcodes);
+		
+		dng_band_opcodes & operator= (const dng_band_opcodes &opcodes);
+		
+	};
+
+/*****************************************************************************/
+
+void dng_band_opcodes::Prepare (dng_negative &negative,
+								uint32 threadCount,
+								const dng_point &tileSize,
+								uint32 planes,
+								uint32 pixelType,
+								dng_memory_allocator &allocator)
+	{
+	
+	uint32 bufferSize = 0;
+	
+	for (size_t index = 0; index < fOpcodes.size (); index++)
+		{
+		
+		if (fPixelType [index] != pixelType)
+			{
+			
+			bufferSize = Max_uint32 (bufferSize,
+									 ComputeBufferSize (fPixelType [index],
+														tileSize,
+														planes,
+														pad16Bytes));
+			
+			}
+		
+		}
+		
+	if (bufferSize)
+		{
+		
+		for (uint32 threadIndex = 0; threadIndex < threadCount; threadIndex++)
+			{
+			
+			fBuffer [threadIndex] . Reset (allocator.Allocate (bufferSize));
+			
+			}
+			
+		}
+		
+	for (size_t index = 0; index < fOpcodes.size (); index++)
+		{
+		
+		fOpcodes [index]->Prepare (negative,
+								   threadCount,
+								   tileSize,
+								   fImageBounds,
+								   planes,
+								   fPixelType [index],
+								   allocator);
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+// Apply the opcodes to the part of the area of the buffer each one modifies.
+
+void dng_band_opcodes::Process (dng_negative &negative,
+								uint32 threadIndex,
+								dng_pixel_buffer &buffer,
+								const dng_rect &area)
+	{
+	
+	for (size_t index = 0; index < fOpcodes.size (); index++)
+		{
+		
+		dng_rect opcodeArea = area & fBounds [index];
+		
+		if (opcodeArea.IsEmpty ())
+			{
+			continue;
+			}
+			
+		if (fPixelType [index] == buffer.fPixelType)
+			{
+			
+			dng_pixel_buffer temp (buffer);
+			
+			temp.fArea = opcodeArea;
+			
+			temp.fData = buffer.DirtyPixel (opcodeArea.t,
+											opcodeArea.l,
+											buffer.fPlane);
+			
+			fOpcodes [index]->ProcessArea (negative,
+										   threadIndex,
+										   temp,
+										   opcodeArea,
+										   fImageBounds);
+			
+			}
+			
+		else
+			{
+			
+			dng_pixel_buffer temp (opcodeArea,
+								   buffer.fPlane,
+								   buffer.fPlanes,
+								   fPixelType [index],
+								   pcRowInterleavedAlign16,
+								   fBuffer [threadIndex]->Buffer ());
+									 
+			temp.CopyArea (buffer, opcodeArea, buffer.fPlane, buffer.fPlanes);
+			
+			fOpcodes [index]->ProcessArea (negative,
+										   threadIndex,
+										   temp,
+										   opcodeArea,
+										   fImageBounds);
+										   
+			buffer.CopyArea (temp, opcodeArea, buffer.fPlane, buffer.fPlanes);
+			
+			}
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+// Presents the part of a pixel buffer already read from an image as an
+// image with that image's bounds, so dng_image::Get can fill in the rest of
+// the buffer by repeating its edges from the pixels in the buffer.
+
+class dng_buffer_edge_image: public dng_image
+	{
+	
+	private:
+	
+		const dng_pixel_buffer &fBuffer;
+		
+	public:
+	
+		dng_buffer_edge_image (const dng_rect &bounds,
+							   const dng_pixel_buffer &buffer)
+		
+			:	dng_image (bounds,
+						   buffer.fPlane + buffer.fPlanes,
+						   buffer.fPixelType)
+						   
+			,	fBuffer (buffer)
+			
+			{
+			}
+			
+	protected:
+	
+		virtual void DoGet (dng_pixel_buffer &buffer) const
+			{
+			
+			if ((buffer.fArea & fBuffer.fArea) != buffer.fArea)
+				{
+				ThrowProgramError ("Area outside buffer");
+				}
+				
+			if (buffer.fData != fBuffer.ConstPixel (buffer.fArea.t,
+													buffer.fArea.l,
+													buffer.fPlane))
+				{
+				
+				buffer.CopyArea (fBuffer,
+								 buffer.fArea,
+								 buffer.fPlane,
+								 buffer.fPlanes);
+				
+				}
+			
+			}
+			
+	};
+
+/*****************************************************************************/
+
+// Interpolates one destination tile at a time, then applies the in-place
+// opcodes of an opcode list to the tile before storing it, so the source
+// area is read and the result written only once, while both are in cache.
+// The in-place opcodes of opcode list 2 can likewise be applied to the
+// source area of each tile as it is read.
+
+class dng_mosaic_band_task: public dng_area_task
+	{
+	
+	private:
+	
+		const dng_mosaic_info &fInfo;
+		
+		dng_negative &fNegative;
+		
+		const dng_image &fSrcImage;
+		
+		dng_image &fDstImage;
+		
+		dng_point fDownScale;
+		
+		uint32 fSrcPlane;
+		
+		uint32 fSrcPixelType;
+		uint32 fDstPixelType;
+		
+		dng_point fSrcTileSize;
+		
+		// Full size interpolation, as done by InterpolateGeneric.
+		
+		dng_point fSrcShift;
+		
+		AutoPtr<dng_bilinear_interpolator> fBilinear;
+		
+		// Downscaled interpolation, as done by InterpolateFast.
+		
+		AutoPtr<dng_fast_interpolator> fFast;
+		
+		// Opcodes to apply to the stage 2 and stage 3 tiles.
+		
+		dng_band_opcodes fStage2Opcodes;
+		dng_band_opcodes fStage3Opcodes;
+		
+		AutoPtr<dng_memory_block> fSrcBuffer [kMaxMPThreads];
+		AutoPtr<dng_memory_block> fDstBuffer [kMaxMPThreads];
+		
+	public:
+	
+		dng_mosaic_band_task (const dng_mosaic_info &info,
+							  dng_negative &negative,
+							  const dng_image &srcImage,
+							  dng_image &dstImage,
+							  const dng_point &downScale,
+							  uint32 srcPlane);
+							  
+		void AddStage2Opcode (dng_inplace_opcode &opcode)
+			{
+			fStage2Opcodes.Add (opcode, fSrcImage);
+			}
+		
+		void AddStage3Opcode (dng_inplace_opcode &opcode)
+			{
+			fStage3Opcodes.Add (opcode, fDstImage);
+			}
+		
+		virtual dng_rect RepeatingTile1 () const;
+		
+		virtual bool ReusesSourceOverlap () const
+			{
+			return true;
+			}
+		
+		virtual void Start (uint32 threadCount,
+							const dng_point &tileSize,
+							dng_memory_allocator *allocator,
+							dng_abort_sniffer *sniffer);
+							
+		virtual void Process (uint32 threadIndex,
+							  const dng_rect &tile,
+							  dng_abort_sniffer *sniffer);
+							  
+	private:
+	
+		dng_rect SrcArea (const dng_rect &dstArea) const;
+		
+		// Hidden copy constructor and assignment operator.
+	
+		dng_mosaic_band_task (const dng_mosaic_band_task &task);
+		
+		dng_mosaic_band_task & operator= (const dng_mosaic_band_task &task);
+		
+	};
+
+/*****************************************************************************/
+
+dng_mosaic_band_task::dng_mosaic_band_task (const dng_mosaic_info &info,
+											dng_negative &negative,
+											const dng_image &srcImage,
+											dng_image &dstImage,
+											const dng_point &downScale,
+											uint32 srcPlane)
+
+	:	fInfo          (info)
+	,	fNegative      (negative)
+	,	fSrcImage      (srcImage)
+	,	fDstImage      (dstImage)
+	,	fDownScale     (downScale)
+	,	fSrcPlane      (srcPlane)
+	,	fSrcPixelType  (srcImage.PixelType ())
+	,	fDstPixelType  (dstImage.PixelType ())
+	,	fSrcTileSize   ()
+	,	fSrcShift      ()
+	,	fBilinear      ()
+	,	fFast          ()
+	,	fStage2Opcodes ()
+	,	fStage3Opcodes ()
+	
+	{
+	
+	if (fDownScale == dng_point (1, 1))
+		{
+		
+		dng_point scale = fInfo.FullScale ();
+		
+		fSrcShift = dng_point (scale.v - 1,
+							   scale.h - 1);
+		
+		fUnitCell = scale;
+		
+		fMaxTileSize = dng_point (128, 128);
+		
+		}
+		
+	else
+		{
+		
+		fFast.Reset (new dng_fast_interpolator (fInfo,
+												srcImage,
+												dstImage,
+												fDownScale,
+												fSrcPlane));
+												
+		fSrcPixelType = srcImage.PixelType () == ttFloat ? ttFloat : ttShort;
+		fDstPixelType = fSrcPixelType;
+		
+		fUnitCell    = fFast->UnitCell    ();
+		fMaxTileSize = fFast->MaxTileSize ();
+		
+		}
+		
+	// Opcodes that depend on the overall image area see the full stage
+	// bounds, as in dng_inplace_opcode::Apply.
+	
+	if (fNegative.IsWindowed ())
+		{
+		
+		fStage2Opcodes.fImageBounds = fNegative.FullStageBounds (2);
+		fStage3Opcodes.fImageBounds = fNegative.FullStageBounds (3);
+		
+		}
+		
+	else
+		{
+		
+		fStage2Opcodes.fImageBounds = srcImage.Bounds ();
+		fStage3Opcodes.fImageBounds = dstImage.Bounds ();
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+dng_rect dng_mosaic_band_task::RepeatingTile1 () const
+	{
+	
+	return fDstImage.RepeatingTile ();
+	
+	}
+
+/*****************************************************************************/
+
+dng_rect dng_mosaic_band_task::SrcArea (const dng_rect &dstArea) const
+	{
+	
+	if (fFast.Get ())
+		{
+		return fFast->SrcArea (dstArea);
+		}
+		
+	return dng_rect ((dstArea.t >> fSrcShift.v) - fInfo.fCFAPatternSize.v,
+					 (dstArea.l >> fSrcShift.h) - fInfo.fCFAPatternSize.h,
+					 (dstArea.b >> fSrcShift.v) + fInfo.fCFAPatternSize.v,
+					 (dstArea.r >> fSrcShift.h) + fInfo.fCFAPatternSize.h);
+	
+	}
+
+/*****************************************************************************/
+
+void dng_mosaic_band_task::Start (uint32 threadCount,
+								  const dng_point &tileSize,
+								  dng_memory_allocator *allocator,
+								  dng_abort_sniffer * /* sniffer */)
+	{
+	
+	// A tile that does not start on a multiple of the full scale can
+	// straddle one more source row or column.
+	
+	fSrcTileSize = SrcArea (dng_rect (tileSize)).Size () + fSrcShift;
+	
+	uint32 planes = fDstImage.Planes ();
+	
+	uint32 srcBufferSize = ComputeBufferSize (fSrcPixelType, fSrcTileSize,
+											  1, pad16Bytes);
+											  
+	uint32 dstBufferSize = ComputeBufferSize (fDstPixelType, tileSize,
+											  planes, pad16Bytes);
+											  
+	for (uint32 threadIndex = 0; threadIndex < threadCount; threadIndex++)
+		{
+		
+		fSrcBuffer [threadIndex] . Reset (allocator->Allocate (srcBufferSize));
+		
+		fDstBuffer [threadIndex] . Reset (allocator->Allocate (dstBufferSize));
+		
+		}
+		
+	// The bilinear patterns depend on the source buffer row step, which
+	// is fixed by the source tile size.
+		
+	if (!fFast.Get ())
+		{
+		
+		dng_pixel_buffer srcBuffer (dng_rect (fSrcTileSize), fSrcPlane, 1,
+									fSrcPixelType, pcInterleaved, NULL);
+		
+		fBilinear.Reset (new dng_bilinear_interpolator (fInfo,
+														srcBuffer.fRowStep,
+														srcBuffer.fColStep));
+		
+		}
+		
+	fStage2Opcodes.Prepare (fNegative,
+							threadCount,
+							fSrcTileSize,
+							fSrcImage.Planes (),
+							fSrcPixelType,
+							*allocator);
+		
+	fStage3Opcodes.Prepare (fNegative,
+							threadCount,
+							tileSize,
+							planes,
+							fDstPixelType,
+							*allocator);
+	
+	}
+
+/*****************************************************************************/
+
+void dng_mosaic_band_task::Process (uint32 threadIndex,
+									const dng_rect &tile,
+									dng_abort_sniffer * /* sniffer */)
+	{
+	
+	dng_rect srcArea = SrcArea (tile);
+	
+	if (srcArea.H () > (uint32) fSrcTileSize.v ||
+		srcArea.W () > (uint32) fSrcTileSize.h)
+		{
+		
+		ThrowProgramError ("Area exceeds tile size.");
+		
+		}
+		
+	// Get the source pixels, with the edges repeated by whole CFA patterns.
+	
+	dng_pixel_buffer srcBuffer (dng_rect (fSrcTileSize), fSrcPlane, 1,
+								fSrcPixelType, pcInterleaved,
+								fSrcBuffer [threadIndex]->Buffer ());
+								
+	srcBuffer.fArea = srcArea;
+	
+	if (fStage2Opcodes.fOpcodes.empty ())
+		{
+	
+		fSrcImage.Get (srcBuffer,
+					   dng_image::edge_repeat,
+					   fInfo.fCFAPatternSize.v,
+					   fInfo.fCFAPatternSize.h);
+					   
+		}
+		
+	else
+		{
+		
+		// The opcodes only see pixels inside the image, and the edges are
+		// then repeated from their results, as when they are applied to the
+		// whole stage 2 image.
+		
+		dng_rect overlap = srcArea & fSrcImage.Bounds ();
+		
+		dng_pixel_buffer overlapBuffer (srcBuffer);
+		
+		overlapBuffer.fArea = overlap;
+		
+		overlapBuffer.fData = srcBuffer.DirtyPixel (overlap.t,
+													overlap.l,
+													fSrcPlane);
+													
+		fSrcImage.Get (overlapBuffer);
+		
+		fStage2Opcodes.Process (fNegative,
+								threadIndex,
+								overlapBuffer,
+								overlap);
+								
+		if (overlap != srcArea)
+			{
+			
+			dng_buffer_edge_image edgeImage (fSrcImage.Bounds (),
+											 overlapBuffer);
+			
+			edgeImage.Get (srcBuffer,
+						   dng_image::edge_repeat,
+						   fInfo.fCFAPatternSize.v,
+						   fInfo.fCFAPatternSize.h);
+			
+			}
+		
+		}
+				   
+	// Interpolate.
+	
+	uint32 planes = fDstImage.Planes ();
+	
+	dng_pixel_buffer dstBuffer (tile, 0, planes, fDstPixelType,
+								pcRowInterleavedAlign16,
+								fDstBuffer [threadIndex]->Buffer ());
+								
+	if (fFast.Get ())
+		{
+		
+		fFast->ProcessArea (threadIndex,
+							srcBuffer,
+							dstBuffer);
+		
+		}
+		
+	else
+		{
+		
+		fBilinear->Interpolate (srcBuffer,
+								dstBuffer);
+		
+		}
+		
+	// Apply the opcodes to the part of the tile each one modifies.
+	
+	fStage3Opcodes.Process (fNegative,
+							threadIndex,
+							dstBuffer,
+							tile);
+		
+	fDstImage.Put (dstBuffer);
+	
+	}
+	
+/*****************************************************************************/
+
+dng_mosaic_info::dng_mosaic_info ()
+
+	:	fCFAPatternSize  ()
+	,	fColorPlanes     (0)
+	,	fCFALayout		 (1)
+	,	fBayerGreenSplit (0)
+	,	fSrcSize		 ()
+	,	fCroppedSize     ()
+	,	fAspectRatio     (1.0)
+	
+	{
+	
+	}
+
+/*****************************************************************************/
+
+dng_mosaic_info::~dng_mosaic_info ()
+	{
+	
+	}
+		
+/*****************************************************************************/
+
+void dng_mosaic_info::Parse (dng_host & /* host */,
+							 dng_stream & /* stream */,
+							 dng_info &info)
+	{
+	
+	// Find main image IFD.
+	
+	dng_ifd &rawIFD = *info.fIFD [info.fMainIndex].Get ();
 	
 	// This information only applies to CFA images.
 	
@@ -1408,7 +2507,7 @@ void dng_mosaic_info::PostParse (dng_host & /* host */,
 	
 	// Keep track of source image size.
 	
-	fSrcSize = negative.Stage2Image ()->Size ();
+	fSrcSize = negative.FullStageBounds (2).Size ();
 	
 	// Default cropped size.
 	
@@ -1990,3 +3089,56 @@ void dng_mosaic_info::Interpolate (dng_host &host,
 	}
 
 /*****************************************************************************/
+
+void dng_mosaic_info::InterpolateBands (dng_host &host,
+										dng_negative &negative,
+										const dng_image &srcImage,
+										dng_image &dstImage,
+										const dng_point &downScale,
+										uint32 srcPlane,
+										const dng_std_vector<dng_inplace_opcode *> *stage2Opcodes,
+										const dng_std_vector<dng_inplace_opcode *> *stage3Opcodes) const
+	{
+	
+	dng_mosaic_band_task task (*this,
+							   negative,
+							   srcImage,
+							   dstImage,
+							   downScale,
+							   srcPlane);
+							   
+	if (stage2Opcodes)
+		{
+		
+		if (srcImage.Planes () != 1)
+			{
+			ThrowProgramError ("Stage 2 opcodes need a single plane image");
+			}
+		
+		for (size_t index = 0; index < stage2Opcodes->size (); index++)
+			{
+			
+			task.AddStage2Opcode (*(*stage2Opcodes) [index]);
+			
+			}
+		
+		}
+							   
+	if (stage3Opcodes)
+		{
+		
+		for (size_t index = 0; index < stage3Opcodes->size (); index++)
+			{
+			
+			task.AddStage3Opcode (*(*stage3Opcodes) [index]);
+			
+			}
+		
+		}
+		
+	host.PerformAreaTask (task,
+						  dstImage.Bounds ());
+	
+	}
+
+/*****************************************************************************/
@@ -23,6 +23,7 @@
 /*****************************************************************************/
 
 #include "dng_classes.h"
+#include "dng_memory.h"
 #include "dng_rect.h"
 #include "dng_sdk_limits.h"
 #include "dng_types.h"
@@ -181,7 +182,35 @@ class dng_mosaic_info
 								  dng_image &dstImage,
 								  const dng_point &downScale,
 								  uint32 srcPlane = 0) const;
-								  
+
+		/// Demosaic interpolation of a single plane in one threaded pass, which
+		/// also applies in-place opcodes to the source area of each tile as it
+		/// is read, and to each tile before it is stored.  Gives the same
+		/// result as applying the stage 2 opcodes, then Interpolate, then the
+		/// stage 3 opcodes.  Derived classes that override Interpolate should
+		/// override this as well.
+		/// \param host dng_host to use for buffer allocation requests, user cancellation testing, and progress updates.
+		/// \param negative DNG negative of mosaiced data.
+		/// \param srcImage Source image for mosaiced data.
+		/// \param dstImage Destination image for resulting interpolated data.
+		/// \param downScale Amount (in horizontal and vertical) by which to subsample image.
+		/// \param srcPlane Which plane to interpolate.
+		/// \param stage2Opcodes Opcodes to apply to the source image, which
+		/// must then have a single plane, or NULL.  The caller has already
+		/// checked with AboutToApply that each one applies.
+		/// \param stage3Opcodes Opcodes to apply to the destination image, or
+		/// NULL.  The caller has already checked with AboutToApply that each
+		/// one applies.
+
+		virtual void InterpolateBands (dng_host &host,
+									   dng_negative &negative,
+									   const dng_image &srcImage,
+									   dng_image &dstImage,
+									   const dng_point &downScale,
+									   uint32 srcPlane = 0,
+									   const dng_std_vector<dng_inplace_opcode *> *stage2Opcodes = NULL,
+									   const dng_std_vector<dng_inplace_opcode *> *stage3Opcodes = NULL) const;
+
 	protected:
 	
 		virtual bool IsSafeDownScale (const dng_point &downScale) const;
@@ -35,7 +35,10 @@
 #include "dng_memory_stream.h"
 #include "dng_misc_opcodes.h"
 #include "dng_mosaic_info.h"
+#include "dng_mutex.h"
+#include "dng_opcodes.h"
 #include "dng_preview.h"
+#include "dng_render.h"
 #include "dng_resample.h"
 #include "dng_safe_arithmetic.h"
 #include "dng_simple_image.h"
@@ -165,41 +168,41 @@ dng_metadata::~dng_metadata ()
 	
 /******************************************************************************/
 
-template< class T >
-T * CloneAutoPtr (const AutoPtr< T > &ptr)
-	{
-	
-	return ptr.Get () ? ptr->Clone () : NULL;
-	
-	}
-
-/******************************************************************************/
+// Makes ptr the only owner of its object, copying the object if it is
+// shared, and returns the object.
 
-template< class T, typename U >
-T * CloneAutoPtr (const AutoPtr< T > &ptr, U &u)
+template< class T >
+static T * UnsharedPtr (std::shared_ptr< T > &ptr)
 	{
 	
-	return ptr.Get () ? ptr->Clone (u) : NULL;
+	if (ptr.get () && ptr.use_count () > 1)
+		{
+		
+		ptr.reset (ptr->Clone ());
+		
+		}
+		
+	return ptr.get ();
 	
 	}
 
 /******************************************************************************/
 
 dng_metadata::dng_metadata (const dng_metadata &rhs,
-							dng_memory_allocator &allocator)
+							dng_memory_allocator & /* allocator */)
 
 	:	fHasBaseOrientation 		(rhs.fHasBaseOrientation)
 	,	fBaseOrientation    		(rhs.fBaseOrientation)
 	,	fIsMakerNoteSafe			(rhs.fIsMakerNoteSafe)
-	,	fMakerNote					(CloneAutoPtr (rhs.fMakerNote, allocator))
-	,	fExif			    		(CloneAutoPtr (rhs.fExif))
-	,	fOriginalExif				(CloneAutoPtr (rhs.fOriginalExif))
-	,	fIPTCBlock          		(CloneAutoPtr (rhs.fIPTCBlock, allocator))
+	,	fMakerNote					(rhs.fMakerNote)
+	,	fExif			    		(rhs.fExif)
+	,	fOriginalExif				(rhs.fOriginalExif)
+	,	fIPTCBlock          		(rhs.fIPTCBlock)
 	,	fIPTCOffset					(rhs.fIPTCOffset)
 	
 	#if qDNGUseXMP
 	
-	,	fXMP			    		(CloneAutoPtr (rhs.fXMP))
+	,	fXMP			    		(rhs.fXMP)
 	
 	#endif
 	
@@ -223,6 +226,37 @@ dng_metadata * dng_metadata::Clone (dng_memory_allocator &allocator) const
 
 /******************************************************************************/
 
+dng_exif * dng_metadata::GetExif ()
+	{
+	
+	return UnsharedPtr (fExif);
+	
+	}
+
+/******************************************************************************/
+
+dng_exif * dng_metadata::GetOriginalExif ()
+	{
+	
+	return UnsharedPtr (fOriginalExif);
+	
+	}
+
+/******************************************************************************/
+
+#if qDNGUseXMP
+
+dng_xmp * dng_metadata::GetXMP ()
+	{
+	
+	return UnsharedPtr (fXMP);
+	
+	}
+
+#endif
+
+/******************************************************************************/
+
 void dng_metadata::SetBaseOrientation (const dng_orientation &orientation)
 	{
 	
@@ -241,7 +275,7 @@ void dng_metadata::ApplyOrientation (const dng_orientation &orientation)
 
 	#if qDNGUseXMP
 	
-	fXMP->SetOrientation (fBaseOrientation);
+	GetXMP ()->SetOrientation (fBaseOrientation);
 	
 	#endif
 
@@ -252,7 +286,7 @@ void dng_metadata::ApplyOrientation (const dng_orientation &orientation)
 void dng_metadata::ResetExif (dng_exif * newExif)
 	{
 
-	fExif.Reset (newExif);
+	fExif.reset (newExif);
 
 	}
 
@@ -404,7 +438,7 @@ dng_memory_block * dng_metadata::BuildExifBlock (dng_memory_allocator &allocator
 void dng_metadata::SetIPTC (AutoPtr<dng_memory_block> &block, uint64 offset)
 	{
 	
-	fIPTCBlock.Reset (block.Release ());
+	fIPTCBlock.reset (block.Release ());
 	
 	fIPTCOffset = offset;
 	
@@ -424,7 +458,7 @@ void dng_metadata::SetIPTC (AutoPtr<dng_memory_block> &block)
 void dng_metadata::ClearIPTC ()
 	{
 	
-	fIPTCBlock.Reset ();
+	fIPTCBlock.reset ();
 	
 	fIPTCOffset = kDNGStreamInvalidOffset;
 	
@@ -435,7 +469,7 @@ void dng_metadata::ClearIPTC ()
 const void * dng_metadata::IPTCData () const
 	{
 	
-	if (fIPTCBlock.Get ())
+	if (fIPTCBlock.get ())
 		{
 		
 		return fIPTCBlock->Buffer ();
@@ -451,7 +485,7 @@ const void * dng_metadata::IPTCData () const
 uint32 dng_metadata::IPTCLength () const
 	{
 	
-	if (fIPTCBlock.Get ())
+	if (fIPTCBlock.get ())
 		{
 		
 		return fIPTCBlock->LogicalSize ();
@@ -467,7 +501,7 @@ uint32 dng_metadata::IPTCLength () const
 uint64 dng_metadata::IPTCOffset () const
 	{
 	
-	if (fIPTCBlock.Get ())
+	if (fIPTCBlock.get ())
 		{
 		
 		return fIPTCOffset;
@@ -532,11 +566,11 @@ void dng_metadata::RebuildIPTC (dng_memory_allocator &allocator,
 	
 	ClearIPTC ();
 	
-	fXMP->RebuildIPTC (*this, allocator, padForTIFF);
+	GetXMP ()->RebuildIPTC (*this, allocator, padForTIFF);
 	
 	dng_fingerprint digest = IPTCDigest ();
 	
-	fXMP->SetIPTCDigest (digest);
+	GetXMP ()->SetIPTCDigest (digest);
 	
 	}
 			  
@@ -545,7 +579,7 @@ void dng_metadata::RebuildIPTC (dng_memory_allocator &allocator,
 void dng_metadata::ResetXMP (dng_xmp * newXMP)
 	{
 	
-	fXMP.Reset (newXMP);
+	fXMP.reset (newXMP);
 	
 	}
 
@@ -556,7 +590,7 @@ void dng_metadata::ResetXMPSidecarNewer (dng_xmp * newXMP,
 										 bool isNewer )
 	{
 
-	fXMP.Reset (newXMP);
+	fXMP.reset (newXMP);
 
 	fXMPinSidecar = inSidecar;
 
@@ -633,11 +667,11 @@ void dng_metadata::SetEmbeddedXMP (dng_host &host,
 		
 		// Remove any sidecar specific tags from embedded XMP.
 		
-		if (fXMP.Get ())
+		if (fXMP.get ())
 			{
 		
-			fXMP->Remove (XMP_NS_PHOTOSHOP, "SidecarForExtension");
-			fXMP->Remove (XMP_NS_PHOTOSHOP, "EmbeddedXMPDigest");
+			GetXMP ()->Remove (XMP_NS_PHOTOSHOP, "SidecarForExtension");
+			GetXMP ()->Remove (XMP_NS_PHOTOSHOP, "EmbeddedXMPDigest");
 			
 			}
 		
@@ -659,22 +693,27 @@ void dng_metadata::SetEmbeddedXMP (dng_host &host,
 void dng_metadata::SynchronizeMetadata ()
 	{
 	
-	if (!fOriginalExif.Get ())
+	// The original EXIF shares the current EXIF data, which is copied if
+	// the sync below changes it.
+	
+	if (!fOriginalExif.get ())
 		{
 		
-		fOriginalExif.Reset (fExif->Clone ());
+		fOriginalExif = fExif;
 		
 		}
 		
 	#if qDNGUseXMP
 	
-	fXMP->ValidateMetadata ();
+	dng_xmp &xmp = *GetXMP ();
+	
+	xmp.ValidateMetadata ();
 	
-	fXMP->IngestIPTC (*this, fXMPisNewer);
+	xmp.IngestIPTC (*this, fXMPisNewer);
 	
-	fXMP->SyncExif (*fExif.Get ());
+	xmp.SyncExif (*GetExif ());
 	
-	fXMP->SyncOrientation (*this, fXMPinSidecar);
+	xmp.SyncOrientation (*this, fXMPinSidecar);
 	
 	#endif
 	
@@ -685,10 +724,10 @@ void dng_metadata::SynchronizeMetadata ()
 void dng_metadata::UpdateDateTime (const dng_date_time_info &dt)
 	{
 	
-	fExif->UpdateDateTime (dt);
+	GetExif ()->UpdateDateTime (dt);
 	
 #if qDNGUseXMP
-	fXMP->UpdateDateTime (dt);
+	GetXMP ()->UpdateDateTime (dt);
 #endif
 	
 	}
@@ -706,7 +745,7 @@ void dng_metadata::UpdateDateTimeToNow ()
 	
 	#if qDNGUseXMP
 	
-	fXMP->UpdateMetadataDate (dt);
+	GetXMP ()->UpdateMetadataDate (dt);
 	
 	#endif
 	
@@ -722,7 +761,7 @@ void dng_metadata::UpdateMetadataDateTimeToNow ()
 	CurrentDateTimeAndZone (dt);
 	
 #if qDNGUseXMP
-	fXMP->UpdateMetadataDate (dt);
+	GetXMP ()->UpdateMetadataDate (dt);
 #endif
 	
 	}
@@ -788,7 +827,11 @@ dng_negative::dng_negative (dng_host &host)
 	,	fStage1Image					()
 	,	fStage2Image					()
 	,	fStage3Image					()
+	,	fStage3Serial					(0)
 	,	fStage3Gain						(1.0)
+	,	fOpcodeList3Applied				(false)
+	,	fOpcodeList2Bands				()
+	,	fOpcodeListsRead				(false)
 	,	fIsPreview						(false)
 	,	fIsDamaged						(false)
 	,	fRawImageStage					(rawImageStageNone)
@@ -1145,6 +1188,10 @@ void dng_negative::AddProfile (AutoPtr<dng_camera_profile> &profile)
 			
 		}
 		
+	// Share the large tables with other negatives using the same profile.
+	
+	profile->ShareTables ();
+	
 	// Now add to profile list.
 	
 	fCameraProfile.push_back (NULL);
@@ -2222,7 +2269,7 @@ dng_rect dng_negative::DefaultCropArea () const
 	if (image)
 		{
 	
-		dng_point imageSize = image->Size ();
+		dng_point imageSize = FullStageBounds (3).Size ();
 		
 		if (result.r > imageSize.h)
 			{
@@ -3592,16 +3639,105 @@ void dng_negative::FindRawJPEGImageDigest (dng_host &host) const
 		
 /*****************************************************************************/
 
-void dng_negative::ReadStage1Image (dng_host &host,
+void dng_negative::ReadOpcodeLists (dng_host &host,
 									dng_stream &stream,
 									dng_info &info)
 	{
 	
-	// Allocate image we are reading.
+	if (fOpcodeListsRead)
+		{
+		return;
+		}
+		
+	dng_ifd &rawIFD = *info.fIFD [info.fMainIndex].Get ();
+	
+	if (rawIFD.fOpcodeList1Count)
+		{
+		
+		#if qDNGValidate
+		
+		if (gVerbose)
+			{
+			printf ("\nParsing OpcodeList1: ");
+			}
+			
+		#endif
+		
+		fOpcodeList1.Parse (host,
+							stream,
+							rawIFD.fOpcodeList1Count,
+							rawIFD.fOpcodeList1Offset);
+		
+		}
+		
+	if (rawIFD.fOpcodeList2Count)
+		{
+		
+		#if qDNGValidate
+		
+		if (gVerbose)
+			{
+			printf ("\nParsing OpcodeList2: ");
+			}
+			
+		#endif
+		
+		fOpcodeList2.Parse (host,
+							stream,
+							rawIFD.fOpcodeList2Count,
+							rawIFD.fOpcodeList2Offset);
+		
+		}
+
+	if (rawIFD.fOpcodeList3Count)
+		{
+		
+		#if qDNGValidate
+		
+		if (gVerbose)
+			{
+			printf ("\nParsing OpcodeList3: ");
+			}
+			
+		#endif
+		
+		fOpcodeList3.Parse (host,
+							stream,
+							rawIFD.fOpcodeList3Count,
+							rawIFD.fOpcodeList3Offset);
+		
+		}
+		
+	fOpcodeListsRead = true;
+
+	}
+					
+/*****************************************************************************/
+
+void dng_negative::ReadStage1Image (dng_host &host,
+									dng_stream &stream,
+									dng_info &info)
+	{
 	
 	dng_ifd &rawIFD = *info.fIFD [info.fMainIndex].Get ();
 	
-	fStage1Image.Reset (host.Make_dng_image (rawIFD.Bounds (),
+	// We are are reading the main image, we should read the opcode lists
+	// also.  Do this first, since they determine the window to read.
+	
+	ReadOpcodeLists (host, stream, info);
+
+	// Find the area of the image we need to read.
+	
+	dng_rect window = SetupStage1Window (host, info);
+	
+	if (IsWindowed ())
+		{
+		SetIsPreview (true);
+		}
+	
+	// Allocate image we are reading.
+	
+	fStage1Image.Reset (host.Make_dng_image (window,
 											 rawIFD.fSamplesPerPixel,
 											 rawIFD.PixelType ()));
 					
@@ -3625,7 +3761,8 @@ void dng_negative::ReadStage1Image (dng_host &host,
 	bool needJPEGDigest = (RawImageDigest    ().IsValid () ||
 						   NewRawImageDigest ().IsValid ()) &&
 						  rawIFD.fCompression == ccLossyJPEG &&
-						  jpegImage.Get () == NULL;
+						  jpegImage.Get () == NULL &&
+						  !IsWindowed ();
 	
 	dng_fingerprint jpegDigest;
 	
@@ -3664,133 +3801,946 @@ void dng_negative::ReadStage1Image (dng_host &host,
 		SetRawJPEGImageDigest (jpegDigest);
 		
 		}
-					  
-	// We are are reading the main image, we should read the opcode lists
-	// also.
+
+	}
+					
+/*****************************************************************************/
+
+void dng_negative::ReadStage1ImageArea (dng_host &host,
+										dng_stream &stream,
+										dng_info &info,
+										const dng_rect &area)
+	{
 	
-	if (rawIFD.fOpcodeList1Count)
+	fRequestedArea = area;
+	
+	try
 		{
 		
-		#if qDNGValidate
-		
-		if (gVerbose)
-			{
-			printf ("\nParsing OpcodeList1: ");
-			}
-			
-		#endif
-		
-		fOpcodeList1.Parse (host,
-							stream,
-							rawIFD.fOpcodeList1Count,
-							rawIFD.fOpcodeList1Offset);
+		ReadStage1Image (host, stream, info);
 		
 		}
 		
-	if (rawIFD.fOpcodeList2Count)
+	catch (...)
 		{
 		
-		#if qDNGValidate
-		
-		if (gVerbose)
-			{
-			printf ("\nParsing OpcodeList2: ");
-			}
-			
-		#endif
+		fRequestedArea = dng_rect ();
 		
-		fOpcodeList2.Parse (host,
-							stream,
-							rawIFD.fOpcodeList2Count,
-							rawIFD.fOpcodeList2Offset);
+		throw;
 		
 		}
+	
+	}
+					
+/*****************************************************************************/
 
-	if (rawIFD.fOpcodeList3Count)
+bool dng_negative::CanReadStage1ImageScaled (dng_info &info) const
+	{
+	
+	// Only a lossy JPEG image with a uniform linearization and uniform
+	// opcodes can be read at a reduced size without rescaling coordinates
+	// in the metadata.  This is what ConvertToProxy writes.
+	
+	const dng_ifd &rawIFD = *info.fIFD [info.fMainIndex].Get ();
+	
+	if (rawIFD.fCompression != ccLossyJPEG || !rawIFD.IsBaselineJPEG () ||
+		rawIFD.fRowInterleaveFactor > 1)
 		{
+		return false;
+		}
 		
-		#if qDNGValidate
-		
-		if (gVerbose)
-			{
-			printf ("\nParsing OpcodeList3: ");
-			}
-			
-		#endif
-		
-		fOpcodeList3.Parse (host,
-							stream,
-							rawIFD.fOpcodeList3Count,
-							rawIFD.fOpcodeList3Offset);
+	if (fMosaicInfo.Get () && fMosaicInfo->IsColorFilterArray ())
+		{
+		return false;
+		}
 		
+	const dng_linearization_info *linearization = fLinearizationInfo.Get ();
+	
+	dng_rect bounds (rawIFD.fImageLength,
+					 rawIFD.fImageWidth);
+	
+	if (!linearization 								||
+		linearization->fActiveArea != bounds 		||
+		linearization->fBlackLevelRepeatRows != 1	||
+		linearization->fBlackLevelRepeatCols != 1	||
+		linearization->fBlackDeltaH.Get ()			||
+		linearization->fBlackDeltaV.Get ())
+		{
+		return false;
 		}
-
+		
+	return fOpcodeList1.IsEmpty () &&
+		   fOpcodeList3.IsEmpty () &&
+		   fOpcodeList2.IsScaleInvariant (bounds);
+	
 	}
 					
 /*****************************************************************************/
 
-void dng_negative::SetStage1Image (AutoPtr<dng_image> &image)
+void dng_negative::ReadStage1ImageScaled (dng_host &host,
+										  dng_stream &stream,
+										  dng_info &info,
+										  uint32 scale)
 	{
 	
-	fStage1Image.Reset (image.Release ());
+	dng_ifd &rawIFD = *info.fIFD [info.fMainIndex].Get ();
 	
-	}
-
-/*****************************************************************************/
-
-void dng_negative::SetStage2Image (AutoPtr<dng_image> &image)
-	{
+	dng_rect bounds ((rawIFD.fImageLength + scale - 1) / scale,
+					 (rawIFD.fImageWidth  + scale - 1) / scale);
 	
-	fStage2Image.Reset (image.Release ());
+	fStage1Image.Reset (host.Make_dng_image (bounds,
+											 rawIFD.fSamplesPerPixel,
+											 rawIFD.PixelType ()));
+											 
+	rawIFD.ReadImage (host,
+					  stream,
+					  *fStage1Image.Get (),
+					  NULL,
+					  NULL,
+					  scale);
+					  
+	// Linearize the whole reduced image, and map the default crop, which
+	// stays in full size coordinates, onto it.
+	
+	fLinearizationInfo->fActiveArea = bounds;
+	
+	fRawToFullScaleH = (real64) bounds.W () / (real64) rawIFD.fImageWidth;
+	fRawToFullScaleV = (real64) bounds.H () / (real64) rawIFD.fImageLength;
+	
+	// The reduced image does not match the raw digest, and must not be
+	// saved as a DNG.
+	
+	SetIsPreview (true);
 	
 	}
-
+					
 /*****************************************************************************/
 
-void dng_negative::SetStage3Image (AutoPtr<dng_image> &image)
-	{
+dng_resolution_level::dng_resolution_level ()
+
+	:	fSource         (kResolutionSource_Raw)
+	,	fIFDIndex       (0)
+	,	fDecodeScale    (1)
+	,	fColorSpace     (previewColorSpace_sRGB)
+	,	fLossy          (false)
+	,	fFixedRendering (false)
+	,	fTooSmall       (false)
 	
-	fStage3Image.Reset (image.Release ());
+	{
 	
 	}
-
+					
 /*****************************************************************************/
 
-void dng_negative::DoBuildStage2 (dng_host &host)
+const char * dng_resolution_level::SourceName () const
 	{
 	
-	dng_image &stage1 = *fStage1Image.Get ();
-		
-	dng_linearization_info &info = *fLinearizationInfo.Get ();
-	
-	uint32 pixelType = ttShort;
-	
-	if (stage1.PixelType () == ttLong ||
-		stage1.PixelType () == ttFloat)
+	switch (fSource)
 		{
 		
-		pixelType = ttFloat;
-		
+		case kResolutionSource_Preview:
+			return "preview";
+			
+		case kResolutionSource_LossyProxy:
+			return "lossy proxy";
+			
+		default:
+			return "raw";
+			
 		}
 	
-	fStage2Image.Reset (host.Make_dng_image (info.fActiveArea.Size (),
-											 stage1.Planes (),
-											 pixelType));
-								   
-	info.Linearize (host,
-					stage1,
-					*fStage2Image.Get ());
-							 
 	}
-		
+					
 /*****************************************************************************/
 
-void dng_negative::DoPostOpcodeList2 (dng_host & /* host */)
+static bool IsReadablePreview (const dng_ifd &ifd)
 	{
 	
-	// Nothing by default.
-	
-	}
+	if (ifd.fNewSubFileType != sfPreviewImage &&
+		ifd.fNewSubFileType != sfAltPreviewImage)
+		{
+		return false;
+		}
+		
+	if (ifd.fBitsPerSample [0] != 8 ||
+		ifd.fSampleFormat  [0] != sfUnsignedInteger ||
+		(ifd.fSamplesPerPixel != 1 && ifd.fSamplesPerPixel != 3) ||
+		(ifd.fSamplesPerPixel > 1 && ifd.fPlanarConfiguration != pcInterleaved))
+		{
+		return false;
+		}
+		
+	if (ifd.fCompression == ccUncompressed)
+		{
+		
+		if (ifd.fPhotometricInterpretation != piRGB &&
+			ifd.fPhotometricInterpretation != piBlackIsZero)
+			{
+			return false;
+			}
+		
+		}
+		
+	else if (ifd.fCompression != ccJPEG)
+		{
+		return false;
+		}
+		
+	return ifd.CanRead ();
+	
+	}
+					
+/*****************************************************************************/
+
+// Largest DCT scale that still leaves at least size pixels on the long side,
+// given the long side of the full size result.
+
+static uint32 FindJPEGScale (const dng_ifd &ifd,
+							 uint32 longSide,
+							 uint32 size)
+	{
+	
+	if (!ifd.IsBaselineJPEG () || ifd.fRowInterleaveFactor > 1)
+		{
+		return 1;
+		}
+		
+	for (uint32 scale = 8; scale > 1; scale >>= 1)
+		{
+		
+		if (longSide / scale >= size &&
+			(ifd.TilesAcross () == 1 || ifd.fTileWidth  % scale == 0) &&
+			(ifd.TilesDown   () == 1 || ifd.fTileLength % scale == 0))
+			{
+			return scale;
+			}
+		
+		}
+		
+	return 1;
+	
+	}
+					
+/*****************************************************************************/
+
+dng_image * dng_negative::ReadResolutionLevel (dng_host &host,
+											   dng_stream &stream,
+											   dng_info &info,
+											   uint32 size,
+											   dng_resolution_level &level)
+	{
+	
+	level = dng_resolution_level ();
+	
+	uint32 fullSize = Max_uint32 (DefaultFinalWidth  (),
+								  DefaultFinalHeight ());
+	
+	if (!size)
+		{
+		size = fullSize;
+		}
+		
+	// Find the smallest preview that is large enough.
+	
+	int32 previewIndex = -1;
+	
+	uint32 previewSize = 0;
+	
+	for (uint32 index = 0; index < info.fIFDCount; index++)
+		{
+		
+		const dng_ifd &ifd = *info.fIFD [index].Get ();
+		
+		uint32 ifdSize = Max_uint32 (ifd.fImageWidth,
+									 ifd.fImageLength);
+		
+		if (ifdSize >= size && IsReadablePreview (ifd) &&
+			(previewIndex < 0 || ifdSize < previewSize))
+			{
+			
+			previewIndex = (int32) index;
+			
+			previewSize = ifdSize;
+			
+			}
+		
+		}
+		
+	if (previewIndex >= 0)
+		{
+		
+		const dng_ifd &ifd = *info.fIFD [previewIndex].Get ();
+		
+		uint32 scale = FindJPEGScale (ifd, previewSize, size);
+		
+		AutoPtr<dng_image> image (host.Make_dng_image (dng_rect ((ifd.fImageLength + scale - 1) / scale,
+																 (ifd.fImageWidth  + scale - 1) / scale),
+													   ifd.fSamplesPerPixel,
+													   ttByte));
+													   
+		ifd.ReadImage (host,
+					   stream,
+					   *image.Get (),
+					   NULL,
+					   NULL,
+					   scale);
+					   
+		level.fSource         = kResolutionSource_Preview;
+		level.fIFDIndex       = (uint32) previewIndex;
+		level.fDecodeScale    = scale;
+		level.fColorSpace     = ifd.fPreviewInfo.fColorSpace;
+		level.fLossy          = ifd.fCompression == ccJPEG;
+		level.fFixedRendering = true;
+		
+		return image.Release ();
+		
+		}
+		
+	// Otherwise render the raw image, at a reduced size if possible.
+		
+	const dng_ifd &rawIFD = *info.fIFD [info.fMainIndex].Get ();
+	
+	// Whether the image can be read scaled depends on the opcode lists.
+	// ReadStage1Image does not parse them again.
+	
+	ReadOpcodeLists (host, stream, info);
+	
+	uint32 scale = 1;
+	
+	if (CanReadStage1ImageScaled (info))
+		{
+		
+		scale = FindJPEGScale (rawIFD, fullSize, size);
+		
+		}
+		
+	if (scale > 1)
+		{
+		
+		ReadStage1ImageScaled (host, stream, info, scale);
+		
+		}
+		
+	else
+		{
+		
+		ReadStage1Image (host, stream, info);
+		
+		}
+		
+	SynchronizeMetadata ();
+	
+	BuildStage2Image (host);
+	
+	// Let a CFA image be interpolated at a reduced size.
+	
+	uint32 savedMinimumSize   = host.MinimumSize   ();
+	uint32 savedPreferredSize = host.PreferredSize ();
+	
+	host.SetMinimumSize   (size);
+	host.SetPreferredSize (size);
+	
+	try
+		{
+		
+		BuildStage3Image (host);
+		
+		}
+		
+	catch (...)
+		{
+		
+		host.SetMinimumSize   (savedMinimumSize  );
+		host.SetPreferredSize (savedPreferredSize);
+		
+		throw;
+		
+		}
+		
+	host.SetMinimumSize   (savedMinimumSize  );
+	host.SetPreferredSize (savedPreferredSize);
+	
+	dng_render render (host, *this);
+	
+	render.SetMaximumSize (size);
+	
+	AutoPtr<dng_image> image (render.Render ());
+	
+	level.fSource      = rawIFD.fCompression == ccLossyJPEG ? kResolutionSource_LossyProxy
+															: kResolutionSource_Raw;
+	level.fIFDIndex    = (uint32) info.fMainIndex;
+	level.fDecodeScale = Max_uint32 (1, Round_uint32 (1.0 / Min_real64 (fRawToFullScaleH,
+																		fRawToFullScaleV)));
+	level.fColorSpace  = image->Planes () == 1 ? previewColorSpace_GrayGamma22
+											   : previewColorSpace_sRGB;
+	level.fLossy       = rawIFD.fCompression == ccLossyJPEG;
+	
+	level.fTooSmall = Max_uint32 (image->Bounds ().W (),
+								  image->Bounds ().H ()) < size;
+		
+	return image.Release ();
+	
+	}
+					
+/*****************************************************************************/
+
+dng_rect dng_negative::FullStageBounds (uint32 stage) const
+	{
+	
+	if (stage < 1 || stage > 3)
+		{
+		ThrowProgramError ("Bad image stage");
+		}
+		
+	if (IsWindowed ())
+		{
+		return fFullStageBounds [stage - 1];
+		}
+		
+	const dng_image *image = (stage == 1) ? Stage1Image ()
+						   : (stage == 2) ? Stage2Image ()
+										  : Stage3Image ();
+										  
+	return image ? image->Bounds () : dng_rect ();
+	
+	}
+					
+/*****************************************************************************/
+
+dng_rect dng_negative::AreaOfInterest (uint32 stage) const
+	{
+	
+	if (stage < 1 || stage > 3)
+		{
+		ThrowProgramError ("Bad image stage");
+		}
+		
+	if (IsWindowed ())
+		{
+		return fAreaOfInterest [stage - 1];
+		}
+		
+	return FullStageBounds (stage);
+	
+	}
+					
+/*****************************************************************************/
+
+// Maps a stage 2 area to stage 3 coordinates for the specified interpolation
+// down scale.  If window is true, the result is the largest stage 3 area
+// that can be computed from the stage 2 area, aligned so that the fast
+// interpolator sees the CFA pattern in phase.  Otherwise the result is the
+// smallest stage 3 area covering the stage 2 area.
+
+dng_rect dng_negative::MapStage2ToStage3 (const dng_rect &area,
+										  const dng_point &downScale,
+										  bool window) const
+	{
+	
+	const dng_mosaic_info *info = fMosaicInfo.Get ();
+	
+	if (!info || !info->IsColorFilterArray ())
+		{
+		return area;
+		}
+		
+	if (downScale == dng_point (1, 1))
+		{
+		
+		dng_point scale = info->FullScale ();
+		
+		return dng_rect (area.t * scale.v,
+						 area.l * scale.h,
+						 area.b * scale.v,
+						 area.r * scale.h);
+		
+		}
+		
+	dng_rect bounds2 = fFullStageBounds [1];
+	dng_rect bounds3 = fFullStageBounds [2];
+		
+	dng_rect result;
+	
+	if (window)
+		{
+		
+		dng_point pattern = info->fCFAPatternSize;
+		
+		result.t = (area.t + downScale.v - 1) / downScale.v;
+		result.l = (area.l + downScale.h - 1) / downScale.h;
+		
+		while ((result.t * downScale.v) % pattern.v)
+			{
+			result.t++;
+			}
+			
+		while ((result.l * downScale.h) % pattern.h)
+			{
+			result.l++;
+			}
+			
+		result.b = (area.b == bounds2.b) ? bounds3.b : area.b / downScale.v;
+		result.r = (area.r == bounds2.r) ? bounds3.r : area.r / downScale.h;
+		
+		}
+		
+	else
+		{
+		
+		result.t = area.t / downScale.v;
+		result.l = area.l / downScale.h;
+		
+		result.b = (area.b + downScale.v - 1) / downScale.v;
+		result.r = (area.r + downScale.h - 1) / downScale.h;
+		
+		}
+		
+	return result & bounds3;
+	
+	}
+					
+/*****************************************************************************/
+
+// Computes the stage 1 area to read for the area requested by
+// ReadStage1ImageArea, if any, and sets up the full stage bounds and areas of
+// interest if that area is smaller than the entire image.  Returns the entire
+// image area if windowing is not possible.  Clears the request.
+
+dng_rect dng_negative::SetupStage1Window (dng_host &host,
+										  dng_info &info)
+	{
+	
+	dng_ifd &rawIFD = *info.fIFD [info.fMainIndex].Get ();
+	
+	dng_rect bounds1 = rawIFD.Bounds ();
+	
+	for (uint32 stage = 0; stage < 3; stage++)
+		{
+		fFullStageBounds [stage] = dng_rect ();
+		fAreaOfInterest  [stage] = dng_rect ();
+		}
+	
+	dng_rect area1 = fRequestedArea & bounds1;
+	
+	fRequestedArea = dng_rect ();
+	
+	if (area1.IsEmpty ())
+		{
+		return bounds1;
+		}
+		
+	// We need the entire image if we are going to save it, or if the
+	// transparency mask or an opcode needs pixels outside the window.
+		
+	if (host.SaveDNGVersion () != dngVersion_None ||
+		info.fMaskIndex != -1 ||
+		rawIFD.fRowInterleaveFactor > 1 ||
+		!fOpcodeList1.IsAreaLocal () ||
+		!fOpcodeList2.IsAreaLocal () ||
+		!fOpcodeList3.IsAreaLocal ())
+		{
+		return bounds1;
+		}
+		
+	// Stage 2 is the active area.
+	
+	dng_rect activeArea = bounds1;
+	
+	if (fLinearizationInfo.Get () &&
+		fLinearizationInfo->fActiveArea.NotEmpty ())
+		{
+		activeArea = fLinearizationInfo->fActiveArea;
+		}
+		
+	dng_rect bounds2 (activeArea.Size ());
+	
+	dng_rect area2 = (area1 & activeArea) - activeArea.TL ();
+	
+	if (area2.IsEmpty ())
+		{
+		return bounds1;
+		}
+		
+	fFullStageBounds [0] = bounds1;
+	fFullStageBounds [1] = bounds2;
+	
+	// Stage 3 size depends on the interpolation down scale.
+	
+	dng_mosaic_info *mosaic = fMosaicInfo.Get ();
+	
+	bool isCFA = mosaic && mosaic->IsColorFilterArray ();
+	
+	dng_rect bounds3 = bounds2;
+	
+	dng_point downScale (1, 1);
+	
+	if (isCFA)
+		{
+		
+		mosaic->PostParse (host, *this);
+		
+		downScale = mosaic->DownScale (host.MinimumSize   (),
+									   host.PreferredSize (),
+									   host.CropFactor    ());
+									   
+		bounds3 = dng_rect (mosaic->DstSize (downScale));
+		
+		}
+		
+	fFullStageBounds [2] = bounds3;
+	
+	// Pad the area of interest backwards through the opcode list 3 and
+	// the CFA interpolation.
+	
+	dng_rect area3 = fOpcodeList3.SrcArea (MapStage2ToStage3 (area2,
+															  downScale,
+															  false),
+										   bounds3);
+										   
+	dng_rect pad2 = area3;
+	
+	if (isCFA)
+		{
+		
+		if (downScale == dng_point (1, 1))
+			{
+			
+			dng_point scale = mosaic->FullScale ();
+			
+			pad2 = dng_rect (area3.t / scale.v,
+							 area3.l / scale.h,
+							 (area3.b + scale.v - 1) / scale.v,
+							 (area3.r + scale.h - 1) / scale.h);
+			
+			}
+			
+		else
+			{
+			
+			pad2 = dng_rect (area3.t * downScale.v,
+							 area3.l * downScale.h,
+							 area3.b * downScale.v,
+							 area3.r * downScale.h);
+							 
+			}
+			
+		// Allow for the interpolation kernel and for aligning the stage 3
+		// window to the CFA pattern.
+			
+		dng_point pattern = mosaic->fCFAPatternSize;
+		
+		pad2.t -= pattern.v * (downScale.v + 1);
+		pad2.b += pattern.v * (downScale.v + 1);
+		
+		pad2.l -= pattern.h * (downScale.h + 1);
+		pad2.r += pattern.h * (downScale.h + 1);
+		
+		}
+		
+	// Then backwards through opcode list 2, linearization (which is
+	// pointwise), and opcode list 1.
+	
+	pad2 = fOpcodeList2.SrcArea (pad2, bounds2);
+	
+	dng_rect window = fOpcodeList1.SrcArea (pad2 + activeArea.TL (), bounds1);
+	
+	// Snap outward to whole tiles, since that is the unit we decode.
+	
+	int32 tileH = (int32) rawIFD.fTileWidth;
+	int32 tileV = (int32) rawIFD.fTileLength;
+	
+	if (tileH > 0 && tileV > 0)
+		{
+		
+		window.t = window.t / tileV * tileV;
+		window.l = window.l / tileH * tileH;
+		
+		window.b = (window.b + tileV - 1) / tileV * tileV;
+		window.r = (window.r + tileH - 1) / tileH * tileH;
+		
+		}
+		
+	window = window & bounds1;
+	
+	if (window == bounds1)
+		{
+		
+		for (uint32 stage = 0; stage < 3; stage++)
+			{
+			fFullStageBounds [stage] = dng_rect ();
+			}
+			
+		return bounds1;
+		
+		}
+		
+	fAreaOfInterest [0] = area1;
+	fAreaOfInterest [1] = area2;
+	
+	return window;
+	
+	}
+					
+/*****************************************************************************/
+
+void dng_negative::SetStage1Image (AutoPtr<dng_image> &image)
+	{
+	
+	fStage1Image.Reset (image.Release ());
+	
+	}
+
+/*****************************************************************************/
+
+void dng_negative::SetStage2Image (AutoPtr<dng_image> &image)
+	{
+	
+	fStage2Image.Reset (image.Release ());
+	
+	}
+
+/*****************************************************************************/
+
+void dng_negative::SetStage3Image (AutoPtr<dng_image> &image)
+	{
+	
+	fStage3Image.Reset (image.Release ());
+	
+	NewStage3Serial ();
+	
+	}
+
+/*****************************************************************************/
+
+static dng_mutex gStage3SerialMutex ("gStage3SerialMutex");
+
+static uint64 gStage3Serial = 0;
+
+void dng_negative::NewStage3Serial ()
+	{
+	
+	dng_lock_mutex lock (&gStage3SerialMutex);
+	
+	fStage3Serial = ++gStage3Serial;
+	
+	}
+
+/*****************************************************************************/
+
+void dng_negative::DoBuildStage2 (dng_host &host)
+	{
+	
+	dng_image &stage1 = *fStage1Image.Get ();
+		
+	dng_linearization_info &info = *fLinearizationInfo.Get ();
+	
+	uint32 pixelType = ttShort;
+	
+	if (stage1.PixelType () == ttLong ||
+		stage1.PixelType () == ttFloat)
+		{
+		
+		pixelType = ttFloat;
+		
+		}
+	
+	dng_rect bounds (info.fActiveArea.Size ());
+	
+	// A windowed stage 1 image gives a windowed stage 2 image.
+	
+	if (IsWindowed ())
+		{
+		
+		bounds = (stage1.Bounds () & info.fActiveArea) - info.fActiveArea.TL ();
+		
+		}
+	
+	// A stage 2 image that is only read by a downscaling interpolation is
+	// linearized as it is read, so the full size image is never built.
+	
+	if (CanLinearizeStage2OnRead (host))
+		{
+		
+		uint32 planes = stage1.Planes ();
+		
+		dng_linearized_image *linearized = new dng_linearized_image (host,
+																	 info,
+																	 fStage1Image,
+																	 bounds,
+																	 pixelType);
+		
+		fStage2Image.Reset (linearized);
+		
+		dng_mosaic_info &mosaic = *fMosaicInfo.Get ();
+		
+		mosaic.PostParse (host, *this);
+		
+		// The band pipeline reads each tile of a full size interpolation
+		// with only a small overlap.
+		
+		if (host.BandPipeline () ||
+			mosaic.DownScale (host.MinimumSize   (),
+							  host.PreferredSize (),
+							  host.CropFactor    ()) != dng_point (1, 1))
+			{
+			return;
+			}
+			
+		// A full size interpolation reads each pixel more than once.
+		
+		AutoPtr<dng_image> image (host.Make_dng_image (bounds,
+													   planes,
+													   pixelType));
+		
+		linearized->Linearize (host, *image);
+		
+		fStage2Image.Reset (image.Release ());
+		
+		return;
+		
+		}
+	
+	fStage2Image.Reset (host.Make_dng_image (bounds,
+											 stage1.Planes (),
+											 pixelType));
+								   
+	info.Linearize (host,
+					stage1,
+					*fStage2Image.Get ());
+							 
+	}
+		
+/*****************************************************************************/
+
+// Could the opcode need more than the pixels of each tile, because it is
+// not an in-place opcode and might apply?  Uses the same tests as
+// dng_opcode::AboutToApply, without its side effects, so AboutToApply
+// still runs just once for each opcode, in either SelectBandOpcodes or
+// ApplyOpcodeList.
+
+static bool NeedsWholeImage (dng_host &host,
+							 dng_opcode &opcode)
+	{
+	
+	if (dynamic_cast<dng_inplace_opcode *> (&opcode))
+		{
+		return false;
+		}
+		
+	if (opcode.SkipIfPreview () && host.ForPreview ())
+		{
+		return false;
+		}
+		
+	if (opcode.MinVersion () > dngVersion_Current &&
+		opcode.WasReadFromStream ())
+		{
+		return !opcode.Optional ();
+		}
+		
+	return !opcode.IsNOP ();
+	
+	}
+
+/*****************************************************************************/
+
+// Can the band pipeline apply the opcode list a tile at a time?
+
+static bool CanApplyInBands (dng_host &host,
+							 dng_opcode_list &list)
+	{
+	
+	for (uint32 index = 0; index < list.Count (); index++)
+		{
+		
+		if (NeedsWholeImage (host, list.Entry (index)))
+			{
+			return false;
+			}
+		
+		}
+		
+	return true;
+	
+	}
+
+/*****************************************************************************/
+
+// Find the opcodes of a list that CanApplyInBands accepted which apply, for
+// the band pipeline.
+
+static void SelectBandOpcodes (dng_host &host,
+							   dng_negative &negative,
+							   dng_opcode_list &list,
+							   dng_std_vector<dng_inplace_opcode *> &opcodes)
+	{
+	
+	opcodes.clear ();
+	
+	for (uint32 index = 0; index < list.Count (); index++)
+		{
+		
+		dng_opcode &opcode (list.Entry (index));
+		
+		if (opcode.AboutToApply (host, negative))
+			{
+			
+			dng_inplace_opcode *inplace = dynamic_cast<dng_inplace_opcode *> (&opcode);
+			
+			if (!inplace)
+				{
+				ThrowProgramError ("Opcode is not in-place");
+				}
+				
+			opcodes.push_back (inplace);
+			
+			}
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+bool dng_negative::CanLinearizeStage2OnRead (dng_host &host)
+	{
+	
+	// The stage 2 image is read-only, and is not kept or saved.
+	
+	if (host.SaveDNGVersion () != dngVersion_None)
+		{
+		return false;
+		}
+		
+	// Only the band pipeline applies opcode list 2 to the tiles of such an
+	// image, and only if the opcodes are in-place ones on a single plane.
+		
+	if (!fOpcodeList2.IsEmpty ())
+		{
+		
+		if (!host.BandPipeline ()			||
+			fStage1Image->Planes () != 1	||
+			!CanApplyInBands (host, fOpcodeList2))
+			{
+			return false;
+			}
+		
+		}
+		
+	dng_mosaic_info *info = fMosaicInfo.Get ();
+	
+	return info && info->IsColorFilterArray ();
+	
+	}
+		
+/*****************************************************************************/
+
+void dng_negative::DoPostOpcodeList2 (dng_host & /* host */)
+	{
+	
+	// Nothing by default.
+	
+	}
 
 /*****************************************************************************/
 
@@ -4003,13 +4953,26 @@ void dng_negative::BuildStage2Image (dng_host &host)
 		
 		}
 	
-	// Process opcode list 2.
+	// Process opcode list 2.  The band pipeline applies it to each tile of
+	// a stage 2 image that is linearized as it is read.
+	
+	if (dynamic_cast<const dng_linearized_image *> (fStage2Image.Get ()))
+		{
+		
+		SelectBandOpcodes (host, *this, fOpcodeList2, fOpcodeList2Bands);
+		
+		}
+		
+	else
+		{
 	
-	host.ApplyOpcodeList (fOpcodeList2, *this, fStage2Image);
+		host.ApplyOpcodeList (fOpcodeList2, *this, fStage2Image);
+		
+		}
 	
 	// See if we are done with the opcode list 2.
 	
-	if (fRawImageStage > rawImageStagePostOpcode1)
+	if (fRawImageStage > rawImageStagePostOpcode1 && fOpcodeList2Bands.empty ())
 		{
 		
 		fOpcodeList2.Clear ();
@@ -4065,8 +5028,25 @@ void dng_negative::DoInterpolateStage3 (dng_host &host,
 		}
 	
 	dng_point dstSize = info.DstSize (downScale);
+	
+	dng_rect dstBounds (dstSize);
+	
+	// A windowed stage 2 image gives a windowed stage 3 image.
+	
+	if (IsWindowed ())
+		{
+		
+		fFullStageBounds [2] = dstBounds;
+		
+		dstBounds = MapStage2ToStage3 (stage2.Bounds (), downScale, true);
+		
+		fAreaOfInterest [2] = MapStage2ToStage3 (fAreaOfInterest [1],
+												 downScale,
+												 false) & dstBounds;
+		
+		}
 			
-	fStage3Image.Reset (host.Make_dng_image (dng_rect (dstSize),
+	fStage3Image.Reset (host.Make_dng_image (dstBounds,
 											 info.fColorPlanes,
 											 stage2.PixelType ()));
 
@@ -4074,6 +5054,44 @@ void dng_negative::DoInterpolateStage3 (dng_host &host,
 		{
 		srcPlane = 0;
 		}
+		
+	// The band pipeline applies opcode list 3 to each tile as it is
+	// interpolated, unless the list needs the whole interpolated image.
+		
+	if (host.BandPipeline ())
+		{
+		
+		fOpcodeList3Applied = CanApplyOpcodeList3InBands (host);
+		
+		dng_std_vector<dng_inplace_opcode *> opcodes3;
+		
+		if (fOpcodeList3Applied)
+			{
+			
+			SelectBandOpcodes (host, *this, fOpcodeList3, opcodes3);
+			
+			}
+		
+		// The opcodes see the pixel aspect ratio of the stage 3 image, which
+		// DoBuildStage3 would only set once the interpolation is done.
+		
+		dng_point stage2_size = FullStageBounds (2).Size ();
+		
+		fRawToFullScaleH = (real64) dstSize.h / (real64) stage2_size.h;
+		fRawToFullScaleV = (real64) dstSize.v / (real64) stage2_size.v;
+		
+		info.InterpolateBands (host,
+							   *this,
+							   stage2,
+							   *fStage3Image.Get (),
+							   downScale,
+							   srcPlane,
+							   &fOpcodeList2Bands,
+							   &opcodes3);
+		
+		return;
+		
+		}
 				
 	info.Interpolate (host,
 					  *this,
@@ -4086,6 +5104,22 @@ void dng_negative::DoInterpolateStage3 (dng_host &host,
 									   
 /*****************************************************************************/
 
+bool dng_negative::CanApplyOpcodeList3InBands (dng_host &host)
+	{
+	
+	// The raw image is grabbed between interpolation and opcode list 3.
+	
+	if (fRawImageStage == rawImageStagePreOpcode3)
+		{
+		return false;
+		}
+		
+	return CanApplyInBands (host, fOpcodeList3);
+	
+	}
+									   
+/*****************************************************************************/
+
 // Interpolate and merge a multi-channel CFA image.
 
 void dng_negative::DoMergeStage3 (dng_host &host)
@@ -4119,6 +5153,15 @@ void dng_negative::DoBuildStage3 (dng_host &host,
 		
 		fStage3Image.Reset (fStage2Image.Release ());
 		
+		if (IsWindowed ())
+			{
+			
+			fFullStageBounds [2] = fFullStageBounds [1];
+			
+			fAreaOfInterest [2] = fAreaOfInterest [1];
+			
+			}
+		
 		}
 		
 	else
@@ -4126,7 +5169,7 @@ void dng_negative::DoBuildStage3 (dng_host &host,
 		
 		// Remember the size of the stage 2 image.
 		
-		dng_point stage2_size = fStage2Image->Size ();
+		dng_point stage2_size = FullStageBounds (2).Size ();
 		
 		// Special case multi-channel CFA interpolation.
 		
@@ -4148,7 +5191,7 @@ void dng_negative::DoBuildStage3 (dng_host &host,
 		
 		// Calculate the ratio of the stage 3 image size to stage 2 image size.
 		
-		dng_point stage3_size = fStage3Image->Size ();
+		dng_point stage3_size = FullStageBounds (3).Size ();
 		
 		fRawToFullScaleH = (real64) stage3_size.h / (real64) stage2_size.h;
 		fRawToFullScaleV = (real64) stage3_size.v / (real64) stage2_size.v;
@@ -4176,12 +5219,31 @@ void dng_negative::BuildStage3Image (dng_host &host,
 		
 	// Do the interpolation as required.
 	
+	fOpcodeList3Applied = false;
+	
 	DoBuildStage3 (host, srcPlane);
 	
 	// Delete the stage2 image now that we have computed the stage 3 image.
 	
 	fStage2Image.Reset ();
 	
+	// See if we are done with the opcode list 2, if it was applied as the
+	// stage 2 image was read.
+	
+	if (!fOpcodeList2Bands.empty ())
+		{
+		
+		fOpcodeList2Bands.clear ();
+		
+		if (fRawImageStage > rawImageStagePostOpcode1)
+			{
+			
+			fOpcodeList2.Clear ();
+			
+			}
+		
+		}
+	
 	// Are we done with the mosaic info?
 	
 	if (fRawImageStage >= rawImageStagePreOpcode3)
@@ -4243,9 +5305,14 @@ void dng_negative::BuildStage3Image (dng_host &host,
 
 		}
 		
-	// Process opcode list 3.
+	// Process opcode list 3, unless it was applied during interpolation.
 	
-	host.ApplyOpcodeList (fOpcodeList3, *this, fStage3Image);
+	if (!fOpcodeList3Applied)
+		{
+		
+		host.ApplyOpcodeList (fOpcodeList3, *this, fStage3Image);
+		
+		}
 	
 	// See if we are done with the opcode list 3.
 	
@@ -4261,6 +5328,8 @@ void dng_negative::BuildStage3Image (dng_host &host,
 	// to be a fast NOP operation.
 	
 	ResizeTransparencyToMatchStage3 (host);
+	
+	NewStage3Serial ();
  
 	// Don't need to grab a copy of raw data at this stage since
 	// it is kept around as the stage 3 image.
@@ -4623,6 +5692,11 @@ void dng_negative::ConvertToProxy (dng_host &host,
 								   uint64 proxyCount)
 	{
 	
+	if (IsWindowed ())
+		{
+		ThrowProgramError ("Cannot convert windowed negative to proxy");
+		}
+	
 	if (!proxySize)
 		{
 		proxySize = kMaxImageSide;
@@ -4798,6 +5872,10 @@ void dng_negative::ConvertToProxy (dng_host &host,
 		
 		}
 		
+	// The stage 3 image may have been trimmed or resampled.
+	
+	NewStage3Serial ();
+	
 	// Convert 32-bit floating point images to 16-bit floating point to
 	// save space.
 	
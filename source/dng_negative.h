@@ -43,6 +43,7 @@
 #include "dng_utils.h"
 #include "dng_xy_coord.h"
 
+#include <memory>
 #include <vector>
 
 /*****************************************************************************/
@@ -208,7 +209,86 @@ class dng_noise_profile
 
 /*****************************************************************************/
 
+/// \brief Sources from which dng_negative::ReadResolutionLevel can produce an
+/// image.
+
+enum dng_resolution_source
+	{
+	
+	/// An embedded preview image, already rendered.
+	
+	kResolutionSource_Preview = 0,
+	
+	/// A raw image stored as lossy JPEG (a proxy DNG), decoded at a reduced
+	/// size using DCT scaling, then rendered.
+	
+	kResolutionSource_LossyProxy,
+	
+	/// The raw image, interpolated at a reduced size where possible, then
+	/// rendered.
+	
+	kResolutionSource_Raw
+	
+	};
+
+/*****************************************************************************/
+
+/// \brief Describes the image returned by dng_negative::ReadResolutionLevel,
+/// and what was given up to produce it quickly.
+
+class dng_resolution_level
+	{
+	
+	public:
+	
+		/// Where the pixels came from.
+	
+		dng_resolution_source fSource;
+		
+		/// Index into dng_info::fIFD of the IFD that was read.
+		
+		uint32 fIFDIndex;
+		
+		/// Linear reduction applied while decoding: the JPEG DCT scale, or
+		/// the reduced-size interpolation factor.  1 if none.
+		
+		uint32 fDecodeScale;
+		
+		/// Color space of the returned image.
+		
+		PreviewColorSpaceEnum fColorSpace;
+		
+		/// The source was lossy compressed.
+		
+		bool fLossy;
+		
+		/// The rendering is baked into the source, so it does not follow the
+		/// negative's current settings (white balance, exposure, profile).
+		
+		bool fFixedRendering;
+		
+		/// No source was as large as requested.
+		
+		bool fTooSmall;
+		
+	public:
+	
+		dng_resolution_level ();
+		
+		/// Short name of fSource, e.g. for logging.
+		
+		const char * SourceName () const;
+		
+	};
+
+/*****************************************************************************/
+
 /// \brief Main class for holding metadata.
+///
+/// Copies made by Clone share the EXIF, XMP, maker note and IPTC data with
+/// the original.  The maker note and IPTC blocks are never changed in place,
+/// and the EXIF and XMP objects are copied the first time they are changed
+/// through a non-const accessor while shared.
 
 class dng_metadata
 	{
@@ -229,19 +309,19 @@ class dng_metadata
 		
 		// MakerNote binary data block.
 		
-		AutoPtr<dng_memory_block> fMakerNote;
+		std::shared_ptr<const dng_memory_block> fMakerNote;
 		
 		// EXIF data.
 		
-		AutoPtr<dng_exif> fExif;
+		std::shared_ptr<dng_exif> fExif;
 		
 		// A copy of the EXIF data before is was synchronized with other metadata sources.
 		
-		AutoPtr<dng_exif> fOriginalExif;
+		std::shared_ptr<dng_exif> fOriginalExif;
 		
 		// IPTC binary data block and offset in original file.
 		
-		AutoPtr<dng_memory_block> fIPTCBlock;
+		std::shared_ptr<const dng_memory_block> fIPTCBlock;
 		
 		uint64 fIPTCOffset;
 		
@@ -249,7 +329,7 @@ class dng_metadata
 		
 		#if qDNGUseXMP
 		
-		AutoPtr<dng_xmp> fXMP;
+		std::shared_ptr<dng_xmp> fXMP;
 		
 		#endif
 		
@@ -280,7 +360,8 @@ class dng_metadata
 		
 		virtual ~dng_metadata ();
 
-		/// Copy this metadata.
+		/// Copy this metadata.  The copy shares its data with this object
+		/// until either one changes it.
 		
 		virtual dng_metadata * Clone (dng_memory_allocator &allocator) const;
 		
@@ -341,37 +422,37 @@ class dng_metadata
 		
 		void SetMakerNote (AutoPtr<dng_memory_block> &block)
 			{
-			fMakerNote.Reset (block.Release ());
+			fMakerNote.reset (block.Release ());
 			}
 		
 		void ClearMakerNote ()
 			{
 			fIsMakerNoteSafe = false;
-			fMakerNote.Reset ();
+			fMakerNote.reset ();
 			}
 		
 		const void * MakerNoteData () const
 			{
-			return fMakerNote.Get () ? fMakerNote->Buffer ()
+			return fMakerNote.get () ? fMakerNote->Buffer ()
 									 : NULL;
 			}
 		
 		uint32 MakerNoteLength () const
 			{
-			return fMakerNote.Get () ? fMakerNote->LogicalSize ()
+			return fMakerNote.get () ? fMakerNote->LogicalSize ()
 									 : 0;
 			}
 		
 		// API for EXIF metadata:
 		
-		dng_exif * GetExif ()
-			{
-			return fExif.Get ();
-			}
+		/// Writeable access to the EXIF data, which is copied first if it is
+		/// shared with another dng_metadata.
+		
+		dng_exif * GetExif ();
 			
 		const dng_exif * GetExif () const
 			{
-			return fExif.Get ();
+			return fExif.get ();
 			}
 			
 		template< class E >
@@ -389,14 +470,11 @@ class dng_metadata
 												   
 		// API for original EXIF metadata.
 		
-		dng_exif * GetOriginalExif ()
-			{
-			return fOriginalExif.Get ();
-			}
+		dng_exif * GetOriginalExif ();
 			
 		const dng_exif * GetOriginalExif () const
 			{
-			return fOriginalExif.Get ();
+			return fOriginalExif.get ();
 			}
 			
 		// API for XMP metadata:
@@ -413,14 +491,14 @@ class dng_metadata
 							 const void *buffer,
 							 uint32 count);
 					 
-		dng_xmp * GetXMP ()
-			{
-			return fXMP.Get ();
-			}
+		/// Writeable access to the XMP data, which is copied first if it is
+		/// shared with another dng_metadata.
+		
+		dng_xmp * GetXMP ();
 			
 		const dng_xmp * GetXMP () const
 			{
-			return fXMP.Get ();
+			return fXMP.get ();
 			}
 
 		template< class X >
@@ -788,10 +866,45 @@ class dng_negative
 		
 		AutoPtr<dng_image> fStage3Image;
 		
+		// Serial number of the current stage 3 image contents, unique across
+		// all negatives in the process.  Zero if none has been built.
+		
+		uint64 fStage3Serial;
+		
+		// Stage 1 area requested by ReadStage1ImageArea for the read it is
+		// making.  Each read of the stage 1 image clears it, so a later
+		// ReadStage1Image reads the entire image again.
+		
+		dng_rect fRequestedArea;
+		
+		// Area of interest in stage 1, 2 and 3 coordinates.  Only valid
+		// for a windowed read.
+		
+		dng_rect fAreaOfInterest [3];
+		
+		// Full bounds of the stage 1, 2 and 3 images when the stage images
+		// only hold a window of the image.  Empty if not windowed.
+		
+		dng_rect fFullStageBounds [3];
+		
 		// Additiona gain applied when building the stage 3 image. 
 		
 		real64 fStage3Gain;
 
+		// Was opcode list 3 applied to each tile of the stage 3 image as
+		// it was interpolated?
+		
+		bool fOpcodeList3Applied;
+
+		// Opcodes of opcode list 2 that the band pipeline applies to each
+		// tile of a stage 2 image that is linearized as it is read.
+		
+		dng_std_vector<dng_inplace_opcode *> fOpcodeList2Bands;
+
+		// Have the opcode lists been parsed from the file?
+		
+		bool fOpcodeListsRead;
+
 		// Were any approximations (e.g. downsampling, etc.) applied
 		// file reading this image?
 		
@@ -2212,6 +2325,16 @@ class dng_negative
 			return fStage3Image.Get ();
 			}
 			
+		// Returns a number that changes whenever the stage 3 image is
+		// built, replaced or modified, and that is never reused, even by
+		// another negative.  Used to tell whether data derived from the
+		// stage 3 image is still current.
+		
+		uint64 Stage3Serial () const
+			{
+			return fStage3Serial;
+			}
+			
 		// Returns the processing stage of the raw image data.
 		
 		RawImageStageEnum RawImageStage () const
@@ -2262,12 +2385,71 @@ class dng_negative
 			
 		void FindRawJPEGImageDigest (dng_host &host) const;
 		
+		// Parse the opcode lists of the main image.  Only the first call
+		// does anything, so each reader can make sure they are read.  The
+		// image readers call this, but a caller recording a parse index
+		// calls it first, so the lists are part of the index.
+		
+		void ReadOpcodeLists (dng_host &host,
+							  dng_stream &stream,
+							  dng_info &info);
+		
 		// Read the stage 1 image.
 			
 		virtual void ReadStage1Image (dng_host &host,
 									  dng_stream &stream,
 									  dng_info &info);
 									  
+		/// Read only the part of the stage 1 image needed to render the
+		/// specified area (in stage 1 coordinates).  The stage 1, 2 and 3
+		/// images then hold a window of the full image that covers this
+		/// area plus any padding needed by the CFA interpolation and
+		/// opcodes.  Reads the entire image if windowing is not possible,
+		/// e.g. when writing a DNG or when an opcode moves pixels.  Only this
+		/// read is windowed; a later ReadStage1Image reads the entire image.
+		
+		void ReadStage1ImageArea (dng_host &host,
+								  dng_stream &stream,
+								  dng_info &info,
+								  const dng_rect &area);
+								  
+		/// Produce an image whose longer side is at least size pixels, if the
+		/// file has that much resolution, from the cheapest source available:
+		/// the smallest embedded preview that is large enough, else a lossy
+		/// JPEG raw image decoded with DCT scaling, else the raw image with a
+		/// reduced-size interpolation.  Previews are returned at their (DCT
+		/// scaled) size; rendered sources are resampled to size.  The image is
+		/// in stored orientation; apply Orientation () to display it.
+		/// Call on a parsed negative in place of ReadStage1Image.  When a raw
+		/// source is used, this builds stages 1 to 3, at reduced size for a
+		/// lossy proxy, so the negative should not be saved afterwards.
+		/// \param size Requested long side in pixels, or 0 for full size.
+		/// \param level Returns the source used and its quality trade-offs.
+		/// \retval The image, 8-bit, in level.fColorSpace.
+		
+		dng_image * ReadResolutionLevel (dng_host &host,
+										 dng_stream &stream,
+										 dng_info &info,
+										 uint32 size,
+										 dng_resolution_level &level);
+								  
+		/// Does the stage image hold only a window of the full image?
+		
+		bool IsWindowed () const
+			{
+			return fFullStageBounds [0].NotEmpty ();
+			}
+			
+		/// Returns the bounds of the full (unwindowed) image at the
+		/// specified stage (1, 2 or 3).
+		
+		dng_rect FullStageBounds (uint32 stage) const;
+		
+		/// Returns the area of interest in the coordinates of the specified
+		/// stage (1, 2 or 3), or the full stage bounds if not windowed.
+		
+		dng_rect AreaOfInterest (uint32 stage) const;
+									  
 		// Assign the stage 1 image.
 		
 		void SetStage1Image (AutoPtr<dng_image> &image);
@@ -2365,6 +2547,10 @@ class dng_negative
 		
 		virtual void Initialize ();
 		
+		// Assign a new serial number to the stage 3 image after it changed.
+		
+		void NewStage3Serial ();
+		
 		virtual dng_linearization_info * MakeLinearizationInfo ();
 		
 		void NeedLinearizationInfo ();
@@ -2375,6 +2561,8 @@ class dng_negative
 		
 		virtual void DoBuildStage2 (dng_host &host);
 		
+		virtual bool CanLinearizeStage2OnRead (dng_host &host);
+		
 		virtual void DoPostOpcodeList2 (dng_host &host);
 									   
 		virtual bool NeedDefloatStage2 (dng_host &host);
@@ -2384,6 +2572,8 @@ class dng_negative
 		virtual void DoInterpolateStage3 (dng_host &host,
 									      int32 srcPlane);
 									
+		virtual bool CanApplyOpcodeList3InBands (dng_host &host);
+									
 		virtual void DoMergeStage3 (dng_host &host);
 									   
 		virtual void DoBuildStage3 (dng_host &host,
@@ -2391,6 +2581,21 @@ class dng_negative
 									   
 		virtual void AdjustProfileForStage3 ();
 									  
+		virtual dng_rect SetupStage1Window (dng_host &host,
+											dng_info &info);
+											
+											
+		virtual bool CanReadStage1ImageScaled (dng_info &info) const;
+		
+		virtual void ReadStage1ImageScaled (dng_host &host,
+											dng_stream &stream,
+											dng_info &info,
+											uint32 scale);
+		
+		dng_rect MapStage2ToStage3 (const dng_rect &area,
+									const dng_point &downScale,
+									bool window) const;
+
 		virtual void ResizeTransparencyToMatchStage3 (dng_host &host,
 													  bool convertTo8Bit = false);
 													  
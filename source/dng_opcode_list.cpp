@@ -133,6 +133,79 @@ void dng_opcode_list::Apply (dng_host &host,
 
 /*****************************************************************************/
 
+bool dng_opcode_list::IsAreaLocal () const
+	{
+	
+	for (uint32 index = 0; index < Count (); index++)
+		{
+		
+		const dng_opcode *opcode = fList [index];
+		
+		if (dynamic_cast<const dng_filter_opcode  *> (opcode) == NULL &&
+			dynamic_cast<const dng_inplace_opcode *> (opcode) == NULL &&
+			dynamic_cast<const dng_opcode_Unknown *> (opcode) == NULL)
+			{
+			
+			return false;
+			
+			}
+		
+		}
+		
+	return true;
+	
+	}
+
+/*****************************************************************************/
+
+bool dng_opcode_list::IsScaleInvariant (const dng_rect &imageBounds) const
+	{
+	
+	for (uint32 index = 0; index < Count (); index++)
+		{
+		
+		if (!fList [index]->IsScaleInvariant (imageBounds))
+			{
+			return false;
+			}
+		
+		}
+		
+	return true;
+	
+	}
+
+/*****************************************************************************/
+
+dng_rect dng_opcode_list::SrcArea (const dng_rect &dstArea,
+								   const dng_rect &imageBounds)
+	{
+	
+	dng_rect area = dstArea & imageBounds;
+	
+	// Work backwards through the list, since the last opcode applied
+	// determines the area needed from the one before it.
+	
+	for (uint32 index = Count (); index > 0; index--)
+		{
+		
+		dng_filter_opcode *filter = dynamic_cast<dng_filter_opcode *> (fList [index - 1]);
+		
+		if (filter && area.NotEmpty ())
+			{
+			
+			area = filter->SrcArea (area, imageBounds) & imageBounds;
+			
+			}
+		
+		}
+		
+	return area;
+	
+	}
+
+/*****************************************************************************/
+
 void dng_opcode_list::Append (AutoPtr<dng_opcode> &opcode)
 	{
 	
@@ -125,6 +125,27 @@ class dng_opcode_list
 					dng_negative &negative,
 					AutoPtr<dng_image> &image);
 
+		/// Returns true if every opcode in this list only reads pixels near
+		/// the pixels it writes, and so can be applied to a window of the
+		/// image rather than the entire image.
+		
+		bool IsAreaLocal () const;
+		
+		/// Returns true if every opcode in this list applies the same function
+		/// to every pixel of an image with the specified bounds, so the list
+		/// can be applied to a resized copy of the image.
+		
+		bool IsScaleInvariant (const dng_rect &imageBounds) const;
+		
+		/// Returns the source pixel area needed to compute the specified
+		/// destination area after applying every opcode in this list.
+		/// \param dstArea The destination pixel area.
+		/// \param imageBounds The bounds of the entire (unwindowed) image.
+		/// \retval The source pixel area, limited to imageBounds.
+		
+		dng_rect SrcArea (const dng_rect &dstArea,
+						  const dng_rect &imageBounds);
+
 		/// Append the specified opcode to this list.
 					
 		void Append (AutoPtr<dng_opcode> &opcode);
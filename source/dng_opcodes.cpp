@@ -241,6 +241,29 @@ void dng_opcode_Unknown::Apply (dng_host & /* host */,
 
 /*****************************************************************************/
 
+// Opcodes that depend on the overall image area (e.g. to normalize
+// coordinates) must see the full stage bounds, even when the negative
+// was read with a window and the image is only part of that area.
+
+static dng_rect OpcodeImageBounds (const dng_opcode &opcode,
+								   const dng_negative &negative,
+								   const dng_image &image)
+	{
+	
+	if (negative.IsWindowed () && opcode.Stage () >= 1
+							   && opcode.Stage () <= 3)
+		{
+		
+		return negative.FullStageBounds (opcode.Stage ());
+		
+		}
+		
+	return image.Bounds ();
+	
+	}
+
+/*****************************************************************************/
+
 class dng_filter_opcode_task: public dng_filter_task
 	{
 	
@@ -250,6 +273,8 @@ class dng_filter_opcode_task: public dng_filter_task
 		
 		dng_negative &fNegative;
 		
+		dng_rect fImageBounds;
+		
 	public:
 	
 		dng_filter_opcode_task (dng_filter_opcode &opcode,
@@ -260,8 +285,9 @@ class dng_filter_opcode_task: public dng_filter_task
 			:	dng_filter_task (srcImage,
 								 dstImage)
 								 
-			,	fOpcode   (opcode)
-			,	fNegative (negative)
+			,	fOpcode      (opcode)
+			,	fNegative    (negative)
+			,	fImageBounds (OpcodeImageBounds (opcode, negative, dstImage))
 			
 			{
 			
@@ -273,11 +299,25 @@ class dng_filter_opcode_task: public dng_filter_task
 			
 			}
 	
+		virtual bool ReusesSourceOverlap () const
+			{
+			
+			// Neighborhood opcodes (e.g. bad pixel repair) pad the source area.
+			
+			dng_rect probe (fImageBounds.t,
+							fImageBounds.l,
+							fImageBounds.t + (int32) Min_uint32 (fImageBounds.H (), 64),
+							fImageBounds.l + (int32) Min_uint32 (fImageBounds.W (), 64));
+			
+			return fOpcode.SrcArea (probe, fImageBounds) != probe;
+			
+			}
+	
 		virtual dng_rect SrcArea (const dng_rect &dstArea)
 			{
 			
 			return fOpcode.SrcArea (dstArea,
-									fDstImage.Bounds ());
+									fImageBounds);
 			
 			}
 
@@ -285,7 +325,7 @@ class dng_filter_opcode_task: public dng_filter_task
 			{
 			
 			return fOpcode.SrcTileSize (dstTileSize,
-										fDstImage.Bounds ());
+										fImageBounds);
 			
 			}
 
@@ -299,7 +339,7 @@ class dng_filter_opcode_task: public dng_filter_task
 								 srcBuffer,
 								 dstBuffer,
 								 dstBuffer.Area (),
-								 fDstImage.Bounds ());
+								 fImageBounds);
 								 
 			}
 
@@ -317,7 +357,7 @@ class dng_filter_opcode_task: public dng_filter_task
 			fOpcode.Prepare (fNegative,
 							 threadCount,
 						     tileSize,
-							 fDstImage.Bounds (),
+							 fImageBounds,
 							 fDstImage.Planes (),
 							 fDstPixelType,
 						     *allocator);
@@ -422,6 +462,8 @@ class dng_inplace_opcode_task: public dng_area_task
 		
 		dng_image &fImage;
 		
+		dng_rect fImageBounds;
+		
 		uint32 fPixelType;
 		
 		AutoPtr<dng_memory_block> fBuffer [kMaxMPThreads];
@@ -436,8 +478,9 @@ class dng_inplace_opcode_task: public dng_area_task
 								 
 			,	fOpcode    (opcode)
 			,	fNegative  (negative)
-			,	fImage     (image)
-			,	fPixelType (opcode.BufferPixelType (image.PixelType ()))
+			,	fImage       (image)
+			,	fImageBounds (OpcodeImageBounds (opcode, negative, image))
+			,	fPixelType   (opcode.BufferPixelType (image.PixelType ()))
 			
 			{
 			
@@ -462,7 +505,7 @@ class dng_inplace_opcode_task: public dng_area_task
 			fOpcode.Prepare (fNegative,
 							 threadCount,
 						     tileSize,
-							 fImage.Bounds (),
+							 fImageBounds,
 							 fImage.Planes (),
 							 fPixelType,
 						     *allocator);
@@ -490,7 +533,7 @@ class dng_inplace_opcode_task: public dng_area_task
 								 threadIndex,
 								 buffer,
 								 tile,
-								 fImage.Bounds ());
+								 fImageBounds);
 
 			// Save result pixels.
 			
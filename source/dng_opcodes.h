@@ -206,6 +206,16 @@ class dng_opcode
 			return false;
 			}
 
+		/// Does this opcode apply the same function to every pixel of an image
+		/// with the specified bounds?  If so, applying it to a resized copy of
+		/// the image gives the same result as resizing the opcode's output.
+		/// Default is true only for NOPs.
+
+		virtual bool IsScaleInvariant (const dng_rect & /* imageBounds */) const
+			{
+			return IsNOP ();
+			}
+
 		/// Is this opcode valid for the specified negative?
 	
 		virtual bool IsValidForNegative (const dng_negative & /* negative */) const
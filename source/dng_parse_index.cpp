@@ -0,0 +1,576 @@
+/*****************************************************************************/
+// Copyright 2006-2012 Adobe Systems Incorporated
+// All Rights Reserved.
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this file in
+// accordance with the terms of the Adobe license agreement accompanying it.
+/*****************************************************************************/
+
+#include "dng_parse_index.h"
+
+#include "dng_bottlenecks.h"
+#include "dng_exceptions.h"
+#include "dng_utils.h"
+
+#include <algorithm>
+
+/*****************************************************************************/
+
+// Saved format, big-endian:
+//
+//		uint32		kMagic
+//		uint32		kVersion
+//		uint64		file length
+//		uint64		modification time
+//		uint8 [16]	header digest
+//		uint32		range count
+//		range count times:
+//			uint64	offset
+//			uint32	length
+//		the data of each range, in order.
+
+static const uint32 kMagic = 0x44504958;	// "DPIX"
+
+static const uint32 kFixedSize = 4 + 4 + 8 + 8 + 16 + 4;
+
+static const uint32 kRangeSize = 8 + 4;
+
+/*****************************************************************************/
+
+dng_parse_index::dng_parse_index ()
+
+	:	fFileLength   (0)
+	,	fModTime      (0)
+	,	fHeaderDigest ()
+	,	fRanges       ()
+	,	fSorted       (true)
+	,	fOwnedData    ()
+	,	fData         (NULL)
+
+	{
+
+	}
+
+/*****************************************************************************/
+
+dng_parse_index::~dng_parse_index ()
+	{
+
+	}
+
+/*****************************************************************************/
+
+void dng_parse_index::Clear ()
+	{
+
+	fFileLength = 0;
+	fModTime    = 0;
+
+	fHeaderDigest.Clear ();
+
+	fRanges.clear ();
+
+	fSorted = true;
+
+	fOwnedData.clear ();
+
+	fData = NULL;
+
+	}
+
+/*****************************************************************************/
+
+void dng_parse_index::SetKey (uint64 fileLength,
+							  uint64 modTime,
+							  const dng_fingerprint &headerDigest)
+	{
+
+	fFileLength   = fileLength;
+	fModTime      = modTime;
+	fHeaderDigest = headerDigest;
+
+	}
+
+/*****************************************************************************/
+
+bool dng_parse_index::Matches (uint64 fileLength,
+							   uint64 modTime,
+							   const dng_fingerprint &headerDigest) const
+	{
+
+	return fFileLength   == fileLength &&
+		   fModTime      == modTime    &&
+		   fHeaderDigest == headerDigest &&
+		   fHeaderDigest.IsValid ();
+
+	}
+
+/*****************************************************************************/
+
+dng_fingerprint dng_parse_index::HeaderDigest (dng_stream &stream)
+	{
+
+	uint8 buffer [kHeaderSize];
+
+	uint32 count = (uint32) Min_uint64 (stream.Length (), kHeaderSize);
+
+	stream.SetReadPosition (0);
+
+	stream.Get (buffer, count);
+
+	dng_md5_printer printer;
+
+	printer.Process (buffer, count);
+
+	return printer.Result ();
+
+	}
+
+/*****************************************************************************/
+
+bool dng_parse_index::Load (const void *data,
+							uint64 size)
+	{
+
+	Clear ();
+
+	if (size < kFixedSize || size > 0xFFFFFFFF)
+		{
+		return false;
+		}
+
+	try
+		{
+
+		dng_stream stream (data, (uint32) size);
+
+		stream.SetBigEndian ();
+
+		if (stream.Get_uint32 () != kMagic ||
+			stream.Get_uint32 () != kVersion)
+			{
+			return false;
+			}
+
+		fFileLength = stream.Get_uint64 ();
+		fModTime    = stream.Get_uint64 ();
+
+		stream.Get (fHeaderDigest.data, dng_fingerprint::kDNGFingerprintSize);
+
+		uint32 rangeCount = stream.Get_uint32 ();
+
+		if (rangeCount > (size - kFixedSize) / kRangeSize)
+			{
+			Clear ();
+			return false;
+			}
+
+		fRanges.resize (rangeCount);
+
+		uint64 dataSize = 0;
+
+		for (uint32 index = 0; index < rangeCount; index++)
+			{
+
+			range &r = fRanges [index];
+
+			r.fOffset = stream.Get_uint64 ();
+			r.fLength = stream.Get_uint32 ();
+			r.fData   = dataSize;
+
+			// Ranges must be in order, apart, and within the file.
+
+			if (r.fLength == 0 ||
+				r.fOffset > fFileLength ||
+				r.fLength > fFileLength - r.fOffset ||
+				(index > 0 && r.fOffset <= fRanges [index - 1].fOffset +
+										   fRanges [index - 1].fLength))
+				{
+				Clear ();
+				return false;
+				}
+
+			dataSize += r.fLength;
+
+			}
+
+		if (dataSize != size - stream.Position ())
+			{
+			Clear ();
+			return false;
+			}
+
+		fData = (const uint8 *) data + stream.Position ();
+
+		}
+
+	catch (...)
+		{
+
+		Clear ();
+
+		return false;
+
+		}
+
+	return true;
+
+	}
+
+/*****************************************************************************/
+
+void dng_parse_index::Save (dng_stream &stream)
+	{
+
+	Compact ();
+
+	stream.SetBigEndian ();
+
+	stream.Put_uint32 (kMagic);
+	stream.Put_uint32 (kVersion);
+
+	stream.Put_uint64 (fFileLength);
+	stream.Put_uint64 (fModTime);
+
+	stream.Put (fHeaderDigest.data, dng_fingerprint::kDNGFingerprintSize);
+
+	stream.Put_uint32 (RangeCount ());
+
+	for (size_t index = 0; index < fRanges.size (); index++)
+		{
+
+		stream.Put_uint64 (fRanges [index].fOffset);
+		stream.Put_uint32 (fRanges [index].fLength);
+
+		}
+
+	const uint8 *data = fData ? fData : fOwnedData.data ();
+
+	for (size_t index = 0; index < fRanges.size (); index++)
+		{
+
+		stream.Put (data + fRanges [index].fData,
+					fRanges [index].fLength);
+
+		}
+
+	stream.Flush ();
+
+	}
+
+/*****************************************************************************/
+
+void dng_parse_index::Add (uint64 offset,
+						   const void *data,
+						   uint32 count)
+	{
+
+	if (count == 0)
+		{
+		return;
+		}
+
+	// Take a copy of loaded data before adding to it.
+
+	if (fData)
+		{
+
+		fOwnedData.assign (fData, fData + DataSize ());
+
+		fData = NULL;
+
+		}
+
+	range r;
+
+	r.fOffset = offset;
+	r.fLength = count;
+	r.fData   = fOwnedData.size ();
+
+	const uint8 *bytes = (const uint8 *) data;
+
+	fOwnedData.insert (fOwnedData.end (), bytes, bytes + count);
+
+	if (!fRanges.empty () && offset <= fRanges.back ().fOffset)
+		{
+		fSorted = false;
+		}
+
+	fRanges.push_back (r);
+
+	}
+
+/*****************************************************************************/
+
+const void * dng_parse_index::Find (uint64 offset,
+									uint32 count) const
+	{
+
+	const uint8 *data = fData ? fData : fOwnedData.data ();
+
+	if (!fSorted)
+		{
+
+		for (size_t index = 0; index < fRanges.size (); index++)
+			{
+
+			const range &r = fRanges [index];
+
+			if (offset >= r.fOffset &&
+				offset - r.fOffset <= r.fLength &&
+				count <= r.fLength - (offset - r.fOffset))
+				{
+				return data + r.fData + (offset - r.fOffset);
+				}
+
+			}
+
+		return NULL;
+
+		}
+
+	// Last range starting at or before offset.
+
+	range key;
+
+	key.fOffset = offset;
+
+	dng_std_vector<range>::const_iterator it = std::upper_bound (fRanges.begin (),
+																 fRanges.end (),
+																 key);
+
+	if (it == fRanges.begin ())
+		{
+		return NULL;
+		}
+
+	const range &r = *(--it);
+
+	if (offset - r.fOffset > r.fLength ||
+		count > r.fLength - (offset - r.fOffset))
+		{
+		return NULL;
+		}
+
+	return data + r.fData + (offset - r.fOffset);
+
+	}
+
+/*****************************************************************************/
+
+uint64 dng_parse_index::DataSize () const
+	{
+
+	uint64 size = 0;
+
+	for (size_t index = 0; index < fRanges.size (); index++)
+		{
+		size += fRanges [index].fLength;
+		}
+
+	return size;
+
+	}
+
+/*****************************************************************************/
+
+void dng_parse_index::Compact ()
+	{
+
+	if (fRanges.empty ())
+		{
+		return;
+		}
+
+	const uint8 *data = fData ? fData : fOwnedData.data ();
+
+	dng_std_vector<range> ranges (fRanges);
+
+	std::stable_sort (ranges.begin (), ranges.end ());
+
+	// Nothing to do if the ranges are already in order and apart.
+
+	bool apart = true;
+
+	for (size_t index = 1; index < ranges.size () && apart; index++)
+		{
+
+		apart = ranges [index].fOffset > ranges [index - 1].fOffset +
+										 ranges [index - 1].fLength;
+
+		}
+
+	if (fSorted && apart)
+		{
+		return;
+		}
+
+	dng_std_vector<range> merged;
+
+	dng_std_vector<uint8> mergedData;
+
+	for (size_t index = 0; index < ranges.size (); index++)
+		{
+
+		const range &r = ranges [index];
+
+		const uint8 *bytes = data + r.fData;
+
+		uint64 end = r.fOffset + r.fLength;
+
+		if (!merged.empty () &&
+			r.fOffset <= merged.back ().fOffset + merged.back ().fLength)
+			{
+
+			range &last = merged.back ();
+
+			uint64 lastEnd = last.fOffset + last.fLength;
+
+			// The overlapping bytes came from the same file, so only the
+			// part past the end of the merged range is added.
+
+			if (end > lastEnd &&
+				end - last.fOffset <= 0xFFFFFFFF)
+				{
+
+				mergedData.insert (mergedData.end (),
+								   bytes + (lastEnd - r.fOffset),
+								   bytes + r.fLength);
+
+				last.fLength = (uint32) (end - last.fOffset);
+
+				}
+
+			else if (end > lastEnd)
+				{
+
+				// Keep ranges under 4 GB by starting a new one.
+
+				range next;
+
+				next.fOffset = lastEnd;
+				next.fLength = (uint32) (end - lastEnd);
+				next.fData   = mergedData.size ();
+
+				mergedData.insert (mergedData.end (),
+								   bytes + (lastEnd - r.fOffset),
+								   bytes + r.fLength);
+
+				merged.push_back (next);
+
+				}
+
+			continue;
+
+			}
+
+		range next = r;
+
+		next.fData = mergedData.size ();
+
+		mergedData.insert (mergedData.end (), bytes, bytes + r.fLength);
+
+		merged.push_back (next);
+
+		}
+
+	fRanges.swap (merged);
+
+	fOwnedData.swap (mergedData);
+
+	fData = NULL;
+
+	fSorted = true;
+
+	}
+
+/*****************************************************************************/
+
+dng_parse_index_stream::dng_parse_index_stream (dng_stream &stream,
+												dng_parse_index &index,
+												bool recording,
+												dng_abort_sniffer *sniffer)
+
+	:	dng_stream (sniffer,
+					kDefaultBufferSize,
+					stream.OffsetInOriginalFile ())
+
+	,	fStream    (stream)
+	,	fIndex     (index)
+	,	fRecording (recording)
+
+	{
+
+	}
+
+/*****************************************************************************/
+
+dng_parse_index_stream::~dng_parse_index_stream ()
+	{
+
+	}
+
+/*****************************************************************************/
+
+const void * dng_parse_index_stream::DirectData (uint64 offset,
+												 uint32 count)
+	{
+
+	// Data recorded by this stream may move as more is recorded, so only a
+	// loaded index can lend its data.
+
+	if (fIndex.IsLoaded ())
+		{
+
+		const void *data = fIndex.Find (offset, count);
+
+		if (data)
+			{
+			return data;
+			}
+
+		}
+
+	return fStream.DirectData (offset, count);
+
+	}
+
+/*****************************************************************************/
+
+uint64 dng_parse_index_stream::DoGetLength ()
+	{
+
+	return fStream.Length ();
+
+	}
+
+/*****************************************************************************/
+
+void dng_parse_index_stream::DoRead (void *data,
+									 uint32 count,
+									 uint64 offset)
+	{
+
+	const void *indexed = fIndex.Find (offset, count);
+
+	if (indexed)
+		{
+
+		DoCopyBytes (indexed, data, count);
+
+		return;
+
+		}
+
+	fStream.SetReadPosition (offset);
+
+	fStream.Get (data, count);
+
+	if (fRecording)
+		{
+		fIndex.Add (offset, data, count);
+		}
+
+	}
+
+/*****************************************************************************/
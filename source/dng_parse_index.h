@@ -0,0 +1,258 @@
+/*****************************************************************************/
+// Copyright 2006-2012 Adobe Systems Incorporated
+// All Rights Reserved.
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this file in
+// accordance with the terms of the Adobe license agreement accompanying it.
+/*****************************************************************************/
+
+/** \file
+ * Index of the metadata bytes read while parsing a file, which can be saved
+ * and used to reopen the file without reading them again.
+ */
+
+/*****************************************************************************/
+
+#ifndef __dng_parse_index__
+#define __dng_parse_index__
+
+/*****************************************************************************/
+
+#include "dng_classes.h"
+#include "dng_fingerprint.h"
+#include "dng_memory.h"
+#include "dng_stream.h"
+#include "dng_types.h"
+
+/*****************************************************************************/
+
+/// \brief The byte ranges of a file read by dng_info::Parse,
+/// dng_negative::Parse and dng_negative::PostParse, with their data.
+///
+/// This covers the IFD chain, tile and strip tables, linearization and mosaic
+/// information, camera profiles, opcode lists, EXIF, maker notes and private
+/// data: everything the parse reads, as the parse code reads it.  An index is
+/// recorded by parsing through a dng_parse_index_stream, saved with Save, and
+/// later loaded with Load from memory, which may be a mapped file.  Parsing
+/// through a dng_parse_index_stream over the loaded index then reads only
+/// image data from the file.
+///
+/// An index is keyed by the file length, a modification time supplied by the
+/// caller, and a digest of the start of the file, and should only be used
+/// with a file that Matches.
+
+class dng_parse_index
+	{
+
+	public:
+
+		enum
+			{
+
+			/// Version of the saved format.
+
+			kVersion = 1,
+
+			/// Number of bytes at the start of the file covered by
+			/// HeaderDigest.
+
+			kHeaderSize = 4096
+
+			};
+
+	private:
+
+		struct range
+			{
+
+			uint64 fOffset;
+
+			uint32 fLength;
+
+			// Offset of the range's data in the data area.
+
+			uint64 fData;
+
+			bool operator< (const range &other) const
+				{
+				return fOffset < other.fOffset;
+				}
+
+			};
+
+		uint64 fFileLength;
+
+		uint64 fModTime;
+
+		dng_fingerprint fHeaderDigest;
+
+		// Ranges, sorted and merged unless fSorted is false.
+
+		dng_std_vector<range> fRanges;
+
+		bool fSorted;
+
+		// Data of the ranges, either owned by the index while recording, or
+		// the caller's memory passed to Load.
+
+		dng_std_vector<uint8> fOwnedData;
+
+		const uint8 *fData;
+
+	public:
+
+		dng_parse_index ();
+
+		~dng_parse_index ();
+
+		/// Remove all ranges and the key.
+
+		void Clear ();
+
+		/// Set the key of the file being indexed.
+		/// \param fileLength Length of the file.
+		/// \param modTime Modification time of the file, in any units the
+		/// caller chooses, or zero if unknown.
+		/// \param headerDigest HeaderDigest of the file.
+
+		void SetKey (uint64 fileLength,
+					 uint64 modTime,
+					 const dng_fingerprint &headerDigest);
+
+		/// Is this an index of the file with this key?
+
+		bool Matches (uint64 fileLength,
+					  uint64 modTime,
+					  const dng_fingerprint &headerDigest) const;
+
+		/// Digest of the first kHeaderSize bytes of a stream.
+
+		static dng_fingerprint HeaderDigest (dng_stream &stream);
+
+		/// Use an index saved by Save.  The data is not copied, and must stay
+		/// valid and unchanged while the index or any stream over it is in
+		/// use.
+		/// \retval false if the data is not an index of this version, in
+		/// which case the index is left empty.
+
+		bool Load (const void *data,
+				   uint64 size);
+
+		/// Write the index to a stream.
+
+		void Save (dng_stream &stream);
+
+		/// Record that count bytes at offset in the file are data.
+
+		void Add (uint64 offset,
+				  const void *data,
+				  uint32 count);
+
+		/// The data of count bytes at offset in the file, or NULL if they are
+		/// not all in one range of the index.
+
+		const void * Find (uint64 offset,
+						   uint32 count) const;
+
+		/// Number of ranges in the index.
+
+		uint32 RangeCount () const
+			{
+			return (uint32) fRanges.size ();
+			}
+
+		/// Is the data the caller's memory passed to Load?  Pointers returned
+		/// by Find on a recording index may be invalidated by Add or Save.
+
+		bool IsLoaded () const
+			{
+			return fData != NULL;
+			}
+
+		/// Total size of the data of the ranges.
+
+		uint64 DataSize () const;
+
+	private:
+
+		// Sort the ranges recorded by Add, and merge those that overlap or
+		// touch, so each byte is stored once.
+
+		void Compact ();
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_parse_index (const dng_parse_index &index);
+
+		dng_parse_index & operator= (const dng_parse_index &index);
+
+	};
+
+/*****************************************************************************/
+
+/// \brief A read-only dng_stream over another stream, which serves reads from
+/// a dng_parse_index where it can, and can record the reads it passes on.
+///
+/// To build an index, parse the file through a recording stream over an empty
+/// index, then turn recording off before reading the image data.  To use an
+/// index, parse and read the file through a stream over the loaded index.
+
+class dng_parse_index_stream: public dng_stream
+	{
+
+	private:
+
+		dng_stream &fStream;
+
+		dng_parse_index &fIndex;
+
+		bool fRecording;
+
+	public:
+
+		/// \param stream Stream holding the file.
+		/// \param index Index to read from and, if recording, add to.
+		/// \param recording If true, reads not served by the index are
+		/// added to it.
+		/// \param sniffer If non-NULL used to check for user cancellation.
+
+		dng_parse_index_stream (dng_stream &stream,
+								dng_parse_index &index,
+								bool recording,
+								dng_abort_sniffer *sniffer = NULL);
+
+		virtual ~dng_parse_index_stream ();
+
+		/// Start or stop adding reads to the index.
+
+		void SetRecording (bool recording)
+			{
+			fRecording = recording;
+			}
+
+		virtual const void * DirectData (uint64 offset,
+										 uint32 count);
+
+	protected:
+
+		virtual uint64 DoGetLength ();
+
+		virtual void DoRead (void *data,
+							 uint32 count,
+							 uint64 offset);
+
+	private:
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_parse_index_stream (const dng_parse_index_stream &stream);
+
+		dng_parse_index_stream & operator= (const dng_parse_index_stream &stream);
+
+	};
+
+/*****************************************************************************/
+
+#endif
+
+/*****************************************************************************/
@@ -40,6 +40,7 @@
 #include "dng_jpeglib.h"
 #endif
 
+#include <algorithm>
 #include <limits>
 
 /******************************************************************************/
@@ -1157,6 +1158,7 @@ void dng_image_spooler::Spool (const void *data,
 dng_read_image::dng_read_image ()
 
 	:	fJPEGTables ()
+	,	fJPEGScale  (1)
 	
 	{
 	
@@ -1171,6 +1173,39 @@ dng_read_image::~dng_read_image ()
 
 /*****************************************************************************/
 
+void dng_read_image::SetJPEGScale (uint32 scale)
+	{
+	
+	if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+		{
+		ThrowProgramError ("Bad JPEG scale");
+		}
+		
+	fJPEGScale = scale;
+	
+	}
+
+/*****************************************************************************/
+
+dng_rect dng_read_image::ScaledArea (const dng_rect &area) const
+	{
+	
+	if (fJPEGScale == 1)
+		{
+		return area;
+		}
+		
+	int32 scale = (int32) fJPEGScale;
+	
+	return dng_rect (area.t / scale,
+					 area.l / scale,
+					 (area.b + scale - 1) / scale,
+					 (area.r + scale - 1) / scale);
+	
+	}
+
+/*****************************************************************************/
+
 bool dng_read_image::ReadUncompressed (dng_host &host,
 									   const dng_ifd &ifd,
 									   dng_stream &stream,
@@ -1585,15 +1620,28 @@ void dng_read_image::DecodeLossyJPEG (dng_host &host,
 				}
 		}
 			
+		// Let the decoder do any downscaling in the DCT domain.
+		
+		cinfo.scale_num   = 1;
+		cinfo.scale_denom = fJPEGScale;
+		
 		// Start the compression.
 		
 		jpeg_start_decompress (&cinfo);
 		
+		dng_rect dstArea = ScaledArea (tileArea);
+		
+		if (cinfo.output_width  != dstArea.W () ||
+			cinfo.output_height != dstArea.H ())
+			{
+			ThrowBadFormat ();
+			}
+		
 		// Setup a one-scanline size buffer.
 		
-		dng_pixel_buffer buffer(tileArea, plane, planes, ttByte, pcInterleaved,
+		dng_pixel_buffer buffer(dstArea, plane, planes, ttByte, pcInterleaved,
 								NULL);
-		buffer.fArea.b = tileArea.t + 1;
+		buffer.fArea.b = dstArea.t + 1;
 		
 		buffer.fDirty = true;
 		
@@ -1607,7 +1655,7 @@ void dng_read_image::DecodeLossyJPEG (dng_host &host,
 		
 		// Read each scanline and save to image.
 			
-		while (buffer.fArea.t < tileArea.b)
+		while (buffer.fArea.t < dstArea.b)
 			{
 			
 			jpeg_read_scanlines (&cinfo, sampArray, 1);
@@ -2229,7 +2277,19 @@ void dng_read_image::ReadTile (dng_host &host,
 			
 			dng_pixel_buffer buffer (tileArea, plane, planes, pixelType, pcInterleaved,
 				 NULL);
-			
+
+			// Floating point data may be stored with 16 or 24 bits per sample.
+			// It is decoded at that size and expanded to 32 bits below.
+
+			if (pixelType == ttFloat)
+				{
+
+				buffer.fPixelSize = bytesPerSample;
+
+				uncompressedSize = SafeUint32Mult (sampleCount, bytesPerSample);
+
+				}
+
 			uint32 bufferSize = uncompressedSize;
 			
 			// If we are using the floating point predictor, we need an extra
@@ -2713,6 +2773,206 @@ bool dng_read_image::CanRead (const dng_ifd &ifd)
 	
 /*****************************************************************************/
 
+// Orders tile indices by file offset, then by index.
+
+class dng_tile_offset_less
+	{
+	
+	private:
+	
+		const uint64 *fTileOffset;
+		
+	public:
+	
+		dng_tile_offset_less (const uint64 *tileOffset)
+			:	fTileOffset (tileOffset)
+			{
+			}
+			
+		bool operator() (uint32 a, uint32 b) const
+			{
+			
+			if (fTileOffset [a] != fTileOffset [b])
+				{
+				return fTileOffset [a] < fTileOffset [b];
+				}
+				
+			return a < b;
+			
+			}
+			
+	};
+
+/*****************************************************************************/
+
+dng_read_planner::dng_read_planner (const uint64 *tileOffset,
+									const uint32 *tileByteCount,
+									const uint32 *tiles,
+									uint32 tileCount,
+									uint32 maxGap,
+									uint32 maxRunLength)
+
+	:	fTileOffset    (tileOffset)
+	,	fTileByteCount (tileByteCount)
+	,	fTileData      (tileCount, sizeof (uint32))
+	,	fRunStartData  (SafeUint32Add (tileCount, 1), sizeof (uint32))
+	,	fRunLengthData (tileCount, sizeof (uint32))
+	,	fRunCount      (0)
+	,	fMaxRunLength  (0)
+	
+	{
+	
+	uint32 *order     = fTileData     .Buffer_uint32 ();
+	uint32 *runStart  = fRunStartData .Buffer_uint32 ();
+	uint32 *runLength = fRunLengthData.Buffer_uint32 ();
+	
+	for (uint32 index = 0; index < tileCount; index++)
+		{
+		order [index] = tiles [index];
+		}
+		
+	std::sort (order,
+			   order + tileCount,
+			   dng_tile_offset_less (fTileOffset));
+			   
+	uint64 runOffset = 0;
+	uint64 runEnd    = 0;
+	
+	for (uint32 index = 0; index < tileCount; index++)
+		{
+		
+		uint32 tileIndex = order [index];
+		
+		uint64 tileOffset = fTileOffset [tileIndex];
+		
+		uint64 tileEnd = tileOffset + fTileByteCount [tileIndex];
+		
+		// Extend the current run if the tile starts within the gap threshold
+		// of its end and the run stays within the length limit.
+		
+		if (fRunCount > 0 &&
+			tileOffset <= runEnd + maxGap &&
+			Max_uint64 (runEnd, tileEnd) - runOffset <= maxRunLength)
+			{
+			
+			runEnd = Max_uint64 (runEnd, tileEnd);
+			
+			}
+			
+		else
+			{
+			
+			if (fRunCount > 0)
+				{
+				
+				runLength [fRunCount - 1] = (uint32) (runEnd - runOffset);
+				
+				}
+			
+			runStart [fRunCount++] = index;
+			
+			runOffset = tileOffset;
+			runEnd    = tileEnd;
+			
+			}
+		
+		}
+		
+	if (fRunCount > 0)
+		{
+		
+		runLength [fRunCount - 1] = (uint32) (runEnd - runOffset);
+		
+		}
+		
+	runStart [fRunCount] = tileCount;
+	
+	for (uint32 run = 0; run < fRunCount; run++)
+		{
+		
+		fMaxRunLength = Max_uint32 (fMaxRunLength, runLength [run]);
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+uint64 dng_read_planner::RunOffset (uint32 run) const
+	{
+	
+	return fTileOffset [RunTile (run, 0)];
+	
+	}
+	
+/*****************************************************************************/
+
+uint32 dng_read_planner::RunLength (uint32 run) const
+	{
+	
+	return fRunLengthData.Buffer_uint32 () [run];
+	
+	}
+	
+/*****************************************************************************/
+
+uint32 dng_read_planner::RunTileCount (uint32 run) const
+	{
+	
+	const uint32 *runStart = fRunStartData.Buffer_uint32 ();
+	
+	return runStart [run + 1] - runStart [run];
+	
+	}
+	
+/*****************************************************************************/
+
+uint32 dng_read_planner::RunTile (uint32 run,
+								  uint32 index) const
+	{
+	
+	return fTileData.Buffer_uint32 () [fRunStartData.Buffer_uint32 () [run] + index];
+	
+	}
+	
+/*****************************************************************************/
+
+const uint8 * dng_read_planner::ReadRun (dng_host &host,
+										 dng_stream &stream,
+										 uint32 run,
+										 AutoPtr<dng_memory_block> &buffer) const
+	{
+	
+	uint32 length = RunLength (run);
+	
+	// Use the stream's own memory, if it has the whole run.
+	
+	const void *data = stream.DirectData (RunOffset (run), length);
+	
+	if (data)
+		{
+		return (const uint8 *) data;
+		}
+	
+	if (buffer.Get () == NULL || buffer->LogicalSize () < length)
+		{
+		
+		buffer.Reset ();
+		
+		buffer.Reset (host.Allocate (fMaxRunLength));
+		
+		}
+		
+	stream.SetReadPosition (RunOffset (run));
+	
+	stream.Get (buffer->Buffer (), length);
+	
+	return buffer->Buffer_uint8 ();
+	
+	}
+
+/*****************************************************************************/
+
 class dng_read_tiles_task : public dng_area_task
 	{
 	
@@ -2732,17 +2992,17 @@ class dng_read_tiles_task : public dng_area_task
 		
 		dng_fingerprint *fJPEGTileDigest;
 		
-		uint32 fOuterSamples;
-		
 		uint32 fInnerSamples;
 		
 		uint32 fTilesDown;
 		
 		uint32 fTilesAcross;
 		
-		uint64 *fTileOffset;
+		const uint64 *fTileOffset;
+		
+		const uint32 *fTileByteCount;
 		
-		uint32 *fTileByteCount;
+		const dng_read_planner &fPlanner;
 		
 		uint32 fCompressedSize;
 		
@@ -2750,7 +3010,7 @@ class dng_read_tiles_task : public dng_area_task
 		
 		dng_mutex fMutex;
 		
-		uint32 fNextTileIndex;
+		uint32 fNextRun;
 		
 	public:
 	
@@ -2761,12 +3021,12 @@ class dng_read_tiles_task : public dng_area_task
 							 dng_image &image,
 							 dng_jpeg_image *jpegImage,
 							 dng_fingerprint *jpegTileDigest,
-							 uint32 outerSamples,
 							 uint32 innerSamples,
 							 uint32 tilesDown,
 							 uint32 tilesAcross,
-							 uint64 *tileOffset,
-							 uint32 *tileByteCount,
+							 const uint64 *tileOffset,
+							 const uint32 *tileByteCount,
+							 const dng_read_planner &planner,
 							 uint32 compressedSize,
 							 uint32 uncompressedSize)
 		
@@ -2777,16 +3037,16 @@ class dng_read_tiles_task : public dng_area_task
 			,	fImage		      (image)
 			,	fJPEGImage		  (jpegImage)
 			,	fJPEGTileDigest   (jpegTileDigest)
-			,	fOuterSamples     (outerSamples)
 			,	fInnerSamples     (innerSamples)
 			,	fTilesDown        (tilesDown)
 			,	fTilesAcross	  (tilesAcross)
 			,	fTileOffset		  (tileOffset)
 			,	fTileByteCount	  (tileByteCount)
+			,	fPlanner		  (planner)
 			,	fCompressedSize   (compressedSize)
 			,	fUncompressedSize (uncompressedSize)
 			,	fMutex			  ("dng_read_tiles_task")
-			,	fNextTileIndex	  (0)
+			,	fNextRun		  (0)
 			
 			{
 			
@@ -2801,11 +3061,12 @@ class dng_read_tiles_task : public dng_area_task
 					  dng_abort_sniffer *sniffer)
 			{
 			
+			AutoPtr<dng_memory_block> runBuffer;
 			AutoPtr<dng_memory_block> compressedBuffer;
 			AutoPtr<dng_memory_block> uncompressedBuffer;
 			AutoPtr<dng_memory_block> subTileBlockBuffer;
 			
-			if (!fJPEGImage)
+			if (fCompressedSize && !fJPEGImage)
 				{
 				compressedBuffer.Reset (fHost.Allocate (fCompressedSize));
 				}
@@ -2815,92 +3076,119 @@ class dng_read_tiles_task : public dng_area_task
 				uncompressedBuffer.Reset (fHost.Allocate (fUncompressedSize));
 				}
 			
+			dng_host host (&fHost.Allocator (),
+						   sniffer);				// Cannot use sniffer attached to main host
+			
 			while (true)
 				{
 				
-				uint32 tileIndex;
-				uint32 byteCount;
+				uint32 run;
+				
+				const uint8 *runData;
+				
+				// Take the next run and fetch it with a single read.
 				
 					{
 					
 					dng_lock_mutex lock (&fMutex);
 					
-					if (fNextTileIndex == fOuterSamples * fTilesDown * fTilesAcross)
+					if (fNextRun == fPlanner.RunCount ())
 						{
 						return;
 						}
 						
-					tileIndex = fNextTileIndex++;
+					run = fNextRun++;
 					
 					TempStreamSniffer noSniffer (fStream, NULL);
-
-					fStream.SetReadPosition (fTileOffset [tileIndex]);
 					
-					byteCount = fTileByteCount [tileIndex];
-					
-					if (fJPEGImage)
-						{
-						
-						fJPEGImage->fJPEGData [tileIndex] . Reset (fHost.Allocate (byteCount));
-						
-						}
-					
-					fStream.Get (fJPEGImage ? fJPEGImage->fJPEGData [tileIndex]->Buffer ()
-											: compressedBuffer->Buffer (),
-								 byteCount);
+					runData = fPlanner.ReadRun (host,
+												fStream,
+												run,
+												runBuffer);
 					
 					}
 					
-				dng_abort_sniffer::SniffForAbort (sniffer);
+				uint64 runOffset = fPlanner.RunOffset (run);
 				
-				if (fJPEGTileDigest)
+				// Decode each tile from its slice of the run.
+					
+				for (uint32 index = 0; index < fPlanner.RunTileCount (run); index++)
 					{
 					
-					dng_md5_printer printer;
+					dng_abort_sniffer::SniffForAbort (sniffer);
+				
+					uint32 tileIndex = fPlanner.RunTile (run, index);
+					
+					uint32 byteCount = fTileByteCount [tileIndex];
+					
+					const uint8 *tileData = runData + (uint32) (fTileOffset [tileIndex] - runOffset);
 					
-					printer.Process (compressedBuffer->Buffer (),
+					if (fJPEGImage)
+						{
+						
+						fJPEGImage->fJPEGData [tileIndex] . Reset (fHost.Allocate (byteCount));
+						
+						DoCopyBytes (tileData,
+									 fJPEGImage->fJPEGData [tileIndex]->Buffer (),
+									 byteCount);
+						
+						}
+						
+					else if (compressedBuffer.Get ())
+						{
+						
+						DoCopyBytes (tileData,
+									 compressedBuffer->Buffer (),
 									 byteCount);
-									 
-					fJPEGTileDigest [tileIndex] = printer.Result ();
+						
+						}
 					
+					if (fJPEGTileDigest)
+						{
+						
+						dng_md5_printer printer;
+						
+						printer.Process (tileData,
+										 byteCount);
+										 
+						fJPEGTileDigest [tileIndex] = printer.Result ();
+						
+						}
+						
+					dng_stream tileStream (tileData,
+										   byteCount);
+										   
+					tileStream.SetLittleEndian (fStream.LittleEndian ());
+								
+					uint32 plane = tileIndex / (fTilesDown * fTilesAcross);
+					
+					uint32 rowIndex = (tileIndex - plane * fTilesDown * fTilesAcross) / fTilesAcross;
+					
+					uint32 colIndex = tileIndex - (plane * fTilesDown + rowIndex) * fTilesAcross;
+					
+					dng_rect tileArea = fIFD.TileArea (rowIndex, colIndex);
+					
+					fReadImage.ReadTile (host,
+										 fIFD,
+										 tileStream,
+										 fImage,
+										 tileArea,
+										 plane,
+										 fInnerSamples,
+										 byteCount,
+										 fJPEGImage ? fJPEGImage->fJPEGData [tileIndex]
+													: compressedBuffer,
+										 uncompressedBuffer,
+										 subTileBlockBuffer);
+										 
 					}
 					
-				dng_stream tileStream (fJPEGImage ? fJPEGImage->fJPEGData [tileIndex]->Buffer ()
-												  : compressedBuffer->Buffer (),
-									   byteCount);
-									   
-				tileStream.SetLittleEndian (fStream.LittleEndian ());
-							
-				uint32 plane = tileIndex / (fTilesDown * fTilesAcross);
-				
-				uint32 rowIndex = (tileIndex - plane * fTilesDown * fTilesAcross) / fTilesAcross;
-				
-				uint32 colIndex = tileIndex - (plane * fTilesDown + rowIndex) * fTilesAcross;
-				
-				dng_rect tileArea = fIFD.TileArea (rowIndex, colIndex);
-				
-				dng_host host (&fHost.Allocator (),
-							   sniffer);				// Cannot use sniffer attached to main host
-				
-				fReadImage.ReadTile (host,
-									 fIFD,
-									 tileStream,
-									 fImage,
-									 tileArea,
-									 plane,
-									 fInnerSamples,
-									 byteCount,
-									 fJPEGImage ? fJPEGImage->fJPEGData [tileIndex]
-												: compressedBuffer,
-									 uncompressedBuffer,
-									 subTileBlockBuffer);
-					
 				}
 			
 			}
 		
 	private:
-
+	
 		// Hidden copy constructor and assignment operator.
 
 		dng_read_tiles_task (const dng_read_tiles_task &);
@@ -2921,6 +3209,20 @@ void dng_read_image::Read (dng_host &host,
 	
 	uint32 tileIndex;
 	
+	// Scaled reads need every tile to start on a multiple of the scale.
+	
+	if (fJPEGScale > 1)
+		{
+		
+		if (!ifd.IsBaselineJPEG () || ifd.fRowInterleaveFactor > 1 ||
+			(ifd.TilesAcross () > 1 && ifd.fTileWidth  % fJPEGScale) ||
+			(ifd.TilesDown   () > 1 && ifd.fTileLength % fJPEGScale))
+			{
+			ThrowProgramError ("Cannot scale this image while reading");
+			}
+		
+		}
+	
 	// Deal with row interleaved images.
 	
 	if (ifd.fRowInterleaveFactor > 1 &&
@@ -3215,12 +3517,91 @@ void dng_read_image::Read (dng_host &host,
 #if qImagecore
 	useMultipleThreads = false;	
 #endif
-		
-	if (useMultipleThreads)
+
+	// If we know the tile byte counts, and the tiles are not too large to
+	// hold in memory, plan the reads so that tiles which are close together
+	// in the file are fetched with a single read.
+	
+	if (tileByteCount && maxTileByteCount <= kReadRunSize)
 		{
 		
-		uint32 threadCount = Min_uint32 (outerSamples * tilesDown * tilesAcross,
-										 host.PerformAreaTaskThreads ());
+		// Find the tiles to read.  Skip tiles that do not overlap a windowed
+		// destination image, unless we need all the compressed data.
+		
+		uint32 planeTiles = SafeUint32Mult (tilesDown, tilesAcross);
+		
+		dng_memory_data tileListData (SafeUint32Mult (planeTiles, outerSamples),
+									  sizeof (uint32));
+		
+		uint32 *tileList = tileListData.Buffer_uint32 ();
+		
+		uint32 listCount = 0;
+		
+		uint64 listBytes = 0;
+		
+		for (tileIndex = 0; tileIndex < planeTiles * outerSamples; tileIndex++)
+			{
+			
+			uint32 tilePlaneIndex = tileIndex % planeTiles;
+			
+			dng_rect tileArea = ifd.TileArea (tilePlaneIndex / tilesAcross,
+											  tilePlaneIndex % tilesAcross);
+			
+			if (jpegImage || jpegDigest ||
+				(ScaledArea (tileArea) & image.Bounds ()).NotEmpty ())
+				{
+				
+				tileList [listCount++] = tileIndex;
+				
+				listBytes += tileByteCount [tileIndex];
+				
+				}
+			
+			}
+			
+		uint32 threadCount = 1;
+		
+		uint32 maxRunLength = kReadRunSize;
+		
+		// Streams that hold their data in memory gain nothing from merged
+		// reads, and can pass each tile to the decoder in place.
+		
+		bool inMemory = listCount > 0 &&
+						stream.DirectData (tileOffset [tileList [0]], 0) != NULL;
+			
+		if (inMemory)
+			{
+			
+			maxRunLength = 0;
+			
+			}
+			
+		if (useMultipleThreads)
+			{
+			
+			threadCount = Pin_uint32 (1,
+									  listCount,
+									  host.PerformAreaTaskThreads ());
+			
+			// Keep the runs short enough to give each thread several.
+			
+			if (!inMemory)
+				{
+			
+				maxRunLength = (uint32) Pin_uint64 (maxTileByteCount,
+													listBytes / (threadCount * 4),
+													kReadRunSize);
+													
+				}
+			
+			}
+		
+		dng_read_planner planner (tileOffset,
+								  tileByteCount,
+								  tileList,
+								  listCount,
+								  host.ReadGapThreshold (),
+								  maxRunLength);
 		
 		dng_read_tiles_task task (*this,
 								  host,
@@ -3229,17 +3610,32 @@ void dng_read_image::Read (dng_host &host,
 								  image,
 								  jpegImage,
 								  jpegTileDigest.Get (),
-								  outerSamples,
 								  innerSamples,
 								  tilesDown,
 								  tilesAcross,
 								  tileOffset,
 								  tileByteCount,
-								  maxTileByteCount,
+								  planner,
+								  compressedSize,
 								  uncompressedSize);
 								  
-		host.PerformAreaTask (task,
-							  dng_rect (0, 0, 16, 16 * threadCount));
+		if (threadCount > 1)
+			{
+			
+			host.PerformAreaTask (task,
+								  dng_rect (0, 0, 16, 16 * threadCount));
+			
+			}
+			
+		else
+			{
+			
+			dng_area_task::Perform (task,
+									dng_rect (0, 0, 16, 16),
+									&host.Allocator (),
+									host.Sniffer ());
+			
+			}
 		
 		}
 		
@@ -3278,10 +3674,23 @@ void dng_read_image::Read (dng_host &host,
 				for (uint32 colIndex = 0; colIndex < tilesAcross; colIndex++)
 					{
 					
-					stream.SetReadPosition (tileOffset [tileIndex]);
-					
 					dng_rect tileArea = ifd.TileArea (rowIndex, colIndex);
 					
+					// Skip tiles that do not overlap a windowed destination
+					// image, unless we need all the compressed data.
+					
+					if (!jpegImage && !jpegDigest &&
+						(ScaledArea (tileArea) & image.Bounds ()).IsEmpty ())
+						{
+						
+						tileIndex++;
+						
+						continue;
+						
+						}
+					
+					stream.SetReadPosition (tileOffset [tileIndex]);
+					
 					uint32 subTileCount = (tileArea.H () + subTileLength - 1) /
 										  subTileLength;
 										  
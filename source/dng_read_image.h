@@ -62,6 +62,111 @@ class dng_row_interleaved_image: public dng_image
 
 /*****************************************************************************/
 
+/// \brief Plans the reads for a set of tiles.
+///
+/// Sorts the tiles by file offset and merges tiles that are adjacent, or
+/// separated by at most a gap threshold, into runs.  Each run is fetched
+/// with a single seek and read, and the tiles in it are then decoded from
+/// slices of that read.
+
+class dng_read_planner
+	{
+	
+	private:
+	
+		const uint64 *fTileOffset;
+		
+		const uint32 *fTileByteCount;
+		
+		// Tile indices in file order.
+		
+		dng_memory_data fTileData;
+		
+		// For each run, the position in fTileData of its first tile, plus one
+		// extra entry for the end of the last run.
+		
+		dng_memory_data fRunStartData;
+		
+		// Length of each run in bytes.
+		
+		dng_memory_data fRunLengthData;
+		
+		uint32 fRunCount;
+		
+		uint32 fMaxRunLength;
+		
+	public:
+	
+		/// Plan the reads.
+		/// \param tileOffset File offset of each tile.
+		/// \param tileByteCount Byte count of each tile.
+		/// \param tiles Indices of the tiles to read, in any order.
+		/// \param tileCount Number of entries in tiles.
+		/// \param maxGap Largest gap in bytes to read through.
+		/// \param maxRunLength Largest run in bytes, except that a run always
+		/// holds at least one tile.
+	
+		dng_read_planner (const uint64 *tileOffset,
+						  const uint32 *tileByteCount,
+						  const uint32 *tiles,
+						  uint32 tileCount,
+						  uint32 maxGap,
+						  uint32 maxRunLength);
+		
+		/// Number of reads.
+		
+		uint32 RunCount () const
+			{
+			return fRunCount;
+			}
+			
+		/// Length of the longest read.
+			
+		uint32 MaxRunLength () const
+			{
+			return fMaxRunLength;
+			}
+			
+		/// File offset of a read.
+			
+		uint64 RunOffset (uint32 run) const;
+		
+		/// Length of a read in bytes.
+		
+		uint32 RunLength (uint32 run) const;
+		
+		/// Number of tiles in a read.
+		
+		uint32 RunTileCount (uint32 run) const;
+		
+		/// Tile index of the given tile of a read, in file order.
+		
+		uint32 RunTile (uint32 run,
+						uint32 index) const;
+		
+		/// Return the data of a run.  This is the stream's own memory when
+		/// dng_stream::DirectData provides it, otherwise the run is read
+		/// into buffer, which is allocated to MaxRunLength if it is too
+		/// small.  Tile tileIndex of the run starts at offset
+		/// (tileOffset [tileIndex] - RunOffset (run)).
+		
+		const uint8 * ReadRun (dng_host &host,
+							   dng_stream &stream,
+							   uint32 run,
+							   AutoPtr<dng_memory_block> &buffer) const;
+		
+	private:
+	
+		// Hidden copy constructor and assignment operator.
+	
+		dng_read_planner (const dng_read_planner &planner);
+		
+		dng_read_planner & operator= (const dng_read_planner &planner);
+		
+	};
+
+/*****************************************************************************/
+
 /// \brief
 ///
 ///
@@ -78,11 +183,17 @@ class dng_read_image
 			
 			// Target size for buffer used to copy data to the image.
 			
-			kImageBufferSize = 128 * 1024
+			kImageBufferSize = 128 * 1024,
+			
+			// Largest read used to fetch the data of several tiles at once.
+			
+			kReadRunSize = 4 * 1024 * 1024
 			
 			};
 			
 		AutoPtr<dng_memory_block> fJPEGTables;
+		
+		uint32 fJPEGScale;
 	
 	public:
 	
@@ -90,6 +201,26 @@ class dng_read_image
 		
 		virtual ~dng_read_image ();
 		
+		/// Decode baseline JPEG data at 1/scale of its stored size, using the
+		/// JPEG decoder's DCT scaling.  The image passed to Read must then have
+		/// the scaled bounds, as returned by ScaledArea for the IFD's bounds.
+		/// \param scale 1, 2, 4, or 8.  The IFD's tile (or strip) width and
+		/// height must be multiples of it.
+
+		void SetJPEGScale (uint32 scale);
+		
+		/// Getter for the JPEG scale.
+		
+		uint32 JPEGScale () const
+			{
+			return fJPEGScale;
+			}
+			
+		/// Maps an area of the IFD's image to the area it occupies when decoded
+		/// at the current JPEG scale.
+		
+		dng_rect ScaledArea (const dng_rect &area) const;
+		
 		///
 		/// \param 
 
@@ -185,3 +185,23 @@ void dng_ref_counted_block::EnsureWriteable ()
 	}
 
 /*****************************************************************************/
+
+bool dng_ref_counted_block::IsShared () const
+	{
+	
+	if (fBuffer)
+		{
+		
+		header *blockHeader = (header *)fBuffer;
+		
+		dng_lock_mutex lock (&blockHeader->fMutex);
+		
+		return blockHeader->fRefCount > 1;
+		
+		}
+		
+	return false;
+	
+	}
+
+/*****************************************************************************/
@@ -101,6 +101,10 @@ class dng_ref_counted_block
 
 		void EnsureWriteable ();
 
+		/// Is the memory buffer referenced by more than one object?
+
+		bool IsShared () const;
+
 		/// Return pointer to allocated memory as a void *..
 		/// \retval void * valid for as many bytes as were allocated.
 
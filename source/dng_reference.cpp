@@ -1848,6 +1848,222 @@ void RefBaselineRGBTone (const real32 *sPtrR,
 
 /*****************************************************************************/
 
+void RefBaselineRGBTone16 (const uint16 *sPtrR,
+						   const uint16 *sPtrG,
+						   const uint16 *sPtrB,
+						   uint16 *dPtrR,
+						   uint16 *dPtrG,
+						   uint16 *dPtrB,
+						   uint32 count,
+						   const uint16 *table)
+	{
+
+	for (uint32 col = 0; col < count; col++)
+		{
+		
+		int32 r = sPtrR [col];
+		int32 g = sPtrG [col];
+		int32 b = sPtrB [col];
+		
+		int32 rr;
+		int32 gg;
+		int32 bb;
+		
+		// Same as RefBaselineRGBTone, with the middle value interpolated
+		// using rounded integer division.  The tone table need not be
+		// monotonic, so the sign of the output range is tracked.
+		
+		#define RGBTone16(r, g, b, rr, gg, bb)\
+			{\
+			\
+			DNG_ASSERT (r >= g && g >= b && r > b, "Logic Error RGBTone16");\
+			\
+			rr = table [r];\
+			bb = table [b];\
+			\
+			int32 range = rr - bb;\
+			\
+			uint32 scaled = (uint32) Abs_int32 (range) * (uint32) (g - b);\
+			\
+			int32 delta = (int32) ((scaled + (uint32) ((r - b) >> 1)) / (uint32) (r - b));\
+			\
+			gg = (range < 0) ? bb - delta : bb + delta;\
+			\
+			}
+		
+		if (r >= g)
+			{
+			
+			if (g > b)
+				{
+				
+				// Case 1: r >= g > b
+				
+				RGBTone16 (r, g, b, rr, gg, bb);
+				
+				}
+					
+			else if (b > r)
+				{
+				
+				// Case 2: b > r >= g
+				
+				RGBTone16 (b, r, g, bb, rr, gg);
+								
+				}
+				
+			else if (b > g)
+				{
+				
+				// Case 3: r >= b > g
+				
+				RGBTone16 (r, b, g, rr, bb, gg);
+				
+				}
+				
+			else
+				{
+				
+				// Case 4: r >= g == b
+				
+				DNG_ASSERT (r >= g && g == b, "Logic Error 2");
+				
+				rr = table [r];
+				gg = table [g];
+				bb = gg;
+				
+				}
+				
+			}
+			
+		else
+			{
+			
+			if (r >= b)
+				{
+				
+				// Case 5: g > r >= b
+				
+				RGBTone16 (g, r, b, gg, rr, bb);
+				
+				}
+				
+			else if (b > g)
+				{
+				
+				// Case 6: b > g > r
+				
+				RGBTone16 (b, g, r, bb, gg, rr);
+				
+				}
+				
+			else
+				{
+				
+				// Case 7: g >= b > r
+				
+				RGBTone16 (g, b, r, gg, bb, rr);
+				
+				}
+			
+			}
+			
+		#undef RGBTone16
+		
+		dPtrR [col] = (uint16) rr;
+		dPtrG [col] = (uint16) gg;
+		dPtrB [col] = (uint16) bb;
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+void RefBaselineRGBtoGray16_8 (const uint16 *sPtrR,
+							   const uint16 *sPtrG,
+							   const uint16 *sPtrB,
+							   uint8 *dPtrG,
+							   uint32 count,
+							   const int32 *matrix,
+							   const uint8 *encodeTable)
+	{
+	
+	int32 m00 = matrix [0];
+	int32 m01 = matrix [1];
+	int32 m02 = matrix [2];
+	
+	const int32 round = 1 << (kBaselineMatrix16Shift - 1);
+	
+	for (uint32 col = 0; col < count; col++)
+		{
+		
+		int32 R = sPtrR [col];
+		int32 G = sPtrG [col];
+		int32 B = sPtrB [col];
+		
+		int32 g = m00 * R + m01 * G + m02 * B + round;
+		
+		g = Pin_int32 (0, g >> kBaselineMatrix16Shift, 0xFFFF);
+		
+		dPtrG [col] = encodeTable [g];
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+void RefBaselineRGBtoRGB16_8 (const uint16 *sPtrR,
+							  const uint16 *sPtrG,
+							  const uint16 *sPtrB,
+							  uint8 *dPtrR,
+							  uint8 *dPtrG,
+							  uint8 *dPtrB,
+							  uint32 count,
+							  const int32 *matrix,
+							  const uint8 *encodeTable)
+	{
+	
+	int32 m00 = matrix [0];
+	int32 m01 = matrix [1];
+	int32 m02 = matrix [2];
+	
+	int32 m10 = matrix [3];
+	int32 m11 = matrix [4];
+	int32 m12 = matrix [5];
+	
+	int32 m20 = matrix [6];
+	int32 m21 = matrix [7];
+	int32 m22 = matrix [8];
+	
+	const int32 round = 1 << (kBaselineMatrix16Shift - 1);
+	
+	for (uint32 col = 0; col < count; col++)
+		{
+		
+		int32 R = sPtrR [col];
+		int32 G = sPtrG [col];
+		int32 B = sPtrB [col];
+		
+		int32 r = m00 * R + m01 * G + m02 * B + round;
+		int32 g = m10 * R + m11 * G + m12 * B + round;
+		int32 b = m20 * R + m21 * G + m22 * B + round;
+		
+		r = Pin_int32 (0, r >> kBaselineMatrix16Shift, 0xFFFF);
+		g = Pin_int32 (0, g >> kBaselineMatrix16Shift, 0xFFFF);
+		b = Pin_int32 (0, b >> kBaselineMatrix16Shift, 0xFFFF);
+		
+		dPtrR [col] = encodeTable [r];
+		dPtrG [col] = encodeTable [g];
+		dPtrB [col] = encodeTable [b];
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
 void RefResampleDown16 (const uint16 *sPtr,
 						uint16 *dPtr,
 						uint32 sCount,
@@ -2779,3 +2995,145 @@ void RefMapArea16 (uint16 *dPtr,
 	}
 
 /*****************************************************************************/
+
+void RefScaleRow16 (uint16 *dPtr,
+					const real32 *scale,
+					uint32 count,
+					int32 dStep,
+					int32 scaleStep)
+	{
+	
+	const real32 kToFloat = 1.0f / (real32) 0xFFFF;
+	
+	const real32 kFromFloat = (real32) 0xFFFF;
+	
+	// The product is pinned to at most 1, and a NaN product also becomes 1,
+	// so Pin_Overrange reduces to pinning at zero.  The unit step loops are
+	// written without branches so they vectorize.
+	
+	if (dStep == 1 && scaleStep == 0)
+		{
+		
+		const real32 s = scale [0];
+		
+		for (uint32 index = 0; index < count; index++)
+			{
+			
+			real32 x = kToFloat * (real32) dPtr [index];
+			
+			real32 y = Max_real32 (Min_real32 (x * s, 1.0f), 0.0f);
+			
+			dPtr [index] = (uint16) (y * kFromFloat + 0.5f);
+			
+			}
+		
+		return;
+		
+		}
+	
+	if (dStep == 1 && scaleStep == 1)
+		{
+		
+		for (uint32 index = 0; index < count; index++)
+			{
+			
+			real32 x = kToFloat * (real32) dPtr [index];
+			
+			real32 y = Max_real32 (Min_real32 (x * scale [index], 1.0f), 0.0f);
+			
+			dPtr [index] = (uint16) (y * kFromFloat + 0.5f);
+			
+			}
+		
+		return;
+		
+		}
+	
+	for (uint32 index = 0; index < count; index++)
+		{
+		
+		real32 x = kToFloat * (real32) dPtr [0];
+		
+		real32 y = Max_real32 (Min_real32 (x * scale [0], 1.0f), 0.0f);
+		
+		dPtr [0] = (uint16) (y * kFromFloat + 0.5f);
+		
+		dPtr  += dStep;
+		scale += scaleStep;
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+void RefDeltaRow16 (uint16 *dPtr,
+					const real32 *delta,
+					uint32 count,
+					int32 dStep,
+					int32 deltaStep)
+	{
+	
+	const real32 kToFloat = 1.0f / (real32) 0xFFFF;
+	
+	const real32 kFromFloat = (real32) 0xFFFF;
+	
+	// The sum is pinned to [0,1], and a NaN sum also becomes 1, so
+	// Pin_Overrange leaves it unchanged.  The unit step loops are written
+	// without branches so they vectorize.
+	
+	if (dStep == 1 && deltaStep == 0)
+		{
+		
+		const real32 s = delta [0];
+		
+		for (uint32 index = 0; index < count; index++)
+			{
+			
+			real32 x = kToFloat * (real32) dPtr [index];
+			
+			real32 y = Pin_real32 (0.0f, x + s, 1.0f);
+			
+			dPtr [index] = (uint16) (y * kFromFloat + 0.5f);
+			
+			}
+		
+		return;
+		
+		}
+	
+	if (dStep == 1 && deltaStep == 1)
+		{
+		
+		for (uint32 index = 0; index < count; index++)
+			{
+			
+			real32 x = kToFloat * (real32) dPtr [index];
+			
+			real32 y = Pin_real32 (0.0f, x + delta [index], 1.0f);
+			
+			dPtr [index] = (uint16) (y * kFromFloat + 0.5f);
+			
+			}
+		
+		return;
+		
+		}
+	
+	for (uint32 index = 0; index < count; index++)
+		{
+		
+		real32 x = kToFloat * (real32) dPtr [0];
+		
+		real32 y = Pin_real32 (0.0f, x + delta [0], 1.0f);
+		
+		dPtr [0] = (uint16) (y * kFromFloat + 0.5f);
+		
+		dPtr  += dStep;
+		delta += deltaStep;
+		
+		}
+	
+	}
+
+/*****************************************************************************/
@@ -390,6 +390,35 @@ void RefBaselineRGBTone (const real32 *sPtrR,
 
 /*****************************************************************************/
 
+void RefBaselineRGBTone16 (const uint16 *sPtrR,
+						   const uint16 *sPtrG,
+						   const uint16 *sPtrB,
+						   uint16 *dPtrR,
+						   uint16 *dPtrG,
+						   uint16 *dPtrB,
+						   uint32 count,
+						   const uint16 *table);
+
+void RefBaselineRGBtoGray16_8 (const uint16 *sPtrR,
+							   const uint16 *sPtrG,
+							   const uint16 *sPtrB,
+							   uint8 *dPtrG,
+							   uint32 count,
+							   const int32 *matrix,
+							   const uint8 *encodeTable);
+
+void RefBaselineRGBtoRGB16_8 (const uint16 *sPtrR,
+							  const uint16 *sPtrG,
+							  const uint16 *sPtrB,
+							  uint8 *dPtrR,
+							  uint8 *dPtrG,
+							  uint8 *dPtrB,
+							  uint32 count,
+							  const int32 *matrix,
+							  const uint8 *encodeTable);
+
+/*****************************************************************************/
+
 void RefResampleDown16 (const uint16 *sPtr,
 						uint16 *dPtr,
 						uint32 sCount,
@@ -516,6 +545,20 @@ void RefMapArea16 (uint16 *dPtr,
 
 /*****************************************************************************/
 
+void RefScaleRow16 (uint16 *dPtr,
+					const real32 *scale,
+					uint32 count,
+					int32 dStep,
+					int32 scaleStep);
+
+void RefDeltaRow16 (uint16 *dPtr,
+					const real32 *delta,
+					uint32 count,
+					int32 dStep,
+					int32 deltaStep);
+
+/*****************************************************************************/
+
 #endif
 	
 /*****************************************************************************/
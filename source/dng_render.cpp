@@ -704,7 +704,54 @@ const dng_1d_function & dng_tone_curve_acr3_default::Get ()
 
 /*****************************************************************************/
 
-class dng_render_task: public dng_filter_task
+// Make the color spec for the default profile, set to the white point a render
+// with the given white point uses: that white point if valid, or else the
+// negative's as shot white balance.
+
+static dng_color_spec * MakeRenderColorSpec (const dng_negative &negative,
+											 const dng_xy_coord &whiteXY)
+	{
+	
+	AutoPtr<dng_color_spec> spec (negative.MakeColorSpec (dng_camera_profile_id ()));
+	
+	if (whiteXY.IsValid ())
+		{
+		
+		spec->SetWhiteXY (whiteXY);
+		
+		}
+						 
+	else if (negative.HasCameraNeutral ())
+		{
+		
+		spec->SetWhiteXY (spec->NeutralToXY (negative.CameraNeutral ()));
+		
+		}
+		
+	else if (negative.HasCameraWhiteXY ())
+		{
+		
+		spec->SetWhiteXY (negative.CameraWhiteXY ());
+		
+		}
+		
+	else
+		{
+		
+		spec->SetWhiteXY (D55_xy_coord ());
+		
+		}
+		
+	return spec.Release ();
+	
+	}
+
+/*****************************************************************************/
+
+// Converts the stage 3 image from camera native space to linear ProPhoto RGB,
+// applying the white balance, camera profile and hue/sat map.
+
+class dng_render_linear_task: public dng_filter_task
 	{
 	
 	protected:
@@ -720,31 +767,16 @@ class dng_render_task: public dng_filter_task
 		
 		AutoPtr<dng_hue_sat_map> fHueSatMap;
 		
-		dng_1d_table fExposureRamp;
-		
-		AutoPtr<dng_hue_sat_map> fLookTable;
-		
-		dng_1d_table fToneCurve;
-		
-		dng_matrix fRGBtoFinal;
-		
-		dng_1d_table fEncodeGamma;
-
 		AutoPtr<dng_1d_table> fHueSatMapEncode;
 		AutoPtr<dng_1d_table> fHueSatMapDecode;
-
-		AutoPtr<dng_1d_table> fLookTableEncode;
-		AutoPtr<dng_1d_table> fLookTableDecode;
-	
-		AutoPtr<dng_memory_block> fTempBuffer [kMaxMPThreads];
 		
 	public:
 	
-		dng_render_task (const dng_image &srcImage,
-						 dng_image &dstImage,
-						 const dng_negative &negative,
-						 const dng_render &params,
-						 const dng_point &srcOffset);
+		dng_render_linear_task (const dng_image &srcImage,
+								dng_image &dstImage,
+								const dng_negative &negative,
+								const dng_render &params,
+								const dng_point &srcOffset);
 	
 		virtual dng_rect SrcArea (const dng_rect &dstArea);
 			
@@ -756,16 +788,28 @@ class dng_render_task: public dng_filter_task
 		virtual void ProcessArea (uint32 threadIndex,
 								  dng_pixel_buffer &srcBuffer,
 								  dng_pixel_buffer &dstBuffer);
+								  
+	protected:
+	
+		void SetupCameraToRGB (dng_memory_allocator &allocator);
+		
+		void ConvertToLinear (const dng_pixel_buffer &srcBuffer,
+							  int32 srcRow,
+							  int32 srcCol,
+							  uint32 srcCols,
+							  real32 *dPtrR,
+							  real32 *dPtrG,
+							  real32 *dPtrB);
 		
 	};
 
 /*****************************************************************************/
 
-dng_render_task::dng_render_task (const dng_image &srcImage,
-								  dng_image &dstImage,
-								  const dng_negative &negative,
-								  const dng_render &params,
-								  const dng_point &srcOffset)
+dng_render_linear_task::dng_render_linear_task (const dng_image &srcImage,
+												dng_image &dstImage,
+												const dng_negative &negative,
+												const dng_render &params,
+												const dng_point &srcOffset)
 								  
 	:	dng_filter_task (srcImage,
 						 dstImage)
@@ -778,22 +822,9 @@ dng_render_task::dng_render_task (const dng_image &srcImage,
 	,	fCameraToRGB ()
 	
 	,	fHueSatMap ()
-	
-	,	fExposureRamp ()
-	
-	,	fLookTable ()
-	
-	,	fToneCurve ()
-	
-	,	fRGBtoFinal ()
-	
-	,	fEncodeGamma ()
 
 	,	fHueSatMapEncode ()
 	,	fHueSatMapDecode ()
-
-	,	fLookTableEncode ()
-	,	fLookTableDecode ()
 	
 	{
 	
@@ -804,7 +835,7 @@ dng_render_task::dng_render_task (const dng_image &srcImage,
 			
 /*****************************************************************************/
 
-dng_rect dng_render_task::SrcArea (const dng_rect &dstArea)
+dng_rect dng_render_linear_task::SrcArea (const dng_rect &dstArea)
 	{
 	
 	return dstArea + fSrcOffset;
@@ -813,10 +844,10 @@ dng_rect dng_render_task::SrcArea (const dng_rect &dstArea)
 	
 /*****************************************************************************/
 
-void dng_render_task::Start (uint32 threadCount,
-							 const dng_point &tileSize,
-							 dng_memory_allocator *allocator,
-							 dng_abort_sniffer *sniffer)
+void dng_render_linear_task::Start (uint32 threadCount,
+									const dng_point &tileSize,
+									dng_memory_allocator *allocator,
+									dng_abort_sniffer *sniffer)
 	{
 	
 	dng_filter_task::Start (threadCount,
@@ -824,6 +855,15 @@ void dng_render_task::Start (uint32 threadCount,
 							allocator,
 							sniffer);
 							
+	SetupCameraToRGB (*allocator);
+	
+	}
+	
+/*****************************************************************************/
+
+void dng_render_linear_task::SetupCameraToRGB (dng_memory_allocator &allocator)
+	{
+	
 	// Compute camera space to linear ProPhoto RGB parameters.
 	
 	dng_camera_profile_id profileID;	// Default profile ID.
@@ -831,67 +871,383 @@ void dng_render_task::Start (uint32 threadCount,
 	if (!fNegative.IsMonochrome ())
 		{
 		
-		AutoPtr<dng_color_spec> spec (fNegative.MakeColorSpec (profileID));
+		AutoPtr<dng_color_spec> spec (MakeRenderColorSpec (fNegative,
+														   fParams.WhiteXY ()));
+			
+		fCameraWhite = spec->CameraWhite ();
 		
-		if (fParams.WhiteXY ().IsValid ())
+		fCameraToRGB = dng_space_ProPhoto::Get ().MatrixFromPCS () *
+					   spec->CameraToPCS ();
+					   
+		// Find Hue/Sat table, if any.
+		
+		const dng_camera_profile *profile = fNegative.ProfileByID (profileID);
+		
+		if (profile)
 			{
 			
-			spec->SetWhiteXY (fParams.WhiteXY ());
+			fHueSatMap.Reset (profile->HueSatMapForWhite (spec->WhiteXY ()));
+			
+			if (profile->HueSatMapEncoding () != encoding_Linear)
+				{
+					
+				BuildHueSatMapEncodingTable (allocator,
+											 profile->HueSatMapEncoding (),
+											 fHueSatMapEncode,
+											 fHueSatMapDecode,
+											 false);
+					
+				}
 			
 			}
-							 
-		else if (fNegative.HasCameraNeutral ())
+		
+		}
+		
+	}
+							
+/*****************************************************************************/
+
+void dng_render_linear_task::ConvertToLinear (const dng_pixel_buffer &srcBuffer,
+											  int32 srcRow,
+											  int32 srcCol,
+											  uint32 srcCols,
+											  real32 *dPtrR,
+											  real32 *dPtrG,
+											  real32 *dPtrB)
+	{
+	
+	const real32 *sPtrA = (const real32 *)
+						  srcBuffer.ConstPixel (srcRow,
+											    srcCol,
+											    0);
+											   
+	if (fSrcPlanes == 1)
+		{
+		
+		// For monochrome cameras, this just requires copying
+		// the data into all three color channels.
+		
+		DoCopyBytes (sPtrA, dPtrR, srcCols * (uint32) sizeof (real32));
+		DoCopyBytes (sPtrA, dPtrG, srcCols * (uint32) sizeof (real32));
+		DoCopyBytes (sPtrA, dPtrB, srcCols * (uint32) sizeof (real32));
+		
+		}
+		
+	else
+		{
+		
+		const real32 *sPtrB = sPtrA + srcBuffer.fPlaneStep;
+		const real32 *sPtrC = sPtrB + srcBuffer.fPlaneStep;
+		
+		if (fSrcPlanes == 3)
 			{
 			
-			spec->SetWhiteXY (spec->NeutralToXY (fNegative.CameraNeutral ()));
+			DoBaselineABCtoRGB (sPtrA,
+							    sPtrB,
+							    sPtrC,
+							    dPtrR,
+							    dPtrG,
+							    dPtrB,
+							    srcCols,
+							    fCameraWhite,
+							    fCameraToRGB);
 			
 			}
 			
-		else if (fNegative.HasCameraWhiteXY ())
+		else
 			{
 			
-			spec->SetWhiteXY (fNegative.CameraWhiteXY ());
+			const real32 *sPtrD = sPtrC + srcBuffer.fPlaneStep;
+		
+			DoBaselineABCDtoRGB (sPtrA,
+							     sPtrB,
+							     sPtrC,
+							     sPtrD,
+							     dPtrR,
+							     dPtrG,
+							     dPtrB,
+							     srcCols,
+							     fCameraWhite,
+							     fCameraToRGB);
 			
 			}
 			
-		else
+		// Apply Hue/Sat map, if any.
+		
+		if (fHueSatMap.Get ())
+			{
+			
+			DoBaselineHueSatMap (dPtrR,
+								 dPtrG,
+								 dPtrB,
+								 dPtrR,
+								 dPtrG,
+								 dPtrB,
+								 srcCols,
+								 *fHueSatMap.Get (),
+								 fHueSatMapEncode.Get (),
+								 fHueSatMapDecode.Get ());
+			
+			}
+		
+		}
+		
+	}
+							
+/*****************************************************************************/
+
+void dng_render_linear_task::ProcessArea (uint32 /* threadIndex */,
+										  dng_pixel_buffer &srcBuffer,
+										  dng_pixel_buffer &dstBuffer)
+	{
+	
+	dng_rect srcArea = srcBuffer.fArea;
+	dng_rect dstArea = dstBuffer.fArea;
+	
+	uint32 srcCols = srcArea.W ();
+	
+	for (int32 srcRow = srcArea.t; srcRow < srcArea.b; srcRow++)
+		{
+		
+		int32 dstRow = srcRow + (dstArea.t - srcArea.t);
+		
+		real32 *dPtrR = dstBuffer.DirtyPixel_real32 (dstRow,
+													 dstArea.l,
+													 0);
+													 
+		// Monochrome images keep a single plane.
+		
+		if (fDstPlanes == 1)
+			{
+			
+			DoCopyBytes (srcBuffer.ConstPixel (srcRow, srcArea.l, 0),
+						 dPtrR,
+						 srcCols * (uint32) sizeof (real32));
+			
+			continue;
+			
+			}
+		
+		real32 *dPtrG = dPtrR + dstBuffer.fPlaneStep;
+		real32 *dPtrB = dPtrG + dstBuffer.fPlaneStep;
+		
+		ConvertToLinear (srcBuffer,
+						 srcRow,
+						 srcArea.l,
+						 srcCols,
+						 dPtrR,
+						 dPtrG,
+						 dPtrB);
+		
+		}
+	
+	}
+		
+/*****************************************************************************/
+
+// Renders either the stage 3 image, or its linear ProPhoto RGB version made
+// by dng_render_linear_task, to the final space.
+
+class dng_render_task: public dng_render_linear_task
+	{
+	
+	protected:
+	
+		bool fLinearSource;
+		
+		dng_1d_table fExposureRamp;
+		
+		AutoPtr<dng_hue_sat_map> fLookTable;
+		
+		dng_1d_table fToneCurve;
+		
+		dng_matrix fRGBtoFinal;
+		
+		dng_1d_table fEncodeGamma;
+
+		AutoPtr<dng_1d_table> fLookTableEncode;
+		AutoPtr<dng_1d_table> fLookTableDecode;
+	
+		AutoPtr<dng_memory_block> fTempBuffer [kMaxMPThreads];
+		
+		// Fixed-point versions of the tone curve, final space matrix and
+		// gamma encoding, used for 8-bit output.
+		
+		bool fFixedPoint;
+		
+		int32 fRGBtoFinal16 [9];
+		
+		AutoPtr<dng_memory_block> fToneTable16;
+		AutoPtr<dng_memory_block> fEncodeTable8;
+		
+		AutoPtr<dng_memory_block> fTempBuffer16 [kMaxMPThreads];
+		
+	public:
+	
+		dng_render_task (const dng_image &srcImage,
+						 dng_image &dstImage,
+						 const dng_negative &negative,
+						 const dng_render &params,
+						 const dng_point &srcOffset,
+						 bool linearSource = false);
+	
+		virtual void Start (uint32 threadCount,
+							const dng_point &tileSize,
+							dng_memory_allocator *allocator,
+							dng_abort_sniffer *sniffer);
+							
+		virtual void ProcessArea (uint32 threadIndex,
+								  dng_pixel_buffer &srcBuffer,
+								  dng_pixel_buffer &dstBuffer);
+								  
+	protected:
+	
+		static bool ConvertMatrix16 (const dng_matrix &matrix,
+									 int32 *result);
+		
+	};
+
+/*****************************************************************************/
+
+dng_render_task::dng_render_task (const dng_image &srcImage,
+								  dng_image &dstImage,
+								  const dng_negative &negative,
+								  const dng_render &params,
+								  const dng_point &srcOffset,
+								  bool linearSource)
+								  
+	:	dng_render_linear_task (srcImage,
+								dstImage,
+								negative,
+								params,
+								srcOffset)
+						 
+	,	fLinearSource (linearSource)
+	
+	,	fExposureRamp ()
+	
+	,	fLookTable ()
+	
+	,	fToneCurve ()
+	
+	,	fRGBtoFinal ()
+	
+	,	fEncodeGamma ()
+
+	,	fLookTableEncode ()
+	,	fLookTableDecode ()
+	
+	,	fFixedPoint (false)
+	
+	,	fToneTable16  ()
+	,	fEncodeTable8 ()
+	
+	{
+	
+	// The fixed-point path writes bytes directly, and needs the final space
+	// matrix to fit the 32-bit accumulators of the 16-bit kernels.
+	
+	if (params.FixedPoint () && dstImage.PixelType () == ttByte)
+		{
+		
+		dng_matrix rgbToFinal = params.FinalSpace ().MatrixFromPCS () *
+								dng_space_ProPhoto::Get ().MatrixToPCS ();
+								
+		fFixedPoint = ConvertMatrix16 (rgbToFinal, fRGBtoFinal16);
+		
+		if (fFixedPoint)
 			{
 			
-			spec->SetWhiteXY (D55_xy_coord ());
+			fDstPixelType = ttByte;
 			
 			}
+		
+		}
+	
+	}
 			
-		fCameraWhite = spec->CameraWhite ();
+/*****************************************************************************/
+
+bool dng_render_task::ConvertMatrix16 (const dng_matrix &matrix,
+									   int32 *result)
+	{
+	
+	const real64 scale = (real64) (1 << kBaselineMatrix16Shift);
+	
+	// Largest row sum that cannot overflow int32 with 16-bit inputs.
+	
+	const real64 limit = (2147483647.0 - scale) / (65535.0 * scale);
+	
+	// Gray final spaces have a single row.
+	
+	if (matrix.Cols () != 3 || matrix.Rows () > 3)
+		{
+		return false;
+		}
+	
+	for (uint32 row = 0; row < 3; row++)
+		{
+		
+		real64 total = 0.0;
+		
+		for (uint32 col = 0; col < 3; col++)
+			{
+			
+			real64 coef = row < matrix.Rows () ? matrix [row] [col] : 0.0;
+			
+			total += Abs_real64 (coef);
+			
+			if (total >= limit)
+				{
+				return false;
+				}
+			
+			result [row * 3 + col] = Round_int32 (coef * scale);
+			
+			}
+			
+		}
+		
+	return true;
+	
+	}
+			
+/*****************************************************************************/
+
+void dng_render_task::Start (uint32 threadCount,
+							 const dng_point &tileSize,
+							 dng_memory_allocator *allocator,
+							 dng_abort_sniffer *sniffer)
+	{
+	
+	dng_filter_task::Start (threadCount,
+							tileSize,
+							allocator,
+							sniffer);
+							
+	// A linear source has already been through the camera profile and
+	// hue/sat map.
+	
+	if (!fLinearSource)
+		{
+		
+		SetupCameraToRGB (*allocator);
 		
-		fCameraToRGB = dng_space_ProPhoto::Get ().MatrixFromPCS () *
-					   spec->CameraToPCS ();
-					   
-		// Find Hue/Sat table, if any.
+		}
+							
+	dng_camera_profile_id profileID;	// Default profile ID.
+	
+	// Find look table, if any.
+		
+	if (!fNegative.IsMonochrome ())
+		{
 		
 		const dng_camera_profile *profile = fNegative.ProfileByID (profileID);
 		
-		if (profile)
+		if (profile && profile->HasLookTable ())
 			{
 			
-			fHueSatMap.Reset (profile->HueSatMapForWhite (spec->WhiteXY ()));
-			
-			if (profile->HasLookTable ())
-				{
-				
-				fLookTable.Reset (new dng_hue_sat_map (profile->LookTable ()));
-				
-				}
-
-			if (profile->HueSatMapEncoding () != encoding_Linear)
-				{
-					
-				BuildHueSatMapEncodingTable (*allocator,
-											 profile->HueSatMapEncoding (),
-											 fHueSatMapEncode,
-											 fHueSatMapDecode,
-											 false);
-					
-				}
+			fLookTable.Reset (new dng_hue_sat_map (profile->LookTable ()));
 			
 			if (profile->LookTableEncoding () != encoding_Linear)
 				{
@@ -981,6 +1337,42 @@ void dng_render_task::Start (uint32 threadCount,
 		fTempBuffer [threadIndex] . Reset (allocator->Allocate (tempBufferSize));
 		
 		}
+		
+	// Sample the tone curve and gamma encoding at every 16-bit value for the
+	// fixed-point path.
+		
+	if (fFixedPoint)
+		{
+		
+		fToneTable16 .Reset (allocator->Allocate (0x10000 * (uint32) sizeof (uint16)));
+		fEncodeTable8.Reset (allocator->Allocate (0x10000 * (uint32) sizeof (uint8 )));
+		
+		uint16 *toneTable   = fToneTable16 ->Buffer_uint16 ();
+		uint8  *encodeTable = fEncodeTable8->Buffer_uint8  ();
+		
+		for (uint32 index = 0; index <= 0xFFFF; index++)
+			{
+			
+			real32 x = (real32) index * (1.0f / 65535.0f);
+			
+			real32 tone = Pin_real32 (0.0f, fToneCurve.Interpolate (x), 1.0f);
+			
+			toneTable [index] = (uint16) (tone * 65535.0f + 0.5f);
+			
+			real32 encode = Pin_real32 (0.0f, fEncodeGamma.Interpolate (x), 1.0f);
+			
+			encodeTable [index] = (uint8) (encode * 255.0f + 0.5f);
+			
+			}
+			
+		for (uint32 threadIndex = 0; threadIndex < threadCount; threadIndex++)
+			{
+			
+			fTempBuffer16 [threadIndex] . Reset (allocator->Allocate (tempBufferSize / 2));
+			
+			}
+		
+		}
 
 	}
 							
@@ -1004,105 +1396,77 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 	for (int32 srcRow = srcArea.t; srcRow < srcArea.b; srcRow++)
 		{
 		
-		// First convert from camera native space to linear PhotoRGB,
-		// applying the white balance and camera profile.
-		
+		if (fLinearSource)
 			{
-		
-			const real32 *sPtrA = (const real32 *)
+			
+			// The source is already linear ProPhoto RGB (or monochrome),
+			// so the exposure curve can read it directly.
+			
+			const real32 *sPtrR = (const real32 *)
 								  srcBuffer.ConstPixel (srcRow,
 													    srcArea.l,
 													    0);
 													   
-			if (fSrcPlanes == 1)
-				{
-				
-				// For monochrome cameras, this just requires copying
-				// the data into all three color channels.
-				
-				DoCopyBytes (sPtrA, tPtrR, srcCols * (uint32) sizeof (real32));
-				DoCopyBytes (sPtrA, tPtrG, srcCols * (uint32) sizeof (real32));
-				DoCopyBytes (sPtrA, tPtrB, srcCols * (uint32) sizeof (real32));
-				
-				}
-				
-			else
+			const real32 *sPtrG = sPtrR;
+			const real32 *sPtrB = sPtrR;
+			
+			if (fSrcPlanes != 1)
 				{
 				
-				const real32 *sPtrB = sPtrA + srcBuffer.fPlaneStep;
-				const real32 *sPtrC = sPtrB + srcBuffer.fPlaneStep;
-				
-				if (fSrcPlanes == 3)
-					{
-					
-					DoBaselineABCtoRGB (sPtrA,
-									    sPtrB,
-									    sPtrC,
-									    tPtrR,
-									    tPtrG,
-									    tPtrB,
-									    srcCols,
-									    fCameraWhite,
-									    fCameraToRGB);
-					
-					}
-					
-				else
-					{
-					
-					const real32 *sPtrD = sPtrC + srcBuffer.fPlaneStep;
-				
-					DoBaselineABCDtoRGB (sPtrA,
-									     sPtrB,
-									     sPtrC,
-									     sPtrD,
-									     tPtrR,
-									     tPtrG,
-									     tPtrB,
-									     srcCols,
-									     fCameraWhite,
-									     fCameraToRGB);
-					
-					}
-					
-				// Apply Hue/Sat map, if any.
-				
-				if (fHueSatMap.Get ())
-					{
-					
-					DoBaselineHueSatMap (tPtrR,
-										 tPtrG,
-										 tPtrB,
-										 tPtrR,
-										 tPtrG,
-										 tPtrB,
-										 srcCols,
-										 *fHueSatMap.Get (),
-										 fHueSatMapEncode.Get (),
-										 fHueSatMapDecode.Get ());
-					
-					}
+				sPtrG = sPtrR + srcBuffer.fPlaneStep;
+				sPtrB = sPtrG + srcBuffer.fPlaneStep;
 				
 				}
 				
+			DoBaseline1DTable (sPtrR,
+							   tPtrR,
+							   srcCols,
+							   fExposureRamp);
+									
+			DoBaseline1DTable (sPtrG,
+							   tPtrG,
+							   srcCols,
+							   fExposureRamp);
+									
+			DoBaseline1DTable (sPtrB,
+							   tPtrB,
+							   srcCols,
+							   fExposureRamp);
+			
 			}
 			
-		// Apply exposure curve.
-		
-		DoBaseline1DTable (tPtrR,
-						   tPtrR,
-						   srcCols,
-						   fExposureRamp);
-								
-		DoBaseline1DTable (tPtrG,
-						   tPtrG,
-						   srcCols,
-						   fExposureRamp);
-								
-		DoBaseline1DTable (tPtrB,
-						   tPtrB,
-						   srcCols,
-						   fExposureRamp);
+		else
+			{
+			
+			// First convert from camera native space to linear PhotoRGB,
+			// applying the white balance and camera profile.
+			
+			ConvertToLinear (srcBuffer,
+							 srcRow,
+							 srcArea.l,
+							 srcCols,
+							 tPtrR,
+							 tPtrG,
+							 tPtrB);
+				
+			// Apply exposure curve.
+			
+			DoBaseline1DTable (tPtrR,
+							   tPtrR,
+							   srcCols,
+							   fExposureRamp);
+									
+			DoBaseline1DTable (tPtrG,
+							   tPtrG,
+							   srcCols,
+							   fExposureRamp);
+									
+			DoBaseline1DTable (tPtrB,
+							   tPtrB,
+							   srcCols,
+							   fExposureRamp);
+							   
+			}
 		
 		// Apply look table, if any.
 		
@@ -1122,6 +1486,80 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 			
 			}
 
+		int32 dstRow = srcRow + (dstArea.t - srcArea.t);
+		
+		if (fFixedPoint)
+			{
+			
+			uint16 *qPtrR = fTempBuffer16 [threadIndex]->Buffer_uint16 ();
+			
+			uint16 *qPtrG = qPtrR + srcCols;
+			uint16 *qPtrB = qPtrG + srcCols;
+			
+			// Quantize to 16 bits, then apply baseline tone curve, convert
+			// to the final color space and gamma encode in fixed point.
+			
+			DoCopyAreaR32_16 (tPtrR,
+							  qPtrR,
+							  1,
+							  srcCols,
+							  3,
+							  0,
+							  1,
+							  srcCols,
+							  0,
+							  1,
+							  srcCols,
+							  0xFFFF);
+							  
+			DoBaselineRGBTone16 (qPtrR,
+								 qPtrG,
+								 qPtrB,
+								 qPtrR,
+								 qPtrG,
+								 qPtrB,
+								 srcCols,
+								 fToneTable16->Buffer_uint16 ());
+			
+			uint8 *dPtrR = dstBuffer.DirtyPixel_uint8 (dstRow,
+													   dstArea.l,
+													   0);
+			
+			if (fDstPlanes == 1)
+				{
+				
+				DoBaselineRGBtoGray16_8 (qPtrR,
+										 qPtrG,
+										 qPtrB,
+										 dPtrR,
+										 srcCols,
+										 fRGBtoFinal16,
+										 fEncodeTable8->Buffer_uint8 ());
+				
+				}
+				
+			else
+				{
+				
+				uint8 *dPtrG = dPtrR + dstBuffer.fPlaneStep;
+				uint8 *dPtrB = dPtrG + dstBuffer.fPlaneStep;
+				
+				DoBaselineRGBtoRGB16_8 (qPtrR,
+										qPtrG,
+										qPtrB,
+										dPtrR,
+										dPtrG,
+										dPtrB,
+										srcCols,
+										fRGBtoFinal16,
+										fEncodeTable8->Buffer_uint8 ());
+				
+				}
+				
+			continue;
+			
+			}
+			
 		// Apply baseline tone curve.
 		
 		DoBaselineRGBTone (tPtrR,
@@ -1135,8 +1573,6 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 						   
 		// Convert to final color space.
 		
-		int32 dstRow = srcRow + (dstArea.t - srcArea.t);
-		
 		if (fDstPlanes == 1)
 			{
 			
@@ -1200,6 +1636,181 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 		
 /*****************************************************************************/
 
+dng_render_cache::dng_render_cache ()
+
+	:	fStage3Serial			(0)
+	,	fProfileFingerprint		()
+	,	fHueSatMapFingerprint	()
+	,	fLookTableFingerprint	()
+	,	fSrcBounds				()
+	,	fDstSize				()
+	,	fWhiteXY				()
+	,	fCameraWhite			()
+	,	fCameraToPCS			()
+	,	fImage					()
+	
+	{
+	
+	}
+
+/*****************************************************************************/
+
+dng_render_cache::~dng_render_cache ()
+	{
+	
+	}
+
+/*****************************************************************************/
+
+void dng_render_cache::Clear ()
+	{
+	
+	fImage.Reset ();
+	
+	fStage3Serial = 0;
+	
+	fProfileFingerprint  .Clear ();
+	fHueSatMapFingerprint.Clear ();
+	fLookTableFingerprint.Clear ();
+	
+	}
+
+/*****************************************************************************/
+
+// The profile used by dng_render, or NULL if none.
+
+static const dng_camera_profile * RenderProfile (const dng_negative &negative)
+	{
+	
+	return negative.ProfileByID (dng_camera_profile_id ());
+	
+	}
+
+/*****************************************************************************/
+
+// The white point and camera color the linear task renders with.  These
+// cover the white balance, analog balance, camera calibration and color
+// matrices, which can change without a new stage 3 image.
+
+static void RenderColorKey (const dng_negative &negative,
+							const dng_xy_coord &renderWhiteXY,
+							dng_xy_coord &whiteXY,
+							dng_vector &cameraWhite,
+							dng_matrix &cameraToPCS)
+	{
+	
+	if (negative.IsMonochrome ())
+		{
+		
+		whiteXY     = dng_xy_coord ();
+		cameraWhite = dng_vector   ();
+		cameraToPCS = dng_matrix   ();
+		
+		return;
+		
+		}
+		
+	AutoPtr<dng_color_spec> spec (MakeRenderColorSpec (negative,
+													   renderWhiteXY));
+	
+	whiteXY     = spec->WhiteXY     ();
+	cameraWhite = spec->CameraWhite ();
+	cameraToPCS = spec->CameraToPCS ();
+	
+	}
+
+/*****************************************************************************/
+
+bool dng_render_cache::Matches (const dng_negative &negative,
+								const dng_rect &srcBounds,
+								const dng_point &dstSize,
+								const dng_xy_coord &renderWhiteXY) const
+	{
+	
+	if (!fImage.Get ()										||
+		fStage3Serial == 0									||
+		fStage3Serial != negative.Stage3Serial ()			||
+		fSrcBounds    != srcBounds							||
+		fDstSize      != dstSize)
+		{
+		return false;
+		}
+		
+	dng_xy_coord whiteXY;
+	dng_vector   cameraWhite;
+	dng_matrix   cameraToPCS;
+	
+	RenderColorKey (negative,
+					renderWhiteXY,
+					whiteXY,
+					cameraWhite,
+					cameraToPCS);
+					
+	if (fWhiteXY     != whiteXY     ||
+		fCameraWhite != cameraWhite ||
+		fCameraToPCS != cameraToPCS)
+		{
+		return false;
+		}
+		
+	const dng_camera_profile *profile = RenderProfile (negative);
+	
+	if (!profile)
+		{
+		
+		return !fProfileFingerprint.IsValid ();
+		
+		}
+		
+	return fProfileFingerprint   == profile->Fingerprint          () &&
+		   fHueSatMapFingerprint == profile->HueSatMapFingerprint () &&
+		   fLookTableFingerprint == profile->LookTableFingerprint ();
+	
+	}
+
+/*****************************************************************************/
+
+void dng_render_cache::SetKey (const dng_negative &negative,
+							   const dng_rect &srcBounds,
+							   const dng_point &dstSize,
+							   const dng_xy_coord &renderWhiteXY)
+	{
+	
+	fStage3Serial = negative.Stage3Serial ();
+	
+	fSrcBounds = srcBounds;
+	fDstSize   = dstSize;
+	
+	RenderColorKey (negative,
+					renderWhiteXY,
+					fWhiteXY,
+					fCameraWhite,
+					fCameraToPCS);
+	
+	const dng_camera_profile *profile = RenderProfile (negative);
+	
+	if (profile)
+		{
+		
+		fProfileFingerprint   = profile->Fingerprint          ();
+		fHueSatMapFingerprint = profile->HueSatMapFingerprint ();
+		fLookTableFingerprint = profile->LookTableFingerprint ();
+		
+		}
+		
+	else
+		{
+		
+		fProfileFingerprint  .Clear ();
+		fHueSatMapFingerprint.Clear ();
+		fLookTableFingerprint.Clear ();
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
 dng_render::dng_render (dng_host &host,
 						const dng_negative &negative)
 
@@ -1216,8 +1827,12 @@ dng_render::dng_render (dng_host &host,
 	,	fFinalSpace		(&dng_space_sRGB::Get ())
 	,	fFinalPixelType (ttByte)
 	
+	,	fFixedPoint		(false)
+	
 	,	fMaximumSize	(0)
 	
+	,	fCache			(NULL)
+	
 	,	fProfileToneCurve ()
 	
 	{
@@ -1297,6 +1912,92 @@ dng_image * dng_render::Render ()
 		
 		}
 		
+	// If the negative was read with a window, only render the part of the
+	// default crop within the area of interest.
+	
+	if (fNegative.IsWindowed ())
+		{
+		
+		dng_rect cropArea = srcBounds;
+		
+		srcBounds = srcBounds & fNegative.AreaOfInterest (3);
+		
+		if (srcBounds.IsEmpty ())
+			{
+			ThrowProgramError ("Area of interest outside default crop");
+			}
+			
+		dstSize.v = Max_uint32 (1, Round_uint32 (dstSize.v * (real64) srcBounds.H () /
+																(real64) cropArea.H ()));
+																
+		dstSize.h = Max_uint32 (1, Round_uint32 (dstSize.h * (real64) srcBounds.W () /
+																(real64) cropArea.W ()));
+		
+		}
+		
+	// If only the parameters applied after the linear ProPhoto RGB stage
+	// changed since the cache was filled, start from the cached image.
+	
+	bool linearSource = false;
+	
+	if (fCache)
+		{
+		
+		if (!fCache->Matches (fNegative, srcBounds, dstSize, fWhiteXY))
+			{
+			
+			fCache->Clear ();
+			
+			AutoPtr<dng_image> tempImage;
+	
+			if (srcBounds.Size () != dstSize)
+				{
+		
+				tempImage.Reset (fHost.Make_dng_image (dstSize,
+													   srcImage->Planes    (),
+													   srcImage->PixelType ()));
+													 
+				ResampleImage (fHost,
+							   *srcImage,
+							   *tempImage.Get (),
+							   srcBounds,
+							   tempImage->Bounds (),
+							   dng_resample_bicubic::Get ());
+								   
+				srcImage = tempImage.Get ();
+				
+				}
+				
+			uint32 linearPlanes = srcImage->Planes () == 1 ? 1 : 3;
+			
+			AutoPtr<dng_image> linearImage (fHost.Make_dng_image (dstSize,
+																  linearPlanes,
+																  ttFloat));
+																  
+			dng_render_linear_task linearTask (*srcImage,
+											   *linearImage.Get (),
+											   fNegative,
+											   *this,
+											   tempImage.Get () ? dng_point ()
+																: srcBounds.TL ());
+											   
+			fHost.PerformAreaTask (linearTask,
+								   linearImage->Bounds ());
+								   
+			fCache->fImage.Reset (linearImage.Release ());
+			
+			fCache->SetKey (fNegative, srcBounds, dstSize, fWhiteXY);
+			
+			}
+			
+		srcImage = fCache->fImage.Get ();
+		
+		srcBounds = srcImage->Bounds ();
+		
+		linearSource = true;
+		
+		}
+		
 	AutoPtr<dng_image> tempImage;
 	
 	if (srcBounds.Size () != dstSize)
@@ -1329,7 +2030,8 @@ dng_image * dng_render::Render ()
 						  *dstImage.Get (),
 						  fNegative,
 						  *this,
-						  srcBounds.TL ());
+						  srcBounds.TL (),
+						  linearSource);
 						  
 	fHost.PerformAreaTask (task,
 						   dstImage->Bounds ());
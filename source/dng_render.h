@@ -25,6 +25,10 @@
 #include "dng_1d_function.h"
 #include "dng_auto_ptr.h"
 #include "dng_classes.h"
+#include "dng_fingerprint.h"
+#include "dng_matrix.h"
+#include "dng_point.h"
+#include "dng_rect.h"
 #include "dng_spline.h"
 #include "dng_xy_coord.h"
 
@@ -126,6 +130,91 @@ class dng_function_gamma_encode: public dng_1d_function
 
 /*****************************************************************************/
 
+/// \brief Holds the linear ProPhoto RGB intermediate of a rendered negative, that
+/// is the stage 3 image after white balance, the camera profile matrix and hue/sat
+/// map, cropped and resized.  A dng_render given this cache skips those steps
+/// when only the exposure, shadows, tone curve, final space or pixel type
+/// changed since the cache was filled, and rebuilds the intermediate otherwise.
+
+class dng_render_cache
+	{
+	
+	friend class dng_render;
+	
+	private:
+	
+		// What the cached image was built from.  The stage 3 serial number
+		// identifies both the negative and its stage 3 image contents, and
+		// is never reused once either is destroyed or replaced.
+	
+		uint64 fStage3Serial;
+		
+		dng_fingerprint fProfileFingerprint;
+		
+		dng_fingerprint fHueSatMapFingerprint;
+		
+		dng_fingerprint fLookTableFingerprint;
+		
+		dng_rect fSrcBounds;
+		
+		dng_point fDstSize;
+		
+		// The white point and camera color rendered with, which follow the
+		// negative's white balance, analog balance and calibration when the
+		// render does not set a white point.
+		
+		dng_xy_coord fWhiteXY;
+		
+		dng_vector fCameraWhite;
+		
+		dng_matrix fCameraToPCS;
+		
+		// The linear image, as 32-bit floats, with one plane for monochrome
+		// negatives and three otherwise.
+		
+		AutoPtr<dng_image> fImage;
+		
+	public:
+	
+		dng_render_cache ();
+		
+		~dng_render_cache ();
+		
+		/// Discard the cached image.  Not required for correctness, since a
+		/// cache built from another stage 3 image or profile is never used,
+		/// but releases the memory.
+		
+		void Clear ();
+		
+		/// Is there a cached image?
+		
+		bool IsValid () const
+			{
+			return fImage.Get () != NULL;
+			}
+			
+	private:
+	
+		bool Matches (const dng_negative &negative,
+					  const dng_rect &srcBounds,
+					  const dng_point &dstSize,
+					  const dng_xy_coord &renderWhiteXY) const;
+
+		void SetKey (const dng_negative &negative,
+					 const dng_rect &srcBounds,
+					 const dng_point &dstSize,
+					 const dng_xy_coord &renderWhiteXY);
+	
+		// Hidden copy constructor and assignment operator.
+
+		dng_render_cache (const dng_render_cache &cache);
+
+		dng_render_cache & operator= (const dng_render_cache &cache);
+		
+	};
+
+/*****************************************************************************/
+
 /// \brief Class used to render digital negative to displayable image.
 
 class dng_render
@@ -149,8 +238,12 @@ class dng_render
 		
 		uint32 fFinalPixelType;
 		
+		bool fFixedPoint;
+		
 		uint32 fMaximumSize;
 		
+		dng_render_cache *fCache;
+		
 	private:
 	
 		AutoPtr<dng_spline_solver> fProfileToneCurve;
@@ -266,6 +359,25 @@ class dng_render
 			{
 			return fFinalPixelType;
 			}
+			
+		/// Use 16-bit fixed-point arithmetic for the tone curve, final color
+		/// space conversion and gamma encoding.  Only used when the final pixel
+		/// type is ttByte.  Results are within one code value of the floating
+		/// point path, or two in the deep shadows of Adobe RGB.
+		/// \param fixedPoint True to enable fixed-point rendering.
+
+		void SetFixedPoint (bool fixedPoint)
+			{
+			fFixedPoint = fixedPoint;
+			}
+			
+		/// Get flag for fixed-point rendering of 8-bit images.
+		/// \retval True if fixed-point rendering is enabled.
+
+		bool FixedPoint () const
+			{
+			return fFixedPoint;
+			}
 
 		/// Set maximum dimension, in pixels, of resulting image.
 		/// If final image would have either dimension larger than maximum, the larger
@@ -289,6 +401,24 @@ class dng_render
 			return fMaximumSize;
 			}
 
+		/// Set a cache for the linear intermediate image, to be reused by later
+		/// renders of the same negative.  The cache is owned by the caller and
+		/// must outlive this dng_render.
+		/// \param cache Cache to use, or NULL for none (the default).
+		
+		void SetCache (dng_render_cache *cache)
+			{
+			fCache = cache;
+			}
+			
+		/// Get the cache for the linear intermediate image.
+		/// \retval Cache in use, or NULL.
+		
+		dng_render_cache * Cache () const
+			{
+			return fCache;
+			}
+
 		/// Actually render a digital negative to a displayable image.
 		/// Input digital negative is passed to the constructor of this dng_render class.
 		/// \retval The final resulting image.
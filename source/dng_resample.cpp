@@ -511,6 +511,11 @@ class dng_resample_task: public dng_filter_task
 						   const dng_rect &dstBounds,
 						   const dng_resample_function &kernel);
 	
+		virtual bool ReusesSourceOverlap () const
+			{
+			return true;
+			}
+			
 		virtual dng_rect SrcArea (const dng_rect &dstArea);
 			
 		virtual dng_point SrcTileSize (const dng_point &dstTileSize);
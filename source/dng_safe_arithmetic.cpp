@@ -84,6 +84,16 @@ std::uint32_t SafeUint32Add(std::uint32_t arg1, std::uint32_t arg2) {
   return SafeAdd<std::uint32_t>(arg1, arg2);
 }
 
+bool SafeUint64Add(std::uint64_t arg1, std::uint64_t arg2,
+                   std::uint64_t *result) {
+  try {
+    *result = SafeUint64Add(arg1, arg2);
+    return true;
+  } catch (const dng_exception &) {
+    return false;
+  }
+}
+
 std::uint64_t SafeUint64Add(std::uint64_t arg1, std::uint64_t arg2) {
   return SafeAdd<std::uint64_t>(arg1, arg2);
 }
@@ -161,6 +171,35 @@ std::uint32_t SafeUint32Mult(std::uint32_t arg1, std::uint32_t arg2,
   return SafeUint32Mult(SafeUint32Mult(arg1, arg2, arg3), arg4);
 }
 
+bool SafeUint64Mult(std::uint64_t arg1, std::uint64_t arg2,
+                    std::uint64_t *result) {
+  try {
+    *result = SafeUint64Mult(arg1, arg2);
+    return true;
+  } catch (const dng_exception &) {
+    return false;
+  }
+}
+
+bool SafeUint64Mult(std::uint64_t arg1, std::uint64_t arg2, std::uint64_t arg3,
+                    std::uint64_t *result) {
+  try {
+    *result = SafeUint64Mult(arg1, arg2, arg3);
+    return true;
+  } catch (const dng_exception &) {
+    return false;
+  }
+}
+
+std::uint64_t SafeUint64Mult(std::uint64_t arg1, std::uint64_t arg2) {
+  return SafeUnsignedMult<std::uint64_t>(arg1, arg2);
+}
+
+std::uint64_t SafeUint64Mult(std::uint64_t arg1, std::uint64_t arg2,
+                             std::uint64_t arg3) {
+  return SafeUint64Mult(SafeUint64Mult(arg1, arg2), arg3);
+}
+
 std::int32_t SafeInt32Mult(std::int32_t arg1, std::int32_t arg2) {
   const std::int64_t tmp =
       static_cast<std::int64_t>(arg1) * static_cast<std::int64_t>(arg2);
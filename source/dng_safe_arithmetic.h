@@ -51,6 +51,12 @@ std::int64_t SafeInt64Add(std::int64_t arg1, std::int64_t arg2);
 bool SafeUint32Add(std::uint32_t arg1, std::uint32_t arg2,
                    std::uint32_t *result);
 
+// If the result of adding arg1 and arg2 will fit in a uint64_t (without
+// wraparound), stores this result in *result and returns true. Otherwise,
+// returns false and leaves *result unchanged.
+bool SafeUint64Add(std::uint64_t arg1, std::uint64_t arg2,
+                   std::uint64_t *result);
+
 // Returns the result of adding arg1 and arg2 if it will fit in the result type
 // (without wraparound). Otherwise, throws a dng_exception with error code
 // dng_error_unknown.
@@ -96,6 +102,21 @@ std::uint32_t SafeUint32Mult(std::uint32_t arg1, std::uint32_t arg2,
 std::uint32_t SafeUint32Mult(std::uint32_t arg1, std::uint32_t arg2,
                              std::uint32_t arg3, std::uint32_t arg4);
 
+// If the result of multiplying arg1, ..., argn will fit in a uint64_t (without
+// wraparound), stores this result in *result and returns true. Otherwise,
+// returns false and leaves *result unchanged.
+bool SafeUint64Mult(std::uint64_t arg1, std::uint64_t arg2,
+                    std::uint64_t *result);
+bool SafeUint64Mult(std::uint64_t arg1, std::uint64_t arg2, std::uint64_t arg3,
+                    std::uint64_t *result);
+
+// Returns the result of multiplying arg1, ..., argn if it will fit in a
+// uint64_t (without wraparound). Otherwise, throws a dng_exception with error
+// code dng_error_unknown.
+std::uint64_t SafeUint64Mult(std::uint64_t arg1, std::uint64_t arg2);
+std::uint64_t SafeUint64Mult(std::uint64_t arg1, std::uint64_t arg2,
+                             std::uint64_t arg3);
+
 // Returns the result of multiplying arg1 and arg2 if it will fit in a size_t
 // (without overflow). Otherwise, throws a dng_exception with error code
 // dng_error_unknown.
@@ -36,10 +36,10 @@ dng_simple_image::dng_simple_image (const dng_rect &bounds,
 				   
 	{
 	
-	uint32 bytes =
-		ComputeBufferSize (pixelType, bounds.Size (), planes, pad16Bytes);
+	uint64 bytes =
+		ComputeBufferSize64 (pixelType, bounds.Size (), planes, pad16Bytes);
 				   
-	fMemory.Reset (allocator.Allocate (bytes));
+	fMemory.Reset (allocator.Allocate64 (bytes));
 	
 	fBuffer = dng_pixel_buffer (bounds, 0, planes, pixelType, pcInterleaved, fMemory->Buffer ());
 	
@@ -158,6 +158,66 @@ void dng_simple_image::Rotate (const dng_orientation &orientation)
 		
 /*****************************************************************************/
 
+void dng_simple_image::MaterializeRotate (const dng_orientation &orientation)
+	{
+	
+	Rotate (orientation);
+	
+	// Flips only reverse the steps, so the rows are still contiguous.  Only
+	// a transposed buffer, with the columns further apart than the rows,
+	// needs reordering.
+	
+	if (Abs_int32 (fBuffer.fColStep) <= Abs_int32 (fBuffer.fRowStep))
+		{
+		return;
+		}
+		
+	uint64 bytes =
+		ComputeBufferSize64 (PixelType (), fBounds.Size (), Planes (), pad16Bytes);
+		
+	AutoPtr<dng_memory_block> memory (fAllocator.Allocate64 (bytes));
+	
+	dng_pixel_buffer buffer (fBounds,
+							 0,
+							 Planes (),
+							 PixelType (),
+							 pcInterleaved,
+							 memory->Buffer ());
+							 
+	// Transpose one block at a time.  A block of 64 by 64 pixels touches 64
+	// rows of each buffer, which fit in the L1 cache and TLB for typical
+	// pixel sizes.
+	
+	const int32 kBlockSize = 64;
+	
+	for (int32 row = fBounds.t; row < fBounds.b; row += kBlockSize)
+		{
+		
+		for (int32 col = fBounds.l; col < fBounds.r; col += kBlockSize)
+			{
+			
+			dng_rect block (row,
+							col,
+							Min_int32 (row + kBlockSize, fBounds.b),
+							Min_int32 (col + kBlockSize, fBounds.r));
+							
+			buffer.CopyArea (fBuffer,
+							 block,
+							 0,
+							 Planes ());
+							 
+			}
+			
+		}
+		
+	fBuffer = buffer;
+	
+	fMemory.Reset (memory.Release ());
+	
+	}
+		
+/*****************************************************************************/
+
 void dng_simple_image::AcquireTileBuffer (dng_tile_buffer &buffer,
 										  const dng_rect &area,
 										  bool dirty) const
@@ -60,6 +60,13 @@ class dng_simple_image : public dng_image
 		
 		virtual void Rotate (const dng_orientation &orientation);
 		
+		/// Rotate image according to orientation, then copy the data into a
+		/// new buffer if the rotation left its rows strided in memory.  The
+		/// copy is done in small square blocks so both the source and the
+		/// destination stay in cache.
+
+		virtual void MaterializeRotate (const dng_orientation &orientation);
+		
 		/// Get the buffer for direct processing. (Unique to dng_simple_image.)
 		
 		void GetPixelBuffer (dng_pixel_buffer &buffer)
@@ -156,6 +156,27 @@ const void * dng_stream::Data () const
 		
 /*****************************************************************************/
 
+const void * dng_stream::DirectData (uint64 offset,
+									 uint32 count)
+	{
+	
+	// Only streams constructed over caller data keep it in their buffer;
+	// other streams refill the buffer as they read.
+	
+	if (fMemBlock.Buffer () == NULL && Data () != NULL &&
+		offset < fLength && count <= fLength - offset)
+		{
+		
+		return fBuffer + (uint32) offset;
+		
+		}
+		
+	return NULL;
+	
+	}
+		
+/*****************************************************************************/
+
 dng_memory_block * dng_stream::AsMemoryBlock (dng_memory_allocator &allocator)
 	{
 	
@@ -207,6 +207,17 @@ class dng_stream
 
 		const void * Data () const;
 		
+		/// Return a pointer to count bytes of the stream starting at offset,
+		/// without copying, if the stream holds them contiguously in memory
+		/// that it does not reuse, NULL otherwise.  A count of zero asks
+		/// whether the data at offset is held that way.  The pointer is valid
+		/// for the life of the stream.
+		/// \param offset Offset of the data in the stream.
+		/// \param count Number of bytes needed.
+
+		virtual const void * DirectData (uint64 offset,
+										 uint32 count);
+		
 		/// Return the entire stream as a single memory block.
 		/// This works for all streams, but requires copying the data to a new buffer.
 		/// \param allocator Allocator used to allocate memory.
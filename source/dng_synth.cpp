@@ -0,0 +1,1609 @@
+/*****************************************************************************/
+// Copyright 2006-2012 Adobe Systems Incorporated
+// All Rights Reserved.
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this file in
+// accordance with the terms of the Adobe license agreement accompanying it.
+/*****************************************************************************/
+
+// Synthetic DNG corpus generator.
+//
+// Writes one DNG file for each combination of image size, CFA pattern, bit
+// depth, compression, raw tile layout and opcode lists selected on the
+// command line.  Image content is a deterministic mix of gradients, flat
+// blocks and noise, seeded from the file name, so the same options always
+// produce the same files.  The output is intended as input for benchmarks
+// and regression tests of the reader and the rendering pipeline.
+
+/*****************************************************************************/
+
+#include "dng_auto_ptr.h"
+#include "dng_bad_pixels.h"
+#include "dng_camera_profile.h"
+#include "dng_exceptions.h"
+#include "dng_file_stream.h"
+#include "dng_gain_map.h"
+#include "dng_globals.h"
+#include "dng_host.h"
+#include "dng_image.h"
+#include "dng_image_writer.h"
+#include "dng_info.h"
+#include "dng_lens_correction.h"
+#include "dng_matrix.h"
+#include "dng_memory.h"
+#include "dng_memory_stream.h"
+#include "dng_misc_opcodes.h"
+#include "dng_mosaic_info.h"
+#include "dng_negative.h"
+#include "dng_opcode_list.h"
+#include "dng_pixel_buffer.h"
+#include "dng_string.h"
+#include "dng_tag_values.h"
+#include "dng_utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+/*****************************************************************************/
+
+#if qDNGValidateTarget
+
+/*****************************************************************************/
+
+#define kDNGSynthVersion "1.0"
+
+/*****************************************************************************/
+
+// Values of each axis of the corpus.  The names are used both on the
+// command line and in the output file names.
+
+enum
+	{
+	kSynthCFA_Bayer0 = 0,
+	kSynthCFA_Bayer1,
+	kSynthCFA_Bayer2,
+	kSynthCFA_Bayer3,
+	kSynthCFA_XTrans,
+	kSynthCFA_CYGM,
+	kSynthCFA_Linear,
+	kSynthCFA_Count
+	};
+
+static const char * const kSynthCFANames [kSynthCFA_Count] =
+	{
+	"bayer0",
+	"bayer1",
+	"bayer2",
+	"bayer3",
+	"xtrans",
+	"cygm",
+	"linear"
+	};
+
+enum
+	{
+	kSynthDepth_8 = 0,
+	kSynthDepth_10,
+	kSynthDepth_12,
+	kSynthDepth_14,
+	kSynthDepth_16,
+	kSynthDepth_F16,
+	kSynthDepth_F24,
+	kSynthDepth_F32,
+	kSynthDepth_Count
+	};
+
+static const char * const kSynthDepthNames [kSynthDepth_Count] =
+	{
+	"8",
+	"10",
+	"12",
+	"14",
+	"16",
+	"f16",
+	"f24",
+	"f32"
+	};
+
+enum
+	{
+	kSynthCompression_None = 0,
+	kSynthCompression_LosslessJPEG,
+	kSynthCompression_Deflate,
+	kSynthCompression_LossyJPEG,
+	kSynthCompression_Count
+	};
+
+static const char * const kSynthCompressionNames [kSynthCompression_Count] =
+	{
+	"none",
+	"ljpeg",
+	"deflate",
+	"lossy"
+	};
+
+enum
+	{
+	kSynthOpcodes_List1 = 1,
+	kSynthOpcodes_List2 = 2,
+	kSynthOpcodes_List3 = 4,
+	kSynthOpcodes_List3InPlace = 8,
+	kSynthOpcodes_Count = 16
+	};
+
+// Raw layouts other than square tiles of a given size.
+
+const int32 kSynthLayout_Default     =  0;
+const int32 kSynthLayout_SingleStrip = -1;
+const int32 kSynthLayout_Strips      = -2;
+
+/*****************************************************************************/
+
+// One file of the corpus.
+
+struct dng_synth_params
+	{
+
+	dng_point fSize;
+
+	uint32 fCFA;
+
+	uint32 fDepth;
+
+	uint32 fCompression;
+
+	int32 fLayout;
+
+	uint32 fOpcodes;
+
+	uint32 fSeed;
+
+	dng_synth_params ()
+
+		:	fSize        ()
+		,	fCFA         (kSynthCFA_Bayer0)
+		,	fDepth       (kSynthDepth_12)
+		,	fCompression (kSynthCompression_LosslessJPEG)
+		,	fLayout      (kSynthLayout_Default)
+		,	fOpcodes     (0)
+		,	fSeed        (0)
+
+		{
+
+		}
+
+	bool IsFloat () const
+		{
+		return fDepth >= kSynthDepth_F16;
+		}
+
+	// FixBadPixelsConstant only handles 16-bit Bayer data.
+
+	bool FixesBadPixels () const
+		{
+		return (fOpcodes & kSynthOpcodes_List1) &&
+			   fCFA   <= kSynthCFA_Bayer3 &&
+			   fDepth >= kSynthDepth_10   &&
+			   fDepth <= kSynthDepth_16;
+		}
+
+	bool IsValid () const;
+
+	void GetName (dng_string &name) const;
+
+	};
+
+/*****************************************************************************/
+
+bool dng_synth_params::IsValid () const
+	{
+
+	// The two opcode list 3 variants are alternatives.
+
+	if ((fOpcodes & kSynthOpcodes_List3) &&
+		(fOpcodes & kSynthOpcodes_List3InPlace))
+		{
+		return false;
+		}
+
+	// Lossless JPEG and the floating point predictor treat each pair of
+	// columns of a two column CFA pattern as one sample.  Tiles are rounded
+	// to whole pairs, but strips are as wide as the image, so the reader
+	// cannot decode strips of odd width.
+
+	if (fCompression != kSynthCompression_None &&
+		fLayout      <  kSynthLayout_Default   &&
+		fCFA         != kSynthCFA_XTrans       &&
+		fCFA         != kSynthCFA_Linear       &&
+		(fSize.h & 1))
+		{
+		return false;
+		}
+
+	switch (fCompression)
+		{
+
+		// Lossless JPEG is only used for integer data, and deflate with the
+		// floating point predictor only for floating point data.
+
+		case kSynthCompression_LosslessJPEG:
+			return !IsFloat ();
+
+		case kSynthCompression_Deflate:
+			return IsFloat ();
+
+		// The lossy JPEG proxy has its own fixed tile layout.  A proxy of
+		// floating point data is written as 16-bit float deflate data
+		// rather than lossy JPEG, so only integer data is used.
+
+		case kSynthCompression_LossyJPEG:
+			return fLayout == kSynthLayout_Default &&
+				   !IsFloat ();
+
+		default:
+			break;
+
+		}
+
+	return true;
+
+	}
+
+/*****************************************************************************/
+
+void dng_synth_params::GetName (dng_string &name) const
+	{
+
+	char layout [32];
+
+	if (fLayout == kSynthLayout_Default)
+		{
+		strcpy (layout, "default");
+		}
+
+	else if (fLayout == kSynthLayout_SingleStrip)
+		{
+		strcpy (layout, "strip");
+		}
+
+	else if (fLayout == kSynthLayout_Strips)
+		{
+		strcpy (layout, "strips");
+		}
+
+	else
+		{
+		sprintf (layout, "tile%d", (int) fLayout);
+		}
+
+	char opcodes [16];
+
+	if (fOpcodes == 0)
+		{
+		strcpy (opcodes, "none");
+		}
+
+	else
+		{
+		sprintf (opcodes,
+				 "op%s%s%s%s",
+				 (fOpcodes & kSynthOpcodes_List1) ? "1" : "",
+				 (fOpcodes & kSynthOpcodes_List2) ? "2" : "",
+				 (fOpcodes & kSynthOpcodes_List3) ? "3" : "",
+				 (fOpcodes & kSynthOpcodes_List3InPlace) ? "4" : "");
+		}
+
+	char s [256];
+
+	sprintf (s,
+			 "%ux%u_%s_%s_%s_%s_%s",
+			 (unsigned) fSize.h,
+			 (unsigned) fSize.v,
+			 kSynthCFANames         [fCFA        ],
+			 kSynthDepthNames       [fDepth      ],
+			 kSynthCompressionNames [fCompression],
+			 layout,
+			 opcodes);
+
+	name.Set (s);
+
+	}
+
+/*****************************************************************************/
+
+// Small deterministic generator, so the corpus does not depend on the
+// C library's rand implementation.
+
+class dng_synth_random
+	{
+
+	private:
+
+		uint32 fState;
+
+	public:
+
+		explicit dng_synth_random (uint32 seed)
+			:	fState (seed ? seed : 0x9E3779B9)
+			{
+			}
+
+		uint32 Next ()
+			{
+
+			fState ^= fState << 13;
+			fState ^= fState >> 17;
+			fState ^= fState <<  5;
+
+			return fState;
+
+			}
+
+		// Uniform value in [-0.5, 0.5).
+
+		real32 Noise ()
+			{
+			return (real32) (Next () >> 8) * (1.0f / 16777216.0f) - 0.5f;
+			}
+
+	};
+
+/*****************************************************************************/
+
+static uint32 SynthHash (uint32 a, uint32 b, uint32 c)
+	{
+
+	uint32 h = 2166136261u;
+
+	h = (h ^ a) * 16777619u;
+	h = (h ^ b) * 16777619u;
+	h = (h ^ c) * 16777619u;
+
+	h ^= h >> 15;
+	h *= 0x2C1B3C6D;
+	h ^= h >> 12;
+
+	return h;
+
+	}
+
+/*****************************************************************************/
+
+static uint32 SynthHash (const char *s)
+	{
+
+	uint32 h = 2166136261u;
+
+	while (*s)
+		{
+		h = (h ^ (uint8) *s++) * 16777619u;
+		}
+
+	return h;
+
+	}
+
+/*****************************************************************************/
+
+// Rounds a value to the precision it will be stored with, so that the raw
+// image digest computed when writing matches the data read back.
+
+static real32 SynthRoundFloat (real32 value,
+							   uint32 bitDepth)
+	{
+
+	union
+		{
+		real32 f;
+		uint32 i;
+		} x;
+
+	x.f = value;
+
+	if (bitDepth == 16)
+		{
+
+		x.i = DNG_HalfToFloat (DNG_FloatToHalf (x.i));
+
+		}
+
+	else if (bitDepth == 24)
+		{
+
+		uint8 temp [3];
+
+		DNG_FloatToFP24 (x.i, temp);
+
+		x.i = DNG_FP24ToFloat (temp);
+
+		}
+
+	return x.f;
+
+	}
+
+/*****************************************************************************/
+
+// Scene value in [0, 1] of the given color at the given pixel: a diagonal
+// gradient, 16 by 16 flat blocks with a per-color level, a fine ramp to
+// exercise the predictors, and noise.
+
+static real32 SynthValue (uint32 row,
+						  uint32 col,
+						  uint32 color,
+						  const dng_point &size,
+						  dng_synth_random &random)
+	{
+
+	real32 gradient = (real32) (row + col) / (real32) (size.v + size.h);
+
+	real32 block = (real32) (SynthHash (row >> 4, col >> 4, color) >> 24) * (1.0f / 255.0f);
+
+	real32 ramp = (real32) ((row * 3 + col) & 31) * (1.0f / 31.0f);
+
+	real32 value = 0.05f + 0.40f * gradient
+						 + 0.30f * block
+						 + 0.10f * ramp
+						 + 0.08f * random.Noise ();
+
+	return Pin_real32 (0.0f, value, 1.0f);
+
+	}
+
+/*****************************************************************************/
+
+// Color of the CFA at a given pixel, or the plane for linear images.
+
+static uint32 SynthColor (const dng_negative &negative,
+						  uint32 row,
+						  uint32 col,
+						  uint32 plane)
+	{
+
+	const dng_mosaic_info *info = negative.GetMosaicInfo ();
+
+	if (info && info->IsColorFilterArray ())
+		{
+
+		return info->fCFAPattern [row % info->fCFAPatternSize.v]
+								 [col % info->fCFAPatternSize.h];
+
+		}
+
+	return plane;
+
+	}
+
+/*****************************************************************************/
+
+static void SetupSynthColor (dng_negative &negative,
+							 const dng_synth_params &params)
+	{
+
+	AutoPtr<dng_camera_profile> profile (new dng_camera_profile);
+
+	profile->SetName ("Synthetic");
+
+	profile->SetCalibrationIlluminant1 (lsD65);
+
+	if (params.fCFA == kSynthCFA_CYGM)
+		{
+
+		negative.SetColorChannels (4);
+
+		negative.SetColorKeys (colorKeyGreen,
+							   colorKeyMagenta,
+							   colorKeyCyan,
+							   colorKeyYellow);
+
+		negative.SetQuadMosaic (0xb4b4b4b4);
+
+		dng_matrix colorMatrix (4, 3);
+
+		static const real64 kCYGM [4] [3] =
+			{
+			{ -0.30,  1.10,  0.05 },
+			{  0.70, -0.20,  0.55 },
+			{ -0.25,  0.70,  0.60 },
+			{  0.60,  0.65, -0.20 }
+			};
+
+		for (uint32 j = 0; j < 4; j++)
+			for (uint32 k = 0; k < 3; k++)
+				{
+				colorMatrix [j] [k] = kCYGM [j] [k];
+				}
+
+		profile->SetColorMatrix1 (colorMatrix);
+
+		dng_vector neutral (4);
+
+		neutral [0] = 1.0;
+		neutral [1] = 0.7;
+		neutral [2] = 0.8;
+		neutral [3] = 0.9;
+
+		negative.SetCameraNeutral (neutral);
+
+		}
+
+	else
+		{
+
+		negative.SetColorChannels (3);
+
+		negative.SetColorKeys (colorKeyRed, colorKeyGreen, colorKeyBlue);
+
+		if (params.fCFA == kSynthCFA_XTrans)
+			{
+			negative.SetFujiMosaic6x6 (0);
+			}
+
+		else if (params.fCFA != kSynthCFA_Linear)
+			{
+			negative.SetBayerMosaic (params.fCFA - kSynthCFA_Bayer0);
+			}
+
+		profile->SetColorMatrix1 (dng_matrix_3by3 ( 0.80, -0.20, -0.10,
+												   -0.40,  1.20,  0.20,
+												   -0.10,  0.20,  0.60));
+
+		negative.SetCameraNeutral (dng_vector_3 (0.5, 1.0, 0.6));
+
+		}
+
+	negative.AddProfile (profile);
+
+	}
+
+/*****************************************************************************/
+
+// Builds the stage 1 image, filled one band of rows at a time.
+
+static void SetupSynthImage (dng_host &host,
+							 dng_negative &negative,
+							 const dng_synth_params &params)
+	{
+
+	const dng_point &size = params.fSize;
+
+	uint32 planes = params.fCFA == kSynthCFA_Linear ? 3 : 1;
+
+	uint32 pixelType = params.IsFloat () ? ttFloat : ttShort;
+
+	// Levels, keeping the black level above zero so that the only zero
+	// samples are the ones marked as bad pixels below.  The 8-bit case
+	// uses a 256 entry linearization table to 12 bits, which is how 8-bit
+	// raw data is usually stored (the writer packs it into 8 bits).
+
+	uint32 white = 1;
+	uint32 black = 0;
+
+	switch (params.fDepth)
+		{
+
+		case kSynthDepth_8:
+		case kSynthDepth_12:	white =  4095;	black =  64;	break;
+		case kSynthDepth_10:	white =  1023;	black =  16;	break;
+		case kSynthDepth_14:	white = 16383;	black = 256;	break;
+		case kSynthDepth_16:	white = 65535;	black = 512;	break;
+
+		case kSynthDepth_F16:	negative.SetRawFloatBitDepth (16);	break;
+		case kSynthDepth_F24:	negative.SetRawFloatBitDepth (24);	break;
+		case kSynthDepth_F32:	negative.SetRawFloatBitDepth (32);	break;
+
+		default:
+			ThrowProgramError ();
+
+		}
+
+	bool linearize = params.fDepth == kSynthDepth_8;
+
+	if (linearize)
+		{
+
+		AutoPtr<dng_memory_block> curve (host.Allocate (256 * sizeof (uint16)));
+
+		for (uint32 j = 0; j < 256; j++)
+			{
+
+			real64 x = j * (1.0 / 255.0);
+
+			curve->Buffer_uint16 () [j] = (uint16) (black + Round_uint32 (x * x * (white - black)));
+
+			}
+
+		negative.SetLinearization (curve);
+
+		}
+
+	negative.SetWhiteLevel (white);
+
+	if (black)
+		{
+		negative.SetBlackLevel (black);
+		}
+
+	// Sprinkle bad pixels only if stage 1 will fix them.
+
+	bool badPixels = params.FixesBadPixels ();
+
+	AutoPtr<dng_image> image (host.Make_dng_image (dng_rect (size.v, size.h),
+												   planes,
+												   pixelType));
+
+	const uint32 kBandRows = 64;
+
+	uint32 pixelSize = TagTypeSize (pixelType);
+
+	AutoPtr<dng_memory_block> block (host.Allocate (kBandRows *
+													size.h *
+													planes *
+													pixelSize));
+
+	dng_synth_random random (params.fSeed);
+
+	for (int32 band = 0; band < size.v; band += kBandRows)
+		{
+
+		dng_rect area (band,
+					   0,
+					   Min_int32 (band + kBandRows, size.v),
+					   size.h);
+
+		dng_pixel_buffer buffer;
+
+		buffer.fArea      = area;
+		buffer.fPlane     = 0;
+		buffer.fPlanes    = planes;
+		buffer.fRowStep   = planes * size.h;
+		buffer.fColStep   = planes;
+		buffer.fPlaneStep = 1;
+		buffer.fPixelType = pixelType;
+		buffer.fPixelSize = pixelSize;
+		buffer.fData      = block->Buffer ();
+
+		for (int32 row = area.t; row < area.b; row++)
+			{
+
+			for (int32 col = 0; col < size.h; col++)
+				{
+
+				for (uint32 plane = 0; plane < planes; plane++)
+					{
+
+					real32 value = SynthValue (row,
+											   col,
+											   SynthColor (negative, row, col, plane),
+											   size,
+											   random);
+
+					if (pixelType == ttFloat)
+						{
+
+						*buffer.DirtyPixel_real32 (row, col, plane) = SynthRoundFloat (value,
+																					   negative.RawFloatBitDepth ());
+
+						}
+
+					else
+						{
+
+						uint32 x = linearize ? Round_uint32 (sqrtf (value) * 255.0f)
+											 : black + Round_uint32 (value * (real32) (white - black));
+
+						if (badPixels && (random.Next () & 4095) == 0)
+							{
+							x = 0;
+							}
+
+						*buffer.DirtyPixel_uint16 (row, col, plane) = (uint16) x;
+
+						}
+
+					}
+
+				}
+
+			}
+
+		image->Put (buffer);
+
+		}
+
+	negative.SetStage1Image (image);
+
+	}
+
+/*****************************************************************************/
+
+static void AppendSynthOpcode (dng_opcode_list &list,
+							   dng_opcode *opcode)
+	{
+
+	AutoPtr<dng_opcode> temp (opcode);
+
+	list.Append (temp);
+
+	}
+
+/*****************************************************************************/
+
+static void SetupSynthOpcodes (dng_host &host,
+							   dng_negative &negative,
+							   const dng_synth_params &params)
+	{
+
+	const dng_image &stage1 = *negative.Stage1Image ();
+
+	dng_rect bounds = stage1.Bounds ();
+
+	// Stage 1: fix the bad pixels on Bayer images, otherwise a mild tone
+	// curve on the raw values.  Stage 1 polynomials only support 16-bit
+	// and floating point data, so integer data uses a table.
+
+	if (params.fOpcodes & kSynthOpcodes_List1)
+		{
+
+		if (params.FixesBadPixels ())
+			{
+
+			AppendSynthOpcode (negative.OpcodeList1 (),
+							   new dng_opcode_FixBadPixelsConstant (0,
+																	params.fCFA - kSynthCFA_Bayer0));
+
+			}
+
+		else if (!params.IsFloat ())
+			{
+
+			uint32 count = params.fDepth == kSynthDepth_8 ? 256
+														  : negative.WhiteLevel () + 1;
+
+			AutoPtr<dng_memory_block> table (host.Allocate (count * sizeof (uint16)));
+
+			for (uint32 j = 0; j < count; j++)
+				{
+				table->Buffer_uint16 () [j] = (uint16) (j - (j >> 5));
+				}
+
+			AppendSynthOpcode (negative.OpcodeList1 (),
+							   new dng_opcode_MapTable (host,
+														dng_area_spec (bounds,
+																	   0,
+																	   stage1.Planes ()),
+														table->Buffer_uint16 (),
+														count));
+
+			}
+
+		else
+			{
+
+			static const real64 kCurve [3] = { 0.0, 1.02, -0.02 };
+
+			AppendSynthOpcode (negative.OpcodeList1 (),
+							   new dng_opcode_MapPolynomial (dng_area_spec (bounds,
+																			0,
+																			stage1.Planes ()),
+															 2,
+															 kCurve));
+
+			}
+
+		}
+
+	// Stage 2: a polynomial on the left half and a radial falloff gain map
+	// over the whole image.
+
+	if (params.fOpcodes & kSynthOpcodes_List2)
+		{
+
+		static const real64 kCurve [2] = { 0.01, 0.98 };
+
+		dng_rect left = bounds;
+
+		left.r = left.l + (bounds.W () >> 1);
+
+		AppendSynthOpcode (negative.OpcodeList2 (),
+						   new dng_opcode_MapPolynomial (dng_area_spec (left,
+																		0,
+																		stage1.Planes ()),
+														 1,
+														 kCurve));
+
+		const int32 kMapPoints = 9;
+
+		AutoPtr<dng_gain_map> gainMap (new dng_gain_map (host.Allocator (),
+														 dng_point (kMapPoints, kMapPoints),
+														 dng_point_real64 (1.0 / (kMapPoints - 1),
+																		   1.0 / (kMapPoints - 1)),
+														 dng_point_real64 (0.0, 0.0),
+														 1));
+
+		for (int32 row = 0; row < kMapPoints; row++)
+			for (int32 col = 0; col < kMapPoints; col++)
+				{
+
+				real64 dv = (real64) row / (kMapPoints - 1) - 0.5;
+				real64 dh = (real64) col / (kMapPoints - 1) - 0.5;
+
+				gainMap->Entry (row, col, 0) = (real32) (1.0 + 0.8 * (dv * dv + dh * dh));
+
+				}
+
+		AppendSynthOpcode (negative.OpcodeList2 (),
+						   new dng_opcode_GainMap (dng_area_spec (bounds,
+																  0,
+																  stage1.Planes ()),
+												   gainMap));
+
+		}
+
+	// Stage 3: lens corrections.
+
+	if (params.fOpcodes & kSynthOpcodes_List3)
+		{
+
+		dng_vector radParams [1];
+		dng_vector tanParams [1];
+
+		radParams [0] = dng_vector (4);
+		tanParams [0] = dng_vector (2);
+
+		radParams [0] [0] =  1.0;
+		radParams [0] [1] = -0.03;
+		radParams [0] [2] =  0.01;
+
+		tanParams [0] [0] =  0.001;
+		tanParams [0] [1] = -0.001;
+
+		dng_warp_params_rectilinear warpParams (1,
+												radParams,
+												tanParams,
+												dng_point_real64 (0.5, 0.5));
+
+		AppendSynthOpcode (negative.OpcodeList3 (),
+						   new dng_opcode_WarpRectilinear (warpParams,
+														   dng_opcode::kFlag_None));
+
+		dng_std_vector<real64> vignette (5, 0.0);
+
+		vignette [0] = 0.25;
+		vignette [1] = 0.05;
+
+		AppendSynthOpcode (negative.OpcodeList3 (),
+						   new dng_opcode_FixVignetteRadial (dng_vignette_radial_params (vignette,
+																						 dng_point_real64 (0.5, 0.5)),
+															 dng_opcode::kFlag_None));
+
+		}
+
+	// Stage 3, in-place opcodes only, which the band pipeline applies to
+	// each tile as it is interpolated: a vignette correction, a polynomial
+	// on the top half and a gain map.  Stage 3 bounds are not known yet,
+	// so the areas use stage 1 coordinates and are clipped to the image.
+
+	if (params.fOpcodes & kSynthOpcodes_List3InPlace)
+		{
+
+		uint32 planes = negative.ColorChannels ();
+
+		dng_std_vector<real64> vignette (5, 0.0);
+
+		vignette [0] = 0.25;
+		vignette [1] = 0.05;
+
+		AppendSynthOpcode (negative.OpcodeList3 (),
+						   new dng_opcode_FixVignetteRadial (dng_vignette_radial_params (vignette,
+																						 dng_point_real64 (0.5, 0.5)),
+															 dng_opcode::kFlag_None));
+
+		static const real64 kCurve [2] = { 0.02, 0.97 };
+
+		dng_rect top = bounds;
+
+		top.b = top.t + (bounds.H () >> 1);
+
+		AppendSynthOpcode (negative.OpcodeList3 (),
+						   new dng_opcode_MapPolynomial (dng_area_spec (top,
+																		0,
+																		planes),
+														 1,
+														 kCurve));
+
+		const int32 kMapPoints = 5;
+
+		AutoPtr<dng_gain_map> gainMap (new dng_gain_map (host.Allocator (),
+														 dng_point (kMapPoints, kMapPoints),
+														 dng_point_real64 (1.0 / (kMapPoints - 1),
+																		   1.0 / (kMapPoints - 1)),
+														 dng_point_real64 (0.0, 0.0),
+														 1));
+
+		for (int32 row = 0; row < kMapPoints; row++)
+			for (int32 col = 0; col < kMapPoints; col++)
+				{
+
+				gainMap->Entry (row, col, 0) = (real32) (0.9 + 0.05 * (row + col) / (kMapPoints - 1));
+
+				}
+
+		AppendSynthOpcode (negative.OpcodeList3 (),
+						   new dng_opcode_GainMap (dng_area_spec (bounds,
+																  0,
+																  planes),
+												   gainMap));
+
+		}
+
+	}
+
+/*****************************************************************************/
+
+// Writer that applies the requested raw tile layout.
+
+class dng_synth_writer: public dng_image_writer
+	{
+
+	private:
+
+		int32 fLayout;
+
+	public:
+
+		explicit dng_synth_writer (int32 layout = kSynthLayout_Default)
+			:	fLayout (layout)
+			{
+			}
+
+	protected:
+
+		virtual void AdjustRawTileLayout (dng_host & /* host */,
+										  const dng_negative & /* negative */,
+										  dng_ifd &ifd)
+			{
+
+			if (fLayout == kSynthLayout_SingleStrip)
+				{
+
+				ifd.SetSingleStrip ();
+
+				}
+
+			else if (fLayout == kSynthLayout_Strips)
+				{
+
+				ifd.FindStripSize (64 * 1024);
+
+				}
+
+			else if (fLayout > 0)
+				{
+
+				ifd.fTileWidth  = fLayout;
+				ifd.fTileLength = fLayout;
+
+				ifd.fUsesTiles  = true;
+				ifd.fUsesStrips = false;
+
+				}
+
+			}
+
+	};
+
+/*****************************************************************************/
+
+// Rebuilds the negative from a DNG in memory and converts it to a full size
+// lossy JPEG proxy, the same way dng_validate -proxy does.
+
+static dng_negative * MakeSynthProxy (dng_host &host,
+									  dng_memory_stream &stream)
+	{
+
+	host.SetSaveDNGVersion (dngVersion_SaveDefault);
+
+	host.SetSaveLinearDNG (false);
+
+	host.SetKeepOriginalFile (false);
+
+	stream.SetReadPosition (0);
+
+	dng_info info;
+
+	info.Parse (host, stream);
+
+	info.PostParse (host);
+
+	if (!info.IsValidDNG ())
+		{
+		ThrowBadFormat ();
+		}
+
+	AutoPtr<dng_negative> negative (host.Make_dng_negative ());
+
+	negative->Parse (host, stream, info);
+
+	negative->PostParse (host, stream, info);
+
+	negative->ReadStage1Image (host, stream, info);
+
+	negative->SynchronizeMetadata ();
+
+	negative->BuildStage2Image (host);
+
+	negative->BuildStage3Image (host);
+
+	dng_image_writer writer;
+
+	negative->ConvertToProxy (host, writer);
+
+	return negative.Release ();
+
+	}
+
+/*****************************************************************************/
+
+static void dng_synth (const dng_synth_params &params,
+					   const char *fileName)
+	{
+
+	dng_host host;
+
+	AutoPtr<dng_negative> negative (host.Make_dng_negative ());
+
+	negative->SetModelName ("Synthetic");
+	negative->SetLocalName ("Synthetic");
+
+	SetupSynthColor (*negative, params);
+
+	SetupSynthImage (host, *negative, params);
+
+	// Crop a few pixels off each side, keeping the CFA phase.
+
+	uint32 cropH = Min_uint32 (12, params.fSize.h / 8);
+	uint32 cropV = Min_uint32 (12, params.fSize.v / 8);
+
+	negative->SetDefaultCropOrigin (cropH, cropV);
+
+	negative->SetDefaultCropSize (params.fSize.h - 2 * cropH,
+								  params.fSize.v - 2 * cropV);
+
+	SetupSynthOpcodes (host, *negative, params);
+
+	negative->SynchronizeMetadata ();
+
+	bool uncompressed = params.fCompression == kSynthCompression_None;
+
+	if (params.fCompression == kSynthCompression_LossyJPEG)
+		{
+
+		dng_memory_stream stream (host.Allocator ());
+
+		dng_image_writer writer;
+
+		writer.WriteDNG (host,
+						 stream,
+						 *negative,
+						 NULL,
+						 dngVersion_SaveDefault,
+						 false);
+
+		negative.Reset (MakeSynthProxy (host, stream));
+
+		uncompressed = false;
+
+		}
+
+	dng_file_stream stream (fileName, true);
+
+	dng_synth_writer writer (params.fLayout);
+
+	writer.WriteDNG (host,
+					 stream,
+					 *negative,
+					 NULL,
+					 dngVersion_SaveDefault,
+					 uncompressed);
+
+	}
+
+/*****************************************************************************/
+
+// Parses a comma separated list of names into a selection mask.
+
+static bool ParseSynthNames (const char *list,
+							 const char * const names [],
+							 uint32 count,
+							 std::vector<bool> &selected)
+	{
+
+	selected.assign (count, false);
+
+	std::vector<char> s (list, list + strlen (list) + 1);
+
+	char *token = strtok (&s [0], ",");
+
+	if (!token)
+		{
+		return false;
+		}
+
+	for (; token; token = strtok (NULL, ","))
+		{
+
+		uint32 index;
+
+		for (index = 0; index < count; index++)
+			{
+
+			if (strcmp (token, names [index]) == 0)
+				{
+				selected [index] = true;
+				break;
+				}
+
+			}
+
+		if (index == count)
+			{
+			fprintf (stderr, "*** Unknown value \"%s\"\n", token);
+			return false;
+			}
+
+		}
+
+	return true;
+
+	}
+
+/*****************************************************************************/
+
+static bool ParseSynthSizes (const char *list,
+							 std::vector<dng_point> &sizes)
+	{
+
+	sizes.clear ();
+
+	std::vector<char> s (list, list + strlen (list) + 1);
+
+	for (char *token = strtok (&s [0], ",");
+		 token;
+		 token = strtok (NULL, ","))
+		{
+
+		unsigned w = 0;
+		unsigned h = 0;
+
+		if (sscanf (token, "%ux%u", &w, &h) != 2 ||
+			w < 16 || h < 16 ||
+			w > kMaxImageSide || h > kMaxImageSide)
+			{
+			fprintf (stderr, "*** Invalid size \"%s\"\n", token);
+			return false;
+			}
+
+		sizes.push_back (dng_point ((int32) h, (int32) w));
+
+		}
+
+	return !sizes.empty ();
+
+	}
+
+/*****************************************************************************/
+
+static bool ParseSynthLayouts (const char *list,
+							   std::vector<int32> &layouts)
+	{
+
+	layouts.clear ();
+
+	std::vector<char> s (list, list + strlen (list) + 1);
+
+	for (char *token = strtok (&s [0], ",");
+		 token;
+		 token = strtok (NULL, ","))
+		{
+
+		unsigned tile = 0;
+
+		if (strcmp (token, "default") == 0)
+			{
+			layouts.push_back (kSynthLayout_Default);
+			}
+
+		else if (strcmp (token, "strip") == 0)
+			{
+			layouts.push_back (kSynthLayout_SingleStrip);
+			}
+
+		else if (strcmp (token, "strips") == 0)
+			{
+			layouts.push_back (kSynthLayout_Strips);
+			}
+
+		// TIFF requires tile sizes to be multiples of 16.
+
+		else if (sscanf (token, "tile%u", &tile) == 1 &&
+				 tile >= 16 && tile <= 4096 && (tile & 15) == 0)
+			{
+			layouts.push_back ((int32) tile);
+			}
+
+		else
+			{
+			fprintf (stderr, "*** Invalid layout \"%s\"\n", token);
+			return false;
+			}
+
+		}
+
+	return !layouts.empty ();
+
+	}
+
+/*****************************************************************************/
+
+static bool ParseSynthOpcodes (const char *list,
+							   std::vector<bool> &selected)
+	{
+
+	selected.assign (kSynthOpcodes_Count, false);
+
+	std::vector<char> s (list, list + strlen (list) + 1);
+
+	char *token = strtok (&s [0], ",");
+
+	if (!token)
+		{
+		return false;
+		}
+
+	for (; token; token = strtok (NULL, ","))
+		{
+
+		// "none", "all", or "op" followed by the list numbers, e.g. "op13",
+		// where 4 is opcode list 3 with only in-place opcodes.
+
+		uint32 mask = 0;
+
+		if (strcmp (token, "none") == 0)
+			{
+			mask = 0;
+			}
+
+		else if (strcmp (token, "all") == 0)
+			{
+			mask = kSynthOpcodes_List1 | kSynthOpcodes_List2 | kSynthOpcodes_List3;
+			}
+
+		else if (strncmp (token, "op", 2) == 0 && token [2])
+			{
+
+			for (const char *p = token + 2; *p; p++)
+				{
+
+				if (*p < '1' || *p > '4')
+					{
+					fprintf (stderr, "*** Invalid opcode lists \"%s\"\n", token);
+					return false;
+					}
+
+				mask |= 1 << (*p - '1');
+
+				}
+
+			}
+
+		else
+			{
+			fprintf (stderr, "*** Invalid opcode lists \"%s\"\n", token);
+			return false;
+			}
+
+		selected [mask] = true;
+
+		}
+
+	return true;
+
+	}
+
+/*****************************************************************************/
+
+int main (int argc, char *argv [])
+	{
+
+	try
+		{
+
+		if (argc == 1)
+			{
+
+			fprintf (stderr,
+					 "\n"
+					 "dng_synth, version " kDNGSynthVersion "\n"
+					 "\n"
+					 "Usage:  %s [options] outdir\n"
+					 "\n"
+					 "Writes one synthetic DNG to <outdir> for each combination of:\n"
+					 "-sizes <list>        Image sizes, WxH (default 256x192,333x251)\n"
+					 "-cfa <list>          bayer0..bayer3, xtrans, cygm, linear (default all)\n"
+					 "-depth <list>        8, 10, 12, 14, 16, f16, f24, f32 (default all)\n"
+					 "-compression <list>  none, ljpeg, deflate, lossy (default all)\n"
+					 "-layout <list>       default, strip, strips, tile<num> (default all\n"
+					 "                     but tile<num>, plus tile64,tile256)\n"
+					 "-opcodes <list>      none, all, op<lists> e.g. op1, op23, where 4 is\n"
+					 "                     list 3 with only in-place opcodes (default\n"
+					 "                     none,op1,op2,op3,op4)\n"
+					 "\n"
+					 "Deflate is only used for floating point data, lossless JPEG only\n"
+					 "for integer data, and lossy JPEG proxies only for integer data with\n"
+					 "the default layout.  Compressed strips of odd width CFA data are\n"
+					 "not supported by the reader.  Other combinations are skipped.\n"
+					 "\n"
+					 "Other options:\n"
+					 "-seed <num>          Seed for the image content (default 0)\n"
+					 "-sample <num>        Only write every <num>th combination\n"
+					 "-n                   List the file names without writing them\n"
+					 "-v                   Verbose mode\n"
+					 "\n",
+					 argv [0]);
+
+			return 1;
+
+			}
+
+		std::vector<dng_point> sizes;
+
+		sizes.push_back (dng_point (192, 256));
+		sizes.push_back (dng_point (251, 333));
+
+		std::vector<bool> cfas        (kSynthCFA_Count, true);
+		std::vector<bool> depths      (kSynthDepth_Count, true);
+		std::vector<bool> compressions (kSynthCompression_Count, true);
+		std::vector<bool> opcodes     (kSynthOpcodes_Count, false);
+
+		opcodes [0                  ] = true;
+		opcodes [kSynthOpcodes_List1] = true;
+		opcodes [kSynthOpcodes_List2] = true;
+		opcodes [kSynthOpcodes_List3] = true;
+		opcodes [kSynthOpcodes_List3InPlace] = true;
+
+		std::vector<int32> layouts;
+
+		layouts.push_back (kSynthLayout_Default);
+		layouts.push_back (kSynthLayout_SingleStrip);
+		layouts.push_back (kSynthLayout_Strips);
+		layouts.push_back (64);
+		layouts.push_back (256);
+
+		// Only show timing in verbose mode.
+
+		gDNGShowTimers = false;
+
+		uint32 seed = 0;
+
+		uint32 sample = 1;
+
+		bool listOnly = false;
+
+		int index;
+
+		for (index = 1; index < argc && argv [index] [0] == '-'; index++)
+			{
+
+			dng_string option;
+
+			option.Set (&argv [index] [1]);
+
+			const char *value = index + 1 < argc ? argv [index + 1] : NULL;
+
+			bool ok = true;
+
+			if (option.Matches ("v", true))
+				{
+				gVerbose = true;
+				gDNGShowTimers = true;
+				continue;
+				}
+
+			else if (option.Matches ("n", true))
+				{
+				listOnly = true;
+				continue;
+				}
+
+			else if (!value)
+				{
+				ok = false;
+				}
+
+			else if (option.Matches ("sizes", true))
+				{
+				ok = ParseSynthSizes (value, sizes);
+				}
+
+			else if (option.Matches ("cfa", true))
+				{
+				ok = ParseSynthNames (value, kSynthCFANames, kSynthCFA_Count, cfas);
+				}
+
+			else if (option.Matches ("depth", true))
+				{
+				ok = ParseSynthNames (value, kSynthDepthNames, kSynthDepth_Count, depths);
+				}
+
+			else if (option.Matches ("compression", true))
+				{
+				ok = ParseSynthNames (value, kSynthCompressionNames, kSynthCompression_Count, compressions);
+				}
+
+			else if (option.Matches ("layout", true))
+				{
+				ok = ParseSynthLayouts (value, layouts);
+				}
+
+			else if (option.Matches ("opcodes", true))
+				{
+				ok = ParseSynthOpcodes (value, opcodes);
+				}
+
+			else if (option.Matches ("seed", true))
+				{
+				seed = (uint32) strtoul (value, NULL, 0);
+				}
+
+			else if (option.Matches ("sample", true))
+				{
+				sample = (uint32) atoi (value);
+				ok = sample != 0;
+				}
+
+			else
+				{
+				fprintf (stderr, "*** Unknown option \"-%s\"\n", option.Get ());
+				return 1;
+				}
+
+			if (!ok)
+				{
+				fprintf (stderr, "*** Invalid or missing value after \"-%s\"\n", option.Get ());
+				return 1;
+				}
+
+			index++;
+
+			}
+
+		if (index != argc - 1)
+			{
+			fprintf (stderr, "*** Expected one output directory\n");
+			return 1;
+			}
+
+		dng_string outDir;
+
+		outDir.Set (argv [index]);
+
+		if (!outDir.EndsWith ("/"))
+			{
+			outDir.Append ("/");
+			}
+
+		uint32 combination = 0;
+
+		uint32 written = 0;
+		uint32 failed  = 0;
+
+		dng_synth_params params;
+
+		for (size_t sizeIndex = 0; sizeIndex < sizes.size (); sizeIndex++)
+			for (params.fCFA = 0; params.fCFA < kSynthCFA_Count; params.fCFA++)
+				for (params.fDepth = 0; params.fDepth < kSynthDepth_Count; params.fDepth++)
+					for (params.fCompression = 0; params.fCompression < kSynthCompression_Count; params.fCompression++)
+						for (size_t layoutIndex = 0; layoutIndex < layouts.size (); layoutIndex++)
+							for (params.fOpcodes = 0; params.fOpcodes < kSynthOpcodes_Count; params.fOpcodes++)
+								{
+
+								params.fSize   = sizes   [sizeIndex  ];
+								params.fLayout = layouts [layoutIndex];
+
+								if (!cfas         [params.fCFA        ] ||
+									!depths       [params.fDepth      ] ||
+									!compressions [params.fCompression] ||
+									!opcodes      [params.fOpcodes    ] ||
+									!params.IsValid ())
+									{
+									continue;
+									}
+
+								if (combination++ % sample)
+									{
+									continue;
+									}
+
+								dng_string name;
+
+								params.GetName (name);
+
+								params.fSeed = SynthHash (name.Get ()) ^ seed;
+
+								dng_string path (outDir);
+
+								path.Append (name.Get ());
+								path.Append (".dng");
+
+								if (listOnly || gVerbose)
+									{
+									printf ("%s\n", path.Get ());
+									}
+
+								if (listOnly)
+									{
+									continue;
+									}
+
+								try
+									{
+
+									dng_synth (params, path.Get ());
+
+									written++;
+
+									}
+
+								catch (const dng_exception &except)
+									{
+
+									fprintf (stderr,
+											 "*** Error %d writing \"%s\"\n",
+											 (int) except.ErrorCode (),
+											 path.Get ());
+
+									failed++;
+
+									}
+
+								}
+
+		if (!listOnly)
+			{
+
+			printf ("Wrote %u files", (unsigned) written);
+
+			if (failed)
+				{
+				printf (", %u failed", (unsigned) failed);
+				}
+
+			printf ("\n");
+
+			}
+
+		return failed ? 1 : 0;
+
+		}
+
+	catch (...)
+		{
+
+		}
+
+	fprintf (stderr, "*** Exception thrown in main routine\n");
+
+	return 1;
+
+	}
+
+/*****************************************************************************/
+
+#endif
+
+/*****************************************************************************/
@@ -170,6 +170,24 @@ void dng_show_message_f (const char *fmt, ... )
 uint32 ComputeBufferSize(uint32 pixelType, const dng_point &tileSize,
 						 uint32 numPlanes, PaddingType paddingType)
 
+{
+	
+	const uint64 bufferSize = ComputeBufferSize64(pixelType, tileSize,
+												  numPlanes, paddingType);
+	
+	if (bufferSize > 0xFFFFFFFF)
+		{
+		ThrowMemoryFull("Arithmetic overflow computing buffer size");
+		}
+	
+	return static_cast<uint32>(bufferSize);
+}
+
+/*****************************************************************************/
+
+uint64 ComputeBufferSize64(uint32 pixelType, const dng_point &tileSize,
+						   uint32 numPlanes, PaddingType paddingType)
+
 {
 	
 	// Convert tile size to uint32.
@@ -193,10 +211,9 @@ uint32 ComputeBufferSize(uint32 pixelType, const dng_point &tileSize,
 		}
 	
 	// Compute buffer size.
-	uint32 bufferSize;
-	if (!SafeUint32Mult(paddedWidth, tileSizeV, &bufferSize) ||
-		!SafeUint32Mult(bufferSize, pixelSize, &bufferSize) ||
-		!SafeUint32Mult(bufferSize, numPlanes, &bufferSize))
+	uint64 bufferSize;
+	if (!SafeUint64Mult(paddedWidth, tileSizeV, pixelSize, &bufferSize) ||
+		!SafeUint64Mult(bufferSize, numPlanes, &bufferSize))
 		{
 		ThrowMemoryFull("Arithmetic overflow computing buffer size");
 		}
@@ -254,6 +254,11 @@ enum PaddingType
 uint32 ComputeBufferSize(uint32 pixelType, const dng_point &tileSize,
 						 uint32 numPlanes, PaddingType paddingType);
 
+// As ComputeBufferSize(), but for buffers that may need more than 4 GB, such
+// as whole images allocated with dng_memory_allocator::Allocate64().
+uint64 ComputeBufferSize64(uint32 pixelType, const dng_point &tileSize,
+						   uint32 numPlanes, PaddingType paddingType);
+
 /******************************************************************************/
 
 inline uint64 Abs_int64 (int64 x)
@@ -759,6 +764,12 @@ real64 TickCountInSeconds ();
 
 /******************************************************************************/
 
+// Should dng_timer print the elapsed time?  Defaults to true.
+
+extern bool gDNGShowTimers;
+
+/******************************************************************************/
+
 class dng_timer
 	{
 
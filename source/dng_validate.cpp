@@ -40,14 +40,27 @@
 #include "dng_image_writer.h"
 #include "dng_info.h"
 #include "dng_linearization_info.h"
+#include "dng_memory.h"
 #include "dng_mosaic_info.h"
+#include "dng_mutex.h"
 #include "dng_negative.h"
+#include "dng_parse_index.h"
 #include "dng_preview.h"
 #include "dng_render.h"
 #include "dng_simple_image.h"
+#include "dng_string_list.h"
 #include "dng_tag_codes.h"
 #include "dng_tag_types.h"
 #include "dng_tag_values.h"
+#include "dng_utils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if !qWinOS
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
 
 #if qDNGUseXMP
 #include "dng_xmp.h"
@@ -64,29 +77,241 @@
 		
 /*****************************************************************************/
 
-static bool gFourColorBayer = false;
+// Options for validating one file.
+
+struct dng_validate_options
+	{
+	
+	bool fFourColorBayer;
+	
+	int32 fMosaicPlane;
+	
+	uint32 fPreferredSize;
+	uint32 fMinimumSize;
+	uint32 fMaximumSize;
+	
+	uint32 fProxyDNGSize;
+	
+	dng_rect fAreaOfInterest;
+	
+	uint32 fThreadCount;
+	
+	bool fThreadAffinity;
+	
+	bool fBandPipeline;
+	
+	bool fSelectPredictor;
+	
+	int32 fReadGap;
+	
+	bool fParseIndex;
+	
+	bool fResolutionLevel;
+	
+	uint32 fLevelSize;
+	
+	const dng_color_space *fFinalSpace;
+	
+	uint32 fFinalPixelType;
+	
+	bool fFixedPoint;
+	
+	dng_string fDumpStage1;
+	dng_string fDumpStage2;
+	dng_string fDumpStage3;
+	dng_string fDumpTIF;
+	dng_string fDumpDNG;
+	
+	dng_validate_options ()
+	
+		:	fFourColorBayer (false)
+		,	fMosaicPlane    (-1)
+		,	fPreferredSize  (0)
+		,	fMinimumSize    (0)
+		,	fMaximumSize    (0)
+		,	fProxyDNGSize   (0)
+		,	fAreaOfInterest ()
+		,	fThreadCount    (1)
+		,	fThreadAffinity (false)
+		,	fBandPipeline   (false)
+		,	fSelectPredictor (false)
+		,	fReadGap        (-1)
+		,	fParseIndex     (false)
+		,	fResolutionLevel (false)
+		,	fLevelSize      (0)
+		,	fFinalSpace     (&dng_space_sRGB::Get ())
+		,	fFinalPixelType (ttByte)
+		,	fFixedPoint     (false)
+		,	fDumpStage1     ()
+		,	fDumpStage2     ()
+		,	fDumpStage3     ()
+		,	fDumpTIF        ()
+		,	fDumpDNG        ()
+		
+		{
+		
+		}
+	
+	};
+
+/*****************************************************************************/
+
+// Statistics for validating one file.
+
+struct dng_validate_result
+	{
+	
+	dng_error_code fError;
+	
+	real64 fSeconds;
+	
+	real64 fMegapixels;
+	
+	dng_validate_result ()
+	
+		:	fError      (dng_error_none)
+		,	fSeconds    (0.0)
+		,	fMegapixels (0.0)
+		
+		{
+		
+		}
+	
+	};
+
+/*****************************************************************************/
+
+// Parse index sidecar files.
+
+static const char *kParseIndexSuffix = ".dngidx";
+
+/*****************************************************************************/
+
+static uint64 FileModTime (const char *filename)
+	{
+	
+	#if qWinOS
+	
+	(void) filename;
+	
+	return 0;
+	
+	#else
+	
+	struct stat info;
+	
+	if (stat (filename, &info) != 0)
+		{
+		return 0;
+		}
 		
-static int32 gMosaicPlane = -1;
+	return (uint64) info.st_mtime;
+	
+	#endif
+	
+	}
+
+/*****************************************************************************/
 
-static uint32 gPreferredSize = 0;
-static uint32 gMinimumSize   = 0;
-static uint32 gMaximumSize   = 0;
+// Load the sidecar index of a file into index, whose data is held in block.
+// Returns false, leaving the index keyed for recording, if there is no
+// sidecar or it is stale.
 
-static uint32 gProxyDNGSize = 0;
+static bool LoadParseIndex (const char *filename,
+							dng_stream &stream,
+							dng_parse_index &index,
+							AutoPtr<dng_memory_block> &block)
+	{
+	
+	uint64 fileLength = stream.Length ();
+	
+	uint64 modTime = FileModTime (filename);
+	
+	dng_fingerprint headerDigest = dng_parse_index::HeaderDigest (stream);
+	
+	try
+		{
+		
+		dng_string indexName;
+		
+		indexName.Set (filename);
+		
+		indexName.Append (kParseIndexSuffix);
+		
+		// Check first, since dng_file_stream reports files it cannot open.
+		
+		FILE *file = fopen (indexName.Get (), "rb");
+		
+		if (file)
+			{
+			
+			fclose (file);
+			
+			dng_file_stream indexStream (indexName.Get ());
+			
+			block.Reset (indexStream.AsMemoryBlock (gDefaultDNGMemoryAllocator));
+			
+			if (index.Load (block->Buffer (), block->LogicalSize ()) &&
+				index.Matches (fileLength, modTime, headerDigest))
+				{
+				return true;
+				}
+				
+			}
+		
+		}
+		
+	catch (...)
+		{
+		
+		}
+		
+	index.Clear ();
+	
+	block.Reset ();
+	
+	index.SetKey (fileLength, modTime, headerDigest);
+	
+	return false;
+	
+	}
 
-static const dng_color_space *gFinalSpace = &dng_space_sRGB::Get ();
+/*****************************************************************************/
 
-static uint32 gFinalPixelType = ttByte;
+// Write the sidecar index of a file.  A file that cannot be written only
+// costs the next open a full parse.
 
-static dng_string gDumpStage1;
-static dng_string gDumpStage2;
-static dng_string gDumpStage3;
-static dng_string gDumpTIF;
-static dng_string gDumpDNG;
+static void SaveParseIndex (const char *filename,
+							dng_parse_index &index)
+	{
+	
+	try
+		{
+		
+		dng_string indexName;
+		
+		indexName.Set (filename);
+		
+		indexName.Append (kParseIndexSuffix);
+		
+		dng_file_stream indexStream (indexName.Get (), true);
+		
+		index.Save (indexStream);
+		
+		}
+		
+	catch (...)
+		{
+		
+		}
+		
+	}
 
 /*****************************************************************************/
 
-static dng_error_code dng_validate (const char *filename)
+static dng_error_code dng_validate (const char *filename,
+									dng_validate_options &options,
+									real64 &megapixels)
 	{
 	
 	printf ("Validating \"%s\"...\n", filename);
@@ -94,26 +319,71 @@ static dng_error_code dng_validate (const char *filename)
 	try
 		{
 	
-		dng_file_stream stream (filename);
+		dng_file_stream fileStream (filename);
+		
+		// Option to parse through a sidecar index, which is recorded by the
+		// first parse of the file.
+		
+		dng_parse_index index;
+		
+		AutoPtr<dng_memory_block> indexBlock;
+		
+		AutoPtr<dng_parse_index_stream> indexStream;
+		
+		bool saveIndex = false;
+		
+		if (options.fParseIndex)
+			{
+			
+			saveIndex = !LoadParseIndex (filename,
+										 fileStream,
+										 index,
+										 indexBlock);
+			
+			indexStream.Reset (new dng_parse_index_stream (fileStream,
+														   index,
+														   saveIndex));
+			
+			}
+			
+		dng_stream &stream = indexStream.Get () ? (dng_stream &) *indexStream
+												: (dng_stream &) fileStream;
 		
 		dng_host host;
 		
-		host.SetPreferredSize (gPreferredSize);
-		host.SetMinimumSize   (gMinimumSize  );
-		host.SetMaximumSize   (gMaximumSize  );
+		host.SetPreferredSize (options.fPreferredSize);
+		host.SetMinimumSize   (options.fMinimumSize  );
+		host.SetMaximumSize   (options.fMaximumSize  );
 		
 		host.ValidateSizes ();
 		
+		host.SetThreadCount (options.fThreadCount);
+		
+		host.SetThreadAffinity (options.fThreadAffinity);
+		
+		// A stage 2 image read by the band pipeline does not include opcode
+		// list 2, so it cannot be dumped.
+		
+		host.SetBandPipeline (options.fBandPipeline &&
+							  options.fDumpStage2.IsEmpty ());
+		
+		host.SetSelectLosslessPredictor (options.fSelectPredictor);
+		
+		if (options.fReadGap >= 0)
+			{
+			host.SetReadGapThreshold ((uint32) options.fReadGap);
+			}
+		
 		if (host.MinimumSize ())
 			{
 			
 			host.SetForPreview (true);
 			
-			gDumpDNG.Clear ();
+			options.fDumpDNG.Clear ();
 			
 			}
 			
-		if (gDumpDNG.NotEmpty ())
+		if (options.fDumpDNG.NotEmpty ())
 			{
 			
 			host.SetSaveDNGVersion (dngVersion_SaveDefault);
@@ -147,14 +417,89 @@ static dng_error_code dng_validate (const char *filename)
 			
 			negative->PostParse (host, stream, info);
 			
+			// The opcode lists, which hold any gain maps, are parsed by the
+			// image readers, so parse them now to include them in the index.
+			
+			negative->ReadOpcodeLists (host, stream, info);
+			
+			if (saveIndex)
+				{
+				
+				indexStream->SetRecording (false);
+				
+				SaveParseIndex (filename, index);
+				
+				}
+			
+			// Option to read just a resolution level, from the cheapest
+			// source.
+			
+			if (options.fResolutionLevel)
+				{
+				
+				dng_resolution_level level;
+				
+				AutoPtr<dng_image> image;
+				
+					{
+					
+					dng_timer timer ("Resolution level time");
+					
+					image.Reset (negative->ReadResolutionLevel (host,
+																stream,
+																info,
+																options.fLevelSize,
+																level));
+					
+					}
+					
+				printf ("Resolution level: %u x %u from %s (IFD %u), decode scale 1/%u%s%s%s\n",
+						(unsigned) image->Bounds ().W (),
+						(unsigned) image->Bounds ().H (),
+						level.SourceName (),
+						(unsigned) level.fIFDIndex,
+						(unsigned) level.fDecodeScale,
+						level.fLossy          ? ", lossy"           : "",
+						level.fFixedRendering ? ", fixed rendering" : "",
+						level.fTooSmall       ? ", too small"       : "");
+						
+				megapixels = (real64) image->Bounds ().W () *
+							 (real64) image->Bounds ().H () * 1.0E-6;
+						
+				if (options.fDumpTIF.NotEmpty ())
+					{
+					
+					image->MaterializeRotate (negative->Orientation ());
+					
+					dng_file_stream stream2 (options.fDumpTIF.Get (), true);
+					
+					dng_image_writer writer;
+					
+					writer.WriteTIFF (host,
+									  stream2,
+									  *image.Get (),
+									  image->Planes () >= 3 ? piRGB
+															: piBlackIsZero);
+					
+					options.fDumpTIF.Clear ();
+					
+					}
+					
+				return dng_error_none;
+				
+				}
+			
 				{
 				
 				dng_timer timer ("Raw image read time");
 
-				negative->ReadStage1Image (host, stream, info);
+				negative->ReadStage1ImageArea (host, stream, info, options.fAreaOfInterest);
 				
 				}
 				
+			megapixels = (real64) negative->Stage1Image ()->Bounds ().W () *
+						 (real64) negative->Stage1Image ()->Bounds ().H () * 1.0E-6;
+				
 			if (info.fMaskIndex != -1)
 				{
 				
@@ -170,10 +515,10 @@ static dng_error_code dng_validate (const char *filename)
 					 
 		// Option to write stage 1 image.
 			
-		if (gDumpStage1.NotEmpty ())
+		if (options.fDumpStage1.NotEmpty ())
 			{
 			
-			dng_file_stream stream2 (gDumpStage1.Get (), true);
+			dng_file_stream stream2 (options.fDumpStage1.Get (), true);
 			
 			const dng_image &stage1 = *negative->Stage1Image ();
 			
@@ -185,7 +530,7 @@ static dng_error_code dng_validate (const char *filename)
 							  stage1.Planes () >= 3 ? piRGB 
 												    : piBlackIsZero);
 
-			gDumpStage1.Clear ();
+			options.fDumpStage1.Clear ();
 			
 			}
 			
@@ -195,7 +540,7 @@ static dng_error_code dng_validate (const char *filename)
 		
 		// Four color Bayer option.
 		
-		if (gFourColorBayer)
+		if (options.fFourColorBayer)
 			{
 			negative->SetFourColorBayer ();
 			}
@@ -210,10 +555,10 @@ static dng_error_code dng_validate (const char *filename)
 						         
 			}
 					 
-		if (gDumpStage2.NotEmpty ())
+		if (options.fDumpStage2.NotEmpty ())
 			{
 			
-			dng_file_stream stream2 (gDumpStage2.Get (), true);
+			dng_file_stream stream2 (options.fDumpStage2.Get (), true);
 			
 			const dng_image &stage2 = *negative->Stage2Image ();
 						
@@ -225,7 +570,7 @@ static dng_error_code dng_validate (const char *filename)
 							  stage2.Planes () >= 3 ? piRGB 
 												    : piBlackIsZero);
 			
-			gDumpStage2.Clear ();
+			options.fDumpStage2.Clear ();
 			
 			}
 			
@@ -236,13 +581,13 @@ static dng_error_code dng_validate (const char *filename)
 			dng_timer timer ("Interpolate time");
 		
 			negative->BuildStage3Image (host,
-									    gMosaicPlane);
+									    options.fMosaicPlane);
 							
 			}
 			
 		// Convert to proxy, if requested.
 		
-		if (gProxyDNGSize)
+		if (options.fProxyDNGSize)
 			{
 			
 			dng_timer timer ("ConvertToProxy time");
@@ -251,7 +596,7 @@ static dng_error_code dng_validate (const char *filename)
 			
 			negative->ConvertToProxy (host,
 									  writer,
-									  gProxyDNGSize);
+									  options.fProxyDNGSize);
 		
 			}
 			
@@ -266,10 +611,10 @@ static dng_error_code dng_validate (const char *filename)
 			
 			}
 			
-		if (gDumpStage3.NotEmpty ())
+		if (options.fDumpStage3.NotEmpty ())
 			{
 			
-			dng_file_stream stream2 (gDumpStage3.Get (), true);
+			dng_file_stream stream2 (options.fDumpStage3.Get (), true);
 			
 			const dng_image &stage3 = *negative->Stage3Image ();
 			
@@ -281,13 +626,13 @@ static dng_error_code dng_validate (const char *filename)
 							  stage3.Planes () >= 3 ? piRGB 
 												    : piBlackIsZero);
 			
-			gDumpStage3.Clear ();
+			options.fDumpStage3.Clear ();
 			
 			}
 			
 		// Output DNG file if requested.
 			
-		if (gDumpDNG.NotEmpty ())
+		if (options.fDumpDNG.NotEmpty ())
 			{
 			
 			// Build the preview list.
@@ -327,6 +672,8 @@ static dng_error_code dng_validate (const char *filename)
 					
 					render.SetFinalPixelType (ttByte);
 					
+					render.SetFixedPoint (options.fFixedPoint);
+					
 					render.SetMaximumSize (previewIndex == 0 ? 256 : 1024);
 				
 					previewImage.Reset (render.Render ());
@@ -396,7 +743,7 @@ static dng_error_code dng_validate (const char *filename)
 				
 			// Write DNG file.
 			
-			dng_file_stream stream2 (gDumpDNG.Get (), true);
+			dng_file_stream stream2 (options.fDumpDNG.Get (), true);
 			
 				{
 				
@@ -413,21 +760,22 @@ static dng_error_code dng_validate (const char *filename)
 
 				}
 				
-			gDumpDNG.Clear ();
+			options.fDumpDNG.Clear ();
 			
 			}
 					
 		// Output TIF file if requested.
 			
-		if (gDumpTIF.NotEmpty ())
+		if (options.fDumpTIF.NotEmpty ())
 			{
 			
 			// Render final image.
 				
 			dng_render render (host, *negative);
 			
-			render.SetFinalSpace     (*gFinalSpace   );
-			render.SetFinalPixelType (gFinalPixelType);
+			render.SetFinalSpace     (*options.fFinalSpace   );
+			render.SetFinalPixelType (options.fFinalPixelType);
+			render.SetFixedPoint     (options.fFixedPoint    );
 			
 			if (host.MinimumSize ())
 				{
@@ -449,7 +797,7 @@ static dng_error_code dng_validate (const char *filename)
 				
 				}
 				
-			finalImage->Rotate (negative->Orientation ());
+			finalImage->MaterializeRotate (negative->Orientation ());
 			
 			// Now that Camera Raw supports non-raw formats, we should
 			// not keep any Camera Raw settings in the XMP around when
@@ -469,7 +817,7 @@ static dng_error_code dng_validate (const char *filename)
 			
 			// Write TIF file.
 			
-			dng_file_stream stream2 (gDumpTIF.Get (), true);
+			dng_file_stream stream2 (options.fDumpTIF.Get (), true);
 			
 				{
 				
@@ -488,7 +836,7 @@ static dng_error_code dng_validate (const char *filename)
 								  
 				}
 				
-			gDumpTIF.Clear ();
+			options.fDumpTIF.Clear ();
 			
 			}
 					
@@ -516,80 +864,525 @@ static dng_error_code dng_validate (const char *filename)
 
 /*****************************************************************************/
 
-int main (int argc, char *argv [])
+static void dng_validate_job (const char *filename,
+							  dng_validate_options &options,
+							  dng_validate_result &result)
 	{
 	
-	try
-		{
+	real64 startTime = TickTimeInSeconds ();
+	
+	result.fError = dng_validate (filename,
+								  options,
+								  result.fMegapixels);
+	
+	result.fSeconds = TickTimeInSeconds () - startTime;
+	
+	}
 
-		if (argc == 1)
-			{
+/*****************************************************************************/
 
-			fprintf (stderr,
-					 "\n"
-					 "dng_validate, version " kDNGValidateVersion " "
-					 #if qDNG64Bit
-					 "(64-bit)"
-					 #else
-					 "(32-bit)"
-					 #endif
-					 "\n"
-					 "Copyright 2005-2012 Adobe Systems, Inc.\n"
-					 "\n"
-					 "Usage:  %s [options] file1 file2 ...\n"
-					 "\n"
-					 "Valid options:\n"
-					 "-v            Verbose mode\n"
-					 "-d <num>      Dump line limit (implies -v)\n"
-					 "-b4           Use four-color Bayer interpolation\n"
-					 "-s <num>      Use this sample of multi-sample CFAs\n"
-					 "-size <num>   Preferred preview image size\n"
-					 "-min <num>    Minimum preview image size\n"
-					 "-max <num>    Maximum preview image size\n" 
-					 "-proxy <num>  Target size for proxy DNG\n"
-					 "-cs1          Color space: \"sRGB\" (default)\n"
-					 "-cs2          Color space: \"Adobe RGB\"\n"
-					 "-cs3          Color space: \"ProPhoto RGB\"\n"
-					 "-cs4          Color space: \"ColorMatch RGB\"\n"
-					 "-cs5          Color space: \"Gray Gamma 1.8\"\n"
-					 "-cs6          Color space: \"Gray Gamma 2.2\"\n"
-					 "-16           16-bits/channel output\n"
-					 "-1 <file>     Write stage 1 image to \"<file>.tif\"\n"
-					 "-2 <file>     Write stage 2 image to \"<file>.tif\"\n"
-					 "-3 <file>     Write stage 3 image to \"<file>.tif\"\n"
-					 "-tif <file>   Write TIF image to \"<file>.tif\"\n"
-					 "-dng <file>   Write DNG image to \"<file>.dng\"\n"
-					 "\n",
-					 argv [0]);
-					 
-			return 1;
-			
-			}
-			
-		int index;
+// Returns the output file name to use for one file of a batch, by inserting
+// the base name of the input file before the extension of the output name.
+
+static dng_string BatchOutputName (const dng_string &name,
+								   const char *filename)
+	{
+	
+	if (name.IsEmpty ())
+		{
+		return name;
+		}
 		
-		for (index = 1; index < argc && argv [index] [0] == '-'; index++)
+	const char *base = filename;
+	
+	for (const char *s = filename; *s; s++)
+		{
+		
+		if (*s == '/' || *s == '\\')
 			{
-			
-			dng_string option;
-			
-			option.Set (&argv [index] [1]);
-			
-			if (option.Matches ("v", true))
-				{
-				gVerbose = true;
-				}
-				
-			else if (option.Matches ("d", true))
-				{
-					
-				gVerbose = true;
-				
-				gDumpLineLimit = 0;
-				
-				if (index + 1 < argc)
-					{
-					gDumpLineLimit = atoi (argv [++index]);
+			base = s + 1;
+			}
+		
+		}
+		
+	dng_string baseName;
+	
+	baseName.Set (base);
+	
+	const char *baseExt = strrchr (base, '.');
+	
+	if (baseExt)
+		{
+		baseName.Truncate ((uint32) (baseExt - base));
+		}
+		
+	const char *text = name.Get ();
+	
+	const char *ext = strrchr (text, '.');
+	
+	dng_string result;
+	
+	result.Set (text);
+	
+	if (ext)
+		{
+		result.Truncate ((uint32) (ext - text));
+		}
+		
+	result.Append ("_");
+	result.Append (baseName.Get ());
+	
+	if (ext)
+		{
+		result.Append (ext);
+		}
+		
+	return result;
+	
+	}
+
+/*****************************************************************************/
+
+// Adds the files named in a list file (one per line), or the DNG files in a
+// directory (sorted by name), to a batch.
+
+static bool AddBatchFiles (const char *path,
+						   dng_string_list &files)
+	{
+	
+	#if !qWinOS
+	
+	DIR *dir = opendir (path);
+	
+	if (dir)
+		{
+		
+		uint32 first = files.Count ();
+		
+		while (struct dirent *entry = readdir (dir))
+			{
+			
+			dng_string entryName;
+			
+			entryName.Set (entry->d_name);
+			
+			if (!entryName.EndsWith (".dng"))
+				{
+				continue;
+				}
+				
+			dng_string name;
+			
+			name.Set (path);
+			
+			if (!name.EndsWith ("/"))
+				{
+				name.Append ("/");
+				}
+				
+			name.Append (entryName.Get ());
+			
+			uint32 index = first;
+			
+			while (index < files.Count () &&
+				   strcmp (files [index].Get (), name.Get ()) < 0)
+				{
+				index++;
+				}
+				
+			files.Insert (index, name);
+			
+			}
+			
+		closedir (dir);
+		
+		return true;
+		
+		}
+		
+	#endif
+	
+	FILE *list = fopen (path, "r");
+	
+	if (!list)
+		{
+		return false;
+		}
+		
+	char line [1024];
+	
+	while (fgets (line, sizeof (line), list))
+		{
+		
+		dng_string name;
+		
+		name.Set (line);
+		
+		name.SetLineEndingsToNewLines ();
+		
+		name.Replace ("\n", "");
+		
+		name.TrimLeadingBlanks  ();
+		name.TrimTrailingBlanks ();
+		
+		if (name.NotEmpty () && !name.StartsWith ("#"))
+			{
+			files.Append (name);
+			}
+		
+		}
+		
+	fclose (list);
+	
+	return true;
+	
+	}
+
+/*****************************************************************************/
+
+// Shared state for the worker threads of a batch.
+
+class dng_validate_batch
+	{
+	
+	private:
+	
+		const dng_string_list &fFiles;
+		
+		const dng_validate_options &fOptions;
+		
+		dng_validate_result *fResults;
+		
+		#if qDNGThreadSafe
+		
+		dng_mutex fMutex;
+		
+		#endif
+		
+		uint32 fNextFile;
+		
+	public:
+	
+		dng_validate_batch (const dng_string_list &files,
+							const dng_validate_options &options,
+							dng_validate_result *results)
+		
+			:	fFiles    (files)
+			,	fOptions  (options)
+			,	fResults  (results)
+			
+			#if qDNGThreadSafe
+			,	fMutex    ("dng_validate_batch")
+			#endif
+			
+			,	fNextFile (0)
+			
+			{
+			
+			}
+			
+		void Run ()
+			{
+			
+			while (true)
+				{
+				
+				uint32 index;
+				
+					{
+					
+					#if qDNGThreadSafe
+					dng_lock_mutex lock (&fMutex);
+					#endif
+					
+					if (fNextFile == fFiles.Count ())
+						{
+						return;
+						}
+						
+					index = fNextFile++;
+					
+					}
+					
+				const char *filename = fFiles [index].Get ();
+				
+				// Each file gets its own copy of the options, with its own
+				// output file names.
+				
+				dng_validate_options options (fOptions);
+				
+				options.fDumpStage1 = BatchOutputName (fOptions.fDumpStage1, filename);
+				options.fDumpStage2 = BatchOutputName (fOptions.fDumpStage2, filename);
+				options.fDumpStage3 = BatchOutputName (fOptions.fDumpStage3, filename);
+				options.fDumpTIF    = BatchOutputName (fOptions.fDumpTIF   , filename);
+				options.fDumpDNG    = BatchOutputName (fOptions.fDumpDNG   , filename);
+				
+				dng_validate_job (filename,
+								  options,
+								  fResults [index]);
+				
+				}
+			
+			}
+			
+	private:
+
+		// Hidden copy constructor and assignment operator.
+
+		dng_validate_batch (const dng_validate_batch &);
+
+		dng_validate_batch & operator= (const dng_validate_batch &);
+		
+	};
+
+/*****************************************************************************/
+
+#if qDNGThreadSafe
+
+static void * dng_validate_batch_thread (void *arg)
+	{
+	
+	((dng_validate_batch *) arg)->Run ();
+	
+	return NULL;
+	
+	}
+
+#endif
+
+/*****************************************************************************/
+
+// Validates a batch of files, using up to jobCount files at once, and
+// reports the throughput and latency.  Returns the last error, if any.
+
+static dng_error_code dng_validate_files (const dng_string_list &files,
+										  const dng_validate_options &options,
+										  uint32 jobCount)
+	{
+	
+	uint32 fileCount = files.Count ();
+	
+	if (fileCount == 0)
+		{
+		return dng_error_none;
+		}
+		
+	AutoArray<dng_validate_result> results (fileCount);
+	
+	dng_validate_batch batch (files, options, results.Get ());
+	
+	real64 startTime = TickTimeInSeconds ();
+	
+	#if qDNGThreadSafe
+	
+	jobCount = Pin_uint32 (1, jobCount, fileCount);
+	
+	AutoArray<pthread_t> thread (jobCount);
+	
+	uint32 threadCount = 1;
+	
+	while (threadCount < jobCount &&
+		   pthread_create (&thread [threadCount],
+						   NULL,
+						   dng_validate_batch_thread,
+						   &batch) == 0)
+		{
+		threadCount++;
+		}
+		
+	batch.Run ();
+	
+	for (uint32 index = 1; index < threadCount; index++)
+		{
+		pthread_join (thread [index], NULL);
+		}
+		
+	#else
+	
+	(void) jobCount;
+	
+	batch.Run ();
+	
+	#endif
+	
+	real64 totalTime = Max_real64 (TickTimeInSeconds () - startTime, 1.0E-6);
+	
+	// Report results.
+	
+	dng_error_code result = dng_error_none;
+	
+	uint32 failed = 0;
+	
+	real64 megapixels = 0.0;
+	
+	AutoArray<real64> latency (fileCount);
+	
+	for (uint32 index = 0; index < fileCount; index++)
+		{
+		
+		if (results [index].fError != dng_error_none)
+			{
+			
+			printf ("*** Error %d validating \"%s\"\n",
+					(int) results [index].fError,
+					files [index].Get ());
+					
+			result = results [index].fError;
+			
+			failed++;
+			
+			}
+			
+		megapixels += results [index].fMegapixels;
+		
+		// Insertion sort, since batches are not that large.
+		
+		uint32 j = index;
+		
+		while (j > 0 && latency [j - 1] > results [index].fSeconds)
+			{
+			latency [j] = latency [j - 1];
+			j--;
+			}
+			
+		latency [j] = results [index].fSeconds;
+		
+		}
+		
+	printf ("\nBatch: %u files (%u failed), %u jobs, %u threads/job, %0.3f sec\n",
+			(unsigned) fileCount,
+			(unsigned) failed,
+			(unsigned) jobCount,
+			(unsigned) options.fThreadCount,
+			totalTime);
+			
+	printf ("Throughput: %0.2f files/sec, %0.2f MP/sec\n",
+			fileCount / totalTime,
+			megapixels / totalTime);
+			
+	const uint32 kPercentiles [] = { 50, 90, 99 };
+	
+	printf ("Latency: min %0.3f", latency [0]);
+	
+	for (uint32 k = 0; k < sizeof (kPercentiles) / sizeof (kPercentiles [0]); k++)
+		{
+		
+		// Nearest rank percentile.
+		
+		uint32 rank = (kPercentiles [k] * fileCount + 99) / 100;
+		
+		printf (", p%u %0.3f",
+				(unsigned) kPercentiles [k],
+				latency [Pin_uint32 (1, rank, fileCount) - 1]);
+		
+		}
+		
+	printf (", max %0.3f sec\n", latency [fileCount - 1]);
+	
+	return result;
+	
+	}
+
+/*****************************************************************************/
+
+int main (int argc, char *argv [])
+	{
+	
+	try
+		{
+
+		if (argc == 1)
+			{
+
+			fprintf (stderr,
+					 "\n"
+					 "dng_validate, version " kDNGValidateVersion " "
+					 #if qDNG64Bit
+					 "(64-bit)"
+					 #else
+					 "(32-bit)"
+					 #endif
+					 "\n"
+					 "Copyright 2005-2012 Adobe Systems, Inc.\n"
+					 "\n"
+					 "Usage:  %s [options] file1 file2 ...\n"
+					 "\n"
+					 "Valid options:\n"
+					 "-v            Verbose mode\n"
+					 "-d <num>      Dump line limit (implies -v)\n"
+					 "-b4           Use four-color Bayer interpolation\n"
+					 "-s <num>      Use this sample of multi-sample CFAs\n"
+					 "-size <num>   Preferred preview image size\n"
+					 "-min <num>    Minimum preview image size\n"
+					 "-max <num>    Maximum preview image size\n" 
+					 "-proxy <num>  Target size for proxy DNG\n"
+					 "-roi <t> <l> <b> <r>  Only read this area of the raw image\n"
+					 "-cs1          Color space: \"sRGB\" (default)\n"
+					 "-cs2          Color space: \"Adobe RGB\"\n"
+					 "-cs3          Color space: \"ProPhoto RGB\"\n"
+					 "-cs4          Color space: \"ColorMatch RGB\"\n"
+					 "-cs5          Color space: \"Gray Gamma 1.8\"\n"
+					 "-cs6          Color space: \"Gray Gamma 2.2\"\n"
+					 "-16           16-bits/channel output\n"
+					 "-fixed        Render 8-bit output in fixed point\n"
+					 "-1 <file>     Write stage 1 image to \"<file>.tif\"\n"
+					 "-2 <file>     Write stage 2 image to \"<file>.tif\"\n"
+					 "-3 <file>     Write stage 3 image to \"<file>.tif\"\n"
+					 "-tif <file>   Write TIF image to \"<file>.tif\"\n"
+					 "-dng <file>   Write DNG image to \"<file>.dng\"\n"
+					 "-predictor    Choose the lossless JPEG predictor for each tile\n"
+					 "-readgap <num> Largest gap in bytes read through to merge tile reads\n"
+					 "-index        Parse through the index \"<file>.dngidx\", which is written\n"
+					 "              if missing or out of date\n"
+					 "-threads <num> Threads to use for each file\n"
+					 "-affinity     Bind threads to CPUs and spread large images over them\n"
+					 "-bands        Linearize, apply opcode list 2, interpolate and apply\n"
+					 "              opcode list 3 one tile at a time\n"
+					 "-level <num>  Only read an image of <num> pixels (0 = full size) from\n"
+					 "              the cheapest source, and report it (-tif writes it)\n"
+					 "-jobs <num>   Number of files to process at once (implies -batch)\n"
+					 "-batch <path> Also process the files listed in <path>, or the DNG\n"
+					 "              files in directory <path>, and report throughput.\n"
+					 "              Output file names get \"_<input name>\" appended.\n"
+					 "\n",
+					 argv [0]);
+					 
+			return 1;
+			
+			}
+			
+		dng_validate_options options;
+		
+		dng_string_list batchFiles;
+		
+		bool batchMode = false;
+		
+		uint32 jobCount = 1;
+		
+		int index;
+		
+		for (index = 1; index < argc && argv [index] [0] == '-'; index++)
+			{
+			
+			dng_string option;
+			
+			option.Set (&argv [index] [1]);
+			
+			if (option.Matches ("v", true))
+				{
+				gVerbose = true;
+				}
+				
+			else if (option.Matches ("d", true))
+				{
+					
+				gVerbose = true;
+				
+				gDumpLineLimit = 0;
+				
+				if (index + 1 < argc)
+					{
+					gDumpLineLimit = atoi (argv [++index]);
 					}
 					
 				if (!gDumpLineLimit)
@@ -605,7 +1398,7 @@ int main (int argc, char *argv [])
 				
 				if (index + 1 < argc)
 					{
-					gMosaicPlane = atoi (argv [++index]);
+					options.fMosaicPlane = atoi (argv [++index]);
 					}
 					
 				else
@@ -618,7 +1411,7 @@ int main (int argc, char *argv [])
 					
 			else if (option.Matches ("b4", true))
 				{
-				gFourColorBayer = true;
+				options.fFourColorBayer = true;
 				}
 					
 			else if (option.Matches ("size", true))
@@ -626,7 +1419,7 @@ int main (int argc, char *argv [])
 				
 				if (index + 1 < argc)
 					{
-					gPreferredSize = (uint32) atoi (argv [++index]);
+					options.fPreferredSize = (uint32) atoi (argv [++index]);
 					}
 					
 				else
@@ -642,7 +1435,7 @@ int main (int argc, char *argv [])
 				
 				if (index + 1 < argc)
 					{
-					gMinimumSize = (uint32) atoi (argv [++index]);
+					options.fMinimumSize = (uint32) atoi (argv [++index]);
 					}
 					
 				else
@@ -658,7 +1451,7 @@ int main (int argc, char *argv [])
 				
 				if (index + 1 < argc)
 					{
-					gMaximumSize = (uint32) atoi (argv [++index]);
+					options.fMaximumSize = (uint32) atoi (argv [++index]);
 					}
 					
 				else
@@ -674,7 +1467,7 @@ int main (int argc, char *argv [])
 				
 				if (index + 1 < argc)
 					{
-					gProxyDNGSize = (uint32) atoi (argv [++index]);
+					options.fProxyDNGSize = (uint32) atoi (argv [++index]);
 					}
 					
 				else
@@ -685,74 +1478,211 @@ int main (int argc, char *argv [])
 
 				}
 					
+			else if (option.Matches ("roi", true))
+				{
+				
+				if (index + 4 < argc)
+					{
+					options.fAreaOfInterest.t = atoi (argv [++index]);
+					options.fAreaOfInterest.l = atoi (argv [++index]);
+					options.fAreaOfInterest.b = atoi (argv [++index]);
+					options.fAreaOfInterest.r = atoi (argv [++index]);
+					}
+					
+				else
+					{
+					fprintf (stderr, "*** Missing numbers after -roi\n");
+					return 1;
+					}
+
+				}
+					
+			else if (option.Matches ("threads", true))
+				{
+				
+				if (index + 1 < argc)
+					{
+					options.fThreadCount = (uint32) atoi (argv [++index]);
+					}
+					
+				else
+					{
+					fprintf (stderr, "*** Missing number after -threads\n");
+					return 1;
+					}
+
+				}
+					
+			else if (option.Matches ("readgap", true))
+				{
+				
+				if (index + 1 < argc)
+					{
+					options.fReadGap = Max_int32 (0, atoi (argv [++index]));
+					}
+					
+				else
+					{
+					fprintf (stderr, "*** Missing number after -readgap\n");
+					return 1;
+					}
+
+				}
+					
+			else if (option.Matches ("level", true))
+				{
+				
+				if (index + 1 < argc)
+					{
+					options.fResolutionLevel = true;
+					options.fLevelSize = (uint32) atoi (argv [++index]);
+					}
+					
+				else
+					{
+					fprintf (stderr, "*** Missing number after -level\n");
+					return 1;
+					}
+
+				}
+					
+			else if (option.Matches ("affinity", true))
+				{
+				
+				options.fThreadAffinity = true;
+				
+				}
+					
+			else if (option.Matches ("bands", true))
+				{
+				
+				options.fBandPipeline = true;
+				
+				}
+					
+			else if (option.Matches ("index", true))
+				{
+				
+				options.fParseIndex = true;
+				
+				}
+				
+			else if (option.Matches ("predictor", true))
+				{
+				
+				options.fSelectPredictor = true;
+				
+				}
+					
+			else if (option.Matches ("jobs", true))
+				{
+				
+				if (index + 1 >= argc)
+					{
+					fprintf (stderr, "*** Missing number after -jobs\n");
+					return 1;
+					}
+					
+				jobCount = (uint32) atoi (argv [++index]);
+					
+				if (!jobCount)
+					{
+					fprintf (stderr, "*** Invalid number after -jobs\n");
+					return 1;
+					}
+					
+				batchMode = true;
+
+				}
+					
+			else if (option.Matches ("batch", true))
+				{
+				
+				if (index + 1 >= argc || !AddBatchFiles (argv [++index], batchFiles))
+					{
+					fprintf (stderr, "*** Missing or unreadable list after -batch\n");
+					return 1;
+					}
+					
+				batchMode = true;
+
+				}
+					
 			else if (option.Matches ("cs1", true))
 				{
 				
-				gFinalSpace = &dng_space_sRGB::Get ();
+				options.fFinalSpace = &dng_space_sRGB::Get ();
 				
 				}
 					
 			else if (option.Matches ("cs2", true))
 				{
 				
-				gFinalSpace = &dng_space_AdobeRGB::Get ();
+				options.fFinalSpace = &dng_space_AdobeRGB::Get ();
 				
 				}
 					
 			else if (option.Matches ("cs3", true))
 				{
 				
-				gFinalSpace = &dng_space_ProPhoto::Get ();
+				options.fFinalSpace = &dng_space_ProPhoto::Get ();
 				
 				}
 					
 			else if (option.Matches ("cs4", true))
 				{
 				
-				gFinalSpace = &dng_space_ColorMatch::Get ();
+				options.fFinalSpace = &dng_space_ColorMatch::Get ();
 				
 				}
 					
 			else if (option.Matches ("cs5", true))
 				{
 				
-				gFinalSpace = &dng_space_GrayGamma18::Get ();
+				options.fFinalSpace = &dng_space_GrayGamma18::Get ();
 				
 				}
 					
 			else if (option.Matches ("cs6", true))
 				{
 				
-				gFinalSpace = &dng_space_GrayGamma22::Get ();
+				options.fFinalSpace = &dng_space_GrayGamma22::Get ();
 				
 				}
 					
 			else if (option.Matches ("16"))
 				{
 				
-				gFinalPixelType = ttShort;
+				options.fFinalPixelType = ttShort;
+				
+				}
+					
+			else if (option.Matches ("fixed", true))
+				{
+				
+				options.fFixedPoint = true;
 				
 				}
 					
 			else if (option.Matches ("1"))
 				{
 				
-				gDumpStage1.Clear ();
+				options.fDumpStage1.Clear ();
 				
 				if (index + 1 < argc)
 					{
-					gDumpStage1.Set (argv [++index]);
+					options.fDumpStage1.Set (argv [++index]);
 					}
 					
-				if (gDumpStage1.IsEmpty () || gDumpStage1.StartsWith ("-"))
+				if (options.fDumpStage1.IsEmpty () || options.fDumpStage1.StartsWith ("-"))
 					{
 					fprintf (stderr, "*** Missing file name after -1\n");
 					return 1;
 					}
 				
-				if (!gDumpStage1.EndsWith (".tif"))
+				if (!options.fDumpStage1.EndsWith (".tif"))
 					{
-					gDumpStage1.Append (".tif");
+					options.fDumpStage1.Append (".tif");
 					}
 				
 				}
@@ -760,22 +1690,22 @@ int main (int argc, char *argv [])
 			else if (option.Matches ("2"))
 				{
 				
-				gDumpStage2.Clear ();
+				options.fDumpStage2.Clear ();
 				
 				if (index + 1 < argc)
 					{
-					gDumpStage2.Set (argv [++index]);
+					options.fDumpStage2.Set (argv [++index]);
 					}
 					
-				if (gDumpStage2.IsEmpty () || gDumpStage2.StartsWith ("-"))
+				if (options.fDumpStage2.IsEmpty () || options.fDumpStage2.StartsWith ("-"))
 					{
 					fprintf (stderr, "*** Missing file name after -2\n");
 					return 1;
 					}
 				
-				if (!gDumpStage2.EndsWith (".tif"))
+				if (!options.fDumpStage2.EndsWith (".tif"))
 					{
-					gDumpStage2.Append (".tif");
+					options.fDumpStage2.Append (".tif");
 					}
 				
 				}
@@ -783,22 +1713,22 @@ int main (int argc, char *argv [])
 			else if (option.Matches ("3"))
 				{
 				
-				gDumpStage3.Clear ();
+				options.fDumpStage3.Clear ();
 				
 				if (index + 1 < argc)
 					{
-					gDumpStage3.Set (argv [++index]);
+					options.fDumpStage3.Set (argv [++index]);
 					}
 					
-				if (gDumpStage3.IsEmpty () || gDumpStage3.StartsWith ("-"))
+				if (options.fDumpStage3.IsEmpty () || options.fDumpStage3.StartsWith ("-"))
 					{
 					fprintf (stderr, "*** Missing file name after -3\n");
 					return 1;
 					}
 				
-				if (!gDumpStage3.EndsWith (".tif"))
+				if (!options.fDumpStage3.EndsWith (".tif"))
 					{
-					gDumpStage3.Append (".tif");
+					options.fDumpStage3.Append (".tif");
 					}
 				
 				}
@@ -806,22 +1736,22 @@ int main (int argc, char *argv [])
 			else if (option.Matches ("tif", true))
 				{
 				
-				gDumpTIF.Clear ();
+				options.fDumpTIF.Clear ();
 				
 				if (index + 1 < argc)
 					{
-					gDumpTIF.Set (argv [++index]);
+					options.fDumpTIF.Set (argv [++index]);
 					}
 					
-				if (gDumpTIF.IsEmpty () || gDumpTIF.StartsWith ("-"))
+				if (options.fDumpTIF.IsEmpty () || options.fDumpTIF.StartsWith ("-"))
 					{
 					fprintf (stderr, "*** Missing file name after -tif\n");
 					return 1;
 					}
 				
-				if (!gDumpTIF.EndsWith (".tif"))
+				if (!options.fDumpTIF.EndsWith (".tif"))
 					{
-					gDumpTIF.Append (".tif");
+					options.fDumpTIF.Append (".tif");
 					}
 				
 				}
@@ -829,22 +1759,22 @@ int main (int argc, char *argv [])
 			else if (option.Matches ("dng", true))
 				{
 				
-				gDumpDNG.Clear ();
+				options.fDumpDNG.Clear ();
 				
 				if (index + 1 < argc)
 					{
-					gDumpDNG.Set (argv [++index]);
+					options.fDumpDNG.Set (argv [++index]);
 					}
 					
-				if (gDumpDNG.IsEmpty () || gDumpDNG.StartsWith ("-"))
+				if (options.fDumpDNG.IsEmpty () || options.fDumpDNG.StartsWith ("-"))
 					{
 					fprintf (stderr, "*** Missing file name after -dng\n");
 					return 1;
 					}
 				
-				if (!gDumpDNG.EndsWith (".dng"))
+				if (!options.fDumpDNG.EndsWith (".dng"))
 					{
-					gDumpDNG.Append (".dng");
+					options.fDumpDNG.Append (".dng");
 					}
 				
 				}
@@ -857,7 +1787,7 @@ int main (int argc, char *argv [])
 				
 			}
 					
-		if (index == argc)
+		if (index == argc && batchFiles.Count () == 0)
 			{
 			fprintf (stderr, "*** No file specified\n");
 			return 1;
@@ -871,10 +1801,48 @@ int main (int argc, char *argv [])
 			
 		int result = 0;
 		
+		if (batchMode)
+			{
+			
+			while (index < argc)
+				{
+				
+				dng_string name;
+				
+				name.Set (argv [index++]);
+				
+				batchFiles.Append (name);
+				
+				}
+				
+			// Per-stage timers from concurrent files would be interleaved.
+				
+			if (jobCount > 1)
+				{
+				gDNGShowTimers = false;
+				}
+				
+			dng_error_code error_code = dng_validate_files (batchFiles,
+															options,
+															jobCount);
+			
+			if (error_code != dng_error_none)
+				{
+				
+				result = error_code - dng_error_unknown + 100;
+				
+				}
+			
+			}
+		
 		while (index < argc)
 			{
 			
-			dng_error_code error_code = dng_validate (argv [index++]);
+			real64 megapixels = 0.0;
+			
+			dng_error_code error_code = dng_validate (argv [index++],
+													  options,
+													  megapixels);
 			if (error_code != dng_error_none)
 				{
 				